@@ -4,4 +4,5 @@ C:\VulkanSDK\1.0.39.1\Bin\glslangValidator -V unlit.vert -o ..\..\..\aether3d_bu
 C:\VulkanSDK\1.0.39.1\Bin\glslangValidator -V unlit.frag -o ..\..\..\aether3d_build\Samples\unlit_frag.spv
 C:\VulkanSDK\1.0.39.1\Bin\glslangValidator -V skybox.vert -o ..\..\..\aether3d_build\Samples\skybox_vert.spv
 C:\VulkanSDK\1.0.39.1\Bin\glslangValidator -V skybox.frag -o ..\..\..\aether3d_build\Samples\skybox_frag.spv
+C:\VulkanSDK\1.0.39.1\Bin\glslangValidator -V LightCuller.comp -o ..\..\..\aether3d_build\Samples\LightCuller.spv
 pause
@@ -1,24 +1,24 @@
 #include "AudioSourceComponent.hpp"
+#include "ComponentPool.hpp"
 #include "AudioSystem.hpp"
 #include <vector>
 #include <sstream>
 
-std::vector< ae3d::AudioSourceComponent > audioSourceComponents;
-unsigned nextFreeAudioSourceComponent = 0;
+ae3d::ComponentPool< ae3d::AudioSourceComponent > audioSourceComponents;
 
 unsigned ae3d::AudioSourceComponent::New()
 {
-    if (nextFreeAudioSourceComponent == audioSourceComponents.size())
-    {
-        audioSourceComponents.resize( audioSourceComponents.size() + 10 );
-    }
-    
-    return nextFreeAudioSourceComponent++;
+    return audioSourceComponents.New();
 }
 
-ae3d::AudioSourceComponent* ae3d::AudioSourceComponent::Get( unsigned index )
+void ae3d::AudioSourceComponent::Delete( unsigned handle )
 {
-    return &audioSourceComponents[index];
+    audioSourceComponents.Delete( handle );
+}
+
+ae3d::AudioSourceComponent* ae3d::AudioSourceComponent::Get( unsigned handle )
+{
+    return audioSourceComponents.Get( handle );
 }
 
 void ae3d::AudioSourceComponent::SetClipId( unsigned audioClipId )
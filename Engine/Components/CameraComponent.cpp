@@ -2,24 +2,24 @@
 #include <vector>
 #include <locale>
 #include <sstream>
+#include "ComponentPool.hpp"
 #include "Macros.hpp"
 
-std::vector< ae3d::CameraComponent > cameraComponents;
-unsigned nextFreeCameraComponent = 0;
+ae3d::ComponentPool< ae3d::CameraComponent > cameraComponents;
 
 unsigned ae3d::CameraComponent::New()
 {
-    if (nextFreeCameraComponent == cameraComponents.size())
-    {
-        cameraComponents.resize( cameraComponents.size() + 10 );
-    }
+    return cameraComponents.New();
+}
 
-    return nextFreeCameraComponent++;
+void ae3d::CameraComponent::Delete( unsigned handle )
+{
+    cameraComponents.Delete( handle );
 }
 
-ae3d::CameraComponent* ae3d::CameraComponent::Get( unsigned index )
+ae3d::CameraComponent* ae3d::CameraComponent::Get( unsigned handle )
 {
-    return &cameraComponents[ index ];
+    return cameraComponents.Get( handle );
 }
 
 ae3d::Vec3 ae3d::CameraComponent::GetScreenPoint( const ae3d::Vec3 &worldPoint, float viewWidth, float viewHeight ) const
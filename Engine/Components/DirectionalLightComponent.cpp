@@ -2,23 +2,23 @@
 #include <locale>
 #include <vector>
 #include <sstream>
+#include "ComponentPool.hpp"
 
-std::vector< ae3d::DirectionalLightComponent > directionalLightComponents;
-unsigned nextFreeDirectionalLightComponent = 0;
+ae3d::ComponentPool< ae3d::DirectionalLightComponent > directionalLightComponents;
 
 unsigned ae3d::DirectionalLightComponent::New()
 {
-    if (nextFreeDirectionalLightComponent == directionalLightComponents.size())
-    {
-        directionalLightComponents.resize( directionalLightComponents.size() + 10 );
-    }
+    return directionalLightComponents.New();
+}
 
-    return nextFreeDirectionalLightComponent++;
+void ae3d::DirectionalLightComponent::Delete( unsigned handle )
+{
+    directionalLightComponents.Delete( handle );
 }
 
-ae3d::DirectionalLightComponent* ae3d::DirectionalLightComponent::Get( unsigned index )
+ae3d::DirectionalLightComponent* ae3d::DirectionalLightComponent::Get( unsigned handle )
 {
-    return &directionalLightComponents[ index ];
+    return directionalLightComponents.Get( handle );
 }
 
 void ae3d::DirectionalLightComponent::SetCastShadow( bool enable, int shadowMapSize )
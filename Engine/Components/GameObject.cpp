@@ -12,8 +12,21 @@
 
 using namespace ae3d;
 
+unsigned ae3d::GameObject::componentsVersion = 0;
+unsigned ae3d::GameObject::renderStateVersion = 0;
+unsigned ae3d::GameObject::hierarchyVersion = 0;
+
 unsigned ae3d::GameObject::GetNextComponentIndex()
 {
+    // Reuses entries of removed components.
+    for (unsigned i = 0; i < nextFreeComponentIndex; ++i)
+    {
+        if (components[ i ].type == -1)
+        {
+            return i;
+        }
+    }
+
     return nextFreeComponentIndex >= MaxComponents ? InvalidComponentIndex : nextFreeComponentIndex++;
 }
 
@@ -22,71 +35,110 @@ ae3d::GameObject::GameObject( const GameObject& other )
     *this = other;
 }
 
-GameObject& ae3d::GameObject::operator=( const GameObject& go )
+ae3d::GameObject::~GameObject()
 {
-    name = go.name;
-    
-    for (unsigned i = 0; i < MaxComponents; ++i)
-    {
-        components[ i ].type = -1;
-        components[ i ].handle = InvalidComponentIndex;
-    }
+    DeleteComponents();
+}
 
-    if (go.GetComponent< TransformComponent >())
+void ae3d::GameObject::DeleteComponents()
+{
+    for (unsigned i = 0; i < nextFreeComponentIndex; ++i)
     {
-        AddComponent< TransformComponent >();
-        *GetComponent< TransformComponent >() = *go.GetComponent< TransformComponent >();
+        if (components[ i ].type == TransformComponent::Type())
+        {
+            DeleteComponent< TransformComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == MeshRendererComponent::Type())
+        {
+            DeleteComponent< MeshRendererComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == CameraComponent::Type())
+        {
+            DeleteComponent< CameraComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == DirectionalLightComponent::Type())
+        {
+            DeleteComponent< DirectionalLightComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == AudioSourceComponent::Type())
+        {
+            DeleteComponent< AudioSourceComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == SpriteRendererComponent::Type())
+        {
+            DeleteComponent< SpriteRendererComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == TextRendererComponent::Type())
+        {
+            DeleteComponent< TextRendererComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == SpotLightComponent::Type())
+        {
+            DeleteComponent< SpotLightComponent >( components[ i ] );
+        }
+        else if (components[ i ].type == PointLightComponent::Type())
+        {
+            DeleteComponent< PointLightComponent >( components[ i ] );
+        }
     }
 
-    if (go.GetComponent< MeshRendererComponent >())
-    {
-        AddComponent< MeshRendererComponent >();
-        *GetComponent< MeshRendererComponent >() = *go.GetComponent< MeshRendererComponent >();
-    }
+    nextFreeComponentIndex = 0;
+    componentMask = 0;
+    ++componentsVersion;
+    OnRenderStateChanged();
+}
 
-    if (go.GetComponent< CameraComponent >())
+template< class T > void ae3d::GameObject::CopyComponent( const GameObject& other )
+{
+    if (other.GetComponent< T >())
     {
-        AddComponent< CameraComponent >();
-        *GetComponent< CameraComponent >() = *go.GetComponent< CameraComponent >();
+        AddComponent< T >();
+        *GetComponent< T >() = *other.GetComponent< T >();
+        GetComponent< T >()->gameObject = this;
     }
+}
 
-    if (go.GetComponent< DirectionalLightComponent >())
+GameObject& ae3d::GameObject::operator=( const GameObject& go )
+{
+    if (this == &go)
     {
-        AddComponent< DirectionalLightComponent >();
-        *GetComponent< DirectionalLightComponent >() = *go.GetComponent< DirectionalLightComponent >();
+        return *this;
     }
 
-    if (go.GetComponent< AudioSourceComponent >())
-    {
-        AddComponent< AudioSourceComponent >();
-        *GetComponent< AudioSourceComponent >() = *go.GetComponent< AudioSourceComponent >();
-    }
+    name = go.name;
 
-    if (go.GetComponent< SpriteRendererComponent >())
-    {
-        AddComponent< SpriteRendererComponent >();
-        *GetComponent< SpriteRendererComponent >() = *go.GetComponent< SpriteRendererComponent >();
-    }
+    DeleteComponents();
 
-    if (go.GetComponent< TextRendererComponent >())
-    {
-        AddComponent< TextRendererComponent >();
-        *GetComponent< TextRendererComponent >() = *go.GetComponent< TextRendererComponent >();
-    }
+    CopyComponent< TransformComponent >( go );
+    CopyComponent< MeshRendererComponent >( go );
+    CopyComponent< CameraComponent >( go );
+    CopyComponent< DirectionalLightComponent >( go );
+    CopyComponent< AudioSourceComponent >( go );
+    CopyComponent< SpriteRendererComponent >( go );
+    CopyComponent< TextRendererComponent >( go );
+    CopyComponent< SpotLightComponent >( go );
+    CopyComponent< PointLightComponent >( go );
+
+    return *this;
+}
 
-    if (go.GetComponent< SpotLightComponent >())
+void ae3d::GameObject::SetEnabled( bool enabled )
+{
+    if (isEnabled == enabled)
     {
-        AddComponent< SpotLightComponent >();
-        *GetComponent< SpotLightComponent >() = *go.GetComponent< SpotLightComponent >();
+        return;
     }
 
-    if (go.GetComponent< PointLightComponent >())
+    isEnabled = enabled;
+    OnRenderStateChanged();
+
+    const TransformComponent* transform = GetComponent< TransformComponent >();
+
+    // Children's IsEnabled changes too.
+    if (transform && transform->hasChildren)
     {
-        AddComponent< PointLightComponent >();
-        *GetComponent< PointLightComponent >() = *go.GetComponent< PointLightComponent >();
+        ++hierarchyVersion;
     }
-
-    return *this;
 }
 
 bool ae3d::GameObject::IsEnabled() const
@@ -1,6 +1,9 @@
 #include "MeshRendererComponent.hpp"
+#include <algorithm>
 #include <vector>
+#include "ComponentPool.hpp"
 #include "Frustum.hpp"
+#include "GameObject.hpp"
 #include "Matrix.hpp"
 #include "Mesh.hpp"
 #include "GfxDevice.hpp"
@@ -15,62 +18,65 @@ using namespace ae3d;
 
 namespace MathUtil
 {
-    void GetMinMax( const std::vector< Vec3 >& aPoints, Vec3& outMin, Vec3& outMax );
-    void GetCorners( const Vec3& min, const Vec3& max, std::vector< Vec3 >& outCorners );
+    void TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent );
 }
 
-std::vector< ae3d::MeshRendererComponent > meshRendererComponents;
-unsigned nextFreeMeshRendererComponent = 0;
+ae3d::ComponentPool< ae3d::MeshRendererComponent > meshRendererComponents;
 
-unsigned ae3d::MeshRendererComponent::New()
+GfxDevice::DepthFunc GetDepthFunc( const Material& material )
 {
-    if (nextFreeMeshRendererComponent == meshRendererComponents.size())
+    if (material.GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn)
     {
-        meshRendererComponents.resize( meshRendererComponents.size() + 10 );
+        return GfxDevice::DepthFunc::LessOrEqualWriteOn;
     }
-    
-    return nextFreeMeshRendererComponent++;
+    else if (material.GetDepthFunction() == Material::DepthFunction::NoneWriteOff)
+    {
+        return GfxDevice::DepthFunc::NoneWriteOff;
+    }
+
+    System::Assert( false, "material has unhandled depth function" );
+    return GfxDevice::DepthFunc::NoneWriteOff;
 }
 
-ae3d::MeshRendererComponent* ae3d::MeshRendererComponent::Get( unsigned index )
+unsigned ae3d::MeshRendererComponent::New()
 {
-    return &meshRendererComponents[ index ];
+    return meshRendererComponents.New();
 }
 
-std::string ae3d::MeshRendererComponent::GetSerialized() const
+void ae3d::MeshRendererComponent::Delete( unsigned handle )
 {
-    return "meshrenderer\n";
+    meshRendererComponents.Delete( handle );
 }
 
-void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld )
+ae3d::MeshRendererComponent* ae3d::MeshRendererComponent::Get( unsigned handle )
 {
-    if (!mesh)
-    {
-        return;
-    }
+    return meshRendererComponents.Get( handle );
+}
 
-    isCulled = false;
-    
-    std::vector< Vec3 > aabbWorld;
-    MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabbWorld );
-    
-    for (std::size_t v = 0; v < aabbWorld.size(); ++v)
+std::string ae3d::MeshRendererComponent::GetSerialized() const
+{
+    std::string serialized = "meshrenderer\n";
+
+    if (isOccluder)
     {
-        Matrix44::TransformPoint( aabbWorld[ v ], localToWorld, &aabbWorld[ v ] );
+        serialized += "occluder 1\n";
     }
-    
-    Vec3 aabbMinWorld, aabbMaxWorld;
-    MathUtil::GetMinMax( aabbWorld, aabbMinWorld, aabbMaxWorld );
-    
-    if (!cameraFrustum.BoxInFrustum( aabbMinWorld, aabbMaxWorld ))
+
+    if (!isOccludee)
     {
-        isCulled = true;
-        return;
+        serialized += "occludee 0\n";
     }
 
+    return serialized;
+}
+
+void ae3d::MeshRendererComponent::CullSubMeshes( const Frustum& cameraFrustum, const Matrix44& localToWorld )
+{
     std::vector< SubMesh >& subMeshes = mesh->GetSubMeshes();
+    // The mesh can have more sub-meshes than the arrays until UpdateSubMeshArrays is called.
+    const std::size_t subMeshCount = std::min( subMeshes.size(), materials.size() );
 
-    for (std::size_t subMeshIndex = 0; subMeshIndex < subMeshes.size(); ++subMeshIndex)
+    for (std::size_t subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
     {
         isSubMeshCulled[ subMeshIndex ] = false;
 
@@ -80,20 +86,10 @@ void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum, cons
             continue;
         }
         
-        Vec3 meshAabbMinWorld = subMeshes[ subMeshIndex ].aabbMin;
-        Vec3 meshAabbMaxWorld = subMeshes[ subMeshIndex ].aabbMax;
-        
-        std::vector< Vec3 > meshAabbWorld;
-        MathUtil::GetCorners( meshAabbMinWorld, meshAabbMaxWorld, meshAabbWorld );
+        Vec3 subMeshCenterWorld, subMeshExtentWorld;
+        MathUtil::TransformAABB( subMeshes[ subMeshIndex ].aabbMin, subMeshes[ subMeshIndex ].aabbMax, localToWorld, subMeshCenterWorld, subMeshExtentWorld );
         
-        for (std::size_t v = 0; v < meshAabbWorld.size(); ++v)
-        {
-            Matrix44::TransformPoint( meshAabbWorld[ v ], localToWorld, &meshAabbWorld[ v ] );
-        }
-        
-        MathUtil::GetMinMax( meshAabbWorld, meshAabbMinWorld, meshAabbMaxWorld );
-        
-        if (!cameraFrustum.BoxInFrustum( meshAabbMinWorld, meshAabbMaxWorld ))
+        if (!cameraFrustum.BoxInFrustum( subMeshCenterWorld - subMeshExtentWorld, subMeshCenterWorld + subMeshExtentWorld ))
         {
             isSubMeshCulled[ subMeshIndex ] = true;
         }
@@ -108,84 +104,145 @@ void ae3d::MeshRendererComponent::Render( const Matrix44& modelView, const Matri
         return;
     }
     
-    std::vector< SubMesh >& subMeshes = mesh->GetSubMeshes();
+    const std::size_t subMeshCount = std::min( mesh->GetSubMeshes().size(), materials.size() );
 
-    for (std::size_t subMeshIndex = 0; subMeshIndex < subMeshes.size(); ++subMeshIndex)
+    for (std::size_t subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
     {
         if (isSubMeshCulled[ subMeshIndex ])
         {
             continue;
         }
-        
-        Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
-        GfxDevice::CullMode cullMode = GfxDevice::CullMode::Back;
-        GfxDevice::BlendMode blendMode = GfxDevice::BlendMode::Off;
 
-        if (overrideShader)
+        if (!overrideShader && IsSubMeshTransparent( static_cast< int >( subMeshIndex ) ) != (renderType == RenderType::Transparent))
         {
-            shader->Use();
-            shader->SetMatrix( "_ModelViewProjectionMatrix", &modelViewProjection.m[ 0 ] );
-            shader->SetMatrix( "_ModelViewMatrix", &modelView.m[ 0 ] );
+            continue;
         }
-        else
-        {
-            if (materials[ subMeshIndex ]->GetBlendingMode() != Material::BlendingMode::Off && renderType == RenderType::Opaque)
-            {
-                continue;
-            }
-
-            if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Off && renderType == RenderType::Transparent)
-            {
-                continue;
-            }
-
-            Matrix44 shadowTexProjMatrix = localToWorld;
-            
-            Matrix44::Multiply( shadowTexProjMatrix, shadowView, shadowTexProjMatrix );
-            Matrix44::Multiply( shadowTexProjMatrix, shadowProjection, shadowTexProjMatrix );
-            Matrix44::Multiply( shadowTexProjMatrix, Matrix44::bias, shadowTexProjMatrix );
+
+        RenderSubMesh( static_cast< int >( subMeshIndex ), modelView, modelViewProjection, localToWorld, shadowView, shadowProjection, overrideShader, true );
+    }
+}
+
+bool ae3d::MeshRendererComponent::IsSubMeshTransparent( int subMeshIndex ) const
+{
+    return materials[ subMeshIndex ]->GetBlendingMode() != Material::BlendingMode::Off;
+}
+
+void ae3d::MeshRendererComponent::RenderSubMesh( int subMeshIndex, const Matrix44& modelView, const Matrix44& modelViewProjection, const Matrix44& localToWorld,
+                                                 const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideShader, bool bindTextures )
+{
+    std::vector< SubMesh >& subMeshes = mesh->GetSubMeshes();
+    Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
+    GfxDevice::CullMode cullMode = GfxDevice::CullMode::Back;
+    GfxDevice::BlendMode blendMode = GfxDevice::BlendMode::Off;
+    // Interned once, so per-draw code doesn't hash names.
+    static const int modelViewProjectionId = Shader::GetPropertyId( "_ModelViewProjectionMatrix" );
+    static const int modelViewId = Shader::GetPropertyId( "_ModelViewMatrix" );
+    static const int modelId = Shader::GetPropertyId( "_ModelMatrix" );
+    static const int shadowProjectionId = Shader::GetPropertyId( "_ShadowProjectionMatrix" );
+
+    if (overrideShader)
+    {
+        shader->Use();
+        shader->SetMatrix( modelViewProjectionId, &modelViewProjection.m[ 0 ] );
+        shader->SetMatrix( modelViewId, &modelView.m[ 0 ] );
+    }
+    else
+    {
+        Matrix44 shadowTexProjMatrix = localToWorld;
+        
+        Matrix44::Multiply( shadowTexProjMatrix, shadowView, shadowTexProjMatrix );
+        Matrix44::Multiply( shadowTexProjMatrix, shadowProjection, shadowTexProjMatrix );
+        Matrix44::Multiply( shadowTexProjMatrix, Matrix44::bias, shadowTexProjMatrix );
 #ifndef RENDERER_VULKAN
-            // Disabled on Vulkan backend because uniform code is not complete and this would overwrite MVP.
-            materials[ subMeshIndex ]->SetMatrix( "_ShadowProjectionMatrix", shadowTexProjMatrix );
-            materials[ subMeshIndex ]->SetMatrix( "_ModelMatrix", localToWorld );
+        // Disabled on Vulkan backend because uniform code is not complete and this would overwrite MVP.
+        materials[ subMeshIndex ]->SetMatrix( shadowProjectionId, shadowTexProjMatrix );
+        materials[ subMeshIndex ]->SetMatrix( modelId, localToWorld );
 #endif
-            materials[ subMeshIndex ]->SetMatrix( "_ModelViewProjectionMatrix", modelViewProjection );
-            materials[ subMeshIndex ]->Apply();
-
-            if (!materials[ subMeshIndex ]->IsBackFaceCulled())
-            {
-                cullMode = GfxDevice::CullMode::Off;
-            }
-            
-            if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Alpha)
-            {
-                blendMode = GfxDevice::BlendMode::AlphaBlend;
-            }
-        }
-        
-        GfxDevice::DepthFunc depthFunc;
-        
-        if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::LessOrEqualWriteOn)
-        {
-            depthFunc = GfxDevice::DepthFunc::LessOrEqualWriteOn;
-        }
-        else if (materials[ subMeshIndex ]->GetDepthFunction() == Material::DepthFunction::NoneWriteOff)
+        materials[ subMeshIndex ]->SetMatrix( modelViewProjectionId, modelViewProjection );
+        materials[ subMeshIndex ]->Apply( bindTextures );
+
+        if (!materials[ subMeshIndex ]->IsBackFaceCulled())
         {
-            depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
+            cullMode = GfxDevice::CullMode::Off;
         }
-        else
+        
+        if (materials[ subMeshIndex ]->GetBlendingMode() == Material::BlendingMode::Alpha)
         {
-            System::Assert( false, "material has unhandled depth function" );
-            depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
+            blendMode = GfxDevice::BlendMode::AlphaBlend;
         }
-        
-        GfxDevice::Draw( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
-                         *shader, blendMode, depthFunc, cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid );
     }
+    
+    GfxDevice::Draw( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
+                     *shader, blendMode, GetDepthFunc( *materials[ subMeshIndex ] ), cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid );
+}
+
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+void ae3d::MeshRendererComponent::RenderSubMeshInstanced( int subMeshIndex, const Matrix44& viewProjection, const Matrix44& shadowViewProjection,
+                                                          int firstInstance, int instanceCount, bool bindTextures )
+{
+    Material* material = materials[ subMeshIndex ];
+    Shader* shader = material->GetShader();
+    System::Assert( shader->IsInstanced(), "instanced draw needs an instanced shader" );
+    static const int viewProjectionId = Shader::GetPropertyId( "_ViewProjectionMatrix" );
+    static const int shadowViewProjectionId = Shader::GetPropertyId( "_ShadowViewProjectionMatrix" );
+
+    material->Apply( bindTextures );
+    // Set after Apply because the Vulkan backend writes every matrix into the same slot.
+#ifndef RENDERER_VULKAN
+    shader->SetMatrix( shadowViewProjectionId, &shadowViewProjection.m[ 0 ] );
+#endif
+    shader->SetMatrix( viewProjectionId, &viewProjection.m[ 0 ] );
+
+    const GfxDevice::CullMode cullMode = material->IsBackFaceCulled() ? GfxDevice::CullMode::Back : GfxDevice::CullMode::Off;
+    const GfxDevice::BlendMode blendMode = material->GetBlendingMode() == Material::BlendingMode::Alpha ? GfxDevice::BlendMode::AlphaBlend : GfxDevice::BlendMode::Off;
+    VertexBuffer& vertexBuffer = mesh->GetSubMeshes()[ subMeshIndex ].vertexBuffer;
+
+    GfxDevice::DrawInstanced( vertexBuffer, 0, vertexBuffer.GetFaceCount() / 3, firstInstance, instanceCount, *shader, blendMode, GetDepthFunc( *material ),
+                              cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid );
+}
+#endif
+
+#if RENDERER_OPENGL || RENDERER_NULL
+void ae3d::MeshRendererComponent::RenderSubMeshesIndirect( int subMeshIndex, VertexBuffer* const* vertexBuffers, const Matrix44* modelMatrices, int drawCount,
+                                                           const Matrix44& viewProjection, const Matrix44& shadowViewProjection, bool bindTextures,
+                                                           ComputeShader* cullShader, const float* localBounds, const float* frustumPlanes, int* outVisibleCount )
+{
+    Material* material = materials[ subMeshIndex ];
+    Shader* shader = material->GetShader();
+    System::Assert( shader->IsDrawIndirect(), "indirect draw needs a draw-indirect shader" );
+    static const int viewProjectionId = Shader::GetPropertyId( "_ViewProjectionMatrix" );
+    static const int shadowViewProjectionId = Shader::GetPropertyId( "_ShadowViewProjectionMatrix" );
+
+    material->Apply( bindTextures );
+    shader->SetMatrix( shadowViewProjectionId, &shadowViewProjection.m[ 0 ] );
+    shader->SetMatrix( viewProjectionId, &viewProjection.m[ 0 ] );
+
+    const GfxDevice::CullMode cullMode = material->IsBackFaceCulled() ? GfxDevice::CullMode::Back : GfxDevice::CullMode::Off;
+    const GfxDevice::BlendMode blendMode = material->GetBlendingMode() == Material::BlendingMode::Alpha ? GfxDevice::BlendMode::AlphaBlend : GfxDevice::BlendMode::Off;
+
+    const GfxDevice::FillMode fillMode = isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid;
+
+    if (cullShader != nullptr)
+    {
+        GfxDevice::DrawIndirectCulled( vertexBuffers, &modelMatrices[ 0 ].m[ 0 ], localBounds, drawCount, *cullShader, frustumPlanes, outVisibleCount,
+                                       *shader, blendMode, GetDepthFunc( *material ), cullMode, fillMode );
+    }
+    else
+    {
+        GfxDevice::DrawIndirect( vertexBuffers, &modelMatrices[ 0 ].m[ 0 ], drawCount, *shader, blendMode, GetDepthFunc( *material ), cullMode, fillMode );
+    }
+}
+#endif
+
+ae3d::SubMesh& ae3d::MeshRendererComponent::GetSubMesh( int subMeshIndex ) const
+{
+    return mesh->GetSubMeshes()[ subMeshIndex ];
 }
 
 void ae3d::MeshRendererComponent::SetMaterial( Material* material, int subMeshIndex )
 {
+    UpdateSubMeshArrays();
+
     if (subMeshIndex >= 0 && subMeshIndex < int( materials.size() ))
     {
         materials[ subMeshIndex ] = material;
@@ -196,9 +253,50 @@ void ae3d::MeshRendererComponent::SetMesh( Mesh* aMesh )
 {
     mesh = aMesh;
 
+    if (gameObject != nullptr)
+    {
+        gameObject->OnRenderStateChanged();
+    }
+
     if (mesh != nullptr)
     {
-        materials.resize( mesh->GetSubMeshes().size() );
-        isSubMeshCulled.resize( mesh->GetSubMeshes().size() );
+        ResizeSubMeshArrays();
+    }
+}
+
+void ae3d::MeshRendererComponent::UpdateSubMeshArrays()
+{
+    if (mesh == nullptr || meshContentVersion == mesh->GetContentVersion())
+    {
+        return;
+    }
+
+    ResizeSubMeshArrays();
+
+    if (gameObject != nullptr)
+    {
+        gameObject->OnRenderStateChanged();
+    }
+}
+
+void ae3d::MeshRendererComponent::ResizeSubMeshArrays()
+{
+    materials.resize( mesh->GetSubMeshes().size() );
+    isSubMeshCulled.resize( mesh->GetSubMeshes().size() );
+    meshContentVersion = mesh->GetContentVersion();
+
+    if (isOccluder)
+    {
+        mesh->CreateOccluderGeometry();
+    }
+}
+
+void ae3d::MeshRendererComponent::SetOccluder( bool enable )
+{
+    isOccluder = enable;
+
+    if (isOccluder && mesh != nullptr)
+    {
+        mesh->CreateOccluderGeometry();
     }
 }
@@ -2,23 +2,23 @@
 #include <locale>
 #include <vector>
 #include <sstream>
+#include "ComponentPool.hpp"
 
-std::vector< ae3d::PointLightComponent > pointLightComponents;
-unsigned nextFreePointLightComponent = 0;
+ae3d::ComponentPool< ae3d::PointLightComponent > pointLightComponents;
 
 unsigned ae3d::PointLightComponent::New()
 {
-    if (nextFreePointLightComponent == pointLightComponents.size())
-    {
-        pointLightComponents.resize( pointLightComponents.size() + 10 );
-    }
-    
-    return nextFreePointLightComponent++;
+    return pointLightComponents.New();
+}
+
+void ae3d::PointLightComponent::Delete( unsigned handle )
+{
+    pointLightComponents.Delete( handle );
 }
 
-ae3d::PointLightComponent* ae3d::PointLightComponent::Get( unsigned index )
+ae3d::PointLightComponent* ae3d::PointLightComponent::Get( unsigned handle )
 {
-    return &pointLightComponents[ index ];
+    return pointLightComponents.Get( handle );
 }
 
 void ae3d::PointLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -2,23 +2,23 @@
 #include <locale>
 #include <vector>
 #include <sstream>
+#include "ComponentPool.hpp"
 
-std::vector< ae3d::SpotLightComponent > spotLightComponents;
-unsigned nextFreeSpotlLightComponent = 0;
+ae3d::ComponentPool< ae3d::SpotLightComponent > spotLightComponents;
 
 unsigned ae3d::SpotLightComponent::New()
 {
-    if (nextFreeSpotlLightComponent == spotLightComponents.size())
-    {
-        spotLightComponents.resize( spotLightComponents.size() + 10 );
-    }
-    
-    return nextFreeSpotlLightComponent++;
+    return spotLightComponents.New();
+}
+
+void ae3d::SpotLightComponent::Delete( unsigned handle )
+{
+    spotLightComponents.Delete( handle );
 }
 
-ae3d::SpotLightComponent* ae3d::SpotLightComponent::Get( unsigned index )
+ae3d::SpotLightComponent* ae3d::SpotLightComponent::Get( unsigned handle )
 {
-    return &spotLightComponents[ index ];
+    return spotLightComponents.Get( handle );
 }
 
 void ae3d::SpotLightComponent::SetCastShadow( bool enable, int shadowMapSize )
@@ -42,6 +42,7 @@ std::string ae3d::SpotLightComponent::GetSerialized() const
     outStream << "spotlight\n";
     outStream << "shadow " << (castsShadow ? 1 : 0) << "\n";
     outStream << "coneangle " << coneAngle << "\n";
+    outStream << "radius " << radius << "\n";
     outStream << "color " << color.x << " " << color.y << " " << color.z << "\n\n";
 
     return outStream.str();
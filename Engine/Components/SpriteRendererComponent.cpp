@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <sstream>
 #include <vector>
+#include "ComponentPool.hpp"
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
 #include "RenderTexture.hpp"
@@ -13,8 +14,7 @@
 
 extern ae3d::Renderer renderer;
 
-std::vector<ae3d::SpriteRendererComponent> spriteRendererComponents;
-unsigned nextFreeSpriteComponent = 0;
+ae3d::ComponentPool< ae3d::SpriteRendererComponent > spriteRendererComponents;
 
 struct Drawable
 {
@@ -193,12 +193,12 @@ struct ae3d::SpriteRendererComponent::Impl
 
 unsigned ae3d::SpriteRendererComponent::New()
 {
-    if (nextFreeSpriteComponent == spriteRendererComponents.size())
-    {
-        spriteRendererComponents.resize( spriteRendererComponents.size() + 10 );
-    }
+    return spriteRendererComponents.New();
+}
 
-    return nextFreeSpriteComponent++;
+void ae3d::SpriteRendererComponent::Delete( unsigned handle )
+{
+    spriteRendererComponents.Delete( handle );
 }
 
 ae3d::SpriteInfo ae3d::SpriteRendererComponent::GetSpriteInfo( int index ) const
@@ -211,15 +211,9 @@ ae3d::SpriteInfo ae3d::SpriteRendererComponent::GetSpriteInfo( int index ) const
     return SpriteInfo{ "", 0, 0, 0, 0, false };
 }
 
-ae3d::SpriteRendererComponent* ae3d::SpriteRendererComponent::Get( unsigned index )
+ae3d::SpriteRendererComponent* ae3d::SpriteRendererComponent::Get( unsigned handle )
 {
-    if (index >= spriteRendererComponents.size())
-    {
-        System::Print( "SpriteRendererComponent: invalid index: %u\n", index );
-    }
-    
-    System::Assert( index < spriteRendererComponents.size(), "Tried to get a too high index for spriteRendererComponents." );
-    return &spriteRendererComponents[ index ];
+    return spriteRendererComponents.Get( handle );
 }
 
 ae3d::SpriteRendererComponent::SpriteRendererComponent()
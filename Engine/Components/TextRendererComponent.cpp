@@ -2,6 +2,7 @@
 #include <locale>
 #include <vector>
 #include <sstream>
+#include "ComponentPool.hpp"
 #include "Font.hpp"
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
@@ -11,22 +12,21 @@
 
 extern ae3d::Renderer renderer;
 
-std::vector< ae3d::TextRendererComponent > textComponents;
-unsigned nextFreeTextComponent = 0;
+ae3d::ComponentPool< ae3d::TextRendererComponent > textComponents;
 
 unsigned ae3d::TextRendererComponent::New()
 {
-    if (nextFreeTextComponent == textComponents.size())
-    {
-        textComponents.resize( textComponents.size() + 10 );
-    }
-    
-    return nextFreeTextComponent++;
+    return textComponents.New();
+}
+
+void ae3d::TextRendererComponent::Delete( unsigned handle )
+{
+    textComponents.Delete( handle );
 }
 
-ae3d::TextRendererComponent* ae3d::TextRendererComponent::Get( unsigned index )
+ae3d::TextRendererComponent* ae3d::TextRendererComponent::Get( unsigned handle )
 {
-    return &textComponents[ index ];
+    return textComponents.Get( handle );
 }
 
 struct ae3d::TextRendererComponent::Impl
@@ -1,8 +1,11 @@
 #include "TransformComponent.hpp"
+#include <algorithm>
 #include <locale>
 #include <vector>
 #include <sstream>
 #include <cmath>
+#include "ComponentPool.hpp"
+#include "GameObject.hpp"
 #include "Matrix.hpp"
 #include "System.hpp"
 
@@ -13,30 +16,52 @@ namespace
         return std::abs( f1 - f2 ) < 0.0001f;
     }
 
-    std::vector< ae3d::TransformComponent > transformComponents;
-    unsigned nextFreeTransformComponent = 0;
+    // Transform slot indices sorted so that parents come before their children.
+    // Declared before the pool so that they outlive it during static destruction.
+    std::vector< unsigned > sortedTransformIndices;
+    std::vector< unsigned > updatedTransformIndices;
+    bool isHierarchyChanged = false;
+
+    ae3d::ComponentPool< ae3d::TransformComponent > transformComponents;
 }
 
 unsigned ae3d::TransformComponent::New()
 {
-    if (nextFreeTransformComponent == transformComponents.size())
+    const unsigned handle = transformComponents.New();
+
+    // A new transform has no parent nor children, so it can go last without breaking the order.
+    sortedTransformIndices.push_back( handle & ComponentPool< TransformComponent >::IndexMask );
+
+    return handle;
+}
+
+void ae3d::TransformComponent::Delete( unsigned handle )
+{
+    if (!transformComponents.IsValid( handle ))
     {
-        transformComponents.resize( transformComponents.size() + 10 );
+        return;
     }
 
-    return nextFreeTransformComponent++;
+    // The slot stays in sortedTransformIndices until SortHierarchy removes it, so deleting doesn't search the list.
+    // Children's parent handle goes stale here, so they become roots. SortHierarchy marks them dirty.
+    isHierarchyChanged = true;
+
+    if (transformComponents.Get( handle )->hasChildren)
+    {
+        ++GameObject::hierarchyVersion;
+    }
+
+    transformComponents.Delete( handle );
 }
 
-ae3d::TransformComponent* ae3d::TransformComponent::Get( unsigned index )
+ae3d::TransformComponent* ae3d::TransformComponent::Get( unsigned handle )
 {
-    System::Assert( index < static_cast< unsigned >( transformComponents.size() ), "invalid transform index" );
-    return &transformComponents[ index ];
+    return transformComponents.Get( handle );
 }
 
 ae3d::TransformComponent* ae3d::TransformComponent::GetParent() const
 {
-    System::Assert( parent < static_cast< int >( transformComponents.size() ), "invalid parent transform index" );
-    return parent == -1 ? nullptr : &transformComponents[ parent ];
+    return transformComponents.Get( parent );
 }
 
 void ae3d::TransformComponent::LookAt( const Vec3& aLocalPosition, const Vec3& center, const Vec3& up )
@@ -45,6 +70,7 @@ void ae3d::TransformComponent::LookAt( const Vec3& aLocalPosition, const Vec3& c
     lookAt.MakeLookAt( aLocalPosition, center, up );
     localRotation.FromMatrix( lookAt );
     localPosition = aLocalPosition;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::MoveForward( float amount )
@@ -52,6 +78,7 @@ void ae3d::TransformComponent::MoveForward( float amount )
     if (!IsAlmost( amount, 0 ))
     {
         localPosition += localRotation * Vec3( 0, 0, amount );
+        isDirty = true;
     }
 }
 
@@ -60,12 +87,14 @@ void ae3d::TransformComponent::MoveRight( float amount )
     if (!IsAlmost( amount, 0 ))
     {
         localPosition += localRotation * Vec3( amount, 0, 0 );
+        isDirty = true;
     }
 }
 
 void ae3d::TransformComponent::MoveUp( float amount )
 {
     localPosition.y += amount;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
@@ -93,30 +122,92 @@ void ae3d::TransformComponent::OffsetRotate( const Vec3& axis, float angleDeg )
     }
 
     localRotation = newRotation;
+    isDirty = true;
+}
+
+void ae3d::TransformComponent::SortHierarchy()
+{
+    std::vector< int > depths( transformComponents.GetSlotCount(), 0 );
+    // Deleted slots are removed. A slot that was reused before this is listed twice, so only its first entry is kept.
+    std::vector< bool > isListed( transformComponents.GetSlotCount(), false );
+    std::size_t listedCount = 0;
+
+    for (unsigned componentIndex : sortedTransformIndices)
+    {
+        if (transformComponents.IsAlive( componentIndex ) && !isListed[ componentIndex ])
+        {
+            isListed[ componentIndex ] = true;
+            sortedTransformIndices[ listedCount++ ] = componentIndex;
+        }
+    }
+
+    sortedTransformIndices.resize( listedCount );
+
+    for (unsigned componentIndex : sortedTransformIndices)
+    {
+        TransformComponent& transform = transformComponents[ componentIndex ];
+
+        // Children of a deleted transform become roots.
+        if (transform.parent != 0 && transform.GetParent() == nullptr)
+        {
+            transform.parent = 0;
+            transform.isDirty = true;
+        }
+
+        for (const TransformComponent* parent = transformComponents[ componentIndex ].GetParent(); parent != nullptr; parent = parent->GetParent())
+        {
+            ++depths[ componentIndex ];
+        }
+    }
+
+    std::stable_sort( std::begin( sortedTransformIndices ), std::end( sortedTransformIndices ), [&]( unsigned a, unsigned b ) { return depths[ a ] < depths[ b ]; } );
 }
 
 void ae3d::TransformComponent::UpdateLocalMatrices()
 {
-    for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
+    if (isHierarchyChanged)
     {
-        transformComponents[ componentIndex ].SolveLocalMatrix();
+        SortHierarchy();
+        isHierarchyChanged = false;
     }
 
-    for (unsigned componentIndex = 0; componentIndex < nextFreeTransformComponent; ++componentIndex)
+    updatedTransformIndices.clear();
+
+    // Parents are updated before their children, so a child only needs its parent's final localToWorldMatrix.
+    for (unsigned componentIndex : sortedTransformIndices)
     {
-        int parent = transformComponents[ componentIndex ].parent;
+        TransformComponent& transform = transformComponents[ componentIndex ];
+        const TransformComponent* parentTransform = transform.GetParent();
 
-        Matrix44 transform = transformComponents[ componentIndex ].localMatrix;
+        if (parentTransform != nullptr && parentTransform->isDirty)
+        {
+            transform.isDirty = true;
+        }
 
-        while (parent != -1)
+        if (!transform.isDirty)
+        {
+            continue;
+        }
+
+        transform.SolveLocalMatrix();
+
+        if (parentTransform == nullptr)
+        {
+            transform.localToWorldMatrix = transform.localMatrix;
+        }
+        else
         {
-            Matrix44::Multiply( transform, transformComponents[ parent ].GetLocalMatrix(), transform );
-            parent = transformComponents[ parent ].parent;
+            Matrix44::Multiply( transform.localMatrix, parentTransform->localToWorldMatrix, transform.localToWorldMatrix );
         }
 
-        transformComponents[ componentIndex ].localToWorldMatrix = transform;
-        Matrix44::TransformPoint( transformComponents[ componentIndex ].localPosition, transform, &transformComponents[ componentIndex ].globalPosition );
-        transformComponents[ componentIndex ].globalRotation.FromMatrix( transform );
+        Matrix44::TransformPoint( transform.localPosition, transform.localToWorldMatrix, &transform.globalPosition );
+        transform.globalRotation.FromMatrix( transform.localToWorldMatrix );
+        updatedTransformIndices.push_back( componentIndex );
+    }
+
+    for (unsigned componentIndex : updatedTransformIndices)
+    {
+        transformComponents[ componentIndex ].isDirty = false;
     }
 }
 
@@ -128,16 +219,19 @@ const ae3d::Matrix44& ae3d::TransformComponent::GetLocalMatrix()
 void ae3d::TransformComponent::SetLocalPosition( const Vec3& localPos )
 {
     localPosition = localPos;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::SetLocalRotation( const Quaternion& localRot )
 {
     localRotation = localRot;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::SetLocalScale( float aLocalScale )
 {
     localScale = aLocalScale;
+    isDirty = true;
 }
 
 void ae3d::TransformComponent::SolveLocalMatrix()
@@ -158,6 +252,13 @@ void ae3d::TransformComponent::SetVrView( const Matrix44& view )
 
 void ae3d::TransformComponent::SetParent( TransformComponent* aParent )
 {
+    const unsigned parentHandle = transformComponents.GetHandle( aParent );
+
+    if (aParent != nullptr && parentHandle == 0)
+    {
+        return;
+    }
+
     const TransformComponent* testComponent = aParent;
     
     // Disallows cycles.
@@ -168,17 +269,18 @@ void ae3d::TransformComponent::SetParent( TransformComponent* aParent )
             return;
         }
         
-        testComponent = testComponent->parent == -1 ? nullptr : &transformComponents[ testComponent->parent ];
+        testComponent = testComponent->GetParent();
     }
 
-    for (std::size_t componentIndex = 0; componentIndex < transformComponents.size(); ++componentIndex)
+    if (aParent != nullptr)
     {
-        if (&transformComponents[ componentIndex ] == aParent)
-        {
-            parent = static_cast< int >( componentIndex );
-            return;
-        }
+        aParent->hasChildren = true;
     }
+
+    parent = parentHandle;
+    isDirty = true;
+    isHierarchyChanged = true;
+    ++GameObject::hierarchyVersion;
 }
 
 std::string ae3d::TransformComponent::GetSerialized() const
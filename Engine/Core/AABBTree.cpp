@@ -0,0 +1,441 @@
+#include "AABBTree.hpp"
+#include "Frustum.hpp"
+#include "System.hpp"
+
+// Insertion cost heuristic and AVL-style rotations follow Erin Catto's b2DynamicTree (Box2D).
+
+namespace
+{
+    // Stored boxes are enlarged by this fraction of their size so that small movements don't need a reinsertion.
+    const float fatMarginFraction = 0.1f;
+
+    float SurfaceArea( const ae3d::Vec3& aabbMin, const ae3d::Vec3& aabbMax )
+    {
+        const ae3d::Vec3 d = aabbMax - aabbMin;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool Contains( const ae3d::Vec3& outerMin, const ae3d::Vec3& outerMax, const ae3d::Vec3& innerMin, const ae3d::Vec3& innerMax )
+    {
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+               innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+
+    int Max( int a, int b )
+    {
+        return a > b ? a : b;
+    }
+}
+
+int ae3d::AABBTree::AllocateNode()
+{
+    if (freeList == NullProxy)
+    {
+        nodes.push_back( Node() );
+        nodes.back().height = 0;
+        return static_cast< int >( nodes.size() ) - 1;
+    }
+
+    const int node = freeList;
+    freeList = nodes[ node ].parentOrNext;
+    nodes[ node ] = Node();
+    nodes[ node ].height = 0;
+    return node;
+}
+
+void ae3d::AABBTree::FreeNode( int node )
+{
+    nodes[ node ].parentOrNext = freeList;
+    nodes[ node ].height = -1;
+    freeList = node;
+}
+
+int ae3d::AABBTree::Insert( const Vec3& aabbMin, const Vec3& aabbMax, void* userData )
+{
+    const int proxy = AllocateNode();
+    const Vec3 margin = (aabbMax - aabbMin) * fatMarginFraction;
+    nodes[ proxy ].aabbMin = aabbMin - margin;
+    nodes[ proxy ].aabbMax = aabbMax + margin;
+    nodes[ proxy ].userData = userData;
+
+    InsertLeaf( proxy );
+    ++proxyCount;
+
+    return proxy;
+}
+
+void ae3d::AABBTree::Remove( int proxy )
+{
+    System::Assert( 0 <= proxy && proxy < static_cast< int >( nodes.size() ) && nodes[ proxy ].IsLeaf() && nodes[ proxy ].height == 0, "invalid AABB tree proxy" );
+
+    RemoveLeaf( proxy );
+    FreeNode( proxy );
+    --proxyCount;
+}
+
+bool ae3d::AABBTree::Refit( int proxy, const Vec3& aabbMin, const Vec3& aabbMax )
+{
+    System::Assert( 0 <= proxy && proxy < static_cast< int >( nodes.size() ) && nodes[ proxy ].IsLeaf() && nodes[ proxy ].height == 0, "invalid AABB tree proxy" );
+
+    if (Contains( nodes[ proxy ].aabbMin, nodes[ proxy ].aabbMax, aabbMin, aabbMax ))
+    {
+        return false;
+    }
+
+    RemoveLeaf( proxy );
+
+    const Vec3 margin = (aabbMax - aabbMin) * fatMarginFraction;
+    nodes[ proxy ].aabbMin = aabbMin - margin;
+    nodes[ proxy ].aabbMax = aabbMax + margin;
+
+    InsertLeaf( proxy );
+
+    return true;
+}
+
+void ae3d::AABBTree::InsertLeaf( int leaf )
+{
+    if (root == NullProxy)
+    {
+        root = leaf;
+        nodes[ root ].parentOrNext = NullProxy;
+        return;
+    }
+
+    // Finds the best sibling.
+    const Vec3 leafMin = nodes[ leaf ].aabbMin;
+    const Vec3 leafMax = nodes[ leaf ].aabbMax;
+    int index = root;
+
+    while (!nodes[ index ].IsLeaf())
+    {
+        const int child1 = nodes[ index ].child1;
+        const int child2 = nodes[ index ].child2;
+
+        const float area = SurfaceArea( nodes[ index ].aabbMin, nodes[ index ].aabbMax );
+        const float combinedArea = SurfaceArea( Vec3::Min2( nodes[ index ].aabbMin, leafMin ), Vec3::Max2( nodes[ index ].aabbMax, leafMax ) );
+
+        // Cost of creating a new parent for this node and the new leaf.
+        const float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree.
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float cost1 = SurfaceArea( Vec3::Min2( nodes[ child1 ].aabbMin, leafMin ), Vec3::Max2( nodes[ child1 ].aabbMax, leafMax ) ) + inheritanceCost;
+
+        if (!nodes[ child1 ].IsLeaf())
+        {
+            cost1 -= SurfaceArea( nodes[ child1 ].aabbMin, nodes[ child1 ].aabbMax );
+        }
+
+        float cost2 = SurfaceArea( Vec3::Min2( nodes[ child2 ].aabbMin, leafMin ), Vec3::Max2( nodes[ child2 ].aabbMax, leafMax ) ) + inheritanceCost;
+
+        if (!nodes[ child2 ].IsLeaf())
+        {
+            cost2 -= SurfaceArea( nodes[ child2 ].aabbMin, nodes[ child2 ].aabbMax );
+        }
+
+        if (cost < cost1 && cost < cost2)
+        {
+            break;
+        }
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    const int sibling = index;
+
+    // Creates a new parent. AllocateNode can reallocate nodes, so no references are held over it.
+    const int oldParent = nodes[ sibling ].parentOrNext;
+    const int newParent = AllocateNode();
+    nodes[ newParent ].parentOrNext = oldParent;
+    nodes[ newParent ].aabbMin = Vec3::Min2( leafMin, nodes[ sibling ].aabbMin );
+    nodes[ newParent ].aabbMax = Vec3::Max2( leafMax, nodes[ sibling ].aabbMax );
+    nodes[ newParent ].height = nodes[ sibling ].height + 1;
+    nodes[ newParent ].child1 = sibling;
+    nodes[ newParent ].child2 = leaf;
+    nodes[ sibling ].parentOrNext = newParent;
+    nodes[ leaf ].parentOrNext = newParent;
+
+    if (oldParent != NullProxy)
+    {
+        if (nodes[ oldParent ].child1 == sibling)
+        {
+            nodes[ oldParent ].child1 = newParent;
+        }
+        else
+        {
+            nodes[ oldParent ].child2 = newParent;
+        }
+    }
+    else
+    {
+        root = newParent;
+    }
+
+    // Walks back up the tree fixing heights and boxes.
+    index = nodes[ leaf ].parentOrNext;
+
+    while (index != NullProxy)
+    {
+        index = Balance( index );
+
+        const int child1 = nodes[ index ].child1;
+        const int child2 = nodes[ index ].child2;
+
+        nodes[ index ].height = 1 + Max( nodes[ child1 ].height, nodes[ child2 ].height );
+        nodes[ index ].aabbMin = Vec3::Min2( nodes[ child1 ].aabbMin, nodes[ child2 ].aabbMin );
+        nodes[ index ].aabbMax = Vec3::Max2( nodes[ child1 ].aabbMax, nodes[ child2 ].aabbMax );
+
+        index = nodes[ index ].parentOrNext;
+    }
+}
+
+void ae3d::AABBTree::RemoveLeaf( int leaf )
+{
+    if (leaf == root)
+    {
+        root = NullProxy;
+        return;
+    }
+
+    const int parent = nodes[ leaf ].parentOrNext;
+    const int grandParent = nodes[ parent ].parentOrNext;
+    const int sibling = nodes[ parent ].child1 == leaf ? nodes[ parent ].child2 : nodes[ parent ].child1;
+
+    if (grandParent == NullProxy)
+    {
+        root = sibling;
+        nodes[ sibling ].parentOrNext = NullProxy;
+        FreeNode( parent );
+        return;
+    }
+
+    // Destroys the parent and connects the sibling to the grand parent.
+    if (nodes[ grandParent ].child1 == parent)
+    {
+        nodes[ grandParent ].child1 = sibling;
+    }
+    else
+    {
+        nodes[ grandParent ].child2 = sibling;
+    }
+
+    nodes[ sibling ].parentOrNext = grandParent;
+    FreeNode( parent );
+
+    int index = grandParent;
+
+    while (index != NullProxy)
+    {
+        index = Balance( index );
+
+        const int child1 = nodes[ index ].child1;
+        const int child2 = nodes[ index ].child2;
+
+        nodes[ index ].aabbMin = Vec3::Min2( nodes[ child1 ].aabbMin, nodes[ child2 ].aabbMin );
+        nodes[ index ].aabbMax = Vec3::Max2( nodes[ child1 ].aabbMax, nodes[ child2 ].aabbMax );
+        nodes[ index ].height = 1 + Max( nodes[ child1 ].height, nodes[ child2 ].height );
+
+        index = nodes[ index ].parentOrNext;
+    }
+}
+
+int ae3d::AABBTree::Balance( int iA )
+{
+    Node& A = nodes[ iA ];
+
+    if (A.IsLeaf() || A.height < 2)
+    {
+        return iA;
+    }
+
+    const int iB = A.child1;
+    const int iC = A.child2;
+    Node& B = nodes[ iB ];
+    Node& C = nodes[ iC ];
+
+    const int balance = C.height - B.height;
+
+    // Rotates C up.
+    if (balance > 1)
+    {
+        const int iF = C.child1;
+        const int iG = C.child2;
+        Node& F = nodes[ iF ];
+        Node& G = nodes[ iG ];
+
+        C.child1 = iA;
+        C.parentOrNext = A.parentOrNext;
+        A.parentOrNext = iC;
+
+        if (C.parentOrNext != NullProxy)
+        {
+            if (nodes[ C.parentOrNext ].child1 == iA)
+            {
+                nodes[ C.parentOrNext ].child1 = iC;
+            }
+            else
+            {
+                nodes[ C.parentOrNext ].child2 = iC;
+            }
+        }
+        else
+        {
+            root = iC;
+        }
+
+        if (F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parentOrNext = iA;
+            A.aabbMin = Vec3::Min2( B.aabbMin, G.aabbMin );
+            A.aabbMax = Vec3::Max2( B.aabbMax, G.aabbMax );
+            C.aabbMin = Vec3::Min2( A.aabbMin, F.aabbMin );
+            C.aabbMax = Vec3::Max2( A.aabbMax, F.aabbMax );
+            A.height = 1 + Max( B.height, G.height );
+            C.height = 1 + Max( A.height, F.height );
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parentOrNext = iA;
+            A.aabbMin = Vec3::Min2( B.aabbMin, F.aabbMin );
+            A.aabbMax = Vec3::Max2( B.aabbMax, F.aabbMax );
+            C.aabbMin = Vec3::Min2( A.aabbMin, G.aabbMin );
+            C.aabbMax = Vec3::Max2( A.aabbMax, G.aabbMax );
+            A.height = 1 + Max( B.height, F.height );
+            C.height = 1 + Max( A.height, G.height );
+        }
+
+        return iC;
+    }
+
+    // Rotates B up.
+    if (balance < -1)
+    {
+        const int iD = B.child1;
+        const int iE = B.child2;
+        Node& D = nodes[ iD ];
+        Node& E = nodes[ iE ];
+
+        B.child1 = iA;
+        B.parentOrNext = A.parentOrNext;
+        A.parentOrNext = iB;
+
+        if (B.parentOrNext != NullProxy)
+        {
+            if (nodes[ B.parentOrNext ].child1 == iA)
+            {
+                nodes[ B.parentOrNext ].child1 = iB;
+            }
+            else
+            {
+                nodes[ B.parentOrNext ].child2 = iB;
+            }
+        }
+        else
+        {
+            root = iB;
+        }
+
+        if (D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parentOrNext = iA;
+            A.aabbMin = Vec3::Min2( C.aabbMin, E.aabbMin );
+            A.aabbMax = Vec3::Max2( C.aabbMax, E.aabbMax );
+            B.aabbMin = Vec3::Min2( A.aabbMin, D.aabbMin );
+            B.aabbMax = Vec3::Max2( A.aabbMax, D.aabbMax );
+            A.height = 1 + Max( C.height, E.height );
+            B.height = 1 + Max( A.height, D.height );
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parentOrNext = iA;
+            A.aabbMin = Vec3::Min2( C.aabbMin, D.aabbMin );
+            A.aabbMax = Vec3::Max2( C.aabbMax, D.aabbMax );
+            B.aabbMin = Vec3::Min2( A.aabbMin, E.aabbMin );
+            B.aabbMax = Vec3::Max2( A.aabbMax, E.aabbMax );
+            A.height = 1 + Max( C.height, D.height );
+            B.height = 1 + Max( A.height, E.height );
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+void ae3d::AABBTree::AddLeaves( int node, std::vector< void* >& outUserData ) const
+{
+    if (nodes[ node ].IsLeaf())
+    {
+        outUserData.push_back( nodes[ node ].userData );
+        return;
+    }
+
+    AddLeaves( nodes[ node ].child1, outUserData );
+    AddLeaves( nodes[ node ].child2, outUserData );
+}
+
+void ae3d::AABBTree::Query( const Frustum& frustum, std::vector< void* >& outUserData ) const
+{
+    if (root == NullProxy)
+    {
+        return;
+    }
+
+    stack.clear();
+    stack.push_back( root );
+
+    while (!stack.empty())
+    {
+        const int index = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[ index ];
+
+        if (!frustum.BoxInFrustum( node.aabbMin, node.aabbMax ))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            outUserData.push_back( node.userData );
+        }
+        else if (frustum.BoxFullyInFrustum( node.aabbMin, node.aabbMax ))
+        {
+            // Whole subtree is visible, so its leaves don't need to be tested.
+            AddLeaves( index, outUserData );
+        }
+        else
+        {
+            stack.push_back( node.child1 );
+            stack.push_back( node.child2 );
+        }
+    }
+}
+
+bool ae3d::AABBTree::GetBounds( Vec3& outMin, Vec3& outMax ) const
+{
+    if (root == NullProxy)
+    {
+        return false;
+    }
+
+    outMin = nodes[ root ].aabbMin;
+    outMax = nodes[ root ].aabbMax;
+    return true;
+}
+
+int ae3d::AABBTree::GetHeight() const
+{
+    return root == NullProxy ? 0 : nodes[ root ].height;
+}
@@ -0,0 +1,427 @@
+#include "AssetLoader.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "AudioClip.hpp"
+#include "AudioSystem.hpp"
+#include "FileSystem.hpp"
+#include "Font.hpp"
+#include "Mesh.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+unsigned char* DecodeSTB( const ae3d::FileSystem::FileView& fileContents, int& outWidth, int& outHeight, int& outComponents ); // Defined in TextureCommon.cpp
+void FreeSTB( unsigned char* pixels ); // Defined in TextureCommon.cpp
+void SetPredecodedSTB( const unsigned char* source, unsigned char* pixels, int width, int height, int components ); // Defined in TextureCommon.cpp
+struct ParsedMesh; // Defined in Mesh.cpp
+std::shared_ptr< const ParsedMesh > ParseMesh( const ae3d::FileSystem::FileView& meshData ); // Defined in Mesh.cpp
+void SetPreparsedMesh( const std::shared_ptr< const ParsedMesh >& mesh ); // Defined in Mesh.cpp
+
+using namespace ae3d;
+
+namespace
+{
+    // Pixels decoded on a worker thread, handed to Texture2D::Load through SetPredecodedSTB.
+    struct DecodedImage
+    {
+        DecodedImage() = default;
+        DecodedImage( const DecodedImage& ) = delete;
+        DecodedImage& operator=( const DecodedImage& ) = delete;
+
+        ~DecodedImage()
+        {
+            FreeSTB( pixels );
+        }
+
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+    };
+
+    struct TextureFile
+    {
+        FileSystem::FileView view;
+        std::shared_ptr< DecodedImage > image;
+    };
+
+    struct Upload
+    {
+        // Runs on the main thread. Returns false if the asset could not be loaded.
+        std::function< bool() > run;
+        std::shared_ptr< std::atomic< AssetLoader::State > > state;
+    };
+}
+
+namespace AssetLoaderGlobal
+{
+    std::deque< Upload > uploads;
+    std::mutex uploadsMutex;
+    // Reads run on their own thread instead of JobSystem, so that JobSystem::Wait never runs a disk read or a decode
+    // in the middle of a frame and workers stay free for frame jobs.
+    std::deque< std::function< void() > > reads;
+    std::mutex readsMutex;
+    std::condition_variable readsCondition;
+    std::thread ioThread;
+    // Queued reads and the read that is running.
+    int pendingReadCount = 0;
+    bool isIOThreadRunning = false;
+    std::atomic< int > loadingCount{ 0 };
+    float uploadBudgetMS = 2;
+    ae3d::Mesh placeholderMesh;
+    bool isPlaceholderMeshLoaded = false;
+}
+
+namespace
+{
+    AssetLoader::Handle CreateHandle()
+    {
+        AssetLoader::Handle handle;
+        handle.state = std::make_shared< std::atomic< AssetLoader::State > >( AssetLoader::State::Loading );
+        ++AssetLoaderGlobal::loadingCount;
+        return handle;
+    }
+
+    void QueueUpload( const std::function< bool() >& run, const AssetLoader::Handle& handle )
+    {
+        Upload upload;
+        upload.run = run;
+        upload.state = handle.state;
+
+        std::lock_guard< std::mutex > lock( AssetLoaderGlobal::uploadsMutex );
+        AssetLoaderGlobal::uploads.push_back( upload );
+    }
+
+    void IOThreadMain()
+    {
+        std::unique_lock< std::mutex > lock( AssetLoaderGlobal::readsMutex );
+
+        while (true)
+        {
+            AssetLoaderGlobal::readsCondition.wait( lock, [] { return !AssetLoaderGlobal::isIOThreadRunning || !AssetLoaderGlobal::reads.empty(); } );
+
+            if (AssetLoaderGlobal::reads.empty())
+            {
+                return;
+            }
+
+            const std::function< void() > read = AssetLoaderGlobal::reads.front();
+            AssetLoaderGlobal::reads.pop_front();
+
+            lock.unlock();
+            read();
+            lock.lock();
+
+            --AssetLoaderGlobal::pendingReadCount;
+            AssetLoaderGlobal::readsCondition.notify_all();
+        }
+    }
+
+    void QueueRead( const std::function< void() >& read )
+    {
+        std::lock_guard< std::mutex > lock( AssetLoaderGlobal::readsMutex );
+
+        if (!AssetLoaderGlobal::isIOThreadRunning)
+        {
+            AssetLoaderGlobal::isIOThreadRunning = true;
+            AssetLoaderGlobal::ioThread = std::thread( IOThreadMain );
+        }
+
+        AssetLoaderGlobal::reads.push_back( read );
+        ++AssetLoaderGlobal::pendingReadCount;
+        AssetLoaderGlobal::readsCondition.notify_all();
+    }
+
+    void WaitForReads()
+    {
+        std::unique_lock< std::mutex > lock( AssetLoaderGlobal::readsMutex );
+        AssetLoaderGlobal::readsCondition.wait( lock, [] { return AssetLoaderGlobal::pendingReadCount == 0; } );
+    }
+
+    // Finishes queued reads and joins the I/O thread. It's started again by the next load.
+    void StopIOThread()
+    {
+        {
+            std::lock_guard< std::mutex > lock( AssetLoaderGlobal::readsMutex );
+            AssetLoaderGlobal::isIOThreadRunning = false;
+            AssetLoaderGlobal::readsCondition.notify_all();
+        }
+
+        if (AssetLoaderGlobal::ioThread.joinable())
+        {
+            AssetLoaderGlobal::ioThread.join();
+        }
+    }
+
+    // Joins the I/O thread at exit if the application didn't call System::Deinit.
+    struct IOThreadJoiner
+    {
+        ~IOThreadJoiner()
+        {
+            StopIOThread();
+        }
+    } ioThreadJoiner;
+
+    // Reads every page of a mapped file, so the upload on the main thread doesn't wait for the disk.
+    void Prefault( const FileSystem::FileView& view )
+    {
+        const std::size_t pageSize = 4096;
+        unsigned char sum = 0;
+
+        for (std::size_t i = 0; i < view.size; i += pageSize)
+        {
+            sum = static_cast< unsigned char >( sum + view.data[ i ] );
+        }
+
+        volatile unsigned char sink = sum;
+        (void)sink;
+    }
+
+    // Runs on the I/O thread.
+    TextureFile ReadTexture( const std::string& path )
+    {
+        TextureFile file;
+        file.view = FileSystem::FileContentsView( path.c_str() );
+        file.image = std::make_shared< DecodedImage >();
+
+        if (!file.view.isLoaded)
+        {
+            return file;
+        }
+
+#if !RENDERER_NULL
+        // The null renderer doesn't upload pixels, so it only reads the header.
+        if (HasStbExtension( path ))
+        {
+            DecodedImage& image = *file.image;
+            image.pixels = DecodeSTB( file.view, image.width, image.height, image.components );
+            return file;
+        }
+#endif
+        Prefault( file.view );
+        return file;
+    }
+
+    // Runs on the main thread.
+    bool UploadTexture( Texture2D* texture, const TextureFile& file, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy )
+    {
+        if (!file.view.isLoaded)
+        {
+            return false;
+        }
+
+        // The placeholder shares the default texture's handle, which must not be overwritten.
+        *texture = Texture2D();
+
+        SetPredecodedSTB( file.view.data, file.image->pixels, file.image->width, file.image->height, file.image->components );
+        file.image->pixels = nullptr;
+        texture->Load( file.view, wrap, filter, mipmaps, colorSpace, anisotropy );
+        SetPredecodedSTB( nullptr, nullptr, 0, 0, 0 );
+
+        return true;
+    }
+
+    void RunQueuedUploads( float budgetMS )
+    {
+        const auto startTime = std::chrono::high_resolution_clock::now();
+
+        while (true)
+        {
+            Upload upload;
+
+            {
+                std::lock_guard< std::mutex > lock( AssetLoaderGlobal::uploadsMutex );
+
+                if (AssetLoaderGlobal::uploads.empty())
+                {
+                    return;
+                }
+
+                upload = AssetLoaderGlobal::uploads.front();
+                AssetLoaderGlobal::uploads.pop_front();
+            }
+
+            upload.state->store( upload.run() ? AssetLoader::State::Ready : AssetLoader::State::Failed );
+            --AssetLoaderGlobal::loadingCount;
+
+            const auto elapsed = std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - startTime ).count();
+
+            if (elapsed >= (double)budgetMS)
+            {
+                return;
+            }
+        }
+    }
+}
+
+AssetLoader::Handle ae3d::AssetLoader::LoadTexture( Texture2D* texture, const char* path, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy )
+{
+    System::Assert( texture != nullptr && path != nullptr, "AssetLoader::LoadTexture needs a texture and a path" );
+
+    *texture = *Texture2D::GetDefaultTexture();
+
+    const Handle handle = CreateHandle();
+    const std::string pathString( path );
+
+    QueueRead( [=]()
+    {
+        const TextureFile file = ReadTexture( pathString );
+        QueueUpload( [=]() { return UploadTexture( texture, file, wrap, filter, mipmaps, colorSpace, anisotropy ); }, handle );
+    } );
+
+    return handle;
+}
+
+AssetLoader::Handle ae3d::AssetLoader::LoadMesh( Mesh* mesh, const char* path )
+{
+    System::Assert( mesh != nullptr && path != nullptr, "AssetLoader::LoadMesh needs a mesh and a path" );
+
+    // Loading from a view without contents generates the default cube.
+    if (!AssetLoaderGlobal::isPlaceholderMeshLoaded)
+    {
+        AssetLoaderGlobal::placeholderMesh.Load( FileSystem::FileView() );
+        AssetLoaderGlobal::isPlaceholderMeshLoaded = true;
+    }
+
+    *mesh = AssetLoaderGlobal::placeholderMesh;
+
+    const Handle handle = CreateHandle();
+    const std::string pathString( path );
+
+    QueueRead( [=]()
+    {
+        const FileSystem::FileView view = FileSystem::FileContentsView( pathString.c_str() );
+        const std::shared_ptr< const ParsedMesh > parsedMesh = ParseMesh( view );
+
+        QueueUpload( [=]()
+        {
+            if (!view.isLoaded)
+            {
+                return false;
+            }
+
+            SetPreparsedMesh( parsedMesh );
+            const bool isLoaded = mesh->Load( view ) == Mesh::LoadResult::Success;
+            SetPreparsedMesh( nullptr );
+            return isLoaded;
+        }, handle );
+    } );
+
+    return handle;
+}
+
+AssetLoader::Handle ae3d::AssetLoader::LoadAudioClip( AudioClip* clip, const char* path )
+{
+    System::Assert( clip != nullptr && path != nullptr, "AssetLoader::LoadAudioClip needs a clip and a path" );
+
+    const Handle handle = CreateHandle();
+    const std::string pathString( path );
+
+    QueueRead( [=]()
+    {
+        const FileSystem::FileView view = FileSystem::FileContentsView( pathString.c_str() );
+        const std::shared_ptr< AudioSystem::DecodedOgg > decodedOgg = std::make_shared< AudioSystem::DecodedOgg >();
+        const std::size_t extensionStart = pathString.size() < 3 ? 0 : pathString.size() - 3;
+        const bool isOgg = pathString.compare( extensionStart, 3, "ogg" ) == 0 || pathString.compare( extensionStart, 3, "OGG" ) == 0;
+
+        if (view.isLoaded && isOgg)
+        {
+            AudioSystem::DecodeOgg( view, *decodedOgg );
+        }
+        else
+        {
+            Prefault( view );
+        }
+
+        QueueUpload( [=]()
+        {
+            if (!view.isLoaded)
+            {
+                return false;
+            }
+
+            AudioSystem::SetPredecodedOgg( isOgg ? view.data : nullptr, decodedOgg.get() );
+            clip->Load( view );
+            AudioSystem::SetPredecodedOgg( nullptr, nullptr );
+            return true;
+        }, handle );
+    } );
+
+    return handle;
+}
+
+AssetLoader::Handle ae3d::AssetLoader::LoadFont( Font* font, Texture2D* fontTexture, const char* texturePath, const char* metaPath, TextureWrap wrap, TextureFilter filter, ColorSpace colorSpace )
+{
+    System::Assert( font != nullptr && fontTexture != nullptr && texturePath != nullptr && metaPath != nullptr, "AssetLoader::LoadFont needs a font, a texture and paths" );
+
+    *fontTexture = *Texture2D::GetDefaultTexture();
+
+    const Handle handle = CreateHandle();
+    const std::string texturePathString( texturePath );
+    const std::string metaPathString( metaPath );
+
+    QueueRead( [=]()
+    {
+        const TextureFile textureFile = ReadTexture( texturePathString );
+        const FileSystem::FileView metaView = FileSystem::FileContentsView( metaPathString.c_str() );
+        Prefault( metaView );
+
+        QueueUpload( [=]()
+        {
+            if (!metaView.isLoaded || !UploadTexture( fontTexture, textureFile, wrap, filter, Mipmaps::None, colorSpace, Anisotropy::k1 ))
+            {
+                return false;
+            }
+
+            font->LoadBMFont( fontTexture, metaView );
+            return true;
+        }, handle );
+    } );
+
+    return handle;
+}
+
+void ae3d::AssetLoader::SetUploadBudget( float milliseconds )
+{
+    AssetLoaderGlobal::uploadBudgetMS = milliseconds;
+}
+
+void ae3d::AssetLoader::RunUploads()
+{
+    RunQueuedUploads( AssetLoaderGlobal::uploadBudgetMS );
+}
+
+int ae3d::AssetLoader::GetLoadingCount()
+{
+    return AssetLoaderGlobal::loadingCount.load();
+}
+
+void ae3d::AssetLoader::WaitForAll()
+{
+    WaitForReads();
+    RunQueuedUploads( std::numeric_limits< float >::max() );
+}
+
+void ae3d::AssetLoader::Deinit()
+{
+    WaitForReads();
+    StopIOThread();
+
+    std::lock_guard< std::mutex > lock( AssetLoaderGlobal::uploadsMutex );
+
+    for (const auto& upload : AssetLoaderGlobal::uploads)
+    {
+        upload.state->store( State::Failed );
+    }
+
+    AssetLoaderGlobal::uploads.clear();
+    AssetLoaderGlobal::loadingCount = 0;
+    AssetLoaderGlobal::placeholderMesh = Mesh();
+    AssetLoaderGlobal::isPlaceholderMeshLoaded = false;
+}
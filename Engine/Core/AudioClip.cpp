@@ -2,7 +2,7 @@
 #include "AudioSystem.hpp"
 #include "FileSystem.hpp"
 
-void ae3d::AudioClip::Load( const FileSystem::FileContentsData& clipData )
+void ae3d::AudioClip::Load( const FileSystem::FileView& clipData )
 {
     handle = AudioSystem::GetClipIdForData( clipData );
     length = AudioSystem::GetClipLengthForId( handle );
@@ -5,11 +5,44 @@ namespace ae3d
 {
     namespace FileSystem
     {
-        struct FileContentsData;
+        struct FileView;
     }
 
     namespace AudioSystem
     {
+        /// Ogg Vorbis samples decoded before GetClipIdForData, eg. on AssetLoader's I/O thread.
+        struct DecodedOgg
+        {
+            DecodedOgg() = default;
+            DecodedOgg( const DecodedOgg& ) = delete;
+            DecodedOgg& operator=( const DecodedOgg& ) = delete;
+            ~DecodedOgg();
+
+            /// Interleaved samples, allocated by stb_vorbis.
+            short* samples = nullptr;
+            /// Return value of stb_vorbis_decode_memory, 0 if decoding failed.
+            int length = 0;
+            int channels = 0;
+            int sampleRate = 0;
+            float lengthInSeconds = 0;
+        };
+
+        /**
+          Decodes Ogg Vorbis data. Can be called on any thread.
+
+          \param clipData Ogg Vorbis audio data.
+          \param outDecoded Decoded samples. Backends that don't play audio leave it empty.
+         */
+        void DecodeOgg( const FileSystem::FileView& clipData, DecodedOgg& outDecoded );
+
+        /**
+          Makes the next GetClipIdForData call for the data at source use decoded instead of decoding.
+
+          \param source Clip data that decoded was decoded from. Null clears the previous samples.
+          \param decoded Decoded samples. Must stay alive until GetClipIdForData has been called or this is called again.
+         */
+        void SetPredecodedOgg( const unsigned char* source, const DecodedOgg* decoded );
+
         /// Creates the audio device. Must be called before other methods in this namespace.
         void Init();
         
@@ -22,7 +55,7 @@ namespace ae3d
           \param clipData .wav or Ogg Vorbis audio data.
           \return Clip handle that can be passed to Play.
          */
-        unsigned GetClipIdForData( const FileSystem::FileContentsData& clipData );
+        unsigned GetClipIdForData( const FileSystem::FileView& clipData );
         
         /// \return Length in seconds.
         float GetClipLengthForId( unsigned handle );
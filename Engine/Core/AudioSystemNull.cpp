@@ -0,0 +1,46 @@
+#include "AudioSystem.hpp"
+#include "FileSystem.hpp"
+
+// Silent audio backend for the headless null renderer, so that it has no OpenAL dependency.
+
+ae3d::AudioSystem::DecodedOgg::~DecodedOgg()
+{
+}
+
+void ae3d::AudioSystem::DecodeOgg( const FileSystem::FileView& /*clipData*/, DecodedOgg& /*outDecoded*/ )
+{
+}
+
+void ae3d::AudioSystem::SetPredecodedOgg( const unsigned char* /*source*/, const DecodedOgg* /*decoded*/ )
+{
+}
+
+void ae3d::AudioSystem::Init()
+{
+}
+
+void ae3d::AudioSystem::Deinit()
+{
+}
+
+unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileView& /*clipData*/ )
+{
+    return 0;
+}
+
+float ae3d::AudioSystem::GetClipLengthForId( unsigned /*handle*/ )
+{
+    return 0;
+}
+
+void ae3d::AudioSystem::Play( unsigned /*clipId*/ )
+{
+}
+
+void ae3d::AudioSystem::SetListenerPosition( float /*x*/, float /*y*/, float /*z*/ )
+{
+}
+
+void ae3d::AudioSystem::SetListenerOrientation( float /*forwardX*/, float /*forwardY*/, float /*forwardZ*/ )
+{
+}
@@ -1,8 +1,8 @@
 #include "AudioSystem.hpp"
-#include <sstream>
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <cstdlib>
 #if defined __APPLE__
 #    include <OpenAL/al.h>
 #    include <OpenAL/alc.h>
@@ -15,6 +15,7 @@
 #include "System.hpp"
 #include "FileSystem.hpp"
 #include "FileWatcher.hpp"
+#include "MemoryStream.hpp"
 
 extern ae3d::FileWatcher fileWatcher;
 
@@ -31,6 +32,9 @@ namespace AudioGlobal
     ALCdevice* device = nullptr;
     ALCcontext* context = nullptr;
     std::vector< ClipInfo > clips;
+    // Samples that AssetLoader decoded on its I/O thread from the clip data at predecodedOggSource.
+    const unsigned char* predecodedOggSource = nullptr;
+    const ae3d::AudioSystem::DecodedOgg* predecodedOgg = nullptr;
 }
 
 namespace
@@ -57,7 +61,7 @@ struct WAVE
     // Data sub chunk
     std::uint8_t subchunk2ID[ 4 ]; // Data sub chunk ID.
     std::uint32_t subchunk2Size; // Data sub chunk size.
-    std::vector< unsigned char > data; // Chunk data.
+    const unsigned char* data; // Chunk data, points into the file.
 };
 
 const char * GetOpenALErrorString( int errID )
@@ -82,45 +86,50 @@ void CheckOpenALError( const char* info )
     }
 }
 
-void LoadOgg( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+void LoadOgg( const ae3d::FileSystem::FileView& clipData, ClipInfo& info )
 {
     if (AudioGlobal::device == nullptr)
     {
         return;
     }
 
-    short* decoded = nullptr;
-    int channels = 0;
-    int samplerate = 0;
-    const int len = stb_vorbis_decode_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &channels, &samplerate, &decoded );
-    
-    if (len == 0)
+    ae3d::AudioSystem::DecodedOgg decodedHere;
+    const ae3d::AudioSystem::DecodedOgg* decoded = &decodedHere;
+
+    if (clipData.data != nullptr && clipData.data == AudioGlobal::predecodedOggSource)
+    {
+        decoded = AudioGlobal::predecodedOgg;
+        ae3d::AudioSystem::SetPredecodedOgg( nullptr, nullptr );
+    }
+    else
+    {
+        ae3d::AudioSystem::DecodeOgg( clipData, decodedHere );
+    }
+
+    if (decoded->length == 0)
     {
         ae3d::System::Print( "AudioSystem: Could not open %s\n", clipData.path.c_str() );
         return;
     }
 
-    int error;
-    stb_vorbis* vorbis = stb_vorbis_open_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &error, nullptr );
-    const stb_vorbis_info vinfo = stb_vorbis_get_info( vorbis );
+    const ALenum format = decoded->channels == 2 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
     
-    const ALenum format = vinfo.channels == 2 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
-    
-    alBufferData( info.bufID, format, &decoded[0], len, vinfo.sample_rate );
+    // OpenAL makes its own copy.
+    alBufferData( info.bufID, format, &decoded->samples[0], decoded->length, decoded->sampleRate );
 
-    info.lengthInSeconds = stb_vorbis_stream_length_in_seconds( vorbis );
+    info.lengthInSeconds = decoded->lengthInSeconds;
 
     CheckOpenALError("Loading ogg");
 }
 
-void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+void LoadWav( const ae3d::FileSystem::FileView& clipData, ClipInfo& info )
 {
     if (AudioGlobal::device == nullptr)
     {
         return;
     }
 
-    std::istringstream ifs( std::string( clipData.data.begin(), clipData.data.end() ) );
+    ae3d::imemstream ifs( (const char*)clipData.data, clipData.size );
 
     WAVE wav;
     
@@ -181,20 +190,17 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
     
     ifs.read( (char*)&wav.subchunk2Size, 4 );
     
-    // Data size is file size minus header size.
-    // We get it by saving the current position, moving
-    // to the EOF, checking EOF's position and moving back to
-    // the saved location for data reading.
+    // Data size is file size minus header size. The data is passed to OpenAL in place.
     const std::streampos dataPos = ifs.tellg();
-    ifs.seekg( 0, std::ios::end );
-    const std::streampos fileSize = ifs.tellg();
-    const ALsizei dataSize = (ALsizei)fileSize - 44; // Header is 44 bytes.
-    
-    ifs.seekg( dataPos );
-    
-    wav.data.resize( dataSize );
-    
-    ifs.read( (char*)wav.data.data(), dataSize );
+
+    if (dataPos < 0)
+    {
+        ae3d::System::Print( "%s is truncated!\n", clipData.path.c_str() );
+        return;
+    }
+
+    const ALsizei dataSize = (ALsizei)clipData.size - 44; // Header is 44 bytes.
+    wav.data = clipData.data + (std::size_t)dataPos;
     
     ALenum format = AL_FORMAT_MONO8;
     
@@ -224,7 +230,7 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
     }
 
     alSourcei( info.srcID, AL_BUFFER, 0 );
-    alBufferData( info.bufID, format, wav.data.data(), dataSize, wav.sampleRate );
+    alBufferData( info.bufID, format, wav.data, dataSize, wav.sampleRate );
     alSourcei( info.srcID, AL_BUFFER, info.bufID );
     CheckOpenALError( "Loading .wav data." );
     
@@ -242,11 +248,11 @@ void AudioReload( const std::string& path )
             
             if (extension == "wav" || extension == "WAV")
             {
-                LoadWav( ae3d::FileSystem::FileContents( path.c_str() ), clip );
+                LoadWav( ae3d::FileSystem::FileContentsView( path.c_str() ), clip );
             }
             else if (extension == "ogg" || extension == "OGG")
             {
-                LoadOgg( ae3d::FileSystem::FileContents( path.c_str() ), clip );
+                LoadOgg( ae3d::FileSystem::FileContentsView( path.c_str() ), clip );
             }
             else
             {
@@ -256,6 +262,33 @@ void AudioReload( const std::string& path )
     }
 }
 
+ae3d::AudioSystem::DecodedOgg::~DecodedOgg()
+{
+    std::free( samples );
+}
+
+void ae3d::AudioSystem::DecodeOgg( const FileSystem::FileView& clipData, DecodedOgg& outDecoded )
+{
+    outDecoded.length = stb_vorbis_decode_memory( clipData.data, static_cast< int >( clipData.size ), &outDecoded.channels, &outDecoded.sampleRate, &outDecoded.samples );
+
+    if (outDecoded.length <= 0)
+    {
+        outDecoded.length = 0;
+        return;
+    }
+
+    int error;
+    stb_vorbis* vorbis = stb_vorbis_open_memory( clipData.data, static_cast< int >( clipData.size ), &error, nullptr );
+    outDecoded.lengthInSeconds = stb_vorbis_stream_length_in_seconds( vorbis );
+    stb_vorbis_close( vorbis );
+}
+
+void ae3d::AudioSystem::SetPredecodedOgg( const unsigned char* source, const DecodedOgg* decoded )
+{
+    AudioGlobal::predecodedOggSource = source;
+    AudioGlobal::predecodedOgg = decoded;
+}
+
 void ae3d::AudioSystem::Init()
 {
     AudioGlobal::device = alcOpenDevice( nullptr );
@@ -293,7 +326,7 @@ void ae3d::AudioSystem::Deinit()
     }
 }
 
-unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData& clipData )
+unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileView& clipData )
 {
     // Checks cache for an already loaded clip from the same path.
     for (std::size_t i = 0; i < AudioGlobal::clips.size(); ++i)
@@ -0,0 +1,126 @@
+#ifndef COMPONENT_POOL_H
+#define COMPONENT_POOL_H
+
+#include <vector>
+#include "System.hpp"
+
+namespace ae3d
+{
+    /// Storage for all components of one type. Deleted slots are reused.
+    /// Handles are 32 bits: slot index in the low bits and the slot's generation in the high bits.
+    /// The generation is bumped when a slot is deleted, so an old handle no longer resolves
+    /// to whichever component later reuses the slot. Handle 0 is never valid.
+    template< class T > class ComponentPool
+    {
+    public:
+        static const unsigned IndexBits = 20;
+        static const unsigned IndexMask = (1u << IndexBits) - 1;
+        static const unsigned MaxGeneration = 0xFFFFFFFFu >> IndexBits;
+
+        ~ComponentPool()
+        {
+            // GameObjects with static storage can release their components after this.
+            isDestroyed = true;
+        }
+
+        /// \return Handle to a default-constructed component.
+        unsigned New()
+        {
+            if (freeIndices.empty())
+            {
+                Grow();
+            }
+
+            const unsigned index = freeIndices.back();
+            freeIndices.pop_back();
+
+            // Reset here instead of in Delete so that deleting has no side effects during static destruction.
+            components[ index ] = T();
+            isAlive[ index ] = true;
+
+            return (generations[ index ] << IndexBits) | index;
+        }
+
+        /// Releases a component's slot. Does nothing if the handle is stale.
+        /// \param handle Handle returned by New.
+        void Delete( unsigned handle )
+        {
+            if (isDestroyed || !IsValid( handle ))
+            {
+                return;
+            }
+
+            const unsigned index = handle & IndexMask;
+            isAlive[ index ] = false;
+            generations[ index ] = generations[ index ] == MaxGeneration ? 1 : generations[ index ] + 1;
+            freeIndices.push_back( index );
+        }
+
+        /// \param handle Handle returned by New.
+        /// \return Component or null if the handle is stale.
+        T* Get( unsigned handle )
+        {
+            return IsValid( handle ) ? &components[ handle & IndexMask ] : nullptr;
+        }
+
+        /// \param handle Handle returned by New.
+        /// \return True, if the handle's component has not been deleted.
+        bool IsValid( unsigned handle ) const
+        {
+            const unsigned index = handle & IndexMask;
+            return !isDestroyed && index < generations.size() && isAlive[ index ] && generations[ index ] == (handle >> IndexBits);
+        }
+
+        /// \param component Component in this pool.
+        /// \return Handle of the component or 0 if it's not a live component of this pool.
+        unsigned GetHandle( const T* component ) const
+        {
+            if (component == nullptr || components.empty() || component < &components[ 0 ] || component > &components.back())
+            {
+                return 0;
+            }
+
+            const unsigned index = static_cast< unsigned >( component - &components[ 0 ] );
+            return isAlive[ index ] ? ((generations[ index ] << IndexBits) | index) : 0;
+        }
+
+        /// \return Slot count including deleted slots. Slot indices are handle & IndexMask.
+        unsigned GetSlotCount() const { return static_cast< unsigned >( components.size() ); }
+
+        /// \param index Slot index.
+        /// \return True, if the slot holds a live component.
+        bool IsAlive( unsigned index ) const { return isAlive[ index ]; }
+
+        /// \param index Slot index.
+        /// \return Component in the slot.
+        T& operator[]( unsigned index ) { return components[ index ]; }
+
+    private:
+        void Grow()
+        {
+            const std::size_t oldSize = components.size();
+            const std::size_t newSize = oldSize == 0 ? 16 : oldSize * 2;
+            System::Assert( newSize <= IndexMask + 1, "too many components" );
+
+            // Handles are indices, so moving the storage doesn't invalidate them, only pointers.
+            components.resize( newSize );
+            generations.resize( newSize, 1 );
+            isAlive.resize( newSize, false );
+
+            // Reversed so that the lowest index is used first.
+            for (std::size_t index = newSize; index > oldSize; --index)
+            {
+                freeIndices.push_back( static_cast< unsigned >( index - 1 ) );
+            }
+        }
+
+        std::vector< T > components;
+        std::vector< unsigned > generations;
+        std::vector< bool > isAlive;
+        std::vector< unsigned > freeIndices;
+        static bool isDestroyed;
+    };
+
+    template< class T > bool ComponentPool< T >::isDestroyed = false;
+}
+#endif
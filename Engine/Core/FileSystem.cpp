@@ -1,129 +1,564 @@
-#include "FileSystem.hpp"
-#include "System.hpp"
-#include <algorithm>
-#include <fstream>
-#include <sstream>
-#include <vector>
-
-#if RENDERER_METAL
-const char* GetFullPath( const char* fileName )
-{
-    std::string nameWithSlash( "/" );
-    nameWithSlash += fileName;
-    std::replace( std::begin( nameWithSlash ), std::end( nameWithSlash ), '\\', '/' );
-
-    NSBundle *b = [NSBundle mainBundle];
-    NSString *dir = [b resourcePath];
-    NSString* fName = [NSString stringWithUTF8String: nameWithSlash.c_str()];
-    dir = [dir stringByAppendingString:fName];
-    return [dir fileSystemRepresentation];
-}
-#else
-const char* GetFullPath( const char* fileName )
-{
-    static std::string fName;
-    fName = fileName;
-    std::replace( std::begin( fName ), std::end( fName ), '\\', '/' );
-    return fName.c_str();
-}
-#endif
-
-struct PakFile
-{
-    struct FileEntry
-    {
-        std::string path;
-        std::vector< unsigned char > contents;
-    };
-
-    std::vector< FileEntry > entries;
-    std::string path;
-};
-
-namespace Global
-{
-    std::vector< PakFile > pakFiles;
-}
-
-ae3d::FileSystem::FileContentsData ae3d::FileSystem::FileContents( const char* path )
-{
-    ae3d::FileSystem::FileContentsData outData;
-    outData.path = path == nullptr ? "" : std::string( GetFullPath( path ) );
-
-    for (const auto& pakFile : Global::pakFiles)
-    {
-        for (const auto& entry : pakFile.entries)
-        {
-            if (entry.path == std::string(path))
-            {
-                outData.data = entry.contents;
-                outData.isLoaded = true;
-                return outData;
-            }
-        }
-    }
-
-    std::ifstream in( outData.path.c_str(), std::ifstream::ate | std::ifstream::binary );
-    outData.isLoaded = in.is_open();
-
-    if (!outData.isLoaded)
-    {
-        System::Print( "FileSystem: Could not open %s.\n", outData.path.c_str() );
-        return outData;
-    }
-
-    const std::size_t size = (std::size_t)in.tellg();
-    outData.data.resize( size );
-    in.seekg( std::ifstream::beg );
-    in.read( (char*)outData.data.data(), outData.data.size() );
-
-    return outData;
-}
-
-void ae3d::FileSystem::LoadPakFile( const char* path )
-{
-    if (path == nullptr)
-    {
-        System::Print( "LoadPakFile: path is null\n" );
-    }
-
-    Global::pakFiles.emplace_back( PakFile() );
-    unsigned entryCount = 0;
-    std::ifstream ifs( path );
-    if (!ifs.is_open())
-    {
-        System::Print( "LoadPakFile: Could not open %s\n", path );
-    }
-
-    ifs.read( (char*)&entryCount, 4 );
-    auto& pakFile = Global::pakFiles.back();
-    pakFile.entries.resize( entryCount );
-    pakFile.path = path;
-
-    for (unsigned i = 0; i < entryCount; ++i)
-    {
-        auto& entry = pakFile.entries[i];
-        char entryPath[ 128 ];
-        ifs.read( &entryPath[ 0 ], 128 );
-        entry.path = entryPath;
-        unsigned entrySize = 0;
-        ifs.read( (char*)&entrySize, 4 );
-        entry.contents.resize( entrySize );
-        ifs.read( (char*)entry.contents.data(), entrySize );
-    }
-}
-
-void ae3d::FileSystem::UnloadPakFile( const char* path )
-{
-    int i = 0;
-
-    for (const PakFile& pakFile : Global::pakFiles)
-    {
-        if (pakFile.path == std::string( path ))
-        {
-            Global::pakFiles.erase( std::begin( Global::pakFiles ) + i );
-            return;
-        }
-        ++i;
-    }
-}
+#include "FileSystem.hpp"
+#if _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#define VC_EXTRALEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.hpp"
+#include "PakFormat.hpp"
+#include "System.hpp"
+#define LZ4_BLOCK_IMPLEMENTATION
+#include "lz4_block.h"
+
+#if RENDERER_METAL
+std::string GetFullPath( const char* fileName )
+{
+    std::string nameWithSlash( "/" );
+    nameWithSlash += fileName;
+    std::replace( std::begin( nameWithSlash ), std::end( nameWithSlash ), '\\', '/' );
+
+    NSBundle *b = [NSBundle mainBundle];
+    NSString *dir = [b resourcePath];
+    NSString* fName = [NSString stringWithUTF8String: nameWithSlash.c_str()];
+    dir = [dir stringByAppendingString:fName];
+    return std::string( [dir fileSystemRepresentation] );
+}
+#else
+std::string GetFullPath( const char* fileName )
+{
+    // Returned by value, because AssetLoader calls this from several workers at once.
+    std::string fName( fileName );
+    std::replace( std::begin( fName ), std::end( fName ), '\\', '/' );
+    return fName;
+}
+#endif
+
+// Read-only mapping of a whole file. FileViews and the PakFile share ownership of it,
+// so it's unmapped when the last of them is destroyed.
+struct MappedFile
+{
+    MappedFile() = default;
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+    ~MappedFile();
+
+    /// \param path Path.
+    /// \param isRandomAccess Disables read-ahead, for files whose parts are read in arbitrary order.
+    /// \return True if the file could be mapped. Empty files are not mapped, but succeed.
+    bool Map( const char* path, bool isRandomAccess );
+
+    const unsigned char* data = nullptr;
+    std::uint64_t size = 0;
+#if _MSC_VER
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE fileMapping = nullptr;
+#endif
+};
+
+bool MappedFile::Map( const char* path, bool isRandomAccess )
+{
+#if _MSC_VER
+    file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, isRandomAccess ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx( file, &fileSize ))
+    {
+        return false;
+    }
+
+    size = (std::uint64_t)fileSize.QuadPart;
+
+    if (size == 0)
+    {
+        return true;
+    }
+
+    fileMapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    data = fileMapping ? (const unsigned char*)MapViewOfFile( fileMapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+#else
+    const int fd = open( path, O_RDONLY );
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+
+    if (fstat( fd, &fileStat ) == -1 || !S_ISREG( fileStat.st_mode ))
+    {
+        close( fd );
+        return false;
+    }
+
+    size = (std::uint64_t)fileStat.st_size;
+
+    if (size == 0)
+    {
+        close( fd );
+        return true;
+    }
+
+    void* address = mmap( nullptr, (std::size_t)size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    // The mapping keeps the file alive.
+    close( fd );
+
+    if (address != MAP_FAILED)
+    {
+        madvise( address, (std::size_t)size, isRandomAccess ? MADV_RANDOM : MADV_SEQUENTIAL );
+        data = (const unsigned char*)address;
+    }
+#endif
+
+    return data != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+#if _MSC_VER
+    if (data != nullptr)
+    {
+        UnmapViewOfFile( data );
+    }
+
+    if (fileMapping != nullptr)
+    {
+        CloseHandle( fileMapping );
+    }
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle( file );
+    }
+#else
+    if (data != nullptr)
+    {
+        munmap( const_cast< unsigned char* >( data ), (std::size_t)size );
+    }
+#endif
+}
+
+// Memory-mapped .pak file. Entries are looked up in the mapped table of contents and their pages
+// are read by the OS on first access, so loading a pak costs almost no memory regardless of its size.
+struct PakFile
+{
+    bool Map( const char* aPath );
+    void Unmap();
+    bool ParseTableOfContents();
+    bool FindEntry( const char* entryPath, ae3d::PakFormat::TocEntry& outEntry ) const;
+    bool ReadEntry( const ae3d::PakFormat::TocEntry& entry, std::vector< unsigned char >& outData ) const;
+
+    std::string path;
+    std::shared_ptr< MappedFile > file;
+    // Same as file's, for brevity.
+    const unsigned char* mapping = nullptr;
+    std::uint64_t mappingSize = 0;
+
+    // Version 2+, point into mapping.
+    const ae3d::PakFormat::Header* header = nullptr;
+    const std::uint32_t* buckets = nullptr;
+    const ae3d::PakFormat::TocEntry* toc = nullptr;
+    const char* strings = nullptr;
+
+    // Version 1 paks have no table of contents, so it's built by walking the entry headers.
+    std::unordered_map< std::string, ae3d::PakFormat::TocEntry > legacyEntries;
+};
+
+bool PakFile::Map( const char* aPath )
+{
+    file = std::make_shared< MappedFile >();
+
+    // Entries are read in arbitrary order, so read-ahead would page in unrelated entries.
+    if (!file->Map( aPath, true ) || file->size == 0)
+    {
+        file.reset();
+        return false;
+    }
+
+    mapping = file->data;
+    mappingSize = file->size;
+    path = aPath;
+    return true;
+}
+
+void PakFile::Unmap()
+{
+    // Views of uncompressed entries keep the mapping alive until they are destroyed.
+    file.reset();
+    mapping = nullptr;
+    mappingSize = 0;
+}
+
+bool PakFile::ParseTableOfContents()
+{
+    using namespace ae3d;
+
+    if (mappingSize >= sizeof( PakFormat::Header ) && PakFormat::HasMagic( *(const PakFormat::Header*)mapping ))
+    {
+        header = (const PakFormat::Header*)mapping;
+
+        if (header->version != PakFormat::Version)
+        {
+            System::Print( "LoadPakFile: %s has version %u, expected %u\n", path.c_str(), header->version, PakFormat::Version );
+            return false;
+        }
+
+        const std::uint64_t bucketsEnd = sizeof( PakFormat::Header ) + (header->bucketCount + 1ULL) * sizeof( std::uint32_t );
+        const std::uint64_t tocEnd = header->tocOffset + header->entryCount * (std::uint64_t)sizeof( PakFormat::TocEntry );
+
+        if (header->bucketCount == 0 || bucketsEnd > header->tocOffset || header->tocOffset % alignof( PakFormat::TocEntry ) != 0 ||
+            tocEnd > header->stringsOffset || header->stringsOffset > mappingSize)
+        {
+            System::Print( "LoadPakFile: %s has a corrupt table of contents\n", path.c_str() );
+            return false;
+        }
+
+        buckets = (const std::uint32_t*)(mapping + sizeof( PakFormat::Header ));
+        toc = (const PakFormat::TocEntry*)(mapping + header->tocOffset);
+        strings = (const char*)(mapping + header->stringsOffset);
+        return true;
+    }
+
+    // Version 1: entry count, then path, size and contents of each entry.
+    const unsigned MaxPathLength = 128;
+    std::uint32_t entryCount = 0;
+    std::uint64_t offset = sizeof( entryCount );
+
+    if (mappingSize < offset)
+    {
+        return false;
+    }
+
+    std::memcpy( &entryCount, mapping, sizeof( entryCount ) );
+
+    for (std::uint32_t i = 0; i < entryCount; ++i)
+    {
+        std::uint32_t entrySize = 0;
+
+        if (offset + MaxPathLength + sizeof( entrySize ) > mappingSize)
+        {
+            System::Print( "LoadPakFile: %s is truncated\n", path.c_str() );
+            return false;
+        }
+
+        const char* entryPath = (const char*)mapping + offset;
+        std::memcpy( &entrySize, mapping + offset + MaxPathLength, sizeof( entrySize ) );
+        offset += MaxPathLength + sizeof( entrySize );
+
+        // If a path is in the pak many times, the first entry is used.
+        PakFormat::TocEntry entry = {};
+        entry.offset = offset;
+        entry.size = entrySize;
+        entry.storedSize = entrySize;
+        legacyEntries.emplace( std::string( entryPath, strnlen( entryPath, MaxPathLength ) ), entry );
+        offset += entrySize;
+    }
+
+    return true;
+}
+
+bool PakFile::FindEntry( const char* entryPath, ae3d::PakFormat::TocEntry& outEntry ) const
+{
+    using namespace ae3d;
+
+    if (header == nullptr)
+    {
+        const auto it = legacyEntries.find( entryPath );
+
+        if (it == std::end( legacyEntries ))
+        {
+            return false;
+        }
+
+        outEntry = it->second;
+        return outEntry.offset + outEntry.storedSize <= mappingSize;
+    }
+
+    const std::uint32_t pathLength = (std::uint32_t)std::strlen( entryPath );
+    const std::uint64_t pathHash = PakFormat::HashPath( entryPath, pathLength );
+    const std::uint32_t bucket = PakFormat::GetBucket( pathHash, header->bucketCount );
+    const std::uint32_t end = std::min( buckets[ bucket + 1 ], header->entryCount );
+
+    for (std::uint32_t i = buckets[ bucket ]; i < end; ++i)
+    {
+        const PakFormat::TocEntry& entry = toc[ i ];
+
+        if (entry.pathHash == pathHash && entry.pathLength == pathLength &&
+            header->stringsOffset + entry.pathOffset + pathLength <= mappingSize &&
+            std::memcmp( strings + entry.pathOffset, entryPath, pathLength ) == 0)
+        {
+            outEntry = entry;
+            return entry.offset + entry.storedSize <= mappingSize;
+        }
+    }
+
+    return false;
+}
+
+bool PakFile::ReadEntry( const ae3d::PakFormat::TocEntry& entry, std::vector< unsigned char >& outData ) const
+{
+    using namespace ae3d;
+
+    const unsigned char* stored = mapping + entry.offset;
+
+    if (entry.compression == PakFormat::Compression::None)
+    {
+        outData.assign( stored, stored + entry.storedSize );
+        return true;
+    }
+
+    const std::uint64_t chunkCount = PakFormat::GetChunkCount( entry );
+
+    // A zero chunk size would make a non-empty entry have no chunks and leave its contents uninitialized.
+    if (entry.compression != PakFormat::Compression::LZ4 || (entry.chunkSize == 0 && entry.size != 0) || entry.chunkSize > 0x7FFFFFFF ||
+        chunkCount * sizeof( std::uint32_t ) > entry.storedSize || chunkCount > 0x7FFFFFFF)
+    {
+        return false;
+    }
+
+    // Chunk offsets are a prefix sum of the stored sizes that follow the chunk size table.
+    std::vector< std::uint64_t > chunkOffsets( (std::size_t)chunkCount + 1 );
+    chunkOffsets[ 0 ] = chunkCount * sizeof( std::uint32_t );
+
+    for (std::uint64_t i = 0; i < chunkCount; ++i)
+    {
+        std::uint32_t chunkStoredSize = 0;
+        std::memcpy( &chunkStoredSize, stored + i * sizeof( std::uint32_t ), sizeof( chunkStoredSize ) );
+        chunkOffsets[ i + 1 ] = chunkOffsets[ i ] + (chunkStoredSize & ~PakFormat::ChunkStoredRaw);
+    }
+
+    if (chunkOffsets.back() > entry.storedSize)
+    {
+        return false;
+    }
+
+    outData.resize( (std::size_t)entry.size );
+    std::atomic< bool > isValid( true );
+
+    // Chunks are independent, so large entries are decompressed on all workers.
+    JobSystem::ParallelFor( (int)chunkCount, 1, [&]( int begin, int end )
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            std::uint32_t chunkStoredSize = 0;
+            std::memcpy( &chunkStoredSize, stored + i * sizeof( std::uint32_t ), sizeof( chunkStoredSize ) );
+            const std::uint64_t chunkStart = (std::uint64_t)i * entry.chunkSize;
+            const int chunkSize = (int)std::min( (std::uint64_t)entry.chunkSize, entry.size - chunkStart );
+            const unsigned char* src = stored + chunkOffsets[ i ];
+            const int srcSize = (int)(chunkOffsets[ i + 1 ] - chunkOffsets[ i ]);
+
+            if ((chunkStoredSize & PakFormat::ChunkStoredRaw) != 0)
+            {
+                if (srcSize != chunkSize)
+                {
+                    isValid = false;
+                    continue;
+                }
+
+                std::memcpy( outData.data() + chunkStart, src, (std::size_t)srcSize );
+            }
+            else if (lz4b_decompress( src, srcSize, outData.data() + chunkStart, chunkSize ) != chunkSize)
+            {
+                isValid = false;
+            }
+        }
+    } );
+
+    return isValid;
+}
+
+namespace Global
+{
+    std::vector< std::shared_ptr< const PakFile > > pakFiles;
+    std::mutex pakFilesMutex;
+}
+
+// Readers search a copy, so files can be read on worker threads while the main thread loads or unloads paks.
+std::vector< std::shared_ptr< const PakFile > > GetPakFiles()
+{
+    std::lock_guard< std::mutex > lock( Global::pakFilesMutex );
+    return Global::pakFiles;
+}
+
+ae3d::FileSystem::FileContentsData ae3d::FileSystem::FileContents( const char* path )
+{
+    ae3d::FileSystem::FileContentsData outData;
+    outData.path = path == nullptr ? "" : GetFullPath( path );
+
+    if (path == nullptr)
+    {
+        System::Print( "FileSystem: path is null.\n" );
+        return outData;
+    }
+
+    for (const auto& pakFile : GetPakFiles())
+    {
+        PakFormat::TocEntry entry;
+
+        if (pakFile->FindEntry( path, entry ))
+        {
+            outData.isLoaded = pakFile->ReadEntry( entry, outData.data );
+
+            if (!outData.isLoaded)
+            {
+                System::Print( "FileSystem: %s in %s is corrupt.\n", path, pakFile->path.c_str() );
+                outData.data.clear();
+            }
+
+            return outData;
+        }
+    }
+
+    std::ifstream in( outData.path.c_str(), std::ifstream::ate | std::ifstream::binary );
+    outData.isLoaded = in.is_open();
+
+    if (!outData.isLoaded)
+    {
+        System::Print( "FileSystem: Could not open %s.\n", outData.path.c_str() );
+        return outData;
+    }
+
+    const std::size_t size = (std::size_t)in.tellg();
+    outData.data.resize( size );
+    in.seekg( std::ifstream::beg );
+    in.read( (char*)outData.data.data(), outData.data.size() );
+
+    return outData;
+}
+
+ae3d::FileSystem::FileView::FileView( const FileContentsData& contents )
+    : data( contents.data.data() )
+    , size( contents.data.size() )
+    , path( contents.path )
+    , isLoaded( contents.isLoaded )
+{
+}
+
+ae3d::FileSystem::FileView ae3d::FileSystem::FileContentsView( const char* path )
+{
+    ae3d::FileSystem::FileView outView;
+    outView.path = path == nullptr ? "" : GetFullPath( path );
+
+    if (path == nullptr)
+    {
+        System::Print( "FileSystem: path is null.\n" );
+        return outView;
+    }
+
+    for (const auto& pakFile : GetPakFiles())
+    {
+        PakFormat::TocEntry entry;
+
+        if (!pakFile->FindEntry( path, entry ))
+        {
+            continue;
+        }
+
+        if (entry.compression == PakFormat::Compression::None)
+        {
+            outView.data = pakFile->mapping + entry.offset;
+            outView.size = (std::size_t)entry.size;
+            outView.owner = pakFile->file;
+            outView.isLoaded = true;
+            return outView;
+        }
+
+        auto decompressed = std::make_shared< std::vector< unsigned char > >();
+
+        if (!pakFile->ReadEntry( entry, *decompressed ))
+        {
+            System::Print( "FileSystem: %s in %s is corrupt.\n", path, pakFile->path.c_str() );
+            return outView;
+        }
+
+        outView.data = decompressed->data();
+        outView.size = decompressed->size();
+        outView.owner = decompressed;
+        outView.isLoaded = true;
+        return outView;
+    }
+
+    auto file = std::make_shared< MappedFile >();
+
+    if (!file->Map( outView.path.c_str(), false ))
+    {
+        System::Print( "FileSystem: Could not open %s.\n", outView.path.c_str() );
+        return outView;
+    }
+
+    outView.data = file->data;
+    outView.size = (std::size_t)file->size;
+    outView.owner = file;
+    outView.isLoaded = true;
+    return outView;
+}
+
+void ae3d::FileSystem::LoadPakFile( const char* path )
+{
+    if (path == nullptr)
+    {
+        System::Print( "LoadPakFile: path is null\n" );
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( Global::pakFilesMutex );
+
+    for (const auto& pakFile : Global::pakFiles)
+    {
+        if (pakFile->path == path)
+        {
+            return;
+        }
+    }
+
+    auto pakFile = std::make_shared< PakFile >();
+
+    if (!pakFile->Map( path ))
+    {
+        System::Print( "LoadPakFile: Could not open %s\n", path );
+        return;
+    }
+
+    if (!pakFile->ParseTableOfContents())
+    {
+        pakFile->Unmap();
+        return;
+    }
+
+    Global::pakFiles.push_back( pakFile );
+}
+
+void ae3d::FileSystem::UnloadPakFile( const char* path )
+{
+    std::lock_guard< std::mutex > lock( Global::pakFilesMutex );
+
+    for (auto it = std::begin( Global::pakFiles ); it != std::end( Global::pakFiles ); ++it)
+    {
+        if ((*it)->path == std::string( path ))
+        {
+            // The mapping is closed when reads in progress and views into it are done with it.
+            Global::pakFiles.erase( it );
+            return;
+        }
+    }
+}
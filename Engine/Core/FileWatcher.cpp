@@ -1,56 +1,248 @@
 #include "FileWatcher.hpp"
-#include <ctime>
 #include <sys/stat.h>
-#include <locale.h>
+#include <utility>
+#include <vector>
+#if __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#include "System.hpp"
 
 ae3d::FileWatcher fileWatcher;
 
-void ae3d::FileWatcher::AddFile( const std::string& path, std::function<void(const std::string&)> updateFunc )
+namespace
 {
-    pathToEntry[ path ] = Entry();
-    pathToEntry[ path ].path = path;
-    pathToEntry[ path ].updateFunc = updateFunc;
+    // \return False if path could not be stat'ed.
+    bool GetModification( const std::string& path, long long& outTime, long long& outSize )
+    {
+        struct stat inode;
 
-    struct stat inode;
+        if (stat( path.c_str(), &inode ) == -1)
+        {
+            return false;
+        }
 
-    if (stat( path.c_str(), &inode ) != -1)
-    {
 #if _MSC_VER
-        tm timeinfo;
-        localtime_s( &timeinfo, &inode.st_mtime );
-        tm* timeinfo2 = &timeinfo;
+        outTime = static_cast< long long >( inode.st_mtime ) * 1000000000LL;
+#elif __APPLE__
+        outTime = static_cast< long long >( inode.st_mtimespec.tv_sec ) * 1000000000LL + inode.st_mtimespec.tv_nsec;
 #else
-        tm* timeinfo2 = std::localtime( &inode.st_mtime );
+        outTime = static_cast< long long >( inode.st_mtim.tv_sec ) * 1000000000LL + inode.st_mtim.tv_nsec;
 #endif
-        pathToEntry[ path ].hour = timeinfo2->tm_hour;
-        pathToEntry[ path ].minute = timeinfo2->tm_min;
-        pathToEntry[ path ].second = timeinfo2->tm_sec;
+        outSize = static_cast< long long >( inode.st_size );
+        return true;
     }
 }
 
-void ae3d::FileWatcher::Poll()
+ae3d::FileWatcher::~FileWatcher()
 {
-    struct stat inode = {};
+#if __linux__
+    if (inotifyFd != -1)
+    {
+        close( inotifyFd );
+    }
+#endif
+}
 
-    for (auto& entry : pathToEntry)
+void ae3d::FileWatcher::AddFile( const std::string& path, std::function<void(const std::string&)> updateFunc )
+{
+    const bool isWatched = pathToEntry.find( path ) != pathToEntry.end();
+    Entry& entry = pathToEntry[ path ];
+    entry.updateFunc = updateFunc;
+
+    if (isWatched)
+    {
+        return;
+    }
+
+    entry.path = path;
+    GetModification( path, entry.reportedTime, entry.reportedSize );
+    entry.lastTime = entry.reportedTime;
+    entry.lastSize = entry.reportedSize;
+    entry.isPolled = isPollingForced || !WatchFile( path );
+
+    if (entry.isPolled)
+    {
+        polledEntries.push_back( &entry );
+    }
+}
+
+bool ae3d::FileWatcher::WatchFile( const std::string& path )
+{
+#if __linux__
+    if (!isInotifyInitialized)
     {
-        if (stat( entry.second.path.c_str(), &inode ) != -1)
+        isInotifyInitialized = true;
+        inotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+        if (inotifyFd == -1)
         {
-#if _MSC_VER
-            tm timeinfo;
-            localtime_s( &timeinfo, &inode.st_mtime );
-            tm* timeinfo2 = &timeinfo;
+            System::Print( "FileWatcher: inotify is not available, polling all files.\n" );
+        }
+    }
+
+    if (inotifyFd == -1)
+    {
+        return false;
+    }
+
+    const std::size_t slash = path.find_last_of( '/' );
+    const std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr( 0, slash ));
+    const std::string fileName = slash == std::string::npos ? path : path.substr( slash + 1 );
+
+    auto watch = directoryToWatch.find( directory );
+
+    if (watch == directoryToWatch.end())
+    {
+        // Editors often save by writing a temporary file and renaming it over the original, so renames are watched too.
+        const int newWatch = inotify_add_watch( inotifyFd, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_MOVED_TO );
+
+        if (newWatch == -1)
+        {
+            // Usually means fs.inotify.max_user_watches is reached.
+            System::Print( "FileWatcher: Could not watch %s, polling its files.\n", directory.c_str() );
+        }
+        else
+        {
+            watchToDirectory[ newWatch ].path = directory;
+        }
+
+        watch = directoryToWatch.insert( std::make_pair( directory, newWatch ) ).first;
+    }
+
+    if (watch->second == -1)
+    {
+        return false;
+    }
+
+    watchToDirectory[ watch->second ].fileNameToPath[ fileName ] = path;
+    return true;
 #else
-            tm* timeinfo2 = std::localtime( &inode.st_mtime );
+    (void)path;
+    return false;
 #endif
+}
+
+void ae3d::FileWatcher::MarkChanged( Entry& entry )
+{
+    entry.lastChangeTime = std::chrono::steady_clock::now();
+    changedPaths.insert( entry.path );
+}
 
-            if (timeinfo2->tm_hour != entry.second.hour || timeinfo2->tm_min != entry.second.minute || timeinfo2->tm_sec != entry.second.second)
+void ae3d::FileWatcher::ReadEvents()
+{
+#if __linux__
+    if (inotifyFd == -1)
+    {
+        return;
+    }
+
+    alignas( inotify_event ) char buffer[ 16 * 1024 ];
+
+    while (true)
+    {
+        // The descriptor is non-blocking, so this returns -1 when there are no more events.
+        const ssize_t length = read( inotifyFd, buffer, sizeof( buffer ) );
+
+        if (length <= 0)
+        {
+            return;
+        }
+
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event* event = reinterpret_cast< const inotify_event* >( buffer + offset );
+            offset += static_cast< ssize_t >( sizeof( inotify_event ) + event->len );
+
+            if (event->mask & IN_Q_OVERFLOW)
             {
-                entry.second.updateFunc( entry.second.path );
-                entry.second.hour = timeinfo2->tm_hour;
-                entry.second.minute = timeinfo2->tm_min;
-                entry.second.second = timeinfo2->tm_sec;
+                // Events were dropped, so any file may have changed.
+                for (auto& entry : pathToEntry)
+                {
+                    MarkChanged( entry.second );
+                }
+
+                continue;
+            }
+
+            const auto directory = watchToDirectory.find( event->wd );
+
+            if (event->len == 0 || directory == watchToDirectory.end())
+            {
+                continue;
+            }
+
+            const auto file = directory->second.fileNameToPath.find( event->name );
+
+            if (file != directory->second.fileNameToPath.end())
+            {
+                MarkChanged( pathToEntry[ file->second ] );
             }
         }
     }
+#endif
+}
+
+void ae3d::FileWatcher::Poll()
+{
+    ReadEvents();
+
+    long long time = 0;
+    long long size = -1;
+
+    for (Entry* entry : polledEntries)
+    {
+        time = 0;
+        size = -1;
+        GetModification( entry->path, time, size );
+
+        if (time != entry->lastTime || size != entry->lastSize)
+        {
+            entry->lastTime = time;
+            entry->lastSize = size;
+            MarkChanged( *entry );
+        }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    std::vector< std::pair< std::function<void(const std::string&)>, std::string > > updates;
+
+    for (auto path = changedPaths.begin(); path != changedPaths.end(); )
+    {
+        Entry& entry = pathToEntry[ *path ];
+        time = 0;
+        size = -1;
+        const bool exists = GetModification( entry.path, time, size );
+
+        if (time != entry.lastTime || size != entry.lastSize)
+        {
+            // Still being written.
+            entry.lastTime = time;
+            entry.lastSize = size;
+            entry.lastChangeTime = now;
+            ++path;
+            continue;
+        }
+
+        if (now - entry.lastChangeTime < debounceTime)
+        {
+            ++path;
+            continue;
+        }
+
+        if (exists && (time != entry.reportedTime || size != entry.reportedSize))
+        {
+            entry.reportedTime = time;
+            entry.reportedSize = size;
+            updates.push_back( std::make_pair( entry.updateFunc, entry.path ) );
+        }
+
+        path = changedPaths.erase( path );
+    }
+
+    // Called after checking, because update functions can add files.
+    for (const auto& update : updates)
+    {
+        update.first( update.second );
+    }
 }
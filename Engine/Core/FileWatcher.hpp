@@ -1,32 +1,81 @@
 #ifndef FILEWATCHER_H
 #define FILEWATCHER_H
 
+#include <chrono>
 #include <string>
 #include <functional>
 #include <map>
+#include <set>
+#include <vector>
 
 namespace ae3d
 {
-    /** Keeps track of files and calls updateFunc when they have changed on disk. This enables asset hotloading. */
+    /**
+      Keeps track of files and calls updateFunc when they have changed on disk. This enables asset hotloading.
+
+      On Linux the directories of watched files are watched with inotify, so Poll only looks at files that had events.
+      Elsewhere, or if inotify can't be used, Poll stats every watched file. A file has changed if its modification time
+      in nanoseconds or its size has changed.
+    */
     class FileWatcher
     {
     public:
+        FileWatcher() = default;
+        FileWatcher( const FileWatcher& ) = delete;
+        FileWatcher& operator=( const FileWatcher& ) = delete;
+        ~FileWatcher();
+
         void AddFile( const std::string& path, std::function<void(const std::string&)> updateFunc );
-        // Scans for all watched file modification timestamps and calls updateFunc if they have been updated.
+
+        // Checks watched files for changes and calls updateFunc of each changed file. The calls are made in a batch after all files have been checked.
         void Poll();
 
+        /// \param milliseconds updateFunc is called after the file hasn't changed for this long, so a burst of writes causes one call. Defaults to 100.
+        void SetDebounceTime( int milliseconds ) { debounceTime = std::chrono::milliseconds( milliseconds ); }
+
+        /// \param usePolling If true, Poll stats every watched file instead of using inotify. Must be called before AddFile.
+        void SetUsePolling( bool usePolling ) { isPollingForced = usePolling; }
+
     private:
         struct Entry
         {
-            int hour = 0;
-            int minute = 0;
-            int second = 0;
+            // Modification time in nanoseconds and size that updateFunc was last called for.
+            long long reportedTime = 0;
+            long long reportedSize = -1;
+            // Modification time and size when the file was last checked.
+            long long lastTime = 0;
+            long long lastSize = -1;
+            std::chrono::steady_clock::time_point lastChangeTime;
+            bool isPolled = false;
             std::string path;
             std::function<void(const std::string&)> updateFunc;
         };
-        
+
+        // Watched directory, with the paths of its watched files by file name.
+        struct Directory
+        {
+            std::string path;
+            std::map< std::string, std::string > fileNameToPath;
+        };
+
+        bool WatchFile( const std::string& path );
+        void ReadEvents();
+        void MarkChanged( Entry& entry );
+
         std::map< std::string, Entry > pathToEntry;
-    };    
+        // Files that have changed but whose updateFunc has not been called yet.
+        std::set< std::string > changedPaths;
+        // Files that are not watched with inotify. Point into pathToEntry.
+        std::vector< Entry* > polledEntries;
+        std::chrono::steady_clock::duration debounceTime = std::chrono::milliseconds( 100 );
+        bool isPollingForced = false;
+
+        // inotify instance or -1 if it's not created or failed.
+        int inotifyFd = -1;
+        bool isInotifyInitialized = false;
+        std::map< int, Directory > watchToDirectory;
+        std::map< std::string, int > directoryToWatch;
+    };
 }
 
 #endif
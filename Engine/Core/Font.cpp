@@ -3,6 +3,7 @@
 #include <vector>
 #include "System.hpp"
 #include "FileSystem.hpp"
+#include "MemoryStream.hpp"
 #include "Texture2D.hpp"
 #include "VertexBuffer.hpp"
 #include "Vec3.hpp"
@@ -136,14 +137,14 @@ void ae3d::Font::CreateVertexBuffer( const char* text, const Vec4& color, Vertex
     outVertexBuffer.SetDebugName( text );
 }
 
-void ae3d::Font::LoadBMFont( Texture2D* fontTex, const FileSystem::FileContentsData& metaData )
+void ae3d::Font::LoadBMFont( Texture2D* fontTex, const FileSystem::FileView& metaData )
 {
     if (fontTex != nullptr)
     {
         texture = fontTex;
     }
 
-    std::stringstream metaStream( std::string( std::begin( metaData.data ), std::end( metaData.data ) ) );
+    imemstream metaStream( (const char*)metaData.data, metaData.size );
     std::string token;
     // Determines the encoding (text or binary).
     metaStream >> token;
@@ -158,9 +159,9 @@ void ae3d::Font::LoadBMFont( Texture2D* fontTex, const FileSystem::FileContentsD
     }
 }
 
-void ae3d::Font::LoadBMFontMetaText( const FileSystem::FileContentsData& metaData )
+void ae3d::Font::LoadBMFontMetaText( const FileSystem::FileView& metaData )
 {
-    std::stringstream metaStream( std::string( metaData.data.begin(), metaData.data.end() ) );
+    imemstream metaStream( (const char*)metaData.data, metaData.size );
 
     std::string line;
     std::getline( metaStream, line );
@@ -261,9 +262,9 @@ void ae3d::Font::LoadBMFontMetaText( const FileSystem::FileContentsData& metaDat
     }
 }
 
-void ae3d::Font::LoadBMFontMetaBinary(const FileSystem::FileContentsData& metaData)
+void ae3d::Font::LoadBMFontMetaBinary(const FileSystem::FileView& metaData)
 {
-    std::stringstream ifs( std::string( metaData.data.begin(), metaData.data.end() ) );
+    imemstream ifs( (const char*)metaData.data, metaData.size );
     unsigned char header[ 4 ];
     ifs.read( (char*)&header[ 0 ], 4 );
     const bool validHeaderHead = header[ 0 ] == 66 && header[ 1 ] == 77 && header[ 2 ] == 70;
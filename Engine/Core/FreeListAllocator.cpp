@@ -0,0 +1,112 @@
+#include "FreeListAllocator.hpp"
+#include "System.hpp"
+
+ae3d::FreeListAllocator::FreeListAllocator( unsigned aCapacity )
+    : capacity( aCapacity )
+{
+    if (capacity > 0)
+    {
+        freeRanges.push_back( { 0, capacity } );
+    }
+}
+
+unsigned ae3d::FreeListAllocator::Allocate( unsigned size )
+{
+    if (size == 0)
+    {
+        return InvalidOffset;
+    }
+
+    for (std::size_t i = 0; i < freeRanges.size(); ++i)
+    {
+        Range& range = freeRanges[ i ];
+
+        if (range.size < size)
+        {
+            continue;
+        }
+
+        const unsigned offset = range.offset;
+
+        if (range.size == size)
+        {
+            freeRanges.erase( freeRanges.begin() + i );
+        }
+        else
+        {
+            range.offset += size;
+            range.size -= size;
+        }
+
+        return offset;
+    }
+
+    return InvalidOffset;
+}
+
+void ae3d::FreeListAllocator::Free( unsigned offset, unsigned size )
+{
+    System::Assert( offset != InvalidOffset && offset + size <= capacity, "freed range is outside of the allocator" );
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    // Index of the first free range after the freed one.
+    std::size_t next = 0;
+
+    while (next < freeRanges.size() && freeRanges[ next ].offset < offset)
+    {
+        ++next;
+    }
+
+    System::Assert( next == freeRanges.size() || offset + size <= freeRanges[ next ].offset, "range is freed twice" );
+    System::Assert( next == 0 || freeRanges[ next - 1 ].offset + freeRanges[ next - 1 ].size <= offset, "range is freed twice" );
+
+    const bool mergesPrevious = next > 0 && freeRanges[ next - 1 ].offset + freeRanges[ next - 1 ].size == offset;
+    const bool mergesNext = next < freeRanges.size() && offset + size == freeRanges[ next ].offset;
+
+    if (mergesPrevious && mergesNext)
+    {
+        freeRanges[ next - 1 ].size += size + freeRanges[ next ].size;
+        freeRanges.erase( freeRanges.begin() + next );
+    }
+    else if (mergesPrevious)
+    {
+        freeRanges[ next - 1 ].size += size;
+    }
+    else if (mergesNext)
+    {
+        freeRanges[ next ].offset = offset;
+        freeRanges[ next ].size += size;
+    }
+    else
+    {
+        freeRanges.insert( freeRanges.begin() + next, { offset, size } );
+    }
+}
+
+unsigned ae3d::FreeListAllocator::GetFreeSize() const
+{
+    unsigned freeSize = 0;
+
+    for (const auto& range : freeRanges)
+    {
+        freeSize += range.size;
+    }
+
+    return freeSize;
+}
+
+unsigned ae3d::FreeListAllocator::GetLargestFreeSize() const
+{
+    unsigned largest = 0;
+
+    for (const auto& range : freeRanges)
+    {
+        largest = range.size > largest ? range.size : largest;
+    }
+
+    return largest;
+}
@@ -0,0 +1,48 @@
+#ifndef FREE_LIST_ALLOCATOR_H
+#define FREE_LIST_ALLOCATOR_H
+
+#include <vector>
+
+namespace ae3d
+{
+    /// Allocates ranges from [0, capacity). Doesn't own memory, so it can sub-allocate GPU buffers.
+    /// Free ranges are kept sorted by offset and merged with their neighbours when a range is freed.
+    class FreeListAllocator
+    {
+    public:
+        /// Returned by Allocate when there's no free range large enough.
+        static const unsigned InvalidOffset = ~0u;
+
+        /// \param capacity Size of the managed range.
+        explicit FreeListAllocator( unsigned capacity );
+
+        /// Finds the first free range that fits size.
+        /// \param size Size.
+        /// \return Offset of the allocation or InvalidOffset.
+        unsigned Allocate( unsigned size );
+
+        /// \param offset Offset returned by Allocate.
+        /// \param size Size that was passed to Allocate.
+        void Free( unsigned offset, unsigned size );
+
+        /// \return Size of the managed range.
+        unsigned GetCapacity() const { return capacity; }
+
+        /// \return Sum of free range sizes.
+        unsigned GetFreeSize() const;
+
+        /// \return Size of the largest allocation that currently fits.
+        unsigned GetLargestFreeSize() const;
+
+    private:
+        struct Range
+        {
+            unsigned offset;
+            unsigned size;
+        };
+
+        std::vector< Range > freeRanges;
+        unsigned capacity;
+    };
+}
+#endif
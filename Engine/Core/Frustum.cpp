@@ -1,7 +1,100 @@
 #include "Frustum.hpp"
+#include <cmath>
+#include <cstring>
+// The AVX2 path is compiled for AVX2 without enabling it for the whole engine and is chosen at runtime.
+#if _MSC_VER && (defined( _M_X64 ) || defined( _M_IX86 ))
+#define HAS_AVX2_DISPATCH 1
+#include <immintrin.h>
+#include <intrin.h>
+#elif (defined( __GNUC__ ) || defined( __clang__ )) && (defined( __x86_64__ ) || defined( __i386__ ))
+#define HAS_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+#if defined( SIMD_SSE3 )
+#include <pmmintrin.h>
+#include <xmmintrin.h>
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
 
 using namespace ae3d;
 
+namespace
+{
+    // Frustum planes in structure-of-arrays layout for the batch test.
+    struct PlaneBatch
+    {
+        float normalX[ 6 ];
+        float normalY[ 6 ];
+        float normalZ[ 6 ];
+        float d[ 6 ];
+        float absNormalX[ 6 ];
+        float absNormalY[ 6 ];
+        float absNormalZ[ 6 ];
+    };
+
+#if HAS_AVX2_DISPATCH
+    bool IsAVX2Supported()
+    {
+#if _MSC_VER
+        int info[ 4 ];
+        __cpuid( info, 1 );
+
+        // The OS must save YMM registers on context switches.
+        const bool isAVXEnabledByOS = (info[ 2 ] & (1 << 27)) != 0 && (info[ 2 ] & (1 << 28)) != 0 && (_xgetbv( 0 ) & 6) == 6;
+
+        if (!isAVXEnabledByOS)
+        {
+            return false;
+        }
+
+        __cpuidex( info, 7, 0 );
+        return (info[ 1 ] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+    }
+
+    // \return Count of boxes tested, a multiple of 8.
+#if !_MSC_VER
+    __attribute__(( target( "avx2" ) ))
+#endif
+    unsigned BoxesInFrustumAVX2( const PlaneBatch& batch, const float* centerX, const float* centerY, const float* centerZ,
+                                 const float* extentX, const float* extentY, const float* extentZ,
+                                 unsigned count, std::uint32_t* outVisibleMask )
+    {
+        unsigned i = 0;
+
+        for (; count - i >= 8; i += 8)
+        {
+            const __m256 cx = _mm256_loadu_ps( centerX + i );
+            const __m256 cy = _mm256_loadu_ps( centerY + i );
+            const __m256 cz = _mm256_loadu_ps( centerZ + i );
+            const __m256 ex = _mm256_loadu_ps( extentX + i );
+            const __m256 ey = _mm256_loadu_ps( extentY + i );
+            const __m256 ez = _mm256_loadu_ps( extentZ + i );
+            __m256 visible = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+
+            for (int p = 0; p < 6; ++p)
+            {
+                __m256 distance = _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( batch.normalX[ p ] ), cx ), _mm256_set1_ps( batch.d[ p ] ) );
+                distance = _mm256_add_ps( distance, _mm256_mul_ps( _mm256_set1_ps( batch.normalY[ p ] ), cy ) );
+                distance = _mm256_add_ps( distance, _mm256_mul_ps( _mm256_set1_ps( batch.normalZ[ p ] ), cz ) );
+                distance = _mm256_add_ps( distance, _mm256_mul_ps( _mm256_set1_ps( batch.absNormalX[ p ] ), ex ) );
+                distance = _mm256_add_ps( distance, _mm256_mul_ps( _mm256_set1_ps( batch.absNormalY[ p ] ), ey ) );
+                distance = _mm256_add_ps( distance, _mm256_mul_ps( _mm256_set1_ps( batch.absNormalZ[ p ] ), ez ) );
+                visible = _mm256_and_ps( visible, _mm256_cmp_ps( distance, _mm256_setzero_ps(), _CMP_GE_OQ ) );
+            }
+
+            outVisibleMask[ i >> 5 ] |= static_cast< std::uint32_t >( _mm256_movemask_ps( visible ) ) << (i & 31);
+        }
+
+        return i;
+    }
+#endif
+}
+
 void Frustum::UpdateCornersAndCenters( const Vec3& cameraPosition, const Vec3& zAxis )
 {
     const Vec3 up( 0, 1, 0 );
@@ -40,6 +133,17 @@ Vec3 Frustum::Centroid() const
     return (nearCenter + farCenter) * 0.5f;
 }
 
+void Frustum::GetPlanes( float outPlanes[ 24 ] ) const
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        outPlanes[ p * 4 + 0 ] = planes[ p ].normal.x;
+        outPlanes[ p * 4 + 1 ] = planes[ p ].normal.y;
+        outPlanes[ p * 4 + 2 ] = planes[ p ].normal.z;
+        outPlanes[ p * 4 + 3 ] = planes[ p ].d;
+    }
+}
+
 void Frustum::Plane::CalculateNormal()
 {
     const Vec3 v1 = a - b;
@@ -166,6 +270,142 @@ bool Frustum::BoxInFrustum( const Vec3& min, const Vec3& max ) const
     return result;
 }
 
+bool Frustum::BoxFullyInFrustum( const Vec3& min, const Vec3& max ) const
+{
+    // Tests the negative vertex, ie. the corner furthest along the inverse of the normal.
+    for (unsigned p = 0; p < 6; ++p)
+    {
+        Vec3 neg = max;
+        
+        if (planes[ p ].normal.x >= 0)
+        {
+            neg.x = min.x;
+        }
+        if (planes[ p ].normal.y >= 0)
+        {
+            neg.y = min.y;
+        }
+        if (planes[ p ].normal.z >= 0)
+        {
+            neg.z = min.z;
+        }
+        
+        if (planes[ p ].Distance( neg ) < 0)
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+void Frustum::BoxesInFrustum( const float* centerX, const float* centerY, const float* centerZ,
+                              const float* extentX, const float* extentY, const float* extentZ,
+                              int count, std::uint32_t* outVisibleMask ) const
+{
+    const unsigned boxCount = count < 0 ? 0u : static_cast< unsigned >( count );
+    std::memset( outVisibleMask, 0, ((boxCount + 31) / 32) * sizeof( std::uint32_t ) );
+
+    // A box is outside a plane if its center's distance plus its extent projected onto the normal is negative.
+    // This is the same test as the positive vertex in BoxInFrustum.
+    PlaneBatch batch;
+
+    for (int p = 0; p < 6; ++p)
+    {
+        batch.normalX[ p ] = planes[ p ].normal.x;
+        batch.normalY[ p ] = planes[ p ].normal.y;
+        batch.normalZ[ p ] = planes[ p ].normal.z;
+        batch.d[ p ] = planes[ p ].d;
+        batch.absNormalX[ p ] = std::abs( planes[ p ].normal.x );
+        batch.absNormalY[ p ] = std::abs( planes[ p ].normal.y );
+        batch.absNormalZ[ p ] = std::abs( planes[ p ].normal.z );
+    }
+
+    unsigned i = 0;
+
+#if HAS_AVX2_DISPATCH
+    static const bool isAVX2Supported = IsAVX2Supported();
+
+    if (isAVX2Supported)
+    {
+        i = BoxesInFrustumAVX2( batch, centerX, centerY, centerZ, extentX, extentY, extentZ, boxCount, outVisibleMask );
+    }
+#endif
+
+#if defined( SIMD_SSE3 )
+    for (; boxCount - i >= 4; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps( centerX + i );
+        const __m128 cy = _mm_loadu_ps( centerY + i );
+        const __m128 cz = _mm_loadu_ps( centerZ + i );
+        const __m128 ex = _mm_loadu_ps( extentX + i );
+        const __m128 ey = _mm_loadu_ps( extentY + i );
+        const __m128 ez = _mm_loadu_ps( extentZ + i );
+        __m128 visible = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( batch.normalX[ p ] ), cx ), _mm_set1_ps( batch.d[ p ] ) );
+            distance = _mm_add_ps( distance, _mm_mul_ps( _mm_set1_ps( batch.normalY[ p ] ), cy ) );
+            distance = _mm_add_ps( distance, _mm_mul_ps( _mm_set1_ps( batch.normalZ[ p ] ), cz ) );
+            distance = _mm_add_ps( distance, _mm_mul_ps( _mm_set1_ps( batch.absNormalX[ p ] ), ex ) );
+            distance = _mm_add_ps( distance, _mm_mul_ps( _mm_set1_ps( batch.absNormalY[ p ] ), ey ) );
+            distance = _mm_add_ps( distance, _mm_mul_ps( _mm_set1_ps( batch.absNormalZ[ p ] ), ez ) );
+            visible = _mm_and_ps( visible, _mm_cmpge_ps( distance, _mm_setzero_ps() ) );
+        }
+
+        outVisibleMask[ i >> 5 ] |= static_cast< std::uint32_t >( _mm_movemask_ps( visible ) ) << (i & 31);
+    }
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    const std::uint32_t laneBitData[ 4 ] = { 1, 2, 4, 8 };
+    const uint32x4_t laneBits = vld1q_u32( laneBitData );
+
+    for (; boxCount - i >= 4; i += 4)
+    {
+        const float32x4_t cx = vld1q_f32( centerX + i );
+        const float32x4_t cy = vld1q_f32( centerY + i );
+        const float32x4_t cz = vld1q_f32( centerZ + i );
+        const float32x4_t ex = vld1q_f32( extentX + i );
+        const float32x4_t ey = vld1q_f32( extentY + i );
+        const float32x4_t ez = vld1q_f32( extentZ + i );
+        uint32x4_t visible = vdupq_n_u32( 0xFFFFFFFF );
+
+        for (int p = 0; p < 6; ++p)
+        {
+            float32x4_t distance = vdupq_n_f32( batch.d[ p ] );
+            distance = vmlaq_n_f32( distance, cx, batch.normalX[ p ] );
+            distance = vmlaq_n_f32( distance, cy, batch.normalY[ p ] );
+            distance = vmlaq_n_f32( distance, cz, batch.normalZ[ p ] );
+            distance = vmlaq_n_f32( distance, ex, batch.absNormalX[ p ] );
+            distance = vmlaq_n_f32( distance, ey, batch.absNormalY[ p ] );
+            distance = vmlaq_n_f32( distance, ez, batch.absNormalZ[ p ] );
+            visible = vandq_u32( visible, vcgeq_f32( distance, vdupq_n_f32( 0 ) ) );
+        }
+
+        const uint32x4_t bits = vandq_u32( visible, laneBits );
+        const std::uint32_t mask = vgetq_lane_u32( bits, 0 ) | vgetq_lane_u32( bits, 1 ) | vgetq_lane_u32( bits, 2 ) | vgetq_lane_u32( bits, 3 );
+        outVisibleMask[ i >> 5 ] |= mask << (i & 31);
+    }
+#endif
+
+    for (; i < boxCount; ++i)
+    {
+        bool isVisible = true;
+
+        for (int p = 0; p < 6 && isVisible; ++p)
+        {
+            const float distance = batch.normalX[ p ] * centerX[ i ] + batch.normalY[ p ] * centerY[ i ] + batch.normalZ[ p ] * centerZ[ i ] + batch.d[ p ] +
+                                   batch.absNormalX[ p ] * extentX[ i ] + batch.absNormalY[ p ] * extentY[ i ] + batch.absNormalZ[ p ] * extentZ[ i ];
+            isVisible = distance >= 0;
+        }
+
+        if (isVisible)
+        {
+            outVisibleMask[ i >> 5 ] |= 1u << (i & 31);
+        }
+    }
+}
+
 const Vec3& Frustum::NearTopLeft() const { return nearTopLeft; }
 const Vec3& Frustum::NearTopRight() const { return nearTopRight; }
 const Vec3& Frustum::NearBottomLeft() const { return nearBottomLeft; }
@@ -1,6 +1,7 @@
 #ifndef FRUSTUM_H
 #define FRUSTUM_H
 
+#include <cstdint>
 #include "Vec3.hpp"
 
 namespace ae3d
@@ -38,6 +39,32 @@ public:
      */
     bool BoxInFrustum( const Vec3& min, const Vec3& max ) const;
     
+    /**
+     Tests if AABB is completely inside the frustum.
+     
+     \param min AABB's minimum corner.
+     \param max AABB's maximum corner.
+     \return True, if the whole box is in the frustum.
+     */
+    bool BoxFullyInFrustum( const Vec3& min, const Vec3& max ) const;
+    
+    /**
+     Tests a batch of AABBs against the frustum. Tests 8 boxes at a time with AVX2 if the CPU supports it, otherwise 4 with SSE3 or NEON.
+     The boxes are given in structure-of-arrays layout.
+     
+     \param centerX Box centers' x-coordinates.
+     \param centerY Box centers' y-coordinates.
+     \param centerZ Box centers' z-coordinates.
+     \param extentX Box half sizes along x-axis.
+     \param extentY Box half sizes along y-axis.
+     \param extentZ Box half sizes along z-axis.
+     \param count Box count.
+     \param outVisibleMask Bit i is set if part of box i is in the frustum. Must hold (count + 31) / 32 words.
+     */
+    void BoxesInFrustum( const float* centerX, const float* centerY, const float* centerZ,
+                         const float* extentX, const float* extentY, const float* extentZ,
+                         int count, std::uint32_t* outVisibleMask ) const;
+    
     /**
      Sets values from which the frustum is calculated.
      Should be called when the perspective is changed.
@@ -79,6 +106,13 @@ public:
     
     /// \return Centroid.
     Vec3 Centroid() const;
+
+    /**
+     Copies the planes for shaders that cull on the GPU.
+
+     \param outPlanes Receives 6 planes as (normal.x, normal.y, normal.z, d). Normals point inside the frustum.
+     */
+    void GetPlanes( float outPlanes[ 24 ] ) const;
     
 private:
     void UpdateCornersAndCenters( const Vec3& cameraPosition, const Vec3& zAxis );
@@ -0,0 +1,289 @@
+#include "JobSystem.hpp"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+#include "System.hpp"
+
+namespace
+{
+    struct Job
+    {
+        std::function< void() > function;
+        ae3d::JobSystem::Counter* signal = nullptr;
+    };
+
+    // Owner pushes and pops at the back, thieves steal from the front.
+    struct WorkQueue
+    {
+        std::deque< Job > jobs;
+        std::mutex mutex;
+    };
+}
+
+namespace JobSystemGlobal
+{
+    // Queue 0 is shared by threads that are not workers, eg. the main thread.
+    std::vector< std::unique_ptr< WorkQueue > > queues;
+    std::vector< std::thread > workers;
+    std::atomic< int > pendingJobCount{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::mutex initMutex;
+    std::atomic< bool > isRunning{ false };
+    thread_local unsigned queueIndex = 0;
+}
+
+namespace
+{
+    void PushJob( const Job& job )
+    {
+        WorkQueue& queue = *JobSystemGlobal::queues[ JobSystemGlobal::queueIndex ];
+
+        {
+            std::lock_guard< std::mutex > lock( queue.mutex );
+            queue.jobs.push_back( job );
+        }
+
+        ++JobSystemGlobal::pendingJobCount;
+
+        // Takes the lock so that a worker can't miss the notification between testing the predicate and sleeping.
+        {
+            std::lock_guard< std::mutex > lock( JobSystemGlobal::sleepMutex );
+        }
+
+        JobSystemGlobal::wakeCondition.notify_one();
+    }
+
+    bool PopJob( Job& outJob )
+    {
+        const unsigned queueCount = static_cast< unsigned >( JobSystemGlobal::queues.size() );
+
+        if (queueCount == 0)
+        {
+            return false;
+        }
+
+        for (unsigned i = 0; i < queueCount; ++i)
+        {
+            const unsigned index = (JobSystemGlobal::queueIndex + i) % queueCount;
+            WorkQueue& queue = *JobSystemGlobal::queues[ index ];
+            std::lock_guard< std::mutex > lock( queue.mutex );
+
+            if (queue.jobs.empty())
+            {
+                continue;
+            }
+
+            if (i == 0)
+            {
+                outJob = queue.jobs.back();
+                queue.jobs.pop_back();
+            }
+            else
+            {
+                outJob = queue.jobs.front();
+                queue.jobs.pop_front();
+            }
+
+            --JobSystemGlobal::pendingJobCount;
+            return true;
+        }
+
+        return false;
+    }
+
+    void Finish( ae3d::JobSystem::Counter* counter )
+    {
+        std::vector< std::pair< std::function< void() >, ae3d::JobSystem::Counter* > > dependents;
+
+        {
+            std::lock_guard< std::mutex > lock( counter->dependentsMutex );
+
+            if (--counter->value == 0)
+            {
+                dependents.swap( counter->dependents );
+            }
+        }
+
+        for (const auto& dependent : dependents)
+        {
+            Job job;
+            job.function = dependent.first;
+            job.signal = dependent.second;
+            PushJob( job );
+        }
+    }
+
+    void Execute( const Job& job )
+    {
+        job.function();
+
+        if (job.signal != nullptr)
+        {
+            Finish( job.signal );
+        }
+    }
+
+    void WorkerMain( unsigned index )
+    {
+        JobSystemGlobal::queueIndex = index;
+
+        while (JobSystemGlobal::isRunning)
+        {
+            Job job;
+
+            if (PopJob( job ))
+            {
+                Execute( job );
+                continue;
+            }
+
+            std::unique_lock< std::mutex > lock( JobSystemGlobal::sleepMutex );
+            JobSystemGlobal::wakeCondition.wait( lock, [] { return !JobSystemGlobal::isRunning || JobSystemGlobal::pendingJobCount > 0; } );
+        }
+    }
+
+    void EnsureStarted()
+    {
+        if (!JobSystemGlobal::isRunning)
+        {
+            ae3d::JobSystem::Init( -1 );
+        }
+    }
+
+    // Joins workers at exit if the application didn't call System::Deinit.
+    struct WorkerJoiner
+    {
+        ~WorkerJoiner()
+        {
+            ae3d::JobSystem::Deinit();
+        }
+    } workerJoiner;
+}
+
+void ae3d::JobSystem::Init( int workerCount )
+{
+    std::lock_guard< std::mutex > lock( JobSystemGlobal::initMutex );
+
+    if (!JobSystemGlobal::queues.empty())
+    {
+        return;
+    }
+
+    if (workerCount < 0)
+    {
+        workerCount = static_cast< int >( std::thread::hardware_concurrency() ) - 1;
+        workerCount = workerCount < 0 ? 0 : workerCount;
+    }
+
+    const unsigned threadCount = static_cast< unsigned >( workerCount );
+
+    for (unsigned i = 0; i < threadCount + 1; ++i)
+    {
+        JobSystemGlobal::queues.push_back( std::unique_ptr< WorkQueue >( new WorkQueue() ) );
+    }
+
+    JobSystemGlobal::isRunning = true;
+
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        JobSystemGlobal::workers.push_back( std::thread( WorkerMain, i + 1 ) );
+    }
+}
+
+void ae3d::JobSystem::Deinit()
+{
+    std::lock_guard< std::mutex > initLock( JobSystemGlobal::initMutex );
+
+    {
+        std::lock_guard< std::mutex > lock( JobSystemGlobal::sleepMutex );
+        JobSystemGlobal::isRunning = false;
+    }
+
+    JobSystemGlobal::wakeCondition.notify_all();
+
+    for (auto& worker : JobSystemGlobal::workers)
+    {
+        worker.join();
+    }
+
+    JobSystemGlobal::workers.clear();
+    JobSystemGlobal::queues.clear();
+    JobSystemGlobal::pendingJobCount = 0;
+}
+
+int ae3d::JobSystem::GetWorkerCount()
+{
+    EnsureStarted();
+    return static_cast< int >( JobSystemGlobal::workers.size() );
+}
+
+void ae3d::JobSystem::Run( const std::function< void() >& function, Counter* signal, Counter* dependency )
+{
+    EnsureStarted();
+
+    if (signal != nullptr)
+    {
+        ++signal->value;
+    }
+
+    if (dependency != nullptr)
+    {
+        std::lock_guard< std::mutex > lock( dependency->dependentsMutex );
+
+        if (dependency->value > 0)
+        {
+            dependency->dependents.push_back( std::make_pair( function, signal ) );
+            return;
+        }
+    }
+
+    Job job;
+    job.function = function;
+    job.signal = signal;
+    PushJob( job );
+}
+
+void ae3d::JobSystem::Wait( Counter* counter )
+{
+    System::Assert( counter != nullptr, "JobSystem::Wait needs a counter" );
+
+    while (!counter->IsDone())
+    {
+        Job job;
+
+        if (PopJob( job ))
+        {
+            Execute( job );
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // The last job can still be unlocking the counter, so the caller must not destroy it before that.
+    std::lock_guard< std::mutex > lock( counter->dependentsMutex );
+}
+
+void ae3d::JobSystem::ParallelFor( int count, int batchSize, const std::function< void( int, int ) >& body )
+{
+    batchSize = batchSize < 1 ? 1 : batchSize;
+
+    if (count <= batchSize)
+    {
+        body( 0, count > 0 ? count : 0 );
+        return;
+    }
+
+    Counter counter;
+
+    for (int begin = 0; begin < count; begin += batchSize)
+    {
+        const int end = begin + batchSize < count ? begin + batchSize : count;
+        Run( [ &body, begin, end ]() { body( begin, end ); }, &counter );
+    }
+
+    Wait( &counter );
+}
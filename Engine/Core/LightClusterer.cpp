@@ -0,0 +1,502 @@
+#include "LightClusterer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined( SIMD_SSE3 )
+#include <pmmintrin.h>
+#include <xmmintrin.h>
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+#include "JobSystem.hpp"
+#include "Matrix.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    // Cluster's view space AABB and bounding sphere.
+    struct ClusterBounds
+    {
+        float minX, minY, minZ;
+        float maxX, maxY, maxZ;
+        float centerX, centerY, centerZ;
+        float radius;
+    };
+
+#if defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    float32x4_t SqrtNeon( float32x4_t value )
+    {
+#if defined( __aarch64__ )
+        return vsqrtq_f32( value );
+#else
+        // ARMv7 NEON has no square root, so refine the reciprocal square root estimate twice. Precise enough for culling.
+        const float32x4_t clamped = vmaxq_f32( value, vdupq_n_f32( 1e-12f ) );
+        float32x4_t reciprocal = vrsqrteq_f32( clamped );
+        reciprocal = vmulq_f32( reciprocal, vrsqrtsq_f32( vmulq_f32( clamped, reciprocal ), reciprocal ) );
+        reciprocal = vmulq_f32( reciprocal, vrsqrtsq_f32( vmulq_f32( clamped, reciprocal ), reciprocal ) );
+        return vmulq_f32( clamped, reciprocal );
+#endif
+    }
+
+    std::uint32_t MoveMaskNeon( uint32x4_t visible )
+    {
+        const std::uint32_t laneBitData[ 4 ] = { 1, 2, 4, 8 };
+        const uint32x4_t bits = vandq_u32( visible, vld1q_u32( laneBitData ) );
+        return vgetq_lane_u32( bits, 0 ) | vgetq_lane_u32( bits, 1 ) | vgetq_lane_u32( bits, 2 ) | vgetq_lane_u32( bits, 3 );
+    }
+#endif
+
+    void AppendLanes( unsigned mask, const unsigned* lightIndex, std::vector< unsigned >& outLightIndices )
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            if (mask & (1u << lane))
+            {
+                outLightIndices.push_back( lightIndex[ lane ] );
+            }
+        }
+    }
+
+    // Appends the lights whose sphere intersects the cluster's AABB.
+    void AppendPointLights( const float* x, const float* y, const float* z, const float* radius, const unsigned* lightIndex, std::size_t count,
+                            const ClusterBounds& bounds, std::vector< unsigned >& outLightIndices )
+    {
+        std::size_t i = 0;
+
+#if defined( SIMD_SSE3 )
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps( bounds.minX );
+        const __m128 minY = _mm_set1_ps( bounds.minY );
+        const __m128 minZ = _mm_set1_ps( bounds.minZ );
+        const __m128 maxX = _mm_set1_ps( bounds.maxX );
+        const __m128 maxY = _mm_set1_ps( bounds.maxY );
+        const __m128 maxZ = _mm_set1_ps( bounds.maxZ );
+
+        for (; count - i >= 4; i += 4)
+        {
+            const __m128 cx = _mm_loadu_ps( x + i );
+            const __m128 cy = _mm_loadu_ps( y + i );
+            const __m128 cz = _mm_loadu_ps( z + i );
+            const __m128 r = _mm_loadu_ps( radius + i );
+            const __m128 dx = _mm_max_ps( zero, _mm_max_ps( _mm_sub_ps( minX, cx ), _mm_sub_ps( cx, maxX ) ) );
+            const __m128 dy = _mm_max_ps( zero, _mm_max_ps( _mm_sub_ps( minY, cy ), _mm_sub_ps( cy, maxY ) ) );
+            const __m128 dz = _mm_max_ps( zero, _mm_max_ps( _mm_sub_ps( minZ, cz ), _mm_sub_ps( cz, maxZ ) ) );
+            const __m128 distanceSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+
+            AppendLanes( static_cast< unsigned >( _mm_movemask_ps( _mm_cmple_ps( distanceSq, _mm_mul_ps( r, r ) ) ) ), lightIndex + i, outLightIndices );
+        }
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+        const float32x4_t zero = vdupq_n_f32( 0 );
+        const float32x4_t minX = vdupq_n_f32( bounds.minX );
+        const float32x4_t minY = vdupq_n_f32( bounds.minY );
+        const float32x4_t minZ = vdupq_n_f32( bounds.minZ );
+        const float32x4_t maxX = vdupq_n_f32( bounds.maxX );
+        const float32x4_t maxY = vdupq_n_f32( bounds.maxY );
+        const float32x4_t maxZ = vdupq_n_f32( bounds.maxZ );
+
+        for (; count - i >= 4; i += 4)
+        {
+            const float32x4_t cx = vld1q_f32( x + i );
+            const float32x4_t cy = vld1q_f32( y + i );
+            const float32x4_t cz = vld1q_f32( z + i );
+            const float32x4_t r = vld1q_f32( radius + i );
+            const float32x4_t dx = vmaxq_f32( zero, vmaxq_f32( vsubq_f32( minX, cx ), vsubq_f32( cx, maxX ) ) );
+            const float32x4_t dy = vmaxq_f32( zero, vmaxq_f32( vsubq_f32( minY, cy ), vsubq_f32( cy, maxY ) ) );
+            const float32x4_t dz = vmaxq_f32( zero, vmaxq_f32( vsubq_f32( minZ, cz ), vsubq_f32( cz, maxZ ) ) );
+            const float32x4_t distanceSq = vmlaq_f32( vmlaq_f32( vmulq_f32( dx, dx ), dy, dy ), dz, dz );
+
+            AppendLanes( MoveMaskNeon( vcleq_f32( distanceSq, vmulq_f32( r, r ) ) ), lightIndex + i, outLightIndices );
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            const float dx = std::max( 0.0f, std::max( bounds.minX - x[ i ], x[ i ] - bounds.maxX ) );
+            const float dy = std::max( 0.0f, std::max( bounds.minY - y[ i ], y[ i ] - bounds.maxY ) );
+            const float dz = std::max( 0.0f, std::max( bounds.minZ - z[ i ], z[ i ] - bounds.maxZ ) );
+
+            if (dx * dx + dy * dy + dz * dz <= radius[ i ] * radius[ i ])
+            {
+                outLightIndices.push_back( lightIndex[ i ] );
+            }
+        }
+    }
+
+    // Appends the lights whose cone intersects the cluster's bounding sphere. The test finds the point on the cone that is
+    // closest to the sphere's center and also rejects spheres that are past the cone's range or behind its apex.
+    void AppendSpotLights( const float* x, const float* y, const float* z, const float* range,
+                           const float* directionX, const float* directionY, const float* directionZ, const float* coneCos, const float* coneSin,
+                           const unsigned* lightIndex, std::size_t count, const ClusterBounds& bounds, std::vector< unsigned >& outLightIndices )
+    {
+        std::size_t i = 0;
+
+#if defined( SIMD_SSE3 )
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 centerX = _mm_set1_ps( bounds.centerX );
+        const __m128 centerY = _mm_set1_ps( bounds.centerY );
+        const __m128 centerZ = _mm_set1_ps( bounds.centerZ );
+        const __m128 sphereRadius = _mm_set1_ps( bounds.radius );
+        const __m128 negativeSphereRadius = _mm_set1_ps( -bounds.radius );
+
+        for (; count - i >= 4; i += 4)
+        {
+            const __m128 vx = _mm_sub_ps( centerX, _mm_loadu_ps( x + i ) );
+            const __m128 vy = _mm_sub_ps( centerY, _mm_loadu_ps( y + i ) );
+            const __m128 vz = _mm_sub_ps( centerZ, _mm_loadu_ps( z + i ) );
+            const __m128 lengthSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vx, vx ), _mm_mul_ps( vy, vy ) ), _mm_mul_ps( vz, vz ) );
+            __m128 alongAxis = _mm_mul_ps( vx, _mm_loadu_ps( directionX + i ) );
+            alongAxis = _mm_add_ps( alongAxis, _mm_mul_ps( vy, _mm_loadu_ps( directionY + i ) ) );
+            alongAxis = _mm_add_ps( alongAxis, _mm_mul_ps( vz, _mm_loadu_ps( directionZ + i ) ) );
+            const __m128 fromAxis = _mm_sqrt_ps( _mm_max_ps( zero, _mm_sub_ps( lengthSq, _mm_mul_ps( alongAxis, alongAxis ) ) ) );
+            const __m128 closestDistance = _mm_sub_ps( _mm_mul_ps( _mm_loadu_ps( coneCos + i ), fromAxis ), _mm_mul_ps( alongAxis, _mm_loadu_ps( coneSin + i ) ) );
+
+            __m128 visible = _mm_cmple_ps( closestDistance, sphereRadius );
+            visible = _mm_and_ps( visible, _mm_cmple_ps( alongAxis, _mm_add_ps( sphereRadius, _mm_loadu_ps( range + i ) ) ) );
+            visible = _mm_and_ps( visible, _mm_cmpge_ps( alongAxis, negativeSphereRadius ) );
+
+            AppendLanes( static_cast< unsigned >( _mm_movemask_ps( visible ) ), lightIndex + i, outLightIndices );
+        }
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+        const float32x4_t zero = vdupq_n_f32( 0 );
+        const float32x4_t centerX = vdupq_n_f32( bounds.centerX );
+        const float32x4_t centerY = vdupq_n_f32( bounds.centerY );
+        const float32x4_t centerZ = vdupq_n_f32( bounds.centerZ );
+        const float32x4_t sphereRadius = vdupq_n_f32( bounds.radius );
+        const float32x4_t negativeSphereRadius = vdupq_n_f32( -bounds.radius );
+
+        for (; count - i >= 4; i += 4)
+        {
+            const float32x4_t vx = vsubq_f32( centerX, vld1q_f32( x + i ) );
+            const float32x4_t vy = vsubq_f32( centerY, vld1q_f32( y + i ) );
+            const float32x4_t vz = vsubq_f32( centerZ, vld1q_f32( z + i ) );
+            const float32x4_t lengthSq = vmlaq_f32( vmlaq_f32( vmulq_f32( vx, vx ), vy, vy ), vz, vz );
+            float32x4_t alongAxis = vmulq_f32( vx, vld1q_f32( directionX + i ) );
+            alongAxis = vmlaq_f32( alongAxis, vy, vld1q_f32( directionY + i ) );
+            alongAxis = vmlaq_f32( alongAxis, vz, vld1q_f32( directionZ + i ) );
+            const float32x4_t fromAxis = SqrtNeon( vmaxq_f32( zero, vmlsq_f32( lengthSq, alongAxis, alongAxis ) ) );
+            const float32x4_t closestDistance = vmlsq_f32( vmulq_f32( vld1q_f32( coneCos + i ), fromAxis ), alongAxis, vld1q_f32( coneSin + i ) );
+
+            uint32x4_t visible = vcleq_f32( closestDistance, sphereRadius );
+            visible = vandq_u32( visible, vcleq_f32( alongAxis, vaddq_f32( sphereRadius, vld1q_f32( range + i ) ) ) );
+            visible = vandq_u32( visible, vcgeq_f32( alongAxis, negativeSphereRadius ) );
+
+            AppendLanes( MoveMaskNeon( visible ), lightIndex + i, outLightIndices );
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            const float vx = bounds.centerX - x[ i ];
+            const float vy = bounds.centerY - y[ i ];
+            const float vz = bounds.centerZ - z[ i ];
+            const float lengthSq = vx * vx + vy * vy + vz * vz;
+            const float alongAxis = vx * directionX[ i ] + vy * directionY[ i ] + vz * directionZ[ i ];
+            const float fromAxis = std::sqrt( std::max( 0.0f, lengthSq - alongAxis * alongAxis ) );
+            const float closestDistance = coneCos[ i ] * fromAxis - alongAxis * coneSin[ i ];
+
+            if (closestDistance <= bounds.radius && alongAxis <= bounds.radius + range[ i ] && alongAxis >= -bounds.radius)
+            {
+                outLightIndices.push_back( lightIndex[ i ] );
+            }
+        }
+    }
+}
+
+void LightClusterer::SliceLights::Clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+    directionX.clear();
+    directionY.clear();
+    directionZ.clear();
+    coneCos.clear();
+    coneSin.clear();
+    lightIndex.clear();
+}
+
+void LightClusterer::SetPerspective( float aFovDegrees, float aAspect, float aNearDepth, float aFarDepth )
+{
+    System::Assert( aNearDepth > 0 && aFarDepth > aNearDepth, "LightClusterer needs 0 < near < far" );
+
+    if (aFovDegrees == fovDegrees && aAspect == aspect && aNearDepth == nearDepth && aFarDepth == farDepth)
+    {
+        return;
+    }
+
+    fovDegrees = aFovDegrees;
+    aspect = aAspect;
+    nearDepth = aNearDepth;
+    farDepth = aFarDepth;
+
+    UpdateClusterBounds();
+}
+
+void LightClusterer::UpdateClusterBounds()
+{
+    boundsMinX.resize( ClusterCount );
+    boundsMinY.resize( ClusterCount );
+    boundsMaxX.resize( ClusterCount );
+    boundsMaxY.resize( ClusterCount );
+
+    // Exponential slices keep clusters roughly cube-shaped, because tiles widen linearly with depth.
+    for (int z = 0; z < ClustersZ; ++z)
+    {
+        sliceNear[ z ] = nearDepth * std::pow( farDepth / nearDepth, z / (float)ClustersZ );
+        sliceFar[ z ] = nearDepth * std::pow( farDepth / nearDepth, (z + 1) / (float)ClustersZ );
+    }
+
+    const float tanHalfFovY = std::tan( fovDegrees * 0.5f * 3.14159265358979f / 180.0f );
+    const float tanHalfFovX = tanHalfFovY * aspect;
+
+    for (int z = 0; z < ClustersZ; ++z)
+    {
+        for (int y = 0; y < ClustersY; ++y)
+        {
+            const float bottom = (-1 + 2 * y / (float)ClustersY) * tanHalfFovY;
+            const float top = (-1 + 2 * (y + 1) / (float)ClustersY) * tanHalfFovY;
+
+            for (int x = 0; x < ClustersX; ++x)
+            {
+                const float left = (-1 + 2 * x / (float)ClustersX) * tanHalfFovX;
+                const float right = (-1 + 2 * (x + 1) / (float)ClustersX) * tanHalfFovX;
+                const int index = GetClusterIndex( x, y, z );
+
+                // The tile's side planes go through the camera, so the AABB is spanned by the corners on the slice's near and far planes.
+                boundsMinX[ index ] = std::min( left * sliceNear[ z ], left * sliceFar[ z ] );
+                boundsMaxX[ index ] = std::max( right * sliceNear[ z ], right * sliceFar[ z ] );
+                boundsMinY[ index ] = std::min( bottom * sliceNear[ z ], bottom * sliceFar[ z ] );
+                boundsMaxY[ index ] = std::max( top * sliceNear[ z ], top * sliceFar[ z ] );
+            }
+        }
+    }
+}
+
+int LightClusterer::GetDepthSlice( float viewDepth ) const
+{
+    if (viewDepth <= nearDepth)
+    {
+        return 0;
+    }
+
+    const int slice = (int)(std::log( viewDepth / nearDepth ) / std::log( farDepth / nearDepth ) * ClustersZ);
+    return slice < ClustersZ ? slice : ClustersZ - 1;
+}
+
+void LightClusterer::ClearLights()
+{
+    lights.clear();
+}
+
+void LightClusterer::AddPointLight( const Vec3& position, float radius, const Vec3& color )
+{
+    if ((int)lights.size() >= MaxLights)
+    {
+        return;
+    }
+
+    Light light = {};
+    light.positionAndRadius[ 0 ] = position.x;
+    light.positionAndRadius[ 1 ] = position.y;
+    light.positionAndRadius[ 2 ] = position.z;
+    light.positionAndRadius[ 3 ] = radius;
+    light.colorAndType[ 0 ] = color.x;
+    light.colorAndType[ 1 ] = color.y;
+    light.colorAndType[ 2 ] = color.z;
+    lights.push_back( light );
+}
+
+void LightClusterer::AddSpotLight( const Vec3& position, const Vec3& direction, float radius, float coneAngleDegrees, const Vec3& color )
+{
+    if ((int)lights.size() >= MaxLights)
+    {
+        return;
+    }
+
+    Light light = {};
+    light.positionAndRadius[ 0 ] = position.x;
+    light.positionAndRadius[ 1 ] = position.y;
+    light.positionAndRadius[ 2 ] = position.z;
+    light.positionAndRadius[ 3 ] = radius;
+    light.directionAndConeCos[ 0 ] = direction.x;
+    light.directionAndConeCos[ 1 ] = direction.y;
+    light.directionAndConeCos[ 2 ] = direction.z;
+    light.directionAndConeCos[ 3 ] = std::cos( coneAngleDegrees * 3.14159265358979f / 180.0f );
+    light.colorAndType[ 0 ] = color.x;
+    light.colorAndType[ 1 ] = color.y;
+    light.colorAndType[ 2 ] = color.z;
+    light.colorAndType[ 3 ] = 1;
+    lights.push_back( light );
+}
+
+void LightClusterer::AssignLights( const Matrix44& view )
+{
+    System::Assert( nearDepth > 0, "LightClusterer::SetPerspective must be called before AssignLights" );
+
+    Statistics::BeginLightAssignmentProfiling();
+
+    const int lightCount = (int)lights.size();
+    viewPositionAndRadius.resize( lightCount * 4 );
+    viewDirection.resize( lightCount * 3 );
+    firstSlice.resize( lightCount );
+    lastSlice.resize( lightCount );
+
+    for (int i = 0; i < lightCount; ++i)
+    {
+        const Light& light = lights[ i ];
+        const float radius = light.positionAndRadius[ 3 ];
+        Vec3 viewPosition;
+        Matrix44::TransformPoint( Vec3( light.positionAndRadius[ 0 ], light.positionAndRadius[ 1 ], light.positionAndRadius[ 2 ] ), view, &viewPosition );
+
+        viewPositionAndRadius[ i * 4 + 0 ] = viewPosition.x;
+        viewPositionAndRadius[ i * 4 + 1 ] = viewPosition.y;
+        viewPositionAndRadius[ i * 4 + 2 ] = viewPosition.z;
+        viewPositionAndRadius[ i * 4 + 3 ] = radius;
+
+        if (light.colorAndType[ 3 ] != 0)
+        {
+            Vec3 direction;
+            Matrix44::TransformDirection( Vec3( light.directionAndConeCos[ 0 ], light.directionAndConeCos[ 1 ], light.directionAndConeCos[ 2 ] ), view, &direction );
+            viewDirection[ i * 3 + 0 ] = direction.x;
+            viewDirection[ i * 3 + 1 ] = direction.y;
+            viewDirection[ i * 3 + 2 ] = direction.z;
+        }
+
+        // The camera looks towards -z.
+        const float depth = -viewPosition.z;
+
+        if (radius <= 0 || depth + radius < nearDepth || depth - radius > farDepth)
+        {
+            firstSlice[ i ] = 1;
+            lastSlice[ i ] = 0;
+            continue;
+        }
+
+        firstSlice[ i ] = GetDepthSlice( depth - radius );
+        lastSlice[ i ] = GetDepthSlice( depth + radius );
+    }
+
+    sliceResults.resize( ClustersZ );
+
+    JobSystem::ParallelFor( ClustersZ, 1, [this]( int begin, int end )
+    {
+        for (int slice = begin; slice < end; ++slice)
+        {
+            AssignSlice( slice );
+        }
+    } );
+
+    std::size_t indexCount = 0;
+
+    for (const SliceResult& result : sliceResults)
+    {
+        indexCount += result.lightIndices.size();
+    }
+
+    lightIndices.resize( indexCount );
+    clusters.resize( ClusterCount );
+    unsigned sliceOffset = 0;
+
+    for (int slice = 0; slice < ClustersZ; ++slice)
+    {
+        const SliceResult& result = sliceResults[ slice ];
+
+        if (!result.lightIndices.empty())
+        {
+            std::memcpy( lightIndices.data() + sliceOffset, result.lightIndices.data(), result.lightIndices.size() * sizeof( unsigned ) );
+        }
+
+        for (int i = 0; i < ClustersX * ClustersY; ++i)
+        {
+            Cluster& cluster = clusters[ slice * ClustersX * ClustersY + i ];
+            cluster.offset = sliceOffset + result.clusters[ i ].offset;
+            cluster.count = result.clusters[ i ].count;
+        }
+
+        sliceOffset += (unsigned)result.lightIndices.size();
+    }
+
+    Statistics::EndLightAssignmentProfiling();
+}
+
+void LightClusterer::AssignSlice( int slice )
+{
+    SliceResult& result = sliceResults[ slice ];
+    result.pointLights.Clear();
+    result.spotLights.Clear();
+    result.lightIndices.clear();
+
+    for (int i = 0; i < (int)lights.size(); ++i)
+    {
+        if (slice < firstSlice[ i ] || slice > lastSlice[ i ])
+        {
+            continue;
+        }
+
+        const bool isSpot = lights[ i ].colorAndType[ 3 ] != 0;
+        SliceLights& sliceLights = isSpot ? result.spotLights : result.pointLights;
+        sliceLights.x.push_back( viewPositionAndRadius[ i * 4 + 0 ] );
+        sliceLights.y.push_back( viewPositionAndRadius[ i * 4 + 1 ] );
+        sliceLights.z.push_back( viewPositionAndRadius[ i * 4 + 2 ] );
+        sliceLights.radius.push_back( viewPositionAndRadius[ i * 4 + 3 ] );
+        sliceLights.lightIndex.push_back( (unsigned)i );
+
+        if (isSpot)
+        {
+            const float coneCos = lights[ i ].directionAndConeCos[ 3 ];
+            sliceLights.directionX.push_back( viewDirection[ i * 3 + 0 ] );
+            sliceLights.directionY.push_back( viewDirection[ i * 3 + 1 ] );
+            sliceLights.directionZ.push_back( viewDirection[ i * 3 + 2 ] );
+            sliceLights.coneCos.push_back( coneCos );
+            sliceLights.coneSin.push_back( std::sqrt( std::max( 0.0f, 1 - coneCos * coneCos ) ) );
+        }
+    }
+
+    const SliceLights& points = result.pointLights;
+    const SliceLights& spots = result.spotLights;
+
+    for (int i = 0; i < ClustersX * ClustersY; ++i)
+    {
+        const int index = slice * ClustersX * ClustersY + i;
+
+        ClusterBounds bounds;
+        bounds.minX = boundsMinX[ index ];
+        bounds.minY = boundsMinY[ index ];
+        bounds.minZ = -sliceFar[ slice ];
+        bounds.maxX = boundsMaxX[ index ];
+        bounds.maxY = boundsMaxY[ index ];
+        bounds.maxZ = -sliceNear[ slice ];
+        bounds.centerX = (bounds.minX + bounds.maxX) * 0.5f;
+        bounds.centerY = (bounds.minY + bounds.maxY) * 0.5f;
+        bounds.centerZ = (bounds.minZ + bounds.maxZ) * 0.5f;
+        bounds.radius = (Vec3( bounds.maxX, bounds.maxY, bounds.maxZ ) - Vec3( bounds.centerX, bounds.centerY, bounds.centerZ )).Length();
+
+        result.clusters[ i ].offset = (unsigned)result.lightIndices.size();
+
+        AppendPointLights( points.x.data(), points.y.data(), points.z.data(), points.radius.data(), points.lightIndex.data(), points.x.size(),
+                           bounds, result.lightIndices );
+        AppendSpotLights( spots.x.data(), spots.y.data(), spots.z.data(), spots.radius.data(),
+                          spots.directionX.data(), spots.directionY.data(), spots.directionZ.data(), spots.coneCos.data(), spots.coneSin.data(),
+                          spots.lightIndex.data(), spots.x.size(), bounds, result.lightIndices );
+
+        result.clusters[ i ].count = (unsigned)result.lightIndices.size() - result.clusters[ i ].offset;
+    }
+}
+
+void LightClusterer::GetLightsPerClusterHistogram( int bucketCount, std::vector< int >& outHistogram ) const
+{
+    outHistogram.assign( bucketCount > 0 ? bucketCount : 1, 0 );
+
+    for (const Cluster& cluster : clusters)
+    {
+        const std::size_t bucket = std::min( (std::size_t)cluster.count, outHistogram.size() - 1 );
+        ++outHistogram[ bucket ];
+    }
+}
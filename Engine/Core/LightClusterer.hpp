@@ -0,0 +1,139 @@
+#ifndef LIGHT_CLUSTERER_H
+#define LIGHT_CLUSTERER_H
+
+#include <vector>
+
+namespace ae3d
+{
+    struct Matrix44;
+    struct Vec3;
+
+    /// Assigns point and spot lights to clusters on the CPU, for renderers and GPUs without compute shaders.
+    /// Clusters split the view frustum into ClustersX * ClustersY tiles and ClustersZ depth slices whose thickness grows
+    /// exponentially with depth. Slices are assigned in parallel with JobSystem and the results are compacted into
+    /// one light index list and a per-cluster offset table that GfxDevice::UploadLightClusters uploads once per frame.
+    class LightClusterer
+    {
+    public:
+        static const int ClustersX = 16;
+        static const int ClustersY = 8;
+        static const int ClustersZ = 24;
+        static const int ClusterCount = ClustersX * ClustersY * ClustersZ;
+        /// Lights added after this are ignored.
+        static const int MaxLights = 4096;
+
+        /// Light as uploaded into the lights buffer. Layout matches std430 vec4[ 3 ].
+        struct Light
+        {
+            /// World space position and radius. Spot light's radius is its range along the cone.
+            float positionAndRadius[ 4 ];
+            /// Spot light's world space direction and the cosine of its cone angle. Zero for point lights.
+            float directionAndConeCos[ 4 ];
+            /// Color and type: 0 for point lights, 1 for spot lights.
+            float colorAndType[ 4 ];
+        };
+
+        /// Cluster's range in the light index list. Layout matches std430 uvec2.
+        struct Cluster
+        {
+            unsigned offset;
+            unsigned count;
+        };
+
+        /// Sets the view frustum. Cluster bounds are rebuilt only when a value changes.
+        /// \param fovDegrees Vertical field of view in degrees.
+        /// \param aspect Width divided by height.
+        /// \param nearDepth Near clip plane distance, must be greater than zero.
+        /// \param farDepth Far clip plane distance.
+        void SetPerspective( float fovDegrees, float aspect, float nearDepth, float farDepth );
+
+        /// Removes all lights.
+        void ClearLights();
+
+        /// \param position World space position.
+        /// \param radius Radius.
+        /// \param color Color.
+        void AddPointLight( const Vec3& position, float radius, const Vec3& color );
+
+        /// \param position World space position.
+        /// \param direction World space direction, normalized.
+        /// \param radius Range along the cone.
+        /// \param coneAngleDegrees Angle between the direction and the cone's edge, as in SpotLightComponent.
+        /// \param color Color.
+        void AddSpotLight( const Vec3& position, const Vec3& direction, float radius, float coneAngleDegrees, const Vec3& color );
+
+        /// Transforms the lights into view space and assigns them to clusters. The time goes into System::Statistics::GetLightAssignmentTimeMS.
+        /// \param view View matrix.
+        void AssignLights( const Matrix44& view );
+
+        /// \param x Tile column, 0 is at the left.
+        /// \param y Tile row, 0 is at the bottom like in NDC.
+        /// \param z Depth slice, 0 is nearest.
+        /// \return Index into GetClusters.
+        static int GetClusterIndex( int x, int y, int z ) { return (z * ClustersY + y) * ClustersX + x; }
+
+        /// \param viewDepth Distance from the camera along its view direction.
+        /// \return Depth slice that contains viewDepth, clamped to [0, ClustersZ - 1].
+        int GetDepthSlice( float viewDepth ) const;
+
+        /// \return Lights in the order they were added.
+        const std::vector< Light >& GetLights() const { return lights; }
+
+        /// \return Indices into GetLights, one range per cluster.
+        const std::vector< unsigned >& GetLightIndices() const { return lightIndices; }
+
+        /// \return ClusterCount ranges into GetLightIndices, filled by AssignLights.
+        const std::vector< Cluster >& GetClusters() const { return clusters; }
+
+        /// Counts clusters by their light count.
+        /// \param bucketCount Bucket count. The last bucket also counts clusters that have more lights.
+        /// \param outHistogram Receives the number of clusters that have i lights in element i.
+        void GetLightsPerClusterHistogram( int bucketCount, std::vector< int >& outHistogram ) const;
+
+    private:
+        // Lights that touch a depth slice, in view space and structure-of-arrays layout so they can be tested four at a time.
+        struct SliceLights
+        {
+            std::vector< float > x, y, z, radius;
+            std::vector< float > directionX, directionY, directionZ, coneCos, coneSin;
+            std::vector< unsigned > lightIndex;
+
+            void Clear();
+        };
+
+        struct SliceResult
+        {
+            SliceLights pointLights;
+            SliceLights spotLights;
+            // Light indices of the slice's clusters, offsets are relative to the slice.
+            std::vector< unsigned > lightIndices;
+            Cluster clusters[ ClustersX * ClustersY ];
+        };
+
+        void UpdateClusterBounds();
+        void AssignSlice( int slice );
+
+        std::vector< Light > lights;
+        // Lights in view space and their depth slice range.
+        std::vector< float > viewPositionAndRadius;
+        std::vector< float > viewDirection;
+        std::vector< int > firstSlice;
+        std::vector< int > lastSlice;
+
+        // View space cluster bounds, one element per cluster in GetClusterIndex order.
+        std::vector< float > boundsMinX, boundsMinY, boundsMaxX, boundsMaxY;
+        // Slice z bounds are positive distances from the camera.
+        float sliceNear[ ClustersZ ] = {};
+        float sliceFar[ ClustersZ ] = {};
+
+        std::vector< SliceResult > sliceResults;
+        std::vector< unsigned > lightIndices;
+        std::vector< Cluster > clusters;
+
+        float fovDegrees = 0;
+        float aspect = 0;
+        float nearDepth = 0;
+        float farDepth = 0;
+    };
+}
+#endif
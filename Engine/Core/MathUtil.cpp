@@ -1,4 +1,6 @@
 #include <vector>
+#include <cmath>
+#include "Matrix.hpp"
 #include "Vec3.hpp"
 
 using namespace ae3d;
@@ -64,6 +66,22 @@ namespace MathUtil
         };
     }
 
+    // Transforms the box's center and projects its extent onto the world axes, so the corners don't need to be transformed one by one.
+    void TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent )
+    {
+        const Vec3 center = (aabbMin + aabbMax) * 0.5f;
+        const Vec3 extent = (aabbMax - aabbMin) * 0.5f;
+        const float* m = localToWorld.m;
+
+        outCenter.x = m[ 0 ] * center.x + m[ 4 ] * center.y + m[  8 ] * center.z + m[ 12 ];
+        outCenter.y = m[ 1 ] * center.x + m[ 5 ] * center.y + m[  9 ] * center.z + m[ 13 ];
+        outCenter.z = m[ 2 ] * center.x + m[ 6 ] * center.y + m[ 10 ] * center.z + m[ 14 ];
+
+        outExtent.x = std::abs( m[ 0 ] ) * extent.x + std::abs( m[ 4 ] ) * extent.y + std::abs( m[  8 ] ) * extent.z;
+        outExtent.y = std::abs( m[ 1 ] ) * extent.x + std::abs( m[ 5 ] ) * extent.y + std::abs( m[  9 ] ) * extent.z;
+        outExtent.z = std::abs( m[ 2 ] ) * extent.x + std::abs( m[ 6 ] ) * extent.y + std::abs( m[ 10 ] ) * extent.z;
+    }
+
     float Floor( float f )
     {
         return std::floor( f );
@@ -0,0 +1,48 @@
+#ifndef MEMORY_STREAM_H
+#define MEMORY_STREAM_H
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+
+namespace ae3d
+{
+    /// Stream buffer that reads memory in place, eg. a FileSystem::FileView.
+    struct membuf : std::streambuf
+    {
+        membuf( char const* base, std::size_t size )
+        {
+            char* p( const_cast<char*>(base) );
+            this->setg( p, p, p + size );
+        }
+
+    protected:
+        pos_type seekoff( off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode /*which*/ ) override
+        {
+            char* target = (dir == std::ios_base::beg ? eback() : (dir == std::ios_base::cur ? gptr() : egptr())) + offset;
+
+            if (target < eback() || target > egptr())
+            {
+                return pos_type( off_type( -1 ) );
+            }
+
+            setg( eback(), target, egptr() );
+            return pos_type( target - eback() );
+        }
+
+        pos_type seekpos( pos_type position, std::ios_base::openmode which ) override
+        {
+            return seekoff( off_type( position ), std::ios_base::beg, which );
+        }
+    };
+
+    /// Input stream that reads memory in place, so parsing file contents doesn't need a copy in a std::string.
+    struct imemstream : virtual membuf, std::istream
+    {
+        imemstream( char const* base, std::size_t size )
+            : membuf( base, size )
+            , std::istream( static_cast<std::streambuf*>(this) ) {
+        }
+    };
+}
+#endif
@@ -2,10 +2,13 @@
 #include <vector>
 #include <sstream>
 #include <list>
+#include <memory>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include "FileSystem.hpp"
 #include "FileWatcher.hpp"
+#include "MemoryStream.hpp"
 #include "VertexBuffer.hpp"
 #include "SubMesh.hpp"
 #include "System.hpp"
@@ -26,6 +29,7 @@ struct ae3d::Mesh::Impl
     Vec3 aabbMax;
     std::vector< SubMesh > subMeshes;
     std::string path;
+    unsigned contentVersion = 0;
 };
 
 struct MeshCacheEntry
@@ -41,23 +45,210 @@ namespace
 
 std::vector< MeshCacheEntry > gMeshCache;
 std::list< Mesh* > gMeshInstances;
+// Source of content versions, so that a mesh never gets a version it had before, even after being assigned.
+unsigned gMeshContentVersion = 0;
 
-struct membuf : std::streambuf
+}
+
+// Sub-mesh contents read from an .ae3d file. Arrays point into the file's view, or into the copies if the view keeps them misaligned.
+struct ParsedSubMesh
+{
+    Vec3 aabbMin;
+    Vec3 aabbMax;
+    std::string name;
+    std::uint8_t vertexFormat = 0;
+    std::uint16_t vertexCount = 0;
+    std::uint16_t faceCount = 0;
+    const VertexBuffer::VertexPTNTC* verticesPTNTC = nullptr;
+    const VertexBuffer::VertexPTN* verticesPTN = nullptr;
+    const VertexBuffer::Face* faces = nullptr;
+    std::vector< VertexBuffer::VertexPTNTC > copiedPTNTC;
+    std::vector< VertexBuffer::VertexPTN > copiedPTN;
+    std::vector< VertexBuffer::Face > copiedFaces;
+};
+
+// Parsed .ae3d file. Not copyable, because sub-meshes can point into their own copies.
+struct ParsedMesh
+{
+    ParsedMesh() = default;
+    ParsedMesh( const ParsedMesh& ) = delete;
+    ParsedMesh& operator=( const ParsedMesh& ) = delete;
+
+    FileSystem::FileView view;
+    Mesh::LoadResult result = Mesh::LoadResult::Corrupted;
+    Vec3 aabbMin;
+    Vec3 aabbMax;
+    std::vector< ParsedSubMesh > subMeshes;
+};
+
+namespace PreparsedMesh
 {
-    membuf( char const* base, size_t size )
+    // Mesh that AssetLoader parsed on its I/O thread from the file contents at source.
+    const unsigned char* source = nullptr;
+    std::shared_ptr< const ParsedMesh > mesh;
+}
+
+// \return count elements at the stream's position in view, or their copy in outCopy if they are misaligned. Null if view is too short.
+template< typename T >
+const T* ReadArray( imemstream& is, const FileSystem::FileView& view, std::size_t count, std::vector< T >& outCopy, bool& outIsOutOfMemory )
+{
+    const std::streamoff offset = is.tellg();
+    const std::size_t byteCount = count * sizeof( T );
+
+    if (offset < 0 || static_cast< std::size_t >( offset ) + byteCount > view.size)
     {
-        char* p( const_cast<char*>(base) );
-        this->setg( p, p, p + size );
+        return nullptr;
+    }
+
+    is.seekg( static_cast< std::streamoff >( byteCount ), std::ios_base::cur );
+    const unsigned char* elements = view.data + offset;
+
+    if (reinterpret_cast< std::uintptr_t >( elements ) % alignof( T ) == 0)
+    {
+        return reinterpret_cast< const T* >( elements );
+    }
+
+    try { outCopy.resize( count ); }
+    catch (std::bad_alloc&)
+    {
+        outIsOutOfMemory = true;
+        return nullptr;
     }
-};
 
-struct imemstream : virtual membuf, std::istream
+    std::memcpy( static_cast< void* >( outCopy.data() ), elements, byteCount );
+    return outCopy.data();
+}
+
+namespace
 {
-    imemstream( char const* base, size_t size )
-        : membuf( base, size )
-        , std::istream( static_cast<std::streambuf*>(this) ) {
+void ParseMeshInto( const FileSystem::FileView& meshData, ParsedMesh& outMesh )
+{
+    outMesh.view = meshData;
+    outMesh.result = Mesh::LoadResult::Corrupted;
+
+    if (!meshData.isLoaded)
+    {
+        outMesh.result = Mesh::LoadResult::FileNotFound;
+        return;
     }
-};
+
+    uint8_t magic[ 2 ];
+
+    imemstream is( (const char*)meshData.data, meshData.size );
+    is.read( (char*)&magic[ 0 ], sizeof( magic ) );
+
+    if (magic[ 0 ] != 'a' || magic[ 1 ] != '9')
+    {
+        System::Print( "%s is corrupted or old format: Wrong magic number!\n", meshData.path.c_str() );
+        return;
+    }
+
+    is.read( (char*)&outMesh.aabbMin, sizeof( outMesh.aabbMin ) );
+    is.read( (char*)&outMesh.aabbMax, sizeof( outMesh.aabbMax ) );
+
+    const auto& aabbMin = outMesh.aabbMin;
+    const auto& aabbMax = outMesh.aabbMax;
+
+    if (aabbMin.x > aabbMax.x || aabbMin.y > aabbMax.y || aabbMin.z > aabbMax.z)
+    {
+        return;
+    }
+    
+    uint16_t meshCount;
+    is.read( (char*)&meshCount, sizeof( meshCount ) );
+
+    // Sized up front so that sub-meshes don't move after their arrays point into their copies.
+    outMesh.subMeshes.resize( meshCount );
+
+    for (auto& subMesh : outMesh.subMeshes)
+    {
+        is.read( (char*)&subMesh.aabbMin, sizeof( subMesh.aabbMin ) );
+        is.read( (char*)&subMesh.aabbMax, sizeof( subMesh.aabbMax ) );
+
+        uint16_t nameLength;
+        is.read( (char*)&nameLength, sizeof( nameLength ) );
+
+        std::vector< char > meshName( nameLength + 1 );
+        is.read( (char*)&meshName[ 0 ], nameLength );
+        subMesh.name = std::string( meshName.data(), meshName.size() - 1 );
+
+        is.read( (char*)&subMesh.vertexCount, sizeof( subMesh.vertexCount ) );
+
+        // Vertices and faces are used in place when the view keeps them aligned.
+        bool isOutOfMemory = false;
+
+        is.read( (char*)&subMesh.vertexFormat, sizeof( subMesh.vertexFormat ) );
+        
+        if (subMesh.vertexFormat == 0) // PTNTC
+        {
+            subMesh.verticesPTNTC = ReadArray( is, meshData, subMesh.vertexCount, subMesh.copiedPTNTC, isOutOfMemory );
+        }
+        else if (subMesh.vertexFormat == 1) // PTN
+        {
+            subMesh.verticesPTN = ReadArray( is, meshData, subMesh.vertexCount, subMesh.copiedPTN, isOutOfMemory );
+        }
+        else
+        {
+            System::Print( "Mesh %s submesh %s has invalid vertex format %d. Only 0 and 1 are valid!\n", meshData.path.c_str(), subMesh.name.c_str(), subMesh.vertexFormat );
+            return;
+        }
+
+        is.read( (char*)&subMesh.faceCount, sizeof( subMesh.faceCount ) );
+
+        subMesh.faces = ReadArray( is, meshData, subMesh.faceCount, subMesh.copiedFaces, isOutOfMemory );
+
+        if (isOutOfMemory)
+        {
+            outMesh.result = Mesh::LoadResult::OutOfMemory;
+            return;
+        }
+
+        if (subMesh.faces == nullptr || (subMesh.verticesPTNTC == nullptr && subMesh.verticesPTN == nullptr))
+        {
+            System::Print( "Mesh %s submesh %s is truncated!\n", meshData.path.c_str(), subMesh.name.c_str() );
+            return;
+        }
+    }
+    
+    uint8_t terminator;
+    is.read( (char*)&terminator, sizeof( terminator ) );
+
+    if (terminator == 100)
+    {
+        outMesh.result = Mesh::LoadResult::Success;
+    }
+}
+}
+
+// Reads the sub-meshes of an .ae3d file without touching the GPU, so it can run on any thread.
+std::shared_ptr< const ParsedMesh > ParseMesh( const FileSystem::FileView& meshData )
+{
+    std::shared_ptr< ParsedMesh > mesh = std::make_shared< ParsedMesh >();
+    ParseMeshInto( meshData, *mesh );
+    return mesh;
+}
+
+namespace
+{
+std::shared_ptr< const OccluderGeometry > MakeOccluderGeometry( const ParsedSubMesh& parsed )
+{
+    std::shared_ptr< OccluderGeometry > geometry = std::make_shared< OccluderGeometry >();
+    geometry->positions.resize( parsed.vertexCount );
+
+    for (uint16_t v = 0; v < parsed.vertexCount; ++v)
+    {
+        geometry->positions[ v ] = parsed.vertexFormat == 0 ? parsed.verticesPTNTC[ v ].position : parsed.verticesPTN[ v ].position;
+    }
+
+    geometry->faces.assign( parsed.faces, parsed.faces + parsed.faceCount );
+    return geometry;
+}
+}
+
+void SetPreparsedMesh( const std::shared_ptr< const ParsedMesh >& mesh )
+{
+    PreparsedMesh::source = mesh ? mesh->view.data : nullptr;
+    PreparsedMesh::mesh = mesh;
 }
 
 void AddUniqueInstance( Mesh* mesh )
@@ -94,7 +285,7 @@ void MeshReload( const std::string& path )
     {
         if (instance->GetPath() == path)
         {
-            instance->Load( FileSystem::FileContents( path.c_str() ) );
+            instance->Load( FileSystem::FileContentsView( path.c_str() ) );
         }
     }
 }
@@ -113,6 +304,7 @@ ae3d::Mesh::Mesh( const Mesh& other )
 {
     new(&_storage)Impl();
     reinterpret_cast<Impl&>(_storage) = reinterpret_cast<Impl const&>(other._storage);
+    m().contentVersion = ++gMeshContentVersion;
 }
 
 ae3d::Mesh& ae3d::Mesh::operator=( const Mesh& other )
@@ -124,6 +316,7 @@ ae3d::Mesh& ae3d::Mesh::operator=( const Mesh& other )
 
     new(&_storage)Impl();
     reinterpret_cast<Impl&>(_storage) = reinterpret_cast<Impl const&>(other._storage);
+    m().contentVersion = ++gMeshContentVersion;
     return *this;
 }
 
@@ -132,6 +325,11 @@ const std::string& ae3d::Mesh::GetPath() const
     return m().path;
 }
 
+unsigned ae3d::Mesh::GetContentVersion() const
+{
+    return m().contentVersion;
+}
+
 const Vec3& ae3d::Mesh::GetAABBMin() const
 {
     return m().aabbMin;
@@ -167,7 +365,54 @@ unsigned ae3d::Mesh::GetSubMeshCount() const
     return (unsigned)m().subMeshes.size();
 }
 
-ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& meshData )
+void ae3d::Mesh::CreateOccluderGeometry()
+{
+    if (m().subMeshes.empty() || m().subMeshes[ 0 ].occluderGeometry)
+    {
+        return;
+    }
+
+    MeshCacheEntry* cacheEntry = nullptr;
+
+    for (auto& entry : gMeshCache)
+    {
+        if (entry.path == m().path && entry.subMeshes.size() == m().subMeshes.size())
+        {
+            cacheEntry = &entry;
+        }
+    }
+
+    if (cacheEntry != nullptr && cacheEntry->subMeshes[ 0 ].occluderGeometry)
+    {
+        for (std::size_t i = 0; i < m().subMeshes.size(); ++i)
+        {
+            m().subMeshes[ i ].occluderGeometry = cacheEntry->subMeshes[ i ].occluderGeometry;
+        }
+
+        return;
+    }
+
+    // Load doesn't keep the parsed file, so it's parsed again.
+    const std::shared_ptr< const ParsedMesh > parsedMesh = ParseMesh( FileSystem::FileContentsView( m().path.c_str() ) );
+
+    if (parsedMesh->result != LoadResult::Success || parsedMesh->subMeshes.size() != m().subMeshes.size())
+    {
+        System::Print( "Could not read occluder geometry of mesh %s\n", m().path.c_str() );
+        return;
+    }
+
+    for (std::size_t i = 0; i < m().subMeshes.size(); ++i)
+    {
+        m().subMeshes[ i ].occluderGeometry = MakeOccluderGeometry( parsedMesh->subMeshes[ i ] );
+
+        if (cacheEntry != nullptr)
+        {
+            cacheEntry->subMeshes[ i ].occluderGeometry = m().subMeshes[ i ].occluderGeometry;
+        }
+    }
+}
+
+ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileView& meshData )
 {
     for (const auto& entry : gMeshCache)
     {
@@ -177,6 +422,7 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
             m().aabbMax = entry.aabbMax;
             m().subMeshes = entry.subMeshes;
             m().path = entry.path;
+            m().contentVersion = ++gMeshContentVersion;
 
             AddUniqueInstance( this );
             
@@ -222,104 +468,74 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
         firstSubMesh.vertexBuffer.SetDebugName( "default mesh" );
         firstSubMesh.aabbMin = {-s, -s, -s};
         firstSubMesh.aabbMax = { s,  s, s };
+        m().aabbMin = firstSubMesh.aabbMin;
+        m().aabbMax = firstSubMesh.aabbMax;
+
+        // The default cube has no file to read it again from, and it's tiny, so its occluder geometry is created up front.
+        std::shared_ptr< OccluderGeometry > geometry = std::make_shared< OccluderGeometry >();
+        geometry->faces = indices;
+
+        for (const auto& vertex : vertices)
+        {
+            geometry->positions.push_back( vertex.position );
+        }
+
+        firstSubMesh.occluderGeometry = geometry;
+        m().contentVersion = ++gMeshContentVersion;
+
         return LoadResult::FileNotFound;
     }
     
-    uint8_t magic[ 2 ];
-
-    imemstream is( (const char*)meshData.data.data(), meshData.data.size() );
-    is.read( (char*)&magic[ 0 ], sizeof( magic ) );
+    // AssetLoader parses on its I/O thread, so only the vertex buffers are created here.
+    std::shared_ptr< const ParsedMesh > parsedMesh;
 
-    if (magic[ 0 ] != 'a' || magic[ 1 ] != '9')
+    if (meshData.data != nullptr && meshData.data == PreparsedMesh::source)
     {
-        System::Print( "%s is corrupted or old format: Wrong magic number!\n", meshData.path.c_str() );
-        return LoadResult::Corrupted;
+        parsedMesh = PreparsedMesh::mesh;
+        SetPreparsedMesh( nullptr );
     }
-
-    is.read( (char*)&m().aabbMin, sizeof( m().aabbMin ) );
-    is.read( (char*)&m().aabbMax, sizeof( m().aabbMax ) );
-
-    const auto& aabbMin = m().aabbMin;
-    const auto& aabbMax = m().aabbMax;
-
-    if (aabbMin.x > aabbMax.x || aabbMin.y > aabbMax.y || aabbMin.z > aabbMax.z)
+    else
     {
-        return LoadResult::Corrupted;
+        parsedMesh = ParseMesh( meshData );
     }
-    
-    uint16_t meshCount;
-    is.read( (char*)&meshCount, sizeof( meshCount ) );
 
-    m().subMeshes.clear();
-    m().subMeshes.resize( meshCount );
+    if (parsedMesh->result != LoadResult::Success)
+    {
+        return parsedMesh->result;
+    }
 
+#if RENDERER_OPENGL
+    // Reloading must not leak the previous geometry's space in the mesh arena.
     for (auto& subMesh : m().subMeshes)
     {
-        is.read( (char*)&subMesh.aabbMin, sizeof( subMesh.aabbMin ) );
-        is.read( (char*)&subMesh.aabbMax, sizeof( subMesh.aabbMax ) );
-
-        uint16_t nameLength;
-        is.read( (char*)&nameLength, sizeof( nameLength ) );
-
-        std::vector< char > meshName( nameLength + 1 );
-        is.read( (char*)&meshName[ 0 ], nameLength );
-        subMesh.name = std::string( meshName.data(), meshName.size() - 1 );
-
-        uint16_t vertexCount;
-        is.read( (char*)&vertexCount, sizeof( vertexCount ) );
-
-        std::vector< VertexBuffer::VertexPTNTC > verticesPTNTC;
-        std::vector< VertexBuffer::VertexPTN > verticesPTN;
-
-        uint8_t vertexFormat;
-        is.read( (char*)&vertexFormat, sizeof( vertexFormat ) );
-        
-        if (vertexFormat == 0) // PTNTC
-        {
-            try { verticesPTNTC.resize( vertexCount ); }
-            catch (std::bad_alloc&)
-            {
-                return LoadResult::OutOfMemory;
-            }
-        
-            is.read( (char*)&verticesPTNTC[ 0 ].position.x, vertexCount * sizeof( VertexBuffer::VertexPTNTC ) );
-        }
-        else if (vertexFormat == 1) // PTN
-        {
-            try { verticesPTN.resize( vertexCount ); }
-            catch (std::bad_alloc&)
-            {
-                return LoadResult::OutOfMemory;
-            }
-            
-            is.read( (char*)&verticesPTN[ 0 ].position.x, vertexCount * sizeof( VertexBuffer::VertexPTN ) );
-        }
-        else
-        {
-            System::Print( "Mesh %s submesh %s has invalid vertex format %d. Only 0 and 1 are valid!\n", meshData.path.c_str(), subMesh.name.c_str(), vertexFormat );
-            return LoadResult::Corrupted;
-        }
-
-        uint16_t faceCount;
-        is.read( (char*)&faceCount, sizeof( faceCount ) );
-
-        std::vector< VertexBuffer::Face > indices;
+        subMesh.vertexBuffer.ReleaseMeshArenaRange();
+    }
+#endif
 
-        try { indices.resize( faceCount ); }
-        catch (std::bad_alloc&)
-        {
-            return LoadResult::OutOfMemory;
-        }
+    // A reloaded occluder mesh gets new occluder geometry.
+    const bool hasOccluderGeometry = !m().subMeshes.empty() && m().subMeshes[ 0 ].occluderGeometry;
 
-        is.read( (char*)&indices[ 0 ], faceCount * sizeof( VertexBuffer::Face ) );
+    m().aabbMin = parsedMesh->aabbMin;
+    m().aabbMax = parsedMesh->aabbMax;
+    m().subMeshes.clear();
+    m().subMeshes.resize( parsedMesh->subMeshes.size() );
 
-        if (vertexFormat == 0)
+    for (std::size_t i = 0; i < parsedMesh->subMeshes.size(); ++i)
+    {
+        const ParsedSubMesh& parsed = parsedMesh->subMeshes[ i ];
+        SubMesh& subMesh = m().subMeshes[ i ];
+        subMesh.aabbMin = parsed.aabbMin;
+        subMesh.aabbMax = parsed.aabbMax;
+        subMesh.name = parsed.name;
+        subMesh.vertexBuffer.SetUseMeshArena( true );
+
+        if (parsed.vertexFormat == 0)
         {
-            subMesh.vertexBuffer.Generate( indices.data(), static_cast< int >( indices.size() ), verticesPTNTC.data(), static_cast< int >( verticesPTNTC.size() ) );
+            subMesh.vertexBuffer.Generate( parsed.faces, parsed.faceCount, parsed.verticesPTNTC, parsed.vertexCount );
         }
-        else if (vertexFormat == 1)
+        else if (parsed.vertexFormat == 1)
         {
-            subMesh.vertexBuffer.Generate( indices.data(), static_cast< int >( indices.size() ), verticesPTN.data(), static_cast< int >( verticesPTN.size() ) );
+            subMesh.vertexBuffer.Generate( parsed.faces, parsed.faceCount, parsed.verticesPTN, parsed.vertexCount );
         }
         else
         {
@@ -328,14 +544,11 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
 
         std::string subMeshDebugName = meshData.path + std::string( ":" ) + subMesh.name;
         subMesh.vertexBuffer.SetDebugName( subMeshDebugName.c_str() );
-    }
-    
-    uint8_t terminator;
-    is.read( (char*)&terminator, sizeof( terminator ) );
 
-    if (terminator != 100)
-    {
-        return LoadResult::Corrupted;
+        if (hasOccluderGeometry)
+        {
+            subMesh.occluderGeometry = MakeOccluderGeometry( parsed );
+        }
     }
 
     MeshCacheEntry cacheEntry;
@@ -350,6 +563,7 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
     fileWatcher.AddFile( meshData.path, MeshReload );
     
     m().path = meshData.path;
+    m().contentVersion = ++gMeshContentVersion;
     
     return LoadResult::Success;
 }
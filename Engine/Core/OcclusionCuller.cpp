@@ -0,0 +1,401 @@
+#include "OcclusionCuller.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+#if defined( SIMD_SSE3 )
+#include <pmmintrin.h>
+#include <xmmintrin.h>
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+#include "JobSystem.hpp"
+#include "System.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    // Rows rasterized by one job. A multiple of TileSize so that a job can also build its tiles of the coarse level.
+    const int BandHeight = 2 * OcclusionCuller::TileSize;
+
+    // Clip space w below this is treated as being at or behind the camera.
+    const float MinW = 1e-5f;
+
+    bool ProjectToScreen( const Vec4& clip, float& outX, float& outY, float& outZ )
+    {
+        if (clip.w <= MinW)
+        {
+            return false;
+        }
+
+        const float invW = 1.0f / clip.w;
+        outX = (clip.x * invW * 0.5f + 0.5f) * OcclusionCuller::Width;
+        outY = (clip.y * invW * 0.5f + 0.5f) * OcclusionCuller::Height;
+        outZ = clip.z * invW;
+        return true;
+    }
+}
+
+void OcclusionCuller::Clear()
+{
+    occluders.clear();
+    std::fill( std::begin( depth ), std::end( depth ), 1.0f );
+    std::fill( std::begin( tileMaxDepth ), std::end( tileMaxDepth ), 1.0f );
+}
+
+void OcclusionCuller::AddOccluder( const Vec3* positions, const unsigned short* indices, int triangleCount, const Matrix44& localToClip )
+{
+    Occluder occluder;
+    occluder.positions = positions;
+    occluder.indices = indices;
+    occluder.triangleCount = triangleCount;
+    occluder.localToClip = localToClip;
+    occluders.push_back( occluder );
+}
+
+void OcclusionCuller::SetupTriangles( const Occluder& occluder, std::vector< Triangle >& outTriangles ) const
+{
+    outTriangles.clear();
+
+    for (int t = 0; t < occluder.triangleCount; ++t)
+    {
+        Triangle triangle;
+        bool isInFrontOfCamera = true;
+
+        for (int v = 0; v < 3 && isInFrontOfCamera; ++v)
+        {
+            const Vec3& position = occluder.positions[ occluder.indices[ t * 3 + v ] ];
+            Vec4 clip;
+            Matrix44::TransformPoint( Vec4( position.x, position.y, position.z, 1 ), occluder.localToClip, &clip );
+            isInFrontOfCamera = ProjectToScreen( clip, triangle.x[ v ], triangle.y[ v ], triangle.z[ v ] ) && triangle.z[ v ] >= -1;
+        }
+
+        if (!isInFrontOfCamera)
+        {
+            continue;
+        }
+
+        const float area = (triangle.x[ 1 ] - triangle.x[ 0 ]) * (triangle.y[ 2 ] - triangle.y[ 0 ]) -
+                           (triangle.x[ 2 ] - triangle.x[ 0 ]) * (triangle.y[ 1 ] - triangle.y[ 0 ]);
+
+        if (std::abs( area ) < 1e-6f)
+        {
+            continue;
+        }
+
+        // Occluders are rasterized regardless of their facing, so clockwise triangles are flipped.
+        if (area < 0)
+        {
+            std::swap( triangle.x[ 1 ], triangle.x[ 2 ] );
+            std::swap( triangle.y[ 1 ], triangle.y[ 2 ] );
+            std::swap( triangle.z[ 1 ], triangle.z[ 2 ] );
+        }
+
+        const float minY = std::min( std::min( triangle.y[ 0 ], triangle.y[ 1 ] ), triangle.y[ 2 ] );
+        const float maxY = std::max( std::max( triangle.y[ 0 ], triangle.y[ 1 ] ), triangle.y[ 2 ] );
+        const float minX = std::min( std::min( triangle.x[ 0 ], triangle.x[ 1 ] ), triangle.x[ 2 ] );
+        const float maxX = std::max( std::max( triangle.x[ 0 ], triangle.x[ 1 ] ), triangle.x[ 2 ] );
+
+        if (maxX < 0 || maxY < 0 || minX >= Width || minY >= Height)
+        {
+            continue;
+        }
+
+        triangle.minY = std::max( 0, (int)std::floor( minY ) );
+        triangle.maxY = std::min( Height - 1, (int)std::floor( maxY ) );
+        outTriangles.push_back( triangle );
+    }
+}
+
+void OcclusionCuller::RasterizeBand( int firstRow, int endRow )
+{
+#if defined( __AVX2__ )
+    const int step = 8;
+    const __m256 laneOffsets = _mm256_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f );
+#elif defined( SIMD_SSE3 )
+    const int step = 4;
+    const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    const int step = 4;
+    const float laneOffsetData[ 4 ] = { 0.5f, 1.5f, 2.5f, 3.5f };
+    const float32x4_t laneOffsets = vld1q_f32( laneOffsetData );
+#else
+    const int step = 1;
+#endif
+
+    for (const std::vector< Triangle >& triangles : occluderTriangles)
+    {
+        for (const Triangle& triangle : triangles)
+        {
+            const int rowBegin = std::max( triangle.minY, firstRow );
+            const int rowEnd = std::min( triangle.maxY + 1, endRow );
+
+            if (rowBegin >= rowEnd)
+            {
+                continue;
+            }
+
+            // Edge i goes from vertex i to vertex i + 1 and is positive inside the triangle: edge = a * x + b * y + c.
+            float a[ 3 ], b[ 3 ], c[ 3 ];
+
+            for (int i = 0; i < 3; ++i)
+            {
+                const int next = (i + 1) % 3;
+                a[ i ] = triangle.y[ i ] - triangle.y[ next ];
+                b[ i ] = triangle.x[ next ] - triangle.x[ i ];
+                c[ i ] = -(a[ i ] * triangle.x[ i ] + b[ i ] * triangle.y[ i ]);
+            }
+
+            const float area = b[ 0 ] * (triangle.y[ 2 ] - triangle.y[ 0 ]) + a[ 0 ] * (triangle.x[ 2 ] - triangle.x[ 0 ]);
+            const float dzdx = ((triangle.z[ 1 ] - triangle.z[ 0 ]) * (triangle.y[ 2 ] - triangle.y[ 0 ]) -
+                                (triangle.z[ 2 ] - triangle.z[ 0 ]) * (triangle.y[ 1 ] - triangle.y[ 0 ])) / area;
+            const float dzdy = ((triangle.z[ 2 ] - triangle.z[ 0 ]) * (triangle.x[ 1 ] - triangle.x[ 0 ]) -
+                                (triangle.z[ 1 ] - triangle.z[ 0 ]) * (triangle.x[ 2 ] - triangle.x[ 0 ])) / area;
+            // Pixels store the farthest depth the triangle has inside them, so the buffer never occludes more than the triangle does.
+            const float zBias = 0.5f * (std::abs( dzdx ) + std::abs( dzdy ));
+            const float z0 = triangle.z[ 0 ] - dzdx * triangle.x[ 0 ] - dzdy * triangle.y[ 0 ] + zBias;
+
+            const float minX = std::min( std::min( triangle.x[ 0 ], triangle.x[ 1 ] ), triangle.x[ 2 ] );
+            const float maxX = std::max( std::max( triangle.x[ 0 ], triangle.x[ 1 ] ), triangle.x[ 2 ] );
+            // Spans start at a multiple of step, and Width is a multiple of step, so SIMD loads never cross the row's end.
+            const int columnBegin = std::max( 0, (int)std::floor( minX ) ) / step * step;
+            const int columnEnd = std::min( Width - 1, (int)std::floor( maxX ) ) + 1;
+
+            for (int y = rowBegin; y < rowEnd; ++y)
+            {
+                const float py = y + 0.5f;
+                const float rowEdge0 = b[ 0 ] * py + c[ 0 ];
+                const float rowEdge1 = b[ 1 ] * py + c[ 1 ];
+                const float rowEdge2 = b[ 2 ] * py + c[ 2 ];
+                const float rowZ = z0 + dzdy * py;
+                float* row = depth.data() + y * Width;
+
+                for (int x = columnBegin; x < columnEnd; x += step)
+                {
+#if defined( __AVX2__ )
+                    const __m256 px = _mm256_add_ps( _mm256_set1_ps( (float)x ), laneOffsets );
+                    const __m256 edge0 = _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( a[ 0 ] ), px ), _mm256_set1_ps( rowEdge0 ) );
+                    const __m256 edge1 = _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( a[ 1 ] ), px ), _mm256_set1_ps( rowEdge1 ) );
+                    const __m256 edge2 = _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( a[ 2 ] ), px ), _mm256_set1_ps( rowEdge2 ) );
+                    __m256 inside = _mm256_cmp_ps( edge0, _mm256_setzero_ps(), _CMP_GT_OQ );
+                    inside = _mm256_and_ps( inside, _mm256_cmp_ps( edge1, _mm256_setzero_ps(), _CMP_GT_OQ ) );
+                    inside = _mm256_and_ps( inside, _mm256_cmp_ps( edge2, _mm256_setzero_ps(), _CMP_GT_OQ ) );
+
+                    const __m256 z = _mm256_min_ps( _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( dzdx ), px ), _mm256_set1_ps( rowZ ) ), _mm256_set1_ps( 1.0f ) );
+                    const __m256 current = _mm256_loadu_ps( row + x );
+                    _mm256_storeu_ps( row + x, _mm256_blendv_ps( current, _mm256_min_ps( current, z ), inside ) );
+#elif defined( SIMD_SSE3 )
+                    const __m128 px = _mm_add_ps( _mm_set1_ps( (float)x ), laneOffsets );
+                    const __m128 edge0 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( a[ 0 ] ), px ), _mm_set1_ps( rowEdge0 ) );
+                    const __m128 edge1 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( a[ 1 ] ), px ), _mm_set1_ps( rowEdge1 ) );
+                    const __m128 edge2 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( a[ 2 ] ), px ), _mm_set1_ps( rowEdge2 ) );
+                    __m128 inside = _mm_cmpgt_ps( edge0, _mm_setzero_ps() );
+                    inside = _mm_and_ps( inside, _mm_cmpgt_ps( edge1, _mm_setzero_ps() ) );
+                    inside = _mm_and_ps( inside, _mm_cmpgt_ps( edge2, _mm_setzero_ps() ) );
+
+                    const __m128 z = _mm_min_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( dzdx ), px ), _mm_set1_ps( rowZ ) ), _mm_set1_ps( 1.0f ) );
+                    const __m128 current = _mm_loadu_ps( row + x );
+                    _mm_storeu_ps( row + x, _mm_or_ps( _mm_and_ps( inside, _mm_min_ps( current, z ) ), _mm_andnot_ps( inside, current ) ) );
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+                    const float32x4_t px = vaddq_f32( vdupq_n_f32( (float)x ), laneOffsets );
+                    const float32x4_t edge0 = vmlaq_n_f32( vdupq_n_f32( rowEdge0 ), px, a[ 0 ] );
+                    const float32x4_t edge1 = vmlaq_n_f32( vdupq_n_f32( rowEdge1 ), px, a[ 1 ] );
+                    const float32x4_t edge2 = vmlaq_n_f32( vdupq_n_f32( rowEdge2 ), px, a[ 2 ] );
+                    uint32x4_t inside = vcgtq_f32( edge0, vdupq_n_f32( 0 ) );
+                    inside = vandq_u32( inside, vcgtq_f32( edge1, vdupq_n_f32( 0 ) ) );
+                    inside = vandq_u32( inside, vcgtq_f32( edge2, vdupq_n_f32( 0 ) ) );
+
+                    const float32x4_t z = vminq_f32( vmlaq_n_f32( vdupq_n_f32( rowZ ), px, dzdx ), vdupq_n_f32( 1.0f ) );
+                    const float32x4_t current = vld1q_f32( row + x );
+                    vst1q_f32( row + x, vbslq_f32( inside, vminq_f32( current, z ), current ) );
+#else
+                    const float px = x + 0.5f;
+
+                    if (a[ 0 ] * px + rowEdge0 > 0 && a[ 1 ] * px + rowEdge1 > 0 && a[ 2 ] * px + rowEdge2 > 0)
+                    {
+                        row[ x ] = std::min( row[ x ], std::min( dzdx * px + rowZ, 1.0f ) );
+                    }
+#endif
+                }
+            }
+        }
+    }
+
+    for (int tileY = firstRow / TileSize; tileY < endRow / TileSize; ++tileY)
+    {
+        for (int tileX = 0; tileX < TilesX; ++tileX)
+        {
+            float maxDepth = 0;
+
+            for (int y = tileY * TileSize; y < (tileY + 1) * TileSize; ++y)
+            {
+                const float* row = depth.data() + y * Width + tileX * TileSize;
+                maxDepth = std::max( maxDepth, *std::max_element( row, row + TileSize ) );
+            }
+
+            tileMaxDepth[ tileY * TilesX + tileX ] = maxDepth;
+        }
+    }
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+    occluderTriangles.resize( occluders.size() );
+
+    JobSystem::ParallelFor( static_cast< int >( occluders.size() ), 4, [this]( int begin, int end )
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            SetupTriangles( occluders[ i ], occluderTriangles[ i ] );
+        }
+    } );
+
+    JobSystem::ParallelFor( Height / BandHeight, 1, [this]( int begin, int end )
+    {
+        for (int band = begin; band < end; ++band)
+        {
+            RasterizeBand( band * BandHeight, (band + 1) * BandHeight );
+        }
+    } );
+}
+
+bool OcclusionCuller::IsBoxVisible( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& viewProjection ) const
+{
+    float minX = (float)Width;
+    float minY = (float)Height;
+    float maxX = 0;
+    float maxY = 0;
+    float minZ = 1;
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const Vec4 position( (corner & 1) ? aabbMax.x : aabbMin.x, (corner & 2) ? aabbMax.y : aabbMin.y, (corner & 4) ? aabbMax.z : aabbMin.z, 1 );
+        Vec4 clip;
+        Matrix44::TransformPoint( position, viewProjection, &clip );
+
+        float x, y, z;
+
+        // Boxes that reach behind the camera cover the whole screen.
+        if (!ProjectToScreen( clip, x, y, z ))
+        {
+            return true;
+        }
+
+        minX = std::min( minX, x );
+        minY = std::min( minY, y );
+        maxX = std::max( maxX, x );
+        maxY = std::max( maxY, y );
+        minZ = std::min( minZ, z );
+    }
+
+    const int x0 = std::max( 0, (int)std::floor( minX ) );
+    const int y0 = std::max( 0, (int)std::floor( minY ) );
+    const int x1 = std::min( Width - 1, (int)std::floor( maxX ) );
+    const int y1 = std::min( Height - 1, (int)std::floor( maxY ) );
+
+    // Off-screen boxes are left to frustum culling.
+    if (x0 > x1 || y0 > y1)
+    {
+        return true;
+    }
+
+    for (int tileY = y0 / TileSize; tileY <= y1 / TileSize; ++tileY)
+    {
+        for (int tileX = x0 / TileSize; tileX <= x1 / TileSize; ++tileX)
+        {
+            if (tileMaxDepth[ tileY * TilesX + tileX ] < minZ)
+            {
+                continue;
+            }
+
+            // Some pixel in the tile is farther than the box, so the box's part of the tile must be tested per pixel.
+            const int rowBegin = std::max( y0, tileY * TileSize );
+            const int rowEnd = std::min( y1 + 1, (tileY + 1) * TileSize );
+            const int columnBegin = std::max( x0, tileX * TileSize );
+            const int columnEnd = std::min( x1 + 1, (tileX + 1) * TileSize );
+
+            for (int y = rowBegin; y < rowEnd; ++y)
+            {
+                for (int x = columnBegin; x < columnEnd; ++x)
+                {
+                    if (depth[ y * Width + x ] >= minZ)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+int OcclusionCuller::CullBoxes( const float* centerX, const float* centerY, const float* centerZ,
+                                const float* extentX, const float* extentY, const float* extentZ,
+                                int count, const Matrix44& viewProjection, std::uint32_t* inOutVisibleMask ) const
+{
+    std::atomic< int > occludedCount{ 0 };
+
+    // Batches are multiples of 32, so each mask word is written by one job.
+    JobSystem::ParallelFor( count, 64, [&]( int begin, int end )
+    {
+        int batchOccludedCount = 0;
+
+        for (int i = begin; i < end; ++i)
+        {
+            if ((inOutVisibleMask[ i >> 5 ] & (1u << (i & 31))) == 0)
+            {
+                continue;
+            }
+
+            const Vec3 center( centerX[ i ], centerY[ i ], centerZ[ i ] );
+            const Vec3 extent( extentX[ i ], extentY[ i ], extentZ[ i ] );
+
+            if (!IsBoxVisible( center - extent, center + extent, viewProjection ))
+            {
+                inOutVisibleMask[ i >> 5 ] &= ~(1u << (i & 31));
+                ++batchOccludedCount;
+            }
+        }
+
+        occludedCount += batchOccludedCount;
+    } );
+
+    return occludedCount;
+}
+
+bool OcclusionCuller::WriteDepthImage( const char* path ) const
+{
+    std::ofstream file( path, std::ios::binary );
+
+    if (!file)
+    {
+        System::Print( "Could not open %s for writing the occlusion depth buffer.\n", path );
+        return false;
+    }
+
+    // Perspective depth is crowded near 1, so the nearest depth is stretched to black.
+    const float nearestDepth = *std::min_element( std::begin( depth ), std::end( depth ) );
+    const float depthRange = nearestDepth < 1 ? 1 - nearestDepth : 1;
+    std::vector< unsigned char > pixels( Width * Height );
+
+    for (int y = 0; y < Height; ++y)
+    {
+        for (int x = 0; x < Width; ++x)
+        {
+            const float normalized = (GetDepth( x, Height - 1 - y ) - nearestDepth) / depthRange;
+            pixels[ y * Width + x ] = (unsigned char)(255 * std::max( 0.0f, std::min( normalized, 1.0f ) ));
+        }
+    }
+
+    file << "P5\n" << Width << " " << Height << "\n255\n";
+    file.write( (const char*)pixels.data(), pixels.size() );
+
+    System::Print( "Wrote occlusion depth buffer %s, nearest depth %f.\n", path, (double)nearestDepth );
+    return file.good();
+}
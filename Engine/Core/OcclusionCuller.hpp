@@ -0,0 +1,93 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <cstdint>
+#include <vector>
+#include "Matrix.hpp"
+
+namespace ae3d
+{
+    struct Vec3;
+
+    /// Rasterizes occluder triangles on the CPU into a low resolution depth buffer and tests boxes against it.
+    /// The buffer has a coarse level that stores the farthest depth of each tile, so most boxes are accepted
+    /// or rejected without reading pixels. Rasterization and tests are split into jobs with JobSystem.
+    /// Depths are clip space z / w, and 1 is the far plane.
+    class OcclusionCuller
+    {
+    public:
+        static const int Width = 256;
+        static const int Height = 128;
+        static const int TileSize = 8;
+        static const int TilesX = Width / TileSize;
+        static const int TilesY = Height / TileSize;
+
+        /// Clears the depth buffer and removes the occluders.
+        void Clear();
+
+        /// Queues an occluder's triangles for RasterizeOccluders. The arrays must stay valid until then.
+        /// \param positions Local positions.
+        /// \param indices Vertex indices, three per triangle.
+        /// \param triangleCount Triangle count.
+        /// \param localToClip Local-to-clip matrix, ie. model-view-projection.
+        void AddOccluder( const Vec3* positions, const unsigned short* indices, int triangleCount, const Matrix44& localToClip );
+
+        /// Rasterizes the queued occluders and builds the coarse level. Triangles that cross the near plane are skipped,
+        /// which only makes culling less effective.
+        void RasterizeOccluders();
+
+        /// \param aabbMin World space AABB min.
+        /// \param aabbMax World space AABB max.
+        /// \param viewProjection View-projection matrix that was used for the occluders.
+        /// \return False, if the box is completely behind the rasterized occluders.
+        bool IsBoxVisible( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& viewProjection ) const;
+
+        /// Tests boxes in parallel and clears their bits in inOutVisibleMask if they are occluded.
+        /// \param centerX Box centers' x coordinates. Other coordinates and half-extents are in the arrays that follow.
+        /// \param count Box count.
+        /// \param viewProjection View-projection matrix that was used for the occluders.
+        /// \param inOutVisibleMask Bit i is set if box i is visible. Boxes whose bit is not set are not tested.
+        /// \return Count of boxes that were found to be occluded.
+        int CullBoxes( const float* centerX, const float* centerY, const float* centerZ,
+                       const float* extentX, const float* extentY, const float* extentZ,
+                       int count, const Matrix44& viewProjection, std::uint32_t* inOutVisibleMask ) const;
+
+        /// \param x Column, 0 is at the left.
+        /// \param y Row, 0 is at the bottom like in NDC.
+        /// \return Depth at the pixel.
+        float GetDepth( int x, int y ) const { return depth[ y * Width + x ]; }
+
+        /// Writes the depth buffer as a binary PGM image, top row first. Near depths are dark and empty pixels are white.
+        /// \param path Path.
+        /// \return True, if the file was written.
+        bool WriteDepthImage( const char* path ) const;
+
+    private:
+        struct Occluder
+        {
+            const Vec3* positions;
+            const unsigned short* indices;
+            int triangleCount;
+            Matrix44 localToClip;
+        };
+
+        // Screen space triangle, counter-clockwise. x and y are in pixels.
+        struct Triangle
+        {
+            float x[ 3 ];
+            float y[ 3 ];
+            float z[ 3 ];
+            int minY, maxY;
+        };
+
+        void SetupTriangles( const Occluder& occluder, std::vector< Triangle >& outTriangles ) const;
+        void RasterizeBand( int firstRow, int endRow );
+
+        std::vector< Occluder > occluders;
+        // Triangles of each occluder, set up in parallel.
+        std::vector< std::vector< Triangle > > occluderTriangles;
+        std::vector< float > depth = std::vector< float >( Width * Height, 1.0f );
+        std::vector< float > tileMaxDepth = std::vector< float >( TilesX * TilesY, 1.0f );
+    };
+}
+#endif
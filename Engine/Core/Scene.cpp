@@ -5,6 +5,8 @@
 #include <sstream>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
 #include "CameraComponent.hpp"
@@ -27,9 +29,11 @@
 #include "Texture2D.hpp"
 #include "Renderer.hpp"
 #include "System.hpp"
-#if defined( RENDERER_METAL ) || defined( RENDERER_D3D12 )
+#include "VertexBuffer.hpp"
+#include "SubMesh.hpp"
+#include "LightClusterer.hpp"
 #include "LightTiler.hpp"
-#endif
+#include "OcclusionCuller.hpp"
 
 using namespace ae3d;
 extern Renderer renderer;
@@ -38,6 +42,7 @@ float GetVRFov();
 namespace MathUtil
 {
     void GetMinMax( const std::vector< Vec3 >& aPoints, Vec3& outMin, Vec3& outMax );
+    void TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& localToWorld, Vec3& outCenter, Vec3& outExtent );
     bool IsNaN( float f );
 }
 
@@ -46,21 +51,86 @@ namespace Global
     extern Vec3 vrEyePosition;
 }
 
-#if defined( RENDERER_METAL ) || defined( RENDERER_D3D12 )
 namespace GfxDeviceGlobal
 {
     extern ae3d::LightTiler lightTiler;
 }
-#endif
 
 namespace SceneGlobal
 {
     GameObject shadowCamera;
     bool isShadowCameraCreated = false;
+    LightClusterer lightClusterer;
+    OcclusionCuller occlusionCuller;
     Matrix44 shadowCameraViewMatrix;
     Matrix44 shadowCameraProjectionMatrix;
 }
 
+bool IsVisible( const std::vector< std::uint32_t >& visibleMask, std::size_t index )
+{
+    return ((visibleMask[ index >> 5 ] >> (index & 31)) & 1) != 0;
+}
+
+// Sort key fields. Ids are renumbered before they run out of bits. If one camera draws more shaders, materials or meshes
+// than a field fits, ids wrap around, which only makes sorting less effective.
+const std::uint64_t SortKeyShaderMask = (1u << 12) - 1;
+const std::uint64_t SortKeyMaterialMask = (1u << 14) - 1;
+const std::uint64_t SortKeyMeshMask = (1u << 10) - 1;
+const std::uint64_t SortKeySubMeshMask = (1u << 4) - 1;
+const std::uint64_t SortKeyDepthMask = (1u << 22) - 1;
+// Opaque keys with the same bits above this shift differ only by depth and can be drawn instanced.
+const unsigned SortKeyInstanceShift = 22;
+
+std::uint64_t QuantizeSortDepth( float distance, float farDistance )
+{
+    const float normalizedDistance = farDistance > 0 ? distance / farDistance : 0;
+    const float clampedDistance = normalizedDistance < 0 ? 0 : (normalizedDistance > 1 ? 1 : normalizedDistance);
+    return static_cast< std::uint64_t >( clampedDistance * SortKeyDepthMask );
+}
+
+// Sorts items by their 64-bit key in ascending order, 8 bits per pass. Stable.
+template< typename T > void RadixSortByKey( std::vector< T >& items, std::vector< T >& scratch )
+{
+    if (items.size() < 2)
+    {
+        return;
+    }
+
+    scratch.resize( items.size() );
+
+    for (unsigned shift = 0; shift < 64; shift += 8)
+    {
+        std::size_t offsets[ 256 ] = {};
+
+        for (const auto& item : items)
+        {
+            ++offsets[ (item.key >> shift) & 0xFF ];
+        }
+
+        // All keys have the same byte, so this pass wouldn't change the order.
+        if (offsets[ (items[ 0 ].key >> shift) & 0xFF ] == items.size())
+        {
+            continue;
+        }
+
+        std::size_t offset = 0;
+
+        for (auto& bucketOffset : offsets)
+        {
+            const std::size_t count = bucketOffset;
+            bucketOffset = offset;
+            offset += count;
+        }
+
+        for (const auto& item : items)
+        {
+            scratch[ offsets[ (item.key >> shift) & 0xFF ]++ ] = item;
+        }
+
+        items.swap( scratch );
+    }
+}
+
 void SetupCameraForSpotShadowCasting( const Vec3& lightPosition, const Vec3& lightDirection, ae3d::CameraComponent& outCamera,
                                      ae3d::TransformComponent& outCameraTransform )
 {
@@ -150,31 +220,81 @@ void SetupCameraForDirectionalShadowCasting( const Vec3& lightDirection, const F
 
 void ae3d::Scene::Add( GameObject* gameObject )
 {
-    for (const auto& go : gameObjects)
+    if (gameObject == nullptr || gameObjectSlots.find( gameObject ) != std::end( gameObjectSlots ))
     {
-        if (go == gameObject)
-        {
-            return;
-        }
+        return;
     }
 
-    if (nextFreeGameObject >= gameObjects.size())
+    unsigned slot;
+
+    if (freeGameObjectSlots.empty())
+    {
+        slot = static_cast< unsigned >( gameObjects.size() );
+        gameObjects.push_back( gameObject );
+        meshTreeEntries.push_back( MeshTreeEntry() );
+        renderListEntries.push_back( RenderListEntry() );
+    }
+    else
+    {
+        slot = freeGameObjectSlots.back();
+        freeGameObjectSlots.pop_back();
+        gameObjects[ slot ] = gameObject;
+    }
+
+    gameObjectSlots[ gameObject ] = slot;
+    areComponentListsDirty = true;
+    areRenderListsDirty = true;
+}
+
+void ae3d::Scene::AddRange( const std::vector< GameObject* >& gameObjectsToAdd )
+{
+    gameObjectSlots.reserve( gameObjectSlots.size() + gameObjectsToAdd.size() );
+
+    if (gameObjectsToAdd.size() > freeGameObjectSlots.size())
     {
-        gameObjects.resize( gameObjects.size() + 10 );
+        gameObjects.reserve( gameObjects.size() + gameObjectsToAdd.size() - freeGameObjectSlots.size() );
+        meshTreeEntries.reserve( gameObjects.capacity() );
+        renderListEntries.reserve( gameObjects.capacity() );
     }
 
-    gameObjects[ nextFreeGameObject++ ] = gameObject;
+    for (auto gameObject : gameObjectsToAdd)
+    {
+        Add( gameObject );
+    }
 }
 
 void ae3d::Scene::Remove( GameObject* gameObject )
 {
-    for (std::size_t i = 0; i < gameObjects.size(); ++i)
+    const auto slotIterator = gameObjectSlots.find( gameObject );
+
+    if (slotIterator == std::end( gameObjectSlots ))
     {
-        if (gameObject == gameObjects[ i ])
-        {
-            gameObjects.erase( std::begin( gameObjects ) + i );
-            return;
-        }
+        return;
+    }
+
+    const unsigned slot = slotIterator->second;
+    gameObjectSlots.erase( slotIterator );
+
+    if (meshTreeEntries[ slot ].proxy != AABBTree::NullProxy)
+    {
+        meshTree.Remove( meshTreeEntries[ slot ].proxy );
+    }
+
+    SetRenderListEntry( slot, nullptr, 0 );
+
+    // Leaves a hole so that other game objects keep their slots and order.
+    gameObjects[ slot ] = nullptr;
+    meshTreeEntries[ slot ] = MeshTreeEntry();
+    renderListEntries[ slot ] = RenderListEntry();
+    freeGameObjectSlots.push_back( slot );
+    areComponentListsDirty = true;
+}
+
+void ae3d::Scene::RemoveRange( const std::vector< GameObject* >& gameObjectsToRemove )
+{
+    for (auto gameObject : gameObjectsToRemove)
+    {
+        Remove( gameObject );
     }
 }
 
@@ -188,27 +308,6 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
 
         if (cameraComponent->GetDepthNormalsTexture().GetID() != 0)
         {
-            std::vector< unsigned > gameObjectsWithMeshRenderer;
-            gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-            int i = -1;
-
-            for (auto gameObject : gameObjects)
-            {
-                ++i;
-
-                if (gameObject == nullptr || (gameObject->GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject->IsEnabled())
-                {
-                    continue;
-                }
-
-                auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
-
-                if (meshRenderer)
-                {
-                    gameObjectsWithMeshRenderer.push_back( i );
-                }
-            }
-
             Frustum frustum;
 
             if (cameraComponent->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
@@ -228,33 +327,30 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
             const Vec3 viewDir = Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized();
             frustum.Update( position, viewDir );
 
-            RenderDepthAndNormals( cameraComponent, view, gameObjectsWithMeshRenderer, 0, frustum );
+            RenderDepthAndNormals( cameraComponent, view, GetRenderList( cameraComponent->GetLayerMask() ), 0, frustum );
+
+            if (lightCullingMode != LightCullingMode::GPUTiled)
+            {
+                continue;
+            }
 
-#if defined( RENDERER_METAL ) || defined( RENDERER_D3D12 )
             int goWithPointLightIndex = 0;
 
-            for (auto gameObject : gameObjects)
+            ForEach< TransformComponent, PointLightComponent >( [&]( GameObject& gameObject, TransformComponent& transform, PointLightComponent& pointLight )
             {
-                if (gameObject == nullptr || (gameObject->GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject->IsEnabled())
+                if ((gameObject.GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject.IsEnabled())
                 {
-                    continue;
+                    return;
                 }
 
-                auto transform = gameObject->GetComponent< TransformComponent >();
-                auto pointLight = gameObject->GetComponent< PointLightComponent >();
-
-                if (transform && pointLight)
-                {
-                    auto worldPos = transform->GetWorldPosition();
-                    GfxDeviceGlobal::lightTiler.SetPointLightPositionAndRadius( goWithPointLightIndex, worldPos, pointLight->GetRadius());
-                    ++goWithPointLightIndex;
-                }
-            }
+                auto worldPos = transform.GetWorldPosition();
+                GfxDeviceGlobal::lightTiler.SetPointLightPositionAndRadius( goWithPointLightIndex, worldPos, pointLight.GetRadius());
+                ++goWithPointLightIndex;
+            } );
 
             GfxDeviceGlobal::lightTiler.UpdateLightBuffers();
             GfxDeviceGlobal::lightTiler.CullLights( renderer.builtinShaders.lightCullShader, cameraComponent->GetProjection(),
                                                     view, cameraComponent->GetDepthNormalsTexture() );
-#endif
         }
     }
 
@@ -263,42 +359,42 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
 
 void ae3d::Scene::Render()
 {
-#if RENDERER_OPENGL
+#if RENDERER_OPENGL || RENDERER_NULL
     Statistics::BeginFrameTimeProfiling();
 #endif
 #if RENDERER_VULKAN
     GfxDevice::BeginFrame();
 #endif
-    GenerateAABB();
 #if RENDERER_D3D12
     GfxDevice::ResetCommandList();
 #endif
     Statistics::ResetFrameStatistics();
     TransformComponent::UpdateLocalMatrices();
+    UpdateMeshTree();
+    GenerateAABB();
 
     std::vector< GameObject* > rtCameras;
-    rtCameras.reserve( gameObjects.size() / 4 );
     std::vector< GameObject* > cameras;
-    cameras.reserve( gameObjects.size() / 4 );
-    
-    for (auto gameObject : gameObjects)
+
+    ForEach< CameraComponent, TransformComponent >( [&]( GameObject& gameObject, CameraComponent& cameraComponent, TransformComponent& )
     {
-        if (gameObject == nullptr || !gameObject->IsEnabled())
+        if (!gameObject.IsEnabled())
         {
-            continue;
+            return;
         }
 
-        auto cameraComponent = gameObject->GetComponent<CameraComponent>();
-        
-        if (cameraComponent && cameraComponent->GetTargetTexture() != nullptr && gameObject->GetComponent<TransformComponent>())
+        if (cameraComponent.GetTargetTexture() != nullptr)
         {
-            rtCameras.push_back( gameObject );
+            rtCameras.push_back( &gameObject );
         }
-        if (cameraComponent && cameraComponent->GetTargetTexture() == nullptr && gameObject->GetComponent<TransformComponent>())
+        else
         {
-            cameras.push_back( gameObject );
+            cameras.push_back( &gameObject );
         }
-    }
+    } );
+
+    std::vector< GameObject* > lights;
+    GetGameObjectsWithAnyComponent( GameObject::GetTypeMask< DirectionalLightComponent, SpotLightComponent, PointLightComponent >(), lights );
 #if RENDERER_VULKAN
     if (cameras.empty())
     {
@@ -378,9 +474,9 @@ void ae3d::Scene::Render()
             // Shadow pass
             Material::SetGlobalInt( "_LightType", 0 );
 
-            for (auto go : gameObjects)
+            for (auto go : lights)
             {
-                if (!go || !go->IsEnabled())
+                if (!go->IsEnabled())
                 {
                     continue;
                 }
@@ -545,6 +641,35 @@ void ae3d::Scene::Render()
 #endif
 }
 
+void ae3d::Scene::AssignClusteredLights( CameraComponent* camera, float fovDegrees, const Matrix44& view )
+{
+    LightClusterer& clusterer = SceneGlobal::lightClusterer;
+    clusterer.SetPerspective( fovDegrees, camera->GetAspect(), camera->GetNear(), camera->GetFar() );
+    clusterer.ClearLights();
+
+    ForEach< TransformComponent, PointLightComponent >( [&]( GameObject& gameObject, TransformComponent& transform, PointLightComponent& pointLight )
+    {
+        if ((gameObject.GetLayer() & camera->GetLayerMask()) != 0 && gameObject.IsEnabled())
+        {
+            clusterer.AddPointLight( transform.GetWorldPosition(), pointLight.GetRadius(), pointLight.GetColor() );
+        }
+    } );
+
+    ForEach< TransformComponent, SpotLightComponent >( [&]( GameObject& gameObject, TransformComponent& transform, SpotLightComponent& spotLight )
+    {
+        if ((gameObject.GetLayer() & camera->GetLayerMask()) != 0 && gameObject.IsEnabled())
+        {
+            // GetViewDirection points back from the light like a camera's view direction, see _LightDirection in spot light shaders.
+            clusterer.AddSpotLight( transform.GetWorldPosition(), -transform.GetViewDirection(), spotLight.GetRadius(), spotLight.GetConeAngle(), spotLight.GetColor() );
+        }
+    } );
+
+    clusterer.AssignLights( view );
+#if RENDERER_OPENGL || RENDERER_NULL
+    GfxDevice::UploadLightClusters( clusterer );
+#endif
+}
+
 void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName )
 {
     ae3d::System::Assert( 0 <= cubeMapFace && cubeMapFace < 6, "invalid cube map face" );
@@ -632,15 +757,17 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     const Vec3 viewDir = Vec3( view.m[2], view.m[6], view.m[10] ).Normalized();
     frustum.Update( position, viewDir );
 
-    std::vector< unsigned > gameObjectsWithMeshRenderer;
-    gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-    int i = -1;
-    
-    for (auto gameObject : gameObjects)
+    if (lightCullingMode == LightCullingMode::CPUClustered && camera->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
     {
-        ++i;
-        
-        if (gameObject == nullptr || (gameObject->GetLayer() & camera->GetLayerMask()) == 0 || !gameObject->IsEnabled())
+        AssignClusteredLights( camera, fovDegrees, view );
+    }
+
+    std::vector< GameObject* > gameObjectsWith2DRenderer;
+    GetGameObjectsWithAnyComponent( GameObject::GetTypeMask< SpriteRendererComponent, TextRendererComponent >(), gameObjectsWith2DRenderer );
+
+    for (auto gameObject : gameObjectsWith2DRenderer)
+    {
+        if ((gameObject->GetLayer() & camera->GetLayerMask()) == 0 || !gameObject->IsEnabled())
         {
             continue;
         }
@@ -663,51 +790,345 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
             Matrix44::Multiply( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, camera->GetProjection(), projectionModel );
             textRenderer->Render( projectionModel.m );
         }
-        
-        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+    }
+
+    const RenderList& renderList = GetRenderList( camera->GetLayerMask() );
+    const std::vector< GameObject* >& gameObjectsWithMeshRenderer = renderList.gameObjects;
 
-        if (meshRenderer)
+#if RENDERER_OPENGL || RENDERER_NULL
+    const bool isGpuCulling = cullingMode != CullingMode::CPU;
+#else
+    const bool isGpuCulling = false;
+#endif
+
+    // Opaque draw-indirect draws are culled on the GPU, so the CPU's mesh and sub-mesh results are ignored.
+    auto isSubMeshGpuCulled = [isGpuCulling]( const MeshRendererComponent* meshRenderer, std::size_t subMeshIndex )
+    {
+        Material* material = meshRenderer->materials[ subMeshIndex ];
+        return isGpuCulling && material != nullptr && material->IsValidShader() && material->GetShader()->IsDrawIndirect() &&
+               !meshRenderer->IsSubMeshTransparent( static_cast< int >( subMeshIndex ) );
+    };
+
+    QueryRenderList( frustum, renderList );
+
+    // In GPU culling mode the CPU culls only game objects that have other draws. Draw items of the rest come straight from the render list.
+    // CompareCPUAndGPU culls everything on the CPU too, because it compares the visible counts.
+    if (isGpuCulling && cullingMode != CullingMode::CompareCPUAndGPU)
+    {
+        std::size_t cpuCulledCount = 0;
+
+        for (std::size_t i = 0; i < queriedGameObjects.size(); ++i)
         {
-            gameObjectsWithMeshRenderer.push_back( i );
+            const auto* meshRenderer = queriedGameObjects[ i ]->GetComponent< MeshRendererComponent >();
+            bool hasCpuCulledSubMesh = false;
+
+            for (std::size_t subMeshIndex = 0; subMeshIndex < meshRenderer->isSubMeshCulled.size() && !hasCpuCulledSubMesh; ++subMeshIndex)
+            {
+                hasCpuCulledSubMesh = !isSubMeshGpuCulled( meshRenderer, subMeshIndex );
+            }
+
+            if (hasCpuCulledSubMesh)
+            {
+                queriedGameObjects[ cpuCulledCount ] = queriedGameObjects[ i ];
+                queriedIndices[ cpuCulledCount ] = queriedIndices[ i ];
+                ++cpuCulledCount;
+            }
         }
+
+        queriedGameObjects.resize( cpuCulledCount );
+        queriedIndices.resize( cpuCulledCount );
     }
 
-    auto meshSorterByMesh = [&](unsigned j, unsigned k)
+    CullMeshRenderers( frustum, queriedGameObjects, queriedVisibleMask );
+
+    if (isOcclusionCullingEnabled && camera->GetProjectionType() == CameraComponent::ProjectionType::Perspective)
     {
-        return gameObjects[ j ]->GetComponent< MeshRendererComponent >()->GetMesh() <
-               gameObjects[ k ]->GetComponent< MeshRendererComponent >()->GetMesh();
-    };
+        Matrix44 viewProjection;
+        Matrix44::Multiply( view, camera->GetProjection(), viewProjection );
+        CullOccludedMeshRenderers( viewProjection, queriedGameObjects, queriedVisibleMask );
+    }
 
-    std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
-    
-    for (auto j : gameObjectsWithMeshRenderer)
+    ScatterQueriedVisibleMask( renderList, visibleMask );
+
+    drawItems.clear();
+    RenumberFullSortKeyIds();
+
+    for (std::size_t j = 0; j < gameObjectsWithMeshRenderer.size(); ++j)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        const bool isVisible = IsVisible( visibleMask, j );
 
-        Matrix44 mv;
-        Matrix44 mvp;
-        Matrix44::Multiply( meshLocalToWorld, view, mv );
-        Matrix44::Multiply( mv, camera->GetProjection(), mvp );
+        if (!isVisible && !isGpuCulling)
+        {
+            continue;
+        }
+
+        auto* meshRenderer = gameObjectsWithMeshRenderer[ j ]->GetComponent< MeshRendererComponent >();
+        const std::uint64_t depth = QuantizeSortDepth( (meshRenderer->aabbCenterWorld - position).Length(), camera->GetFar() );
+        const std::uint64_t meshId = GetSortKeyId( meshSortKeyIds, meshRenderer->mesh ) & SortKeyMeshMask;
+
+        for (std::size_t subMeshIndex = 0; subMeshIndex < meshRenderer->isSubMeshCulled.size(); ++subMeshIndex)
+        {
+            Material* material = meshRenderer->materials[ subMeshIndex ];
+
+            if (!isSubMeshGpuCulled( meshRenderer, subMeshIndex ) && (!isVisible || meshRenderer->isSubMeshCulled[ subMeshIndex ]))
+            {
+                continue;
+            }
+
+            const std::uint64_t shaderId = GetSortKeyId( shaderSortKeyIds, material->GetShader() ) & SortKeyShaderMask;
+            const std::uint64_t materialId = GetSortKeyId( materialSortKeyIds, material ) & SortKeyMaterialMask;
+
+            DrawItem drawItem;
+            drawItem.gameObjectIndex = static_cast< unsigned >( j );
+            drawItem.subMeshIndex = static_cast< unsigned >( subMeshIndex );
 
-        auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( mv, mvp, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, MeshRendererComponent::RenderType::Opaque );
+            const std::uint64_t subMeshId = subMeshIndex & SortKeySubMeshMask;
+
+            // Opaque: grouped by state, front-to-back inside a group for early depth rejection.
+            // Transparent: back-to-front for correct blending, state only breaks ties.
+            if (meshRenderer->IsSubMeshTransparent( static_cast< int >( subMeshIndex ) ))
+            {
+                drawItem.key = (1ull << 62) | ((SortKeyDepthMask - depth) << 40) | (shaderId << 28) | (materialId << 14) | (meshId << 4) | subMeshId;
+            }
+            else
+            {
+                drawItem.key = (shaderId << 50) | (materialId << 36) | (meshId << 26) | (subMeshId << SortKeyInstanceShift) | depth;
+            }
+
+            drawItems.push_back( drawItem );
+        }
     }
 
-    for (auto j : gameObjectsWithMeshRenderer)
+    // Shader and texture changes if drawn unsorted, ie. opaque and then transparent in render list order.
+    int unsortedShaderChanges = 0;
+    int unsortedTextureBinds = 0;
+
+    for (int pass = 0; pass < 2; ++pass)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        Matrix44 mv;
-        Matrix44 mvp;
-        Matrix44::Multiply( meshLocalToWorld, view, mv );
-        Matrix44::Multiply( mv, camera->GetProjection(), mvp );
-        
-        gameObjects[ j ]->GetComponent< MeshRendererComponent >()->Render( mv, mvp, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, MeshRendererComponent::RenderType::Transparent );
+        const Shader* previousShader = nullptr;
+
+        for (const auto& drawItem : drawItems)
+        {
+            if (static_cast< int >( drawItem.key >> 62 ) != pass)
+            {
+                continue;
+            }
+
+            Material* material = gameObjectsWithMeshRenderer[ drawItem.gameObjectIndex ]->GetComponent< MeshRendererComponent >()->materials[ drawItem.subMeshIndex ];
+            unsortedShaderChanges += material->GetShader() != previousShader ? 1 : 0;
+            unsortedTextureBinds += material->GetTextureCount();
+            previousShader = material->GetShader();
+        }
+    }
+
+    RadixSortByKey( drawItems, drawItemsScratch );
+
+    // Opaque draws of the same sub-mesh and material become one instanced draw if the shader supports it.
+    // Other draws with an instanced shader are instanced draws of one, because the shader reads its model matrix from the instance data.
+    // Opaque draws of the same material in the same MeshArena page become one indirect draw if the shader supports it.
+    drawBatches.clear();
+    instanceModelMatrices.clear();
+
+    for (std::size_t i = 0; i < drawItems.size(); )
+    {
+        DrawBatch batch;
+        batch.firstItem = static_cast< unsigned >( i );
+        batch.itemCount = 1;
+
+        const MeshRendererComponent* meshRenderer = gameObjectsWithMeshRenderer[ drawItems[ i ].gameObjectIndex ]->GetComponent< MeshRendererComponent >();
+        Material* material = meshRenderer->materials[ drawItems[ i ].subMeshIndex ];
+
+#if RENDERER_OPENGL || RENDERER_NULL
+        // The shader reads its model matrix from the PerDraw block, so transparent draws are indirect draws of one.
+        if (material->GetShader()->IsDrawIndirect())
+        {
+            batch.isDrawIndirect = true;
+            const bool isOpaque = (drawItems[ i ].key >> 62) == 0;
+            const int arenaPage = meshRenderer->GetSubMesh( static_cast< int >( drawItems[ i ].subMeshIndex ) ).vertexBuffer.GetMeshArenaPage();
+
+            // Buffers outside MeshArena have their own VAO, so they are drawn alone.
+            while (isOpaque && arenaPage != -1 && i + batch.itemCount < drawItems.size())
+            {
+                const DrawItem& next = drawItems[ i + batch.itemCount ];
+                MeshRendererComponent* nextMeshRenderer = gameObjectsWithMeshRenderer[ next.gameObjectIndex ]->GetComponent< MeshRendererComponent >();
+
+                if (nextMeshRenderer->materials[ next.subMeshIndex ] != material || nextMeshRenderer->IsWireframe() != meshRenderer->IsWireframe() ||
+                    nextMeshRenderer->GetSubMesh( static_cast< int >( next.subMeshIndex ) ).vertexBuffer.GetMeshArenaPage() != arenaPage)
+                {
+                    break;
+                }
+
+                ++batch.itemCount;
+            }
+
+            drawBatches.push_back( batch );
+            i += batch.itemCount;
+            continue;
+        }
+#endif
+
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+        batch.isInstanced = material->GetShader()->IsInstanced();
+#endif
+
+        if ((drawItems[ i ].key >> 62) == 0 && batch.isInstanced)
+        {
+            while (i + batch.itemCount < drawItems.size())
+            {
+                const DrawItem& next = drawItems[ i + batch.itemCount ];
+                const MeshRendererComponent* nextMeshRenderer = gameObjectsWithMeshRenderer[ next.gameObjectIndex ]->GetComponent< MeshRendererComponent >();
+
+                // Compares pointers too because ids are truncated in keys.
+                if ((next.key >> SortKeyInstanceShift) != (drawItems[ i ].key >> SortKeyInstanceShift) || next.subMeshIndex != drawItems[ i ].subMeshIndex ||
+                    nextMeshRenderer->mesh != meshRenderer->mesh || nextMeshRenderer->materials[ next.subMeshIndex ] != material)
+                {
+                    break;
+                }
+
+                ++batch.itemCount;
+            }
+        }
+
+        if (batch.isInstanced)
+        {
+            batch.firstInstance = static_cast< unsigned >( instanceModelMatrices.size() );
+
+            for (unsigned itemIndex = batch.firstItem; itemIndex < batch.firstItem + batch.itemCount; ++itemIndex)
+            {
+                auto transform = gameObjectsWithMeshRenderer[ drawItems[ itemIndex ].gameObjectIndex ]->GetComponent< TransformComponent >();
+                instanceModelMatrices.push_back( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity );
+            }
+        }
+
+        drawBatches.push_back( batch );
+        i += batch.itemCount;
+    }
+
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+    if (!instanceModelMatrices.empty())
+    {
+        GfxDevice::UploadInstanceData( &instanceModelMatrices[ 0 ].m[ 0 ], static_cast< int >( instanceModelMatrices.size() ) );
+    }
+
+    Matrix44 viewProjection;
+    Matrix44::Multiply( view, camera->GetProjection(), viewProjection );
+
+    Matrix44 shadowViewProjection;
+    Matrix44::Multiply( SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, shadowViewProjection );
+    Matrix44::Multiply( shadowViewProjection, Matrix44::bias, shadowViewProjection );
+#endif
+
+#if RENDERER_OPENGL || RENDERER_NULL
+    float frustumPlanes[ 24 ];
+    frustum.GetPlanes( frustumPlanes );
+#endif
+
+    int sortedShaderChanges = 0;
+    int sortedTextureBinds = 0;
+    const Shader* previousShader = nullptr;
+    const Material* previousMaterial = nullptr;
+    unsigned previousGameObjectIndex = ~0u;
+    Matrix44 meshLocalToWorld;
+    Matrix44 mv;
+    Matrix44 mvp;
+
+    for (const auto& batch : drawBatches)
+    {
+        const DrawItem& drawItem = drawItems[ batch.firstItem ];
+        GameObject* gameObject = gameObjectsWithMeshRenderer[ drawItem.gameObjectIndex ];
+        auto* meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+
+        Material* material = meshRenderer->materials[ drawItem.subMeshIndex ];
+        // Textures are still bound if the previous draw used the same material.
+        const bool bindTextures = material != previousMaterial;
+
+        sortedShaderChanges += material->GetShader() != previousShader ? 1 : 0;
+        sortedTextureBinds += bindTextures ? material->GetTextureCount() : 0;
+        previousShader = material->GetShader();
+        previousMaterial = material;
+
+#if RENDERER_OPENGL || RENDERER_NULL
+        if (batch.isDrawIndirect)
+        {
+            // Transparent draws were culled on the CPU when their draw items were created.
+            const bool isBatchGpuCulled = isGpuCulling && (drawItem.key >> 62) == 0;
+            indirectVertexBuffers.clear();
+            indirectModelMatrices.clear();
+            indirectLocalBounds.clear();
+            int cpuVisibleCount = 0;
+
+            for (unsigned itemIndex = batch.firstItem; itemIndex < batch.firstItem + batch.itemCount; ++itemIndex)
+            {
+                const DrawItem& item = drawItems[ itemIndex ];
+                GameObject* itemGameObject = gameObjectsWithMeshRenderer[ item.gameObjectIndex ];
+                auto transform = itemGameObject->GetComponent< TransformComponent >();
+                MeshRendererComponent* itemMeshRenderer = itemGameObject->GetComponent< MeshRendererComponent >();
+                SubMesh& subMesh = itemMeshRenderer->GetSubMesh( static_cast< int >( item.subMeshIndex ) );
+                indirectVertexBuffers.push_back( &subMesh.vertexBuffer );
+                indirectModelMatrices.push_back( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity );
+
+                if (isBatchGpuCulled)
+                {
+                    const float bounds[ 6 ] = { subMesh.aabbMin.x, subMesh.aabbMin.y, subMesh.aabbMin.z, subMesh.aabbMax.x, subMesh.aabbMax.y, subMesh.aabbMax.z };
+                    indirectLocalBounds.insert( indirectLocalBounds.end(), bounds, bounds + 6 );
+                    cpuVisibleCount += (IsVisible( visibleMask, item.gameObjectIndex ) && !itemMeshRenderer->isSubMeshCulled[ item.subMeshIndex ]) ? 1 : 0;
+                }
+            }
+
+            if (!isBatchGpuCulled)
+            {
+                meshRenderer->RenderSubMeshesIndirect( static_cast< int >( drawItem.subMeshIndex ), indirectVertexBuffers.data(), indirectModelMatrices.data(),
+                                                       static_cast< int >( batch.itemCount ), viewProjection, shadowViewProjection, bindTextures );
+                continue;
+            }
+
+            const bool isComparing = cullingMode == CullingMode::CompareCPUAndGPU;
+            int gpuVisibleCount = 0;
+            meshRenderer->RenderSubMeshesIndirect( static_cast< int >( drawItem.subMeshIndex ), indirectVertexBuffers.data(), indirectModelMatrices.data(),
+                                                   static_cast< int >( batch.itemCount ), viewProjection, shadowViewProjection, bindTextures,
+                                                   &renderer.builtinShaders.frustumCullShader, indirectLocalBounds.data(), frustumPlanes,
+                                                   isComparing ? &gpuVisibleCount : nullptr );
+
+            if (isComparing)
+            {
+                Statistics::IncCpuVisibleDraws( cpuVisibleCount );
+                Statistics::IncGpuVisibleDraws( gpuVisibleCount );
+
+                if (cpuVisibleCount != gpuVisibleCount)
+                {
+                    System::Print( "GPU culling found %d of %d draws visible, CPU culling %d\n", gpuVisibleCount, batch.itemCount, cpuVisibleCount );
+                }
+            }
+
+            continue;
+        }
+#endif
+
+        if (batch.isInstanced)
+        {
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+            meshRenderer->RenderSubMeshInstanced( static_cast< int >( drawItem.subMeshIndex ), viewProjection, shadowViewProjection,
+                                                  static_cast< int >( batch.firstInstance ), static_cast< int >( batch.itemCount ), bindTextures );
+#endif
+            continue;
+        }
+
+        if (drawItem.gameObjectIndex != previousGameObjectIndex)
+        {
+            auto transform = gameObject->GetComponent< TransformComponent >();
+            meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+            Matrix44::Multiply( meshLocalToWorld, view, mv );
+            Matrix44::Multiply( mv, camera->GetProjection(), mvp );
+            previousGameObjectIndex = drawItem.gameObjectIndex;
+        }
+
+        meshRenderer->RenderSubMesh( static_cast< int >( drawItem.subMeshIndex ), mv, mvp, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix,
+                                     SceneGlobal::shadowCameraProjectionMatrix, nullptr, bindTextures );
     }
 
+    Statistics::IncShaderBindsSaved( unsortedShaderChanges - sortedShaderChanges );
+    Statistics::IncTextureBindsSaved( unsortedTextureBinds - sortedTextureBinds );
+
     GfxDevice::PopGroupMarker();
 
 #if RENDERER_METAL
@@ -716,7 +1137,7 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     GfxDevice::ErrorCheck( "Scene render after rendering" );
 }
 
-void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44& view, std::vector< unsigned > gameObjectsWithMeshRenderer,
+void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44& view, const RenderList& renderList,
                                          int cubeMapFace, const Frustum& frustum )
 {
 #if RENDERER_METAL
@@ -728,9 +1149,17 @@ void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44
 #endif
     GfxDevice::PushGroupMarker( "DepthNormal" );
 
-    for (auto j : gameObjectsWithMeshRenderer)
+    const std::vector< GameObject* >& gameObjectsWithMeshRenderer = renderList.gameObjects;
+    CullRenderList( frustum, renderList, visibleMask );
+
+    for (std::size_t j = 0; j < gameObjectsWithMeshRenderer.size(); ++j)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
+        if (!IsVisible( visibleMask, j ))
+        {
+            continue;
+        }
+
+        auto transform = gameObjectsWithMeshRenderer[ j ]->GetComponent< TransformComponent >();
         auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
         
         Matrix44 mv;
@@ -738,9 +1167,8 @@ void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44
         Matrix44::Multiply( meshLocalToWorld, view, mv );
         Matrix44::Multiply( mv, camera->GetProjection(), mvp );
         
-        auto meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
+        auto meshRenderer = gameObjectsWithMeshRenderer[ j ]->GetComponent< MeshRendererComponent >();
 
-        meshRenderer->Cull( frustum, meshLocalToWorld );
         meshRenderer->Render( mv, mvp, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader, MeshRendererComponent::RenderType::Opaque );
         meshRenderer->Render( mv, mvp, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader, MeshRendererComponent::RenderType::Transparent );
     }
@@ -801,37 +1229,20 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
     const Vec3 viewDir = Vec3( view.m[2], view.m[6], view.m[10] ).Normalized();
     frustum.Update( cameraTransform->GetLocalPosition(), viewDir );
     
-    std::vector< unsigned > gameObjectsWithMeshRenderer;
-    gameObjectsWithMeshRenderer.reserve( gameObjects.size() );
-    int i = -1;
-    
-    for (auto gameObject : gameObjects)
-    {
-        ++i;
-        
-        if (gameObject == nullptr)
-        {
-            continue;
-        }
-        
-        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
-        
-        if (meshRenderer)
-        {
-            gameObjectsWithMeshRenderer.push_back( i );
-        }
-    }
-    
-    auto meshSorterByMesh = [&](unsigned j, unsigned k)
-    {
-        return gameObjects[ j ]->GetComponent< MeshRendererComponent >()->GetMesh() <
-               gameObjects[ k ]->GetComponent< MeshRendererComponent >()->GetMesh();
-    };
-    std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
+    // Shadow casters are not filtered by layer.
+    const RenderList& renderList = GetRenderList( ~0u );
+    const std::vector< GameObject* >& gameObjectsWithMeshRenderer = renderList.gameObjects;
+
+    CullRenderList( frustum, renderList, visibleMask );
     
-    for (auto j : gameObjectsWithMeshRenderer)
+    for (std::size_t j = 0; j < gameObjectsWithMeshRenderer.size(); ++j)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
+        if (!IsVisible( visibleMask, j ))
+        {
+            continue;
+        }
+
+        auto transform = gameObjectsWithMeshRenderer[ j ]->GetComponent< TransformComponent >();
         auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
         
         Matrix44 mv;
@@ -839,9 +1250,8 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
         Matrix44::Multiply( meshLocalToWorld, view, mv );
         Matrix44::Multiply( mv, camera->GetProjection(), mvp );
 
-        auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
+        auto* meshRenderer = gameObjectsWithMeshRenderer[ j ]->GetComponent< MeshRendererComponent >();
 
-        meshRenderer->Cull( frustum, meshLocalToWorld );
         meshRenderer->Render( mv, mvp, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.momentsShader, MeshRendererComponent::RenderType::Opaque );
     }
 
@@ -1157,6 +1567,26 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             
             outMeshes.push_back( new Mesh() );
         }
+        else if (token == "occluder" || token == "occludee")
+        {
+            if (outGameObjects.empty() || outGameObjects.back().GetComponent< MeshRendererComponent >() == nullptr)
+            {
+                System::Print( "Failed to parse %s: found %s but there is no meshrenderer before this line.\n", serialized.path.c_str(), token.c_str() );
+                return DeserializeResult::ParseError;
+            }
+
+            int enabled;
+            lineStream >> enabled;
+
+            if (token == "occluder")
+            {
+                outGameObjects.back().GetComponent< MeshRendererComponent >()->SetOccluder( enabled != 0 );
+            }
+            else
+            {
+                outGameObjects.back().GetComponent< MeshRendererComponent >()->SetOccludee( enabled != 0 );
+            }
+        }
         else if (token == "spriterenderer")
         {
             if (outGameObjects.empty())
@@ -1186,7 +1616,7 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             lineStream >> spritePath >> x >> y >> width >> height;
 
             outTexture2Ds[ spritePath ] = new Texture2D();
-            outTexture2Ds[ spritePath ]->Load( FileSystem::FileContents( spritePath.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+            outTexture2Ds[ spritePath ]->Load( FileSystem::FileContentsView( spritePath.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
 
             outGameObjects.back().GetComponent< SpriteRendererComponent >()->SetTexture( outTexture2Ds[ spritePath ], Vec3( x, y, 0 ), Vec3( x, y, 1 ), Vec4( 1, 1, 1, 1 ) );
         }
@@ -1209,7 +1639,7 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             std::string meshFile;
             lineStream >> meshFile;
 
-            outMeshes.back()->Load( FileSystem::FileContents( meshFile.c_str() ) );
+            outMeshes.back()->Load( FileSystem::FileContentsView( meshFile.c_str() ) );
 			meshRenderer->SetMesh( outMeshes.back() );
 
             meshRenderer->SetMaterial( tempMaterial, 0 );
@@ -1276,7 +1706,7 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
             lineStream >> name >> path;
             
             outTexture2Ds[ name ] = new Texture2D();
-            outTexture2Ds[ name ]->Load( FileSystem::FileContents( path.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
+            outTexture2Ds[ name ]->Load( FileSystem::FileContentsView( path.c_str() ), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::Generate, ColorSpace::SRGB, Anisotropy::k1 );
         }
         else if (token == "material")
         {
@@ -1374,7 +1804,15 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
         {
             float radius;
             lineStream >> radius;
-            outGameObjects.back().GetComponent< PointLightComponent >()->SetRadius( radius );
+
+            if (currentLightType == CurrentLightType::Spot)
+            {
+                outGameObjects.back().GetComponent< SpotLightComponent >()->SetRadius( radius );
+            }
+            else
+            {
+                outGameObjects.back().GetComponent< PointLightComponent >()->SetRadius( radius );
+            }
         }
         else if (token == "color")
         {
@@ -1404,61 +1842,484 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
     return DeserializeResult::Success;
 }
 
-void ae3d::Scene::GenerateAABB()
+void ae3d::Scene::UpdateComponentLists()
 {
-    const float maxValue = 99999999.0f;
-    aabbMin = {  maxValue,  maxValue,  maxValue };
-    aabbMax = { -maxValue, -maxValue, -maxValue };
-    
-    for (auto& o : gameObjects)
+    if (!areComponentListsDirty && componentListsVersion == GameObject::GetComponentsVersion())
+    {
+        return;
+    }
+
+    for (auto& componentList : componentLists)
+    {
+        componentList.clear();
+    }
+
+    for (unsigned i = 0; i < static_cast< unsigned >( gameObjects.size() ); ++i)
+    {
+        unsigned componentMask = gameObjects[ i ] ? gameObjects[ i ]->GetComponentMask() : 0;
+
+        // UpdateMeshTree and UpdateRenderLists only visit game objects that still have a mesh renderer.
+        if ((componentMask & GameObject::GetTypeMask< MeshRendererComponent >()) == 0 && meshTreeEntries[ i ].proxy != AABBTree::NullProxy)
+        {
+            meshTree.Remove( meshTreeEntries[ i ].proxy );
+            meshTreeEntries[ i ].proxy = AABBTree::NullProxy;
+        }
+
+        if ((componentMask & GameObject::GetTypeMask< MeshRendererComponent >()) == 0 && renderListEntries[ i ].layer != 0)
+        {
+            SetRenderListEntry( i, nullptr, 0 );
+        }
+
+        for (int type = 0; componentMask != 0; ++type, componentMask >>= 1)
+        {
+            if ((componentMask & 1) != 0)
+            {
+                componentLists[ type ].push_back( i );
+            }
+        }
+    }
+
+    componentListsVersion = GameObject::GetComponentsVersion();
+    areComponentListsDirty = false;
+}
+
+const std::vector< unsigned >& ae3d::Scene::GetShortestComponentList( unsigned typeMask )
+{
+    UpdateComponentLists();
+
+    const std::vector< unsigned >* shortestList = nullptr;
+
+    for (int type = 0; type < GameObject::MaxComponentTypes; ++type)
+    {
+        if ((typeMask & (1u << type)) != 0 && (shortestList == nullptr || componentLists[ type ].size() < shortestList->size()))
+        {
+            shortestList = &componentLists[ type ];
+        }
+    }
+
+    System::Assert( shortestList != nullptr, "empty component type mask" );
+    return *shortestList;
+}
+
+void ae3d::Scene::GetGameObjectsWithAnyComponent( unsigned typeMask, std::vector< GameObject* >& outGameObjects )
+{
+    UpdateComponentLists();
+
+    std::vector< unsigned > indices;
+
+    for (int type = 0; type < GameObject::MaxComponentTypes; ++type)
+    {
+        if ((typeMask & (1u << type)) != 0)
+        {
+            indices.insert( std::end( indices ), std::begin( componentLists[ type ] ), std::end( componentLists[ type ] ) );
+        }
+    }
+
+    std::sort( std::begin( indices ), std::end( indices ) );
+    indices.erase( std::unique( std::begin( indices ), std::end( indices ) ), std::end( indices ) );
+
+    outGameObjects.reserve( outGameObjects.size() + indices.size() );
+
+    for (unsigned index : indices)
+    {
+        outGameObjects.push_back( gameObjects[ index ] );
+    }
+}
+
+void ae3d::Scene::UpdateMeshTree()
+{
+    UpdateComponentLists();
+
+    for (unsigned i : componentLists[ MeshRendererComponent::Type() ])
     {
-        if (!o)
+        MeshTreeEntry& entry = meshTreeEntries[ i ];
+        auto meshRenderer = gameObjects[ i ]->GetComponent< MeshRendererComponent >();
+        Mesh* mesh = meshRenderer ? meshRenderer->GetMesh() : nullptr;
+
+        if (mesh != nullptr)
         {
+            meshRenderer->UpdateSubMeshArrays();
+        }
+
+        if (mesh == nullptr)
+        {
+            if (entry.proxy != AABBTree::NullProxy)
+            {
+                meshTree.Remove( entry.proxy );
+                entry.proxy = AABBTree::NullProxy;
+            }
+
             continue;
         }
 
-        auto meshRenderer = o->GetComponent< ae3d::MeshRendererComponent >();
-        auto meshTransform = o->GetComponent< ae3d::TransformComponent >();
+        auto transform = gameObjects[ i ]->GetComponent< TransformComponent >();
+        const Matrix44& localToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
 
-        if (meshRenderer == nullptr || meshTransform == nullptr)
+        if (entry.proxy != AABBTree::NullProxy && entry.mesh == mesh && entry.meshContentVersion == mesh->GetContentVersion() &&
+            std::memcmp( &entry.localToWorld, &localToWorld, sizeof( Matrix44 ) ) == 0)
         {
             continue;
         }
-        
-        Vec3 oAABBmin = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMin() : Vec3( -1, -1, -1 );
-        Vec3 oAABBmax = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMax() : Vec3(  1,  1,  1 );
-        
-        Matrix44::TransformPoint( oAABBmin, meshTransform->GetLocalToWorldMatrix(), &oAABBmin );
-        Matrix44::TransformPoint( oAABBmax, meshTransform->GetLocalToWorldMatrix(), &oAABBmax );
-        
-        if (oAABBmin.x < aabbMin.x)
+
+        MathUtil::TransformAABB( mesh->GetAABBMin(), mesh->GetAABBMax(), localToWorld, meshRenderer->aabbCenterWorld, meshRenderer->aabbExtentWorld );
+
+        const Vec3 aabbMinWorld = meshRenderer->aabbCenterWorld - meshRenderer->aabbExtentWorld;
+        const Vec3 aabbMaxWorld = meshRenderer->aabbCenterWorld + meshRenderer->aabbExtentWorld;
+
+        if (entry.proxy == AABBTree::NullProxy)
         {
-            aabbMin.x = oAABBmin.x;
+            // Queries map the slot to render lists' indices.
+            entry.proxy = meshTree.Insert( aabbMinWorld, aabbMaxWorld, reinterpret_cast< void* >( static_cast< std::uintptr_t >( i ) ) );
         }
-        
-        if (oAABBmin.y < aabbMin.y)
+        else
         {
-            aabbMin.y = oAABBmin.y;
+            meshTree.Refit( entry.proxy, aabbMinWorld, aabbMaxWorld );
         }
-        
-        if (oAABBmin.z < aabbMin.z)
+
+        entry.mesh = mesh;
+        entry.meshContentVersion = mesh->GetContentVersion();
+        entry.localToWorld = localToWorld;
+    }
+}
+
+unsigned ae3d::Scene::GetSortKeyId( std::unordered_map< const void*, unsigned >& ids, const void* pointer )
+{
+    auto it = ids.find( pointer );
+
+    if (it != ids.end())
+    {
+        return it->second;
+    }
+
+    const unsigned id = static_cast< unsigned >( ids.size() );
+    ids[ pointer ] = id;
+    return id;
+}
+
+void ae3d::Scene::RenumberFullSortKeyIds()
+{
+    // Keys are built from scratch for each camera, so renumbering between cameras doesn't mix ids.
+    if (shaderSortKeyIds.size() > SortKeyShaderMask)
+    {
+        shaderSortKeyIds.clear();
+    }
+
+    if (materialSortKeyIds.size() > SortKeyMaterialMask)
+    {
+        materialSortKeyIds.clear();
+    }
+
+    if (meshSortKeyIds.size() > SortKeyMeshMask)
+    {
+        meshSortKeyIds.clear();
+    }
+}
+
+const unsigned ae3d::Scene::RenderList::NotListed;
+
+const ae3d::Scene::RenderList& ae3d::Scene::GetRenderList( unsigned layerMask )
+{
+    UpdateRenderLists();
+
+    const auto renderListIterator = renderLists.find( layerMask );
+
+    if (renderListIterator != std::end( renderLists ))
+    {
+        return renderListIterator->second;
+    }
+
+    RenderList& renderList = renderLists[ layerMask ];
+
+    for (unsigned slot = 0; slot < static_cast< unsigned >( renderListEntries.size() ); ++slot)
+    {
+        if ((renderListEntries[ slot ].layer & layerMask) != 0)
         {
-            aabbMin.z = oAABBmin.z;
+            renderList.slots.push_back( slot );
         }
-        
-        if (oAABBmax.x > aabbMax.x)
+    }
+
+    auto meshSorterByMesh = [&](unsigned j, unsigned k)
+    {
+        return renderListEntries[ j ].mesh < renderListEntries[ k ].mesh;
+    };
+
+    std::sort( std::begin( renderList.slots ), std::end( renderList.slots ), meshSorterByMesh );
+
+    renderList.indexBySlot.assign( gameObjects.size(), RenderList::NotListed );
+
+    for (unsigned slot : renderList.slots)
+    {
+        renderList.indexBySlot[ slot ] = static_cast< unsigned >( renderList.gameObjects.size() );
+        renderList.gameObjects.push_back( gameObjects[ slot ] );
+    }
+
+    return renderList;
+}
+
+void ae3d::Scene::UpdateRenderLists()
+{
+    const bool isHierarchyChanged = renderListsHierarchyVersion != GameObject::hierarchyVersion;
+
+    if (!areRenderListsDirty && !isHierarchyChanged && renderListsRenderStateVersion == GameObject::renderStateVersion)
+    {
+        return;
+    }
+
+    // Removes game objects that lost their mesh renderer.
+    UpdateComponentLists();
+
+    for (unsigned slot : componentLists[ MeshRendererComponent::Type() ])
+    {
+        const GameObject* gameObject = gameObjects[ slot ];
+        RenderListEntry& entry = renderListEntries[ slot ];
+
+        // A hierarchy change can change any game object's IsEnabled.
+        if (entry.isUpToDate && entry.renderStateChange == gameObject->renderStateChange && !isHierarchyChanged)
         {
-            aabbMax.x = oAABBmax.x;
+            continue;
         }
-        
-        if (oAABBmax.y > aabbMax.y)
+
+        Mesh* mesh = gameObject->GetComponent< MeshRendererComponent >()->GetMesh();
+        const bool isRendered = mesh != nullptr && gameObject->IsEnabled();
+        SetRenderListEntry( slot, isRendered ? mesh : nullptr, isRendered ? gameObject->GetLayer() : 0 );
+        entry.renderStateChange = gameObject->renderStateChange;
+        entry.isUpToDate = true;
+    }
+
+    renderListsRenderStateVersion = GameObject::renderStateVersion;
+    renderListsHierarchyVersion = GameObject::hierarchyVersion;
+    areRenderListsDirty = false;
+}
+
+void ae3d::Scene::SetRenderListEntry( unsigned slot, Mesh* mesh, unsigned layer )
+{
+    RenderListEntry& entry = renderListEntries[ slot ];
+
+    if (entry.mesh == mesh && entry.layer == layer)
+    {
+        return;
+    }
+
+    // A changed mesh moves the game object to its new position in the lists it stays in.
+    for (auto& layerMaskAndList : renderLists)
+    {
+        if ((entry.layer & layerMaskAndList.first) != 0 && (entry.mesh != mesh || (layer & layerMaskAndList.first) == 0))
         {
-            aabbMax.y = oAABBmax.y;
+            RemoveFromRenderList( layerMaskAndList.second, slot );
         }
-        
-        if (oAABBmax.z > aabbMax.z)
+    }
+
+    const Mesh* oldMesh = entry.mesh;
+    const unsigned oldLayer = entry.layer;
+    entry.mesh = mesh;
+    entry.layer = layer;
+
+    for (auto& layerMaskAndList : renderLists)
+    {
+        if ((layer & layerMaskAndList.first) != 0 && (oldMesh != mesh || (oldLayer & layerMaskAndList.first) == 0))
+        {
+            InsertIntoRenderList( layerMaskAndList.second, slot );
+        }
+    }
+}
+
+void ae3d::Scene::InsertIntoRenderList( RenderList& renderList, unsigned slot )
+{
+    const Mesh* mesh = renderListEntries[ slot ].mesh;
+    const auto position = std::upper_bound( std::begin( renderList.slots ), std::end( renderList.slots ), mesh,
+                                            [&]( const Mesh* aMesh, unsigned listedSlot ) { return aMesh < renderListEntries[ listedSlot ].mesh; } );
+    const std::size_t index = static_cast< std::size_t >( position - std::begin( renderList.slots ) );
+
+    renderList.slots.insert( position, slot );
+    renderList.gameObjects.insert( std::begin( renderList.gameObjects ) + index, gameObjects[ slot ] );
+
+    if (renderList.indexBySlot.size() < gameObjects.size())
+    {
+        renderList.indexBySlot.resize( gameObjects.size(), RenderList::NotListed );
+    }
+
+    for (std::size_t i = index; i < renderList.slots.size(); ++i)
+    {
+        renderList.indexBySlot[ renderList.slots[ i ] ] = static_cast< unsigned >( i );
+    }
+}
+
+void ae3d::Scene::RemoveFromRenderList( RenderList& renderList, unsigned slot )
+{
+    const std::size_t index = renderList.indexBySlot[ slot ];
+
+    renderList.slots.erase( std::begin( renderList.slots ) + index );
+    renderList.gameObjects.erase( std::begin( renderList.gameObjects ) + index );
+    renderList.indexBySlot[ slot ] = RenderList::NotListed;
+
+    for (std::size_t i = index; i < renderList.slots.size(); ++i)
+    {
+        renderList.indexBySlot[ renderList.slots[ i ] ] = static_cast< unsigned >( i );
+    }
+}
+
+void ae3d::Scene::QueryRenderList( const Frustum& frustum, const RenderList& renderList )
+{
+    meshTreeQueryResult.clear();
+    meshTree.Query( frustum, meshTreeQueryResult );
+    queriedGameObjects.clear();
+    queriedIndices.clear();
+
+    // The tree has every mesh renderer in the scene, so disabled ones and other layers are filtered out by the render list.
+    for (void* userData : meshTreeQueryResult)
+    {
+        const std::uintptr_t slot = reinterpret_cast< std::uintptr_t >( userData );
+        const unsigned index = slot < renderList.indexBySlot.size() ? renderList.indexBySlot[ slot ] : RenderList::NotListed;
+
+        if (index != RenderList::NotListed)
+        {
+            queriedGameObjects.push_back( renderList.gameObjects[ index ] );
+            queriedIndices.push_back( index );
+        }
+    }
+}
+
+void ae3d::Scene::ScatterQueriedVisibleMask( const RenderList& renderList, std::vector< std::uint32_t >& outVisibleMask ) const
+{
+    outVisibleMask.assign( (renderList.gameObjects.size() + 31) / 32, 0 );
+
+    for (std::size_t i = 0; i < queriedIndices.size(); ++i)
+    {
+        if (IsVisible( queriedVisibleMask, i ))
+        {
+            outVisibleMask[ queriedIndices[ i ] >> 5 ] |= 1u << (queriedIndices[ i ] & 31);
+        }
+    }
+}
+
+void ae3d::Scene::CullRenderList( const Frustum& frustum, const RenderList& renderList, std::vector< std::uint32_t >& outVisibleMask )
+{
+    QueryRenderList( frustum, renderList );
+    CullMeshRenderers( frustum, queriedGameObjects, queriedVisibleMask );
+    ScatterQueriedVisibleMask( renderList, outVisibleMask );
+}
+
+void ae3d::Scene::CullMeshRenderers( const Frustum& frustum, const std::vector< GameObject* >& gameObjectsWithMeshRenderer, std::vector< std::uint32_t >& outVisibleMask )
+{
+    const std::size_t count = gameObjectsWithMeshRenderer.size();
+    cullBounds.resize( count * 6 );
+    float* centerX = cullBounds.data();
+    float* centerY = centerX + count;
+    float* centerZ = centerY + count;
+    float* extentX = centerZ + count;
+    float* extentY = extentX + count;
+    float* extentZ = extentY + count;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const MeshRendererComponent* meshRenderer = gameObjectsWithMeshRenderer[ i ]->GetComponent< MeshRendererComponent >();
+        centerX[ i ] = meshRenderer->aabbCenterWorld.x;
+        centerY[ i ] = meshRenderer->aabbCenterWorld.y;
+        centerZ[ i ] = meshRenderer->aabbCenterWorld.z;
+        extentX[ i ] = meshRenderer->aabbExtentWorld.x;
+        extentY[ i ] = meshRenderer->aabbExtentWorld.y;
+        extentZ[ i ] = meshRenderer->aabbExtentWorld.z;
+    }
+
+    outVisibleMask.resize( (count + 31) / 32 );
+    frustum.BoxesInFrustum( centerX, centerY, centerZ, extentX, extentY, extentZ, static_cast< int >( count ), outVisibleMask.data() );
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto meshRenderer = gameObjectsWithMeshRenderer[ i ]->GetComponent< MeshRendererComponent >();
+        meshRenderer->isCulled = !IsVisible( outVisibleMask, i );
+
+        if (!meshRenderer->isCulled)
+        {
+            auto transform = gameObjectsWithMeshRenderer[ i ]->GetComponent< TransformComponent >();
+            meshRenderer->CullSubMeshes( frustum, transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity );
+        }
+    }
+}
+
+void ae3d::Scene::CullOccludedMeshRenderers( const Matrix44& viewProjection, const std::vector< GameObject* >& gameObjectsWithMeshRenderer,
+                                              std::vector< std::uint32_t >& inOutVisibleMask )
+{
+    OcclusionCuller& culler = SceneGlobal::occlusionCuller;
+    culler.Clear();
+
+    const std::size_t count = gameObjectsWithMeshRenderer.size();
+    // Occluders are drawn anyway, so only occludees are tested.
+    std::vector< std::uint32_t > occludeeMask( inOutVisibleMask.size() );
+    bool hasOccluders = false;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto meshRenderer = gameObjectsWithMeshRenderer[ i ]->GetComponent< MeshRendererComponent >();
+
+        if (!IsVisible( inOutVisibleMask, i ))
+        {
+            continue;
+        }
+
+        if (meshRenderer->IsOccludee() && !meshRenderer->IsOccluder())
+        {
+            occludeeMask[ i >> 5 ] |= 1u << (i & 31);
+        }
+
+        if (!meshRenderer->IsOccluder())
+        {
+            continue;
+        }
+
+        auto transform = gameObjectsWithMeshRenderer[ i ]->GetComponent< TransformComponent >();
+        Matrix44 localToClip;
+        Matrix44::Multiply( transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, viewProjection, localToClip );
+
+        for (std::size_t subMeshIndex = 0; subMeshIndex < meshRenderer->isSubMeshCulled.size(); ++subMeshIndex)
+        {
+            const OccluderGeometry* geometry = meshRenderer->GetSubMesh( static_cast< int >( subMeshIndex ) ).occluderGeometry.get();
+
+            if (!meshRenderer->isSubMeshCulled[ subMeshIndex ] && geometry != nullptr && !geometry->faces.empty())
+            {
+                culler.AddOccluder( geometry->positions.data(), &geometry->faces[ 0 ].a, static_cast< int >( geometry->faces.size() ), localToClip );
+                hasOccluders = true;
+            }
+        }
+    }
+
+    if (!hasOccluders)
+    {
+        return;
+    }
+
+    culler.RasterizeOccluders();
+
+    // CullMeshRenderers left the world bounds in cullBounds.
+    const float* centerX = cullBounds.data();
+    const std::vector< std::uint32_t > testedMask = occludeeMask;
+    const int occludedCount = culler.CullBoxes( centerX, centerX + count, centerX + 2 * count, centerX + 3 * count, centerX + 4 * count, centerX + 5 * count,
+                                                static_cast< int >( count ), viewProjection, occludeeMask.data() );
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (IsVisible( testedMask, i ) && !IsVisible( occludeeMask, i ))
         {
-            aabbMax.z = oAABBmax.z;
+            inOutVisibleMask[ i >> 5 ] &= ~(1u << (i & 31));
+            gameObjectsWithMeshRenderer[ i ]->GetComponent< MeshRendererComponent >()->isCulled = true;
         }
     }
+
+    Statistics::IncOccludedMeshes( occludedCount );
+}
+
+bool ae3d::Scene::WriteOcclusionDepthImage( const char* path ) const
+{
+    return SceneGlobal::occlusionCuller.WriteDepthImage( path );
+}
+
+void ae3d::Scene::GenerateAABB()
+{
+    // Tree's root contains every mesh renderer's bounds, so the scene doesn't need to be walked.
+    if (!meshTree.GetBounds( aabbMin, aabbMax ))
+    {
+        const float maxValue = 99999999.0f;
+        aabbMin = {  maxValue,  maxValue,  maxValue };
+        aabbMax = { -maxValue, -maxValue, -maxValue };
+    }
 }
@@ -8,17 +8,25 @@ namespace Statistics
     int fenceCalls = 0;
     int textureBinds = 0;
     int shaderBinds = 0;
+    int shaderBindsSaved = 0;
+    int textureBindsSaved = 0;
+    int stateChangesSaved = 0;
     int renderTargetBinds = 0;
     int vertexBufferBinds = 0;
     int createConstantBufferCalls = 0;
     int allocCalls = 0;
+    int cpuVisibleDraws = 0;
+    int gpuVisibleDraws = 0;
+    int occludedMeshes = 0;
     int triangleCount = 0;
     float depthNormalsTimeMS = 0;
+    float lightAssignmentTimeMS = 0;
     float shadowMapTimeMS = 0;
     float frameTimeMS = 0;
     std::chrono::time_point< std::chrono::high_resolution_clock > startFrameTimePoint;
     std::chrono::time_point< std::chrono::high_resolution_clock > startShadowMapTimePoint;
     std::chrono::time_point< std::chrono::high_resolution_clock > startDepthNormalsTimePoint;
+    std::chrono::time_point< std::chrono::high_resolution_clock > startLightAssignmentTimePoint;
 }
 
 void Statistics::IncTriangleCount( int triangles )
@@ -55,6 +63,18 @@ void Statistics::EndDepthNormalsProfiling()
     Statistics::depthNormalsTimeMS = static_cast< float >(tDiff);
 }
 
+void Statistics::BeginLightAssignmentProfiling()
+{
+    Statistics::startLightAssignmentTimePoint = std::chrono::high_resolution_clock::now();
+}
+
+void Statistics::EndLightAssignmentProfiling()
+{
+    auto tEnd = std::chrono::high_resolution_clock::now();
+    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - Statistics::startLightAssignmentTimePoint ).count();
+    Statistics::lightAssignmentTimeMS = static_cast< float >(tDiff);
+}
+
 void Statistics::BeginFrameTimeProfiling()
 {
     Statistics::startFrameTimePoint = std::chrono::high_resolution_clock::now();
@@ -142,6 +162,11 @@ float Statistics::GetDepthNormalsTimeMS()
     return Statistics::depthNormalsTimeMS;
 }
 
+float Statistics::GetLightAssignmentTimeMS()
+{
+    return Statistics::lightAssignmentTimeMS;
+}
+
 int Statistics::GetDrawCalls()
 {
     return Statistics::drawCalls;
@@ -167,11 +192,71 @@ int Statistics::GetShaderBinds()
     return Statistics::shaderBinds;
 }
 
+void Statistics::IncShaderBindsSaved( int count )
+{
+    Statistics::shaderBindsSaved += count;
+}
+
+int Statistics::GetShaderBindsSaved()
+{
+    return Statistics::shaderBindsSaved;
+}
+
+void Statistics::IncTextureBindsSaved( int count )
+{
+    Statistics::textureBindsSaved += count;
+}
+
+int Statistics::GetTextureBindsSaved()
+{
+    return Statistics::textureBindsSaved;
+}
+
+void Statistics::IncStateChangesSaved()
+{
+    ++Statistics::stateChangesSaved;
+}
+
+int Statistics::GetStateChangesSaved()
+{
+    return Statistics::stateChangesSaved;
+}
+
 void Statistics::IncBarrierCalls()
 {
     ++Statistics::barrierCalls;
 }
 
+void Statistics::IncCpuVisibleDraws( int count )
+{
+    Statistics::cpuVisibleDraws += count;
+}
+
+int Statistics::GetCpuVisibleDraws()
+{
+    return Statistics::cpuVisibleDraws;
+}
+
+void Statistics::IncGpuVisibleDraws( int count )
+{
+    Statistics::gpuVisibleDraws += count;
+}
+
+int Statistics::GetGpuVisibleDraws()
+{
+    return Statistics::gpuVisibleDraws;
+}
+
+void Statistics::IncOccludedMeshes( int count )
+{
+    Statistics::occludedMeshes += count;
+}
+
+int Statistics::GetOccludedMeshes()
+{
+    return Statistics::occludedMeshes;
+}
+
 void Statistics::ResetFrameStatistics()
 {
     drawCalls = 0;
@@ -179,11 +264,17 @@ void Statistics::ResetFrameStatistics()
     fenceCalls = 0;
     textureBinds = 0;
     shaderBinds = 0;
+    shaderBindsSaved = 0;
+    textureBindsSaved = 0;
+    stateChangesSaved = 0;
     vertexBufferBinds = 0;
     renderTargetBinds = 0;
     createConstantBufferCalls = 0;
     allocCalls = 0;
     triangleCount = 0;
+    cpuVisibleDraws = 0;
+    gpuVisibleDraws = 0;
+    occludedMeshes = 0;
 
     startFrameTimePoint = std::chrono::high_resolution_clock::now();
 }
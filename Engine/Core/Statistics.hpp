@@ -9,9 +9,13 @@ namespace Statistics
     void BeginDepthNormalsProfiling();
     void EndDepthNormalsProfiling();
 
+    void BeginLightAssignmentProfiling();
+    void EndLightAssignmentProfiling();
+
     float GetFrameTimeMS();
     float GetShadowMapTimeMS();
     float GetDepthNormalsTimeMS();
+    float GetLightAssignmentTimeMS();
 
     void BeginFrameTimeProfiling();
     void EndFrameTimeProfiling();
@@ -31,12 +35,24 @@ namespace Statistics
     void ResetFrameStatistics();
     void IncShaderBinds();
     int GetShaderBinds();
+    void IncShaderBindsSaved( int count );
+    int GetShaderBindsSaved();
+    void IncTextureBindsSaved( int count );
+    int GetTextureBindsSaved();
+    void IncStateChangesSaved();
+    int GetStateChangesSaved();
     void IncBarrierCalls();
     int GetBarrierCalls();
     void IncFenceCalls();
     int GetFenceCalls();
     void IncAllocCalls();
     int GetAllocCalls();
+    void IncCpuVisibleDraws( int count );
+    int GetCpuVisibleDraws();
+    void IncGpuVisibleDraws( int count );
+    int GetGpuVisibleDraws();
+    void IncOccludedMeshes( int count );
+    int GetOccludedMeshes();
 }
 
 #endif
@@ -1,17 +1,29 @@
 #ifndef SUBMESH_H
 #define SUBMESH_H
 
+#include <memory>
 #include <string>
+#include <vector>
 #include "Vec3.hpp"
 
 namespace ae3d
 {
+    /// Local positions and faces of a sub-mesh for rasterizing it as an occluder on the CPU.
+    struct OccluderGeometry
+    {
+        std::vector< ae3d::Vec3 > positions;
+        std::vector< ae3d::VertexBuffer::Face > faces;
+    };
+
     struct SubMesh
     {
         ae3d::Vec3 aabbMin;
         ae3d::Vec3 aabbMax;
         ae3d::VertexBuffer vertexBuffer;
         std::string name;
+        /// Created by Mesh::CreateOccluderGeometry only for meshes that are occluders, see MeshRendererComponent::SetOccluder.
+        /// Shared by copies of the mesh and by the mesh cache.
+        std::shared_ptr< const OccluderGeometry > occluderGeometry;
     };
 }
 
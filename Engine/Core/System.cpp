@@ -7,9 +7,11 @@
 #include <vector>
 #include <cstdarg>
 #include <cassert>
+#include "AssetLoader.hpp"
 #include "AudioSystem.hpp"
 #include "GfxDevice.hpp"
 #include "FileWatcher.hpp"
+#include "JobSystem.hpp"
 #include "Matrix.hpp"
 #include "Renderer.hpp"
 #include "Texture2D.hpp"
@@ -58,11 +60,6 @@ void ae3d::System::SetCurrentDrawableMetal( id <CAMetalDrawable> drawable, MTLRe
     GfxDevice::SetCurrentDrawableMetal( drawable, renderPass );
 }
 
-void ae3d::System::BeginFrame()
-{
-    GfxDevice::BeginFrame();
-}
-
 void ae3d::System::EndFrame()
 {
     GfxDevice::PresentDrawable();
@@ -70,10 +67,20 @@ void ae3d::System::EndFrame()
 
 #endif
 
+void ae3d::System::BeginFrame()
+{
+#if RENDERER_METAL
+    GfxDevice::BeginFrame();
+#endif
+    AssetLoader::RunUploads();
+}
+
 void ae3d::System::Deinit()
 {
+    AssetLoader::Deinit();
     GfxDevice::ReleaseGPUObjects();
     AudioSystem::Deinit();
+    JobSystem::Deinit();
 }
 
 void ae3d::System::EnableWindowsMemleakDetection()
@@ -96,6 +103,11 @@ void ae3d::System::InitGamePad()
     PlatformInitGamePad();
 }
 
+void ae3d::System::InitJobSystem( int workerCount )
+{
+    JobSystem::Init( workerCount );
+}
+
 void ae3d::System::LoadBuiltinAssets()
 {
     renderer.builtinShaders.Load();
@@ -110,7 +122,8 @@ void ae3d::System::Print( const char* format, ... )
     va_list ap;
     va_start(ap, format);
 
-    static char msg[ 1024 ];
+    // Per thread, because loaders print from worker threads.
+    thread_local char msg[ 1024 ];
 #if _MSC_VER
     vsnprintf_s( msg, sizeof(msg), format, ap );
 #else
@@ -207,6 +220,36 @@ int ae3d::System::Statistics::GetShaderBindCount()
     return ::Statistics::GetShaderBinds();
 }
 
+int ae3d::System::Statistics::GetShaderBindSavedCount()
+{
+    return ::Statistics::GetShaderBindsSaved();
+}
+
+int ae3d::System::Statistics::GetTextureBindSavedCount()
+{
+    return ::Statistics::GetTextureBindsSaved();
+}
+
+int ae3d::System::Statistics::GetCpuVisibleDrawCount()
+{
+    return ::Statistics::GetCpuVisibleDraws();
+}
+
+int ae3d::System::Statistics::GetGpuVisibleDrawCount()
+{
+    return ::Statistics::GetGpuVisibleDraws();
+}
+
+int ae3d::System::Statistics::GetOccludedMeshCount()
+{
+    return ::Statistics::GetOccludedMeshes();
+}
+
+float ae3d::System::Statistics::GetLightAssignmentTimeMS()
+{
+    return ::Statistics::GetLightAssignmentTimeMS();
+}
+
 void ae3d::System::Statistics::GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outBudgetMBytes )
 {
     GfxDevice::GetGpuMemoryUsage( outUsedMBytes, outBudgetMBytes );
@@ -0,0 +1,78 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <vector>
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /// Dynamic bounding volume hierarchy of axis-aligned boxes. Used by Scene to frustum cull whole subtrees at once.
+    class AABBTree
+    {
+    public:
+        /// Invalid proxy handle.
+        static const int NullProxy = -1;
+
+        /// Inserts a box. The stored box is enlarged a bit so that small movements don't need a reinsertion.
+        /// \param aabbMin Box minimum in world space.
+        /// \param aabbMax Box maximum in world space.
+        /// \param userData Value returned by queries.
+        /// \return Proxy handle.
+        int Insert( const Vec3& aabbMin, const Vec3& aabbMax, void* userData );
+
+        /// \param proxy Proxy handle from Insert.
+        void Remove( int proxy );
+
+        /// Updates a proxy's box. Does nothing if the new box is still inside the enlarged stored box.
+        /// \param proxy Proxy handle from Insert.
+        /// \param aabbMin Box minimum in world space.
+        /// \param aabbMax Box maximum in world space.
+        /// \return True, if the proxy had to be reinserted.
+        bool Refit( int proxy, const Vec3& aabbMin, const Vec3& aabbMax );
+
+        /// \param frustum Frustum.
+        /// \param outUserData Receives userData of every proxy whose box intersects the frustum. Not cleared.
+        void Query( const class Frustum& frustum, std::vector< void* >& outUserData ) const;
+
+        /// \param outMin Returns the minimum of all boxes.
+        /// \param outMax Returns the maximum of all boxes.
+        /// \return False, if the tree is empty.
+        bool GetBounds( Vec3& outMin, Vec3& outMax ) const;
+
+        /// \return Tree height. Empty tree and a single leaf have height 0.
+        int GetHeight() const;
+
+        /// \return Number of proxies in the tree.
+        int GetProxyCount() const { return proxyCount; }
+
+    private:
+        struct Node
+        {
+            bool IsLeaf() const { return child1 == NullProxy; }
+
+            Vec3 aabbMin;
+            Vec3 aabbMax;
+            void* userData = nullptr;
+            // Parent when allocated, next free node when in free list.
+            int parentOrNext = NullProxy;
+            int child1 = NullProxy;
+            int child2 = NullProxy;
+            // Leaf: 0, free node: -1
+            int height = -1;
+        };
+
+        int AllocateNode();
+        void FreeNode( int node );
+        void InsertLeaf( int leaf );
+        void RemoveLeaf( int leaf );
+        int Balance( int node );
+        void AddLeaves( int node, std::vector< void* >& outUserData ) const;
+
+        std::vector< Node > nodes;
+        mutable std::vector< int > stack;
+        int root = NullProxy;
+        int freeList = NullProxy;
+        int proxyCount = 0;
+    };
+}
+#endif
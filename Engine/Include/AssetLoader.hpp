@@ -0,0 +1,112 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <atomic>
+#include <memory>
+#include "TextureBase.hpp"
+
+namespace ae3d
+{
+    class AudioClip;
+    class Font;
+    class Mesh;
+    class Texture2D;
+
+    /**
+      Loads assets without blocking the calling thread.
+
+      Files are read, decoded and parsed on AssetLoader's own I/O thread, so they don't occupy JobSystem workers
+      and JobSystem::Wait never runs them in the middle of a frame. GPU and audio uploads must happen on the main thread,
+      so they are queued and run by System::BeginFrame until the frame's upload budget is spent.
+      Until its upload has run, a texture is the default texture and a mesh is the default cube.
+      Assets passed to the Load functions must stay alive until their handle is no longer loading.
+    */
+    namespace AssetLoader
+    {
+        /// Load state.
+        enum class State
+        {
+            /// The file is being read or decoded, or the upload is queued.
+            Loading,
+            /// The asset has its real contents.
+            Ready,
+            /// The file could not be read. The asset keeps its placeholder.
+            Failed
+        };
+
+        /// Refers to a load started with one of the Load functions. Copies refer to the same load.
+        struct Handle
+        {
+            /// \return Load state.
+            State GetState() const { return state ? state->load() : State::Failed; }
+
+            /// \return True, if the asset has its real contents.
+            bool IsReady() const { return GetState() == State::Ready; }
+
+            std::shared_ptr< std::atomic< State > > state;
+        };
+
+        /**
+          Sets texture to the default texture and loads it from path in the background.
+
+          \param texture Texture.
+          \param path Path. File format must be dds, png, tga, jpg, bmp or bmp.
+          \param wrap Wrap mode.
+          \param filter Filter mode.
+          \param mipmaps Mipmaps
+          \param colorSpace Color space.
+          \param anisotropy Anisotropy.
+          \return Handle.
+        */
+        Handle LoadTexture( Texture2D* texture, const char* path, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy );
+
+        /**
+          Sets mesh to the default cube and loads it from path in the background.
+
+          \param mesh Mesh.
+          \param path .ae3d mesh path.
+          \return Handle.
+        */
+        Handle LoadMesh( Mesh* mesh, const char* path );
+
+        /**
+          Loads an audio clip from path in the background. The clip can't be played before it's ready.
+
+          \param clip Audio clip.
+          \param path .wav or .ogg path.
+          \return Handle.
+        */
+        Handle LoadAudioClip( AudioClip* clip, const char* path );
+
+        /**
+          Loads a BMFont and its texture in the background. The font's metadata is loaded after the texture,
+          because glyph texture coordinates depend on the texture's size.
+
+          \param font Font.
+          \param fontTexture Font texture. Is the default texture until the font is ready.
+          \param texturePath Font texture path.
+          \param metaPath BMFont metadata path. Must be text or binary.
+          \param wrap Font texture wrap mode.
+          \param filter Font texture filter mode.
+          \param colorSpace Font texture color space.
+          \return Handle.
+        */
+        Handle LoadFont( Font* font, Texture2D* fontTexture, const char* texturePath, const char* metaPath, TextureWrap wrap, TextureFilter filter, ColorSpace colorSpace );
+
+        /// \param milliseconds Time that System::BeginFrame may spend on uploads. At least one upload is run per frame, even if it exceeds the budget. Defaults to 2.
+        void SetUploadBudget( float milliseconds );
+
+        /// Runs queued uploads until the budget is spent. Called by System::BeginFrame.
+        void RunUploads();
+
+        /// \return Count of loads that are not ready or failed.
+        int GetLoadingCount();
+
+        /// Waits for all loads and runs their uploads, eg. at the end of a loading screen.
+        void WaitForAll();
+
+        /// Waits for background reads, stops the I/O thread and discards queued uploads. Called by System::Deinit.
+        void Deinit();
+    }
+}
+#endif
@@ -5,7 +5,7 @@ namespace ae3d
 {
     namespace FileSystem
     {
-        struct FileContentsData;
+        struct FileView;
     }
 
     /// Audio clip.
@@ -13,7 +13,7 @@ namespace ae3d
     {
       public:
         /// \param clipData Clip data from .wav or .ogg file.
-        void Load( const FileSystem::FileContentsData& clipData );
+        void Load( const FileSystem::FileView& clipData );
 
         /// \return Clip's handle.
         unsigned GetId() const { return handle; }
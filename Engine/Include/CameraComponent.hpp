@@ -138,8 +138,13 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static CameraComponent* Get( unsigned index );
+        /// \param handle Handle returned by New.
+        /// \return Component or null if the handle is stale.
+        static CameraComponent* Get( unsigned handle );
+
+        /// Releases the component's slot for reuse.
+        /// \param handle Handle returned by New.
+        static void Delete( unsigned handle );
 
         Matrix44 projectionMatrix;
         Matrix44 viewMatrix;
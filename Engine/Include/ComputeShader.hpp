@@ -64,6 +64,10 @@ namespace ae3d
 #if RENDERER_VULKAN
         VkPipelineShaderStageCreateInfo& GetVertexInfo() { return info; }
 #endif
+#if RENDERER_OPENGL
+        /// \return Program handle, 0 if the shader is not loaded.
+        unsigned GetHandle() const { return handle; }
+#endif
 
         /// Sets a render texture into a slot.
         /// \param renderTexture render texture.
@@ -79,8 +83,12 @@ namespace ae3d
     private:
         std::string path;
 
+#if RENDERER_OPENGL
+        unsigned handle = 0;
+#endif
+
 #if RENDERER_VULKAN
-        VkPipelineShaderStageCreateInfo info;
+        VkPipelineShaderStageCreateInfo info = {};
 #endif
 #if RENDERER_METAL
         id <MTLFunction> function;
@@ -1,6 +1,8 @@
 #ifndef FILE_SYSTEM_H
 #define FILE_SYSTEM_H
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -19,6 +21,31 @@ namespace ae3d
             bool isLoaded = false;
         };
 
+        /**
+          Read-only view of file contents. Copying a view doesn't copy the contents: data points into a memory-mapped file,
+          a .pak entry or a decompressed buffer, which stays alive as long as any view that owns it does.
+          Views of loose files map the file, so the file must not be truncated while a view of it is alive.
+        */
+        struct FileView
+        {
+            FileView() = default;
+
+            /// Views contents without owning them, so the view is only valid as long as contents is.
+            /// Lets functions that take a FileView be called with FileContents().
+            FileView( const FileContentsData& contents );
+
+            /// First byte. Null if the file is empty or not loaded.
+            const unsigned char* data = nullptr;
+            /// Size in bytes.
+            std::size_t size = 0;
+            /// File path.
+            std::string path;
+            /// True if data has been loaded from path.
+            bool isLoaded = false;
+            /// Keeps data alive. Null for views that don't own their data.
+            std::shared_ptr< const void > owner;
+        };
+
         /**
         Reads file contents.
 
@@ -26,6 +53,16 @@ namespace ae3d
         */
         FileContentsData FileContents(const char* path);
 
+        /**
+        Maps file contents without copying them. Uncompressed .pak entries point into the .pak's mapping,
+        which stays mapped until their views are destroyed, even if the .pak is unloaded.
+        Can be called from worker threads while the main thread loads or unloads .pak files.
+
+        \param path Path.
+        */
+        FileView FileContentsView( const char* path );
+
+        /// The pak is memory-mapped and entries are read only when FileContents() asks for them, so loading does not read the contents.
         /// \param path .pak file path. After this call FileContents() searches first in all loaded .pak files and if the file is not found, it's loaded without .pak file.
         void LoadPakFile(const char* path);
 
@@ -5,7 +5,7 @@ namespace ae3d
 {
     namespace FileSystem
     {
-        struct FileContentsData;
+        struct FileView;
     }
     
     /// Contains glyphs loaded from AngelCode BMFont files. For Mac there is a compatible program called BMGlyph.
@@ -19,7 +19,7 @@ namespace ae3d
           \param fontTex Font texture. No outline support.
           \param metaData BMFont metadata. Must be text or binary.
          */
-        void LoadBMFont( class Texture2D* fontTex, const FileSystem::FileContentsData& metaData );
+        void LoadBMFont( class Texture2D* fontTex, const FileSystem::FileView& metaData );
         
         /** \return Font texture. */
         Texture2D* GetTexture() { return texture; }
@@ -46,10 +46,10 @@ namespace ae3d
         void CreateVertexBuffer( const char* text, const struct Vec4& color, class VertexBuffer& outVertexBuffer ) const;
 
         /** \param metaData BMFont text metadata. */
-        void LoadBMFontMetaText(const FileSystem::FileContentsData& metaData);
+        void LoadBMFontMetaText(const FileSystem::FileView& metaData);
         
         /** \param metaData BMFont binary metadata. */
-        void LoadBMFontMetaBinary(const FileSystem::FileContentsData& metaData);
+        void LoadBMFontMetaBinary(const FileSystem::FileView& metaData);
         
         /** The spacing for each character (horizontal, vertical). */
         int spacing[ 2 ];
@@ -12,6 +12,9 @@ namespace ae3d
         /// Invalid component index.
         static const unsigned InvalidComponentIndex = 99999999;
 
+        /// Upper bound for component type codes.
+        static const int MaxComponentTypes = 16;
+
         /// Adds a component into the game object. There can be multiple components of the same type.
         template< class T > void AddComponent()
         {
@@ -21,20 +24,39 @@ namespace ae3d
             {
                 components[ index ].handle = T::New();
                 components[ index ].type = T::Type();
-                GetComponent< T >()->gameObject = this;
+                T::Get( components[ index ].handle )->gameObject = this;
+
+                if ((componentMask & GetTypeMask< T >()) == 0 || index < componentSlots[ T::Type() ])
+                {
+                    componentSlots[ T::Type() ] = static_cast< unsigned char >( index );
+                }
+
+                componentMask |= GetTypeMask< T >();
+                ++componentsVersion;
+                OnRenderStateChanged();
             }            
         }
 
         /// Remove a component from the game object.
         template< class T > void RemoveComponent()
         {
+            if ((componentMask & GetTypeMask< T >()) == 0)
+            {
+                return;
+            }
+
+            DeleteComponent< T >( components[ componentSlots[ T::Type() ] ] );
+            componentMask &= ~GetTypeMask< T >();
+            ++componentsVersion;
+            OnRenderStateChanged();
+
+            // Another component of the same type becomes the first one.
             for (unsigned i = 0; i < nextFreeComponentIndex; ++i)
             {
                 if (components[ i ].type == T::Type())
                 {
-                    GetComponent< T >()->gameObject = nullptr;
-                    components[ i ].handle = 0;
-                    components[ i ].type = -1;
+                    componentSlots[ T::Type() ] = static_cast< unsigned char >( i );
+                    componentMask |= GetTypeMask< T >();
                     return;
                 }
             }
@@ -43,23 +65,30 @@ namespace ae3d
         /// \return The first component of type T or null if there is no such component.
         template< class T > T* GetComponent() const
         {
-            for (const auto& component : components)
-            {
-                if (T::Type() == component.type)
-                {
-                    return T::Get( component.handle );
-                }
-            }
-
-            return nullptr;
+            return (componentMask & GetTypeMask< T >()) != 0 ? T::Get( components[ componentSlots[ T::Type() ] ].handle ) : nullptr;
         }
 
+        /// \return Bit mask of component types. Bit T::Type() is set if the game object has a component of type T.
+        unsigned GetComponentMask() const { return componentMask; }
+
+        /// \return Bit mask with a bit set for each of the component types.
+        template< class T > static unsigned GetTypeMask() { return 1u << T::Type(); }
+
+        /// \return Bit mask with a bit set for each of the component types.
+        template< class T, class U, class... Rest > static unsigned GetTypeMask() { return GetTypeMask< T >() | GetTypeMask< U, Rest... >(); }
+
+        /// \return Counter that changes whenever a component is added to or removed from any game object.
+        static unsigned GetComponentsVersion() { return componentsVersion; }
+
         /// Constructor.
         GameObject() = default;
 
         /// Copy constructor.
         GameObject( const GameObject& other );
 
+        /// Destructor. Releases components.
+        ~GameObject();
+
         /// \param go Other game object.
         GameObject& operator=( const GameObject& go );
 
@@ -67,7 +96,7 @@ namespace ae3d
         void SetName( const char* aName ) { name = aName; }
         
         /// \param enabled True if the game object should be rendered, false otherwise.
-        void SetEnabled( bool enabled ) { isEnabled = enabled; }
+        void SetEnabled( bool enabled );
         
         /// \return True if this game object and all its parents are enabled.
         bool IsEnabled() const;
@@ -76,7 +105,14 @@ namespace ae3d
         const std::string& GetName() const { return name; }
         
         /// \param aLayer Layer for controlling camera visibility etc. Must be power of two (2, 4, 8 etc.)
-        void SetLayer( unsigned aLayer ) { layer = aLayer; }
+        void SetLayer( unsigned aLayer )
+        {
+            if (layer != aLayer)
+            {
+                layer = aLayer;
+                OnRenderStateChanged();
+            }
+        }
 
         /// \return Layer.
         unsigned GetLayer() const { return layer; }
@@ -85,18 +121,53 @@ namespace ae3d
         std::string GetSerialized() const;
 
     private:
+        friend class MeshRendererComponent;
+        friend class Scene;
+        friend class TransformComponent;
+
         struct ComponentEntry
         {
             int type = -1;
+            // 0 is never a valid handle.
             unsigned handle = 0;
         };
 
+        template< class T > static void DeleteComponent( ComponentEntry& entry )
+        {
+            T* component = T::Get( entry.handle );
+
+            if (component != nullptr)
+            {
+                component->gameObject = nullptr;
+            }
+
+            T::Delete( entry.handle );
+            entry = ComponentEntry();
+        }
+
+        template< class T > void CopyComponent( const GameObject& other );
+
         unsigned GetNextComponentIndex();
+        void DeleteComponents();
+        /// Marks this game object's render list membership for re-evaluation.
+        void OnRenderStateChanged() { renderStateChange = ++renderStateVersion; }
 
         static const int MaxComponents = 10;
+        static unsigned componentsVersion;
+        // Changes when enabled state, layer, mesh or components of any game object change.
+        static unsigned renderStateVersion;
+        // Changes when enabled state of game objects' ancestors may have changed, ie. a parent changed
+        // or a transform with children was disabled, enabled or deleted.
+        static unsigned hierarchyVersion;
+
         unsigned nextFreeComponentIndex = 0;
         ComponentEntry components[ MaxComponents ];
+        unsigned componentMask = 0;
+        // Index in components of the first component of each type. Valid if the type's bit is set in componentMask.
+        unsigned char componentSlots[ MaxComponentTypes ] = {};
         std::string name;
+        // renderStateVersion after this game object's latest change.
+        unsigned renderStateChange = 0;
         unsigned layer = 1;
         bool isEnabled = true;
     };
@@ -0,0 +1,53 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace ae3d
+{
+    /// Runs jobs on a fixed pool of worker threads. Each worker has its own queue and steals from others when it runs out of work.
+    namespace JobSystem
+    {
+        /// Counts unfinished jobs. Used to wait for jobs and to make jobs depend on other jobs.
+        struct Counter
+        {
+            /// \return True, if all jobs that signal this counter have finished.
+            bool IsDone() const { return value.load() == 0; }
+
+            std::atomic< int > value{ 0 };
+            // Jobs that are queued when value reaches zero.
+            std::vector< std::pair< std::function< void() >, Counter* > > dependents;
+            std::mutex dependentsMutex;
+        };
+
+        /// Starts worker threads. Called automatically on first use if not called before.
+        /// \param workerCount Worker thread count. If negative, uses one less than the number of hardware threads.
+        void Init( int workerCount );
+
+        /// Waits for worker threads to finish their current job and stops them. Queued jobs are discarded.
+        void Deinit();
+
+        /// \return Worker thread count, not including the calling thread.
+        int GetWorkerCount();
+
+        /// Queues a job.
+        /// \param job Job.
+        /// \param signal Counter that's incremented now and decremented when the job finishes. Can be null.
+        /// \param dependency Job is not started before this counter is done. Can be null.
+        void Run( const std::function< void() >& job, Counter* signal, Counter* dependency = nullptr );
+
+        /// Runs queued jobs on the calling thread until counter is done.
+        /// \param counter Counter.
+        void Wait( Counter* counter );
+
+        /// Splits [0, count) into batches, runs them on workers and the calling thread and returns after all are finished.
+        /// \param count Item count.
+        /// \param batchSize Items in one job.
+        /// \param body Called with begin (inclusive) and end (exclusive) item index.
+        void ParallelFor( int count, int batchSize, const std::function< void( int begin, int end ) >& body );
+    }
+}
+#endif
@@ -1,8 +1,7 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
-#include <string>
-#include <unordered_map>
+#include <vector>
 #include "Vec3.hpp"
 #include "Matrix.hpp"
 
@@ -52,7 +51,11 @@ namespace ae3d
         bool IsValidShader() const;
         
         /// Applies the uniforms into the shader. Called internally.
-        void Apply();
+        /// \param bindTextures False, if this material's textures are still bound by the previous Apply.
+        void Apply( bool bindTextures = true );
+
+        /// \return Number of textures that Apply binds, including global textures.
+        int GetTextureCount() const;
 
         /// \return True, if backfaces are culled.
         bool IsBackFaceCulled() const { return cullBackFaces; }
@@ -111,21 +114,85 @@ namespace ae3d
         /// \param vec Vector.
         void SetVector( const char* name, const Vec4& vec );
 
+        /// \param propertyId Matrix uniform id from Shader::GetPropertyId.
+        /// \param matrix 4x4 matrix.
+        void SetMatrix( int propertyId, const Matrix44& matrix );
+
+        /// \param propertyId Integer uniform id from Shader::GetPropertyId.
+        /// \param value Value.
+        void SetInt( int propertyId, int value );
+
+        /// \param propertyId Float uniform id from Shader::GetPropertyId.
+        /// \param value Value.
+        void SetFloat( int propertyId, float value );
+
+        /// \param propertyId Vector uniform id from Shader::GetPropertyId.
+        /// \param vec3 Vector.
+        void SetVector( int propertyId, const Vec3& vec3 );
+
+        /// \param propertyId Vector uniform id from Shader::GetPropertyId.
+        /// \param vec Vector.
+        void SetVector( int propertyId, const Vec4& vec );
+
   private:
-        static std::unordered_map< std::string, RenderTexture* > sTexRTs;
-        static std::unordered_map< std::string, Texture2D* > sTex2ds;
-        static std::unordered_map< std::string, float > sFloats;
-        static std::unordered_map< std::string, int > sInts;
-        static std::unordered_map< std::string, Vec3 > sVec3s;
-
-        std::unordered_map< std::string, float > floats;
-        std::unordered_map< std::string, int > ints;
-        std::unordered_map< std::string, Vec3 > vec3s;
-        std::unordered_map< std::string, Vec4 > vec4s;
-        std::unordered_map< std::string, Texture2D* > tex2ds;
-        std::unordered_map< std::string, TextureCube* > texCubes;
-        std::unordered_map< std::string, RenderTexture* > texRTs;
-        std::unordered_map< std::string, Matrix44 > mat4s;
+        enum class PropertyType : unsigned char { Int, Float, Vec3, Vec4, Matrix, Texture2D, TextureCube, RenderTexture };
+
+        /// Value or texture set by a setter.
+        struct Property
+        {
+            /// Id from Shader::GetPropertyId.
+            int id = 0;
+            /// First value slot. Matrices use four slots, other values one and textures none.
+            unsigned slot = 0;
+            /// Texture2D, TextureCube or RenderTexture.
+            void* texture = nullptr;
+            PropertyType type = PropertyType::Float;
+
+            bool IsTexture() const { return type == PropertyType::Texture2D || type == PropertyType::TextureCube || type == PropertyType::RenderTexture; }
+        };
+
+        /// Properties in the order they were first set. Values are in 16-byte slots
+        /// so that they can be compared and uploaded without per-type containers.
+        struct PropertyBlock
+        {
+            /// \return Index of the property. Adds it if it doesn't exist.
+            unsigned Find( int id, PropertyType type );
+
+            /// Writes a value and marks the property dirty if the value changed.
+            /// \return True, if the value changed.
+            bool SetValue( int id, PropertyType type, const float* value, unsigned floatCount );
+
+            /// Sets a texture and marks the property dirty if the texture changed.
+            void SetTexture( int id, PropertyType type, void* texture );
+
+            std::vector< Property > properties;
+            std::vector< Vec4 > slots;
+            /// Properties that have changed since the last Apply.
+            std::vector< bool > isDirty;
+        };
+
+        /// Uploads a value property into the shader.
+        void UploadValue( const PropertyBlock& block, const Property& property );
+
+        /// Binds a texture property into the shader.
+        void BindTexture( const Property& property, int textureUnit );
+
+        /// \return True, if a global overrides the material's own value or texture.
+        static bool IsOverriddenByGlobal( int propertyId );
+
+        static PropertyBlock globals;
+        /// Incremented when a global value changes.
+        static unsigned globalsVersion;
+        /// Indexed by property id. Material's own value is not applied if a global has the same id.
+        static std::vector< bool > isGlobalProperty;
+        /// Source of Apply stamps.
+        static unsigned applyCounter;
+
+        PropertyBlock block;
+        /// Stamp written into the shader by the last Apply that uploaded this material's values.
+        unsigned applyStamp = 0;
+        /// Shader of the last Apply, to notice SetShader.
+        Shader* appliedShader = nullptr;
         Shader* shader = nullptr;
         DepthFunction depthFunction = DepthFunction::LessOrEqualWriteOn;
         BlendingMode blendingMode = BlendingMode::Off;
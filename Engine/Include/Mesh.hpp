@@ -9,7 +9,7 @@ namespace ae3d
 {
     namespace FileSystem
     {
-        struct FileContentsData;
+        struct FileView;
     }
 
     struct SubMesh;
@@ -36,10 +36,13 @@ namespace ae3d
 
         /// \return Path where this mesh was loaded from.
         const std::string& GetPath() const;
+
+        /// \return Value that changes whenever the bounds or sub-meshes change, eg. when the mesh is loaded again or reloaded from a modified file.
+        unsigned GetContentVersion() const;
         
         /// \param meshData Data from .ae3d mesh file.
         /// \return Load result.
-        LoadResult Load( const FileSystem::FileContentsData& meshData );
+        LoadResult Load( const FileSystem::FileView& meshData );
         
         /// \return Axis-aligned bounding box minimum in local coordinates.
         const Vec3& GetAABBMin() const;
@@ -75,6 +78,9 @@ namespace ae3d
         std::aligned_storage<StorageSize, StorageAlign>::type _storage = {};
         
         std::vector< SubMesh >& GetSubMeshes();
+
+        /// Creates sub-meshes' occluder geometry unless they have it. Meshes loaded from the same file share it through the mesh cache.
+        void CreateOccluderGeometry();
     };
 }
 
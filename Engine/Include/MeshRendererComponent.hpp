@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include "Vec3.hpp"
 
 namespace ae3d
 {
@@ -29,6 +30,19 @@ namespace ae3d
         /// \param enable True, if the mesh will be rendered as a wireframe.
         void EnableWireframe( bool enable ) { isWireframe = enable; }
 
+        /// \return True, if the mesh is rasterized into the occlusion buffer when Scene's occlusion culling is enabled.
+        bool IsOccluder() const { return isOccluder; }
+
+        /// \param enable True, if the mesh hides the meshes behind it. Meant for large, simple meshes like walls. Occluders are not tested themselves.
+        /// Occluders keep a copy of their mesh's positions and faces on the CPU.
+        void SetOccluder( bool enable );
+
+        /// \return True, if the mesh is culled when it's hidden behind occluders. Defaults to true.
+        bool IsOccludee() const { return isOccludee; }
+
+        /// \param enable True, if the mesh is culled when it's hidden behind occluders.
+        void SetOccludee( bool enable ) { isOccludee = enable; }
+
         /// \return Textual representation of component.
         std::string GetSerialized() const;
         
@@ -44,12 +58,18 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static MeshRendererComponent* Get( unsigned index );
+        /// \param handle Handle returned by New.
+        /// \return Component or null if the handle is stale.
+        static MeshRendererComponent* Get( unsigned handle );
+
+        /// Releases the component's slot for reuse.
+        /// \param handle Handle returned by New.
+        static void Delete( unsigned handle );
         
+        /// Culls sub-meshes. Scene has already tested the whole mesh.
         /// \param cameraFrustum cameraFrustum
         /// \param localToWorld Local-to-World matrix
-        void Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld );
+        void CullSubMeshes( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld );
         
         /// \param modelView Model-view matrix.
         /// \param modelViewProjectionMatrix Model-view-projection matrix.
@@ -57,12 +77,62 @@ namespace ae3d
         void Render( const struct Matrix44& modelView, const Matrix44& modelViewProjectionMatrix, const Matrix44& localToWorld,
                      const Matrix44& shadowView, const Matrix44& shadowProjection, class Shader* overrideShader, RenderType renderType );
 
+        /// Renders one sub-mesh that has not been culled.
+        /// \param bindTextures False, if the previous draw used the same material and its textures are still bound.
+        void RenderSubMesh( int subMeshIndex, const Matrix44& modelView, const Matrix44& modelViewProjectionMatrix, const Matrix44& localToWorld,
+                            const Matrix44& shadowView, const Matrix44& shadowProjection, Shader* overrideShader, bool bindTextures );
+
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+        /// Renders one sub-mesh for each model matrix in a range of the instance buffer. The material's shader must be instanced.
+        /// \param viewProjection View-projection matrix.
+        /// \param shadowViewProjection Shadow camera's view-projection-bias matrix.
+        /// \param firstInstance Index of the first model matrix in the instance buffer.
+        /// \param instanceCount Instance count.
+        /// \param bindTextures False, if the previous draw used the same material and its textures are still bound.
+        void RenderSubMeshInstanced( int subMeshIndex, const Matrix44& viewProjection, const Matrix44& shadowViewProjection,
+                                     int firstInstance, int instanceCount, bool bindTextures );
+#endif
+
+#if RENDERER_OPENGL || RENDERER_NULL
+        /// Renders sub-meshes that use this renderer's sub-mesh material with one DrawIndirect. The material's shader must be draw-indirect.
+        /// \param vertexBuffers Sub-meshes' vertex buffers, in the same MeshArena page if there are more than one.
+        /// \param modelMatrices Model matrix of each sub-mesh.
+        /// \param drawCount Sub-mesh count.
+        /// \param bindTextures False, if the previous draw used the same material and its textures are still bound.
+        /// \param cullShader If not null, the sub-meshes are culled on the GPU with GfxDevice::DrawIndirectCulled.
+        /// \param localBounds Sub-meshes' local AABBs for GPU culling, 6 floats per sub-mesh.
+        /// \param frustumPlanes Planes from Frustum::GetPlanes for GPU culling.
+        /// \param outVisibleCount If not null, receives the GPU-culled visible count. Waits for the GPU.
+        void RenderSubMeshesIndirect( int subMeshIndex, class VertexBuffer* const* vertexBuffers, const Matrix44* modelMatrices, int drawCount,
+                                      const Matrix44& viewProjection, const Matrix44& shadowViewProjection, bool bindTextures,
+                                      class ComputeShader* cullShader = nullptr, const float* localBounds = nullptr,
+                                      const float* frustumPlanes = nullptr, int* outVisibleCount = nullptr );
+#endif
+
+        /// \return True, if the sub-mesh's material is blended and must be rendered in the transparent pass.
+        bool IsSubMeshTransparent( int subMeshIndex ) const;
+
+        /// \return Sub-mesh of the mesh.
+        struct SubMesh& GetSubMesh( int subMeshIndex ) const;
+
+        /// Resizes the per-sub-mesh arrays if the mesh has been loaded again since SetMesh, eg. when AssetLoader replaced its placeholder cube.
+        /// New sub-meshes have no material.
+        void UpdateSubMeshArrays();
+        void ResizeSubMeshArrays();
+
         Mesh* mesh = nullptr;
         std::vector< Material* > materials;
         std::vector< bool > isSubMeshCulled;
+        // Mesh::GetContentVersion when materials and isSubMeshCulled were sized.
+        unsigned meshContentVersion = 0;
         GameObject* gameObject = nullptr;
+        // World-space bounds, updated by Scene when the mesh or transform changes.
+        Vec3 aabbCenterWorld;
+        Vec3 aabbExtentWorld;
         bool isCulled = false;
         bool isWireframe = false;
+        bool isOccluder = false;
+        bool isOccludee = true;
     };
 }
 
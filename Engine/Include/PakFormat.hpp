@@ -0,0 +1,120 @@
+#ifndef PAK_FORMAT_H
+#define PAK_FORMAT_H
+
+#include <cstdint>
+
+namespace ae3d
+{
+    /**
+      .pak file layout, shared by FileSystem and CombineFiles.
+
+      Version 3 layout, all integers little-endian:
+      offset          data
+          0           Header
+         32           Bucket table: Header::bucketCount + 1 uint32 TOC indices
+      tocOffset       TOC: Header::entryCount TocEntry structs sorted by pathHash
+      stringsOffset   Entry paths, not null-terminated
+      TocEntry offset Entry contents, each starting at a multiple of EntryAlignment
+
+      Compressed entries are split into TocEntry::chunkSize byte chunks that are compressed independently,
+      so they can be decompressed in parallel. The entry starts with a uint32 stored size for each chunk,
+      followed by the chunks. If ChunkStoredRaw is set in a chunk's stored size, the chunk did not compress
+      and is stored as is.
+
+      Lookup hashes the path, maps the hash to a bucket with GetBucket and scans the bucket's TOC range,
+      which is usually one or two entries. Since the TOC is sorted by hash and GetBucket preserves order,
+      each bucket's entries are contiguous. Nothing needs to be read into memory to look up an entry,
+      so FileSystem can memory-map the file and only touch the pages of entries that are read.
+
+      Version 1 paks start with a uint32 entry count followed by entries that have a 128 byte path,
+      a uint32 size and the contents. They are still readable.
+    */
+    namespace PakFormat
+    {
+        const std::uint32_t Version = 3;
+        /// Entry contents start at multiples of this, so they can be read with aligned loads.
+        const std::uint32_t EntryAlignment = 64;
+        /// Uncompressed size of a compressed entry's chunks, except the last.
+        const std::uint32_t DefaultChunkSize = 256 * 1024;
+        /// Set in a chunk's stored size if the chunk is not compressed.
+        const std::uint32_t ChunkStoredRaw = 0x80000000u;
+
+        enum class Compression : std::uint32_t
+        {
+            None = 0,
+            /// LZ4 block format, see ThirdParty/lz4_block.h.
+            LZ4 = 1
+        };
+
+        struct Header
+        {
+            /// "AEPK"
+            char magic[ 4 ];
+            std::uint32_t version;
+            std::uint32_t entryCount;
+            std::uint32_t bucketCount;
+            std::uint64_t tocOffset;
+            std::uint64_t stringsOffset;
+        };
+
+        struct TocEntry
+        {
+            /// HashPath of the entry's path.
+            std::uint64_t pathHash;
+            /// Offset of the contents from the start of the file.
+            std::uint64_t offset;
+            /// Uncompressed content size in bytes.
+            std::uint64_t size;
+            /// Size of the contents in the file, including the chunk table of compressed entries.
+            std::uint64_t storedSize;
+            /// Offset of the path from Header::stringsOffset.
+            std::uint32_t pathOffset;
+            std::uint32_t pathLength;
+            Compression compression;
+            /// Chunk size of compressed entries, 0 for uncompressed.
+            std::uint32_t chunkSize;
+        };
+
+        static_assert( sizeof( Header ) == 32, "Header layout must not have padding" );
+        static_assert( sizeof( TocEntry ) == 48, "TocEntry layout must not have padding" );
+
+        /// \return Chunk count of a compressed entry.
+        inline std::uint64_t GetChunkCount( const TocEntry& entry )
+        {
+            return entry.chunkSize == 0 ? 0 : (entry.size + entry.chunkSize - 1) / entry.chunkSize;
+        }
+
+        /// \return True if header starts with the version 2+ magic.
+        inline bool HasMagic( const Header& header )
+        {
+            return header.magic[ 0 ] == 'A' && header.magic[ 1 ] == 'E' && header.magic[ 2 ] == 'P' && header.magic[ 3 ] == 'K';
+        }
+
+        /// \return 64-bit FNV-1a hash of path's first length characters.
+        inline std::uint64_t HashPath( const char* path, std::uint32_t length )
+        {
+            std::uint64_t hash = 14695981039346656037ULL;
+
+            for (std::uint32_t i = 0; i < length; ++i)
+            {
+                hash ^= (unsigned char)path[ i ];
+                hash *= 1099511628211ULL;
+            }
+
+            return hash;
+        }
+
+        /// \return Bucket of pathHash. Larger hashes map to the same or later buckets.
+        inline std::uint32_t GetBucket( std::uint64_t pathHash, std::uint32_t bucketCount )
+        {
+            return (std::uint32_t)(((pathHash >> 32) * bucketCount) >> 32);
+        }
+
+        /// \return offset rounded up to the next multiple of alignment.
+        inline std::uint64_t Align( std::uint64_t offset, std::uint64_t alignment )
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+    }
+}
+#endif
@@ -1,9 +1,14 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <cstdint>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
+#include "AABBTree.hpp"
+#include "GameObject.hpp"
+#include "Matrix.hpp"
 #include "Vec3.hpp"
 
 namespace ae3d
@@ -19,18 +24,78 @@ namespace ae3d
     public:
         /// Result of GetSerialized.
         enum class DeserializeResult { Success, ParseError };
+
+        /// How opaque draws with a draw-indirect shader (Shader::IsDrawIndirect) are culled. Other draws are always culled on the CPU.
+        enum class CullingMode
+        {
+            /// Culled on the CPU before they are batched.
+            CPU,
+            /// Batched without culling and culled by a compute shader. OpenGL 4.3 or newer. Other renderers use CPU.
+            GPU,
+            /// Culled like GPU, but also on the CPU. Visible draw counts go into System::Statistics and mismatches are printed.
+            /// Waits for the GPU after every batch, so meant for validation only.
+            CompareCPUAndGPU
+        };
+
+        /// How point and spot lights are culled for forward shading.
+        enum class LightCullingMode
+        {
+            /// Point lights are culled per screen tile by a compute shader against the depth and normals texture.
+            GPUTiled,
+            /// Point and spot lights are assigned to view frustum clusters on the CPU, for renderers or GPUs without compute shaders.
+            /// The lists are uploaded with GfxDevice::UploadLightClusters on OpenGL and the null renderer. Perspective cameras only.
+            CPUClustered
+        };
         
         /// Adds a game object into the scene if it does not exist there already.
-        void Add( class GameObject* gameObject );
+        void Add( GameObject* gameObject );
+
+        /// Adds game objects into the scene. Game objects that are null or already in the scene are skipped.
+        /// \param gameObjects Game objects to add.
+        void AddRange( const std::vector< GameObject* >& gameObjects );
         
         /// \param gameObject Game object to remove. Does nothing if it is null or doesn't exist in the scene.
         void Remove( GameObject* gameObject );
+
+        /// \param gameObjects Game objects to remove. Game objects that are null or not in the scene are skipped.
+        void RemoveRange( const std::vector< GameObject* >& gameObjects );
         
         /// Renders the scene.
         void Render();
 
+        /// Calls function( GameObject&, First&, Rest&... ) for each game object in the scene that has all the given component types.
+        /// Visits only the game objects that have the rarest of the types. The function must not add or remove components or game objects.
+        template< class First, class... Rest, class Function > void ForEach( Function function )
+        {
+            const unsigned typeMask = GameObject::GetTypeMask< First, Rest... >();
+
+            for (unsigned index : GetShortestComponentList( typeMask ))
+            {
+                GameObject& gameObject = *gameObjects[ index ];
+
+                if ((gameObject.GetComponentMask() & typeMask) == typeMask)
+                {
+                    function( gameObject, *gameObject.GetComponent< First >(), *gameObject.GetComponent< Rest >()... );
+                }
+            }
+        }
+
         /// \param skyTexture Skybox texture.
         void SetSkybox( class TextureCube* skyTexture );
+
+        /// \param mode How draw-indirect draws are culled. Defaults to CullingMode::CPU.
+        void SetCullingMode( CullingMode mode ) { cullingMode = mode; }
+
+        /// \param mode How lights are culled. Defaults to LightCullingMode::GPUTiled.
+        void SetLightCullingMode( LightCullingMode mode ) { lightCullingMode = mode; }
+
+        /// \param enable True, if perspective cameras cull meshes that are hidden behind occluders, see MeshRendererComponent::SetOccluder.
+        void SetOcclusionCulling( bool enable ) { isOcclusionCullingEnabled = enable; }
+
+        /// Writes the occlusion culling depth buffer of the latest camera that used it as a PGM image, for debugging occluders.
+        /// \param path Path.
+        /// \return True, if the file was written.
+        bool WriteOcclusionDepthImage( const char* path ) const;
         
         /// \return Scene's contents in a textual format that can be saved into file etc.
         std::string GetSerialized() const;
@@ -48,15 +113,164 @@ namespace ae3d
                                        std::vector< class Mesh* >& outMeshes ) const;
         
     private:
+        struct RenderList;
+
         void RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const char* debugGroupName );
         void RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace );
+        /// Assigns the camera's visible point and spot lights to clusters and uploads the lists. Used in LightCullingMode::CPUClustered.
+        void AssignClusteredLights( class CameraComponent* camera, float fovDegrees, const Matrix44& view );
         void RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >& cameras );
-        void RenderDepthAndNormals( class CameraComponent* camera, const struct Matrix44& view, std::vector< unsigned > gameObjectsWithMeshRenderer,
+        void RenderDepthAndNormals( class CameraComponent* camera, const Matrix44& view, const RenderList& renderList,
                                     int cubeMapFace, const class Frustum& frustum );
+        void UpdateMeshTree();
+        /// \return Enabled game objects that have a mesh and a layer in layerMask, sorted by mesh. Built on the first call for the mask.
+        const RenderList& GetRenderList( unsigned layerMask );
+        /// Re-evaluates game objects whose render state has changed and inserts or removes them in renderLists.
+        void UpdateRenderLists();
+        /// Moves a game object between render lists.
+        /// \param slot Game object's slot.
+        /// \param mesh Game object's mesh, or null if it's not rendered.
+        /// \param layer Game object's layer, or 0 if it's not rendered.
+        void SetRenderListEntry( unsigned slot, class Mesh* mesh, unsigned layer );
+        /// Inserts a game object into renderList by its mesh in renderListEntries.
+        void InsertIntoRenderList( RenderList& renderList, unsigned slot );
+        static void RemoveFromRenderList( RenderList& renderList, unsigned slot );
+        /// Queries meshTree for the render list's game objects whose bounds may intersect the frustum.
+        /// Fills queriedGameObjects and their indices to the render list in queriedIndices.
+        void QueryRenderList( const Frustum& frustum, const RenderList& renderList );
+        /// Moves queriedVisibleMask's bits to the render list's indices in outVisibleMask. Game objects that were not queried are invisible.
+        void ScatterQueriedVisibleMask( const RenderList& renderList, std::vector< std::uint32_t >& outVisibleMask ) const;
+        /// Queries meshTree and culls the game objects that it finds with CullMeshRenderers.
+        /// \param outVisibleMask Bit i is set if renderList.gameObjects[ i ] is at least partially visible.
+        void CullRenderList( const Frustum& frustum, const RenderList& renderList, std::vector< std::uint32_t >& outVisibleMask );
+        /// Tests mesh renderers' world bounds against the frustum in one batch and culls visible meshes' sub-meshes.
+        /// \param outVisibleMask Bit i is set if gameObjectsWithMeshRenderer[ i ] is at least partially visible.
+        void CullMeshRenderers( const Frustum& frustum, const std::vector< GameObject* >& gameObjectsWithMeshRenderer, std::vector< std::uint32_t >& outVisibleMask );
+        /// Rasterizes the visible occluders and clears inOutVisibleMask's bits of occludees that are hidden behind them.
+        void CullOccludedMeshRenderers( const Matrix44& viewProjection, const std::vector< GameObject* >& gameObjectsWithMeshRenderer, std::vector< std::uint32_t >& inOutVisibleMask );
         void GenerateAABB();
+        /// Rebuilds componentLists if components or game objects have been added or removed since the last call.
+        void UpdateComponentLists();
+        /// \return The shortest component list of the types in typeMask.
+        const std::vector< unsigned >& GetShortestComponentList( unsigned typeMask );
+        /// \param typeMask Component types.
+        /// \param outGameObjects Receives game objects that have at least one of the types, in scene order.
+        void GetGameObjectsWithAnyComponent( unsigned typeMask, std::vector< GameObject* >& outGameObjects );
+
+        /// Render list for cameras with the same layer mask. Kept sorted by mesh.
+        struct RenderList
+        {
+            /// Value of indexBySlot for game objects that are not in the list.
+            static const unsigned NotListed = 0xFFFFFFFFu;
+
+            std::vector< GameObject* > gameObjects;
+            /// Slots of gameObjects in Scene::gameObjects.
+            std::vector< unsigned > slots;
+            /// Index to gameObjects by the game object's slot in Scene::gameObjects, or NotListed.
+            std::vector< unsigned > indexBySlot;
+        };
+
+        /// Game object's state in renderLists. Kept in sync with gameObjects by index.
+        struct RenderListEntry
+        {
+            class Mesh* mesh = nullptr;
+            /// Layer of a listed game object, 0 if it's not in any render list.
+            unsigned layer = 0;
+            /// GameObject::renderStateChange when the entry was updated.
+            unsigned renderStateChange = 0;
+            bool isUpToDate = false;
+        };
+
+        /// Sub-mesh draw of RenderWithCamera.
+        struct DrawItem
+        {
+            /// Pass, render state and depth packed so that drawing in ascending key order minimizes state changes.
+            std::uint64_t key;
+            /// Index to the render list.
+            unsigned gameObjectIndex;
+            unsigned subMeshIndex;
+        };
+
+        /// Consecutive sorted draws that are drawn with one draw call.
+        struct DrawBatch
+        {
+            /// Index to drawItems.
+            unsigned firstItem = 0;
+            unsigned itemCount = 0;
+            /// Index to instanceModelMatrices. Used if isInstanced is true.
+            unsigned firstInstance = 0;
+            /// True, if the items are drawn with one DrawInstanced. Their shader reads the model matrices from instance attributes.
+            bool isInstanced = false;
+            /// True, if the items are drawn with one DrawIndirect. Their shader reads the model matrices from a storage block.
+            bool isDrawIndirect = false;
+        };
+
+        /// \param ids Ids of the sort key field that pointer goes into.
+        /// \param pointer Shader, material or mesh.
+        /// \return Small id for sort keys. The same pointer gets the same id until ids are renumbered.
+        static unsigned GetSortKeyId( std::unordered_map< const void*, unsigned >& ids, const void* pointer );
+        /// Renumbers the ids of sort key fields that have run out of bits, eg. after many materials have been created and destroyed.
+        void RenumberFullSortKeyIds();
+
+        /// Mesh renderer's state in meshTree. Kept in sync with gameObjects by index.
+        struct MeshTreeEntry
+        {
+            int proxy = AABBTree::NullProxy;
+            class Mesh* mesh = nullptr;
+            /// Mesh::GetContentVersion when the proxy was fitted, so that a reloaded mesh is fitted again.
+            unsigned meshContentVersion = 0;
+            Matrix44 localToWorld;
+        };
 
+        /// Slot map of game objects. Removing leaves a null hole that a later Add reuses, so the other game objects keep their slots.
         std::vector< GameObject* > gameObjects;
-        unsigned nextFreeGameObject = 0;
+        std::vector< unsigned > freeGameObjectSlots;
+        std::unordered_map< GameObject*, unsigned > gameObjectSlots;
+        /// Indices to gameObjects for each component type, ascending.
+        std::vector< unsigned > componentLists[ GameObject::MaxComponentTypes ];
+        unsigned componentListsVersion = 0;
+        bool areComponentListsDirty = true;
+        std::vector< MeshTreeEntry > meshTreeEntries;
+        AABBTree meshTree;
+        /// Structure-of-arrays scratch buffer for CullMeshRenderers.
+        std::vector< float > cullBounds;
+        /// Result of the latest CullMeshRenderers or CullRenderList call.
+        std::vector< std::uint32_t > visibleMask;
+        /// Scratch buffer for meshTree queries. Holds game objects' slots.
+        std::vector< void* > meshTreeQueryResult;
+        /// Render list's game objects that the latest QueryRenderList found, their indices to the render list and their CullMeshRenderers result.
+        std::vector< GameObject* > queriedGameObjects;
+        std::vector< unsigned > queriedIndices;
+        std::vector< std::uint32_t > queriedVisibleMask;
+        /// Draws of the latest RenderWithCamera, sorted by key.
+        std::vector< DrawItem > drawItems;
+        /// Scratch buffer for sorting drawItems.
+        std::vector< DrawItem > drawItemsScratch;
+        /// Draw calls of the latest RenderWithCamera.
+        std::vector< DrawBatch > drawBatches;
+        /// Model matrices of instanced draws, uploaded once per RenderWithCamera.
+        std::vector< Matrix44 > instanceModelMatrices;
+        /// Scratch buffers for a DrawIndirect batch's vertex buffers and model matrices.
+        std::vector< class VertexBuffer* > indirectVertexBuffers;
+        std::vector< Matrix44 > indirectModelMatrices;
+        /// Scratch buffer for a GPU-culled DrawIndirect batch's sub-mesh bounds, 6 floats per draw.
+        std::vector< float > indirectLocalBounds;
+        CullingMode cullingMode = CullingMode::CPU;
+        LightCullingMode lightCullingMode = LightCullingMode::GPUTiled;
+        bool isOcclusionCullingEnabled = false;
+        /// Ids of shaders, materials and meshes in sort keys. Each field has its own ids.
+        /// Pointers of destroyed objects keep their ids until RenumberFullSortKeyIds clears a full field.
+        std::unordered_map< const void*, unsigned > shaderSortKeyIds;
+        std::unordered_map< const void*, unsigned > materialSortKeyIds;
+        std::unordered_map< const void*, unsigned > meshSortKeyIds;
+        /// Render lists by camera layer mask.
+        std::unordered_map< unsigned, RenderList > renderLists;
+        std::vector< RenderListEntry > renderListEntries;
+        /// GameObject's versions when renderLists were updated.
+        unsigned renderListsRenderStateVersion = 0;
+        unsigned renderListsHierarchyVersion = 0;
+        /// Set when game objects are added, so that UpdateRenderLists evaluates them.
+        bool areRenderListsDirty = true;
         TextureCube* skybox = nullptr;
         Vec3 aabbMin;
         Vec3 aabbMax;
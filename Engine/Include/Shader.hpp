@@ -1,171 +1,299 @@
-#ifndef SHADER_H
-#define SHADER_H
-
-#include <map>
-#include <string>
-#if RENDERER_METAL
-#import <Metal/Metal.h>
-#endif
-#if RENDERER_D3D12
-#include <d3d12.h>
-#include <d3dcompiler.h>
-#endif
-#if RENDERER_VULKAN
-#include <vulkan/vulkan.h>
-#include <cstdint>
-#endif
-
-namespace ae3d
-{
-    namespace FileSystem
-    {
-        struct FileContentsData;
-    }
-    
-    /// Shader program containing a vertex and pixel shader.
-    class Shader
-    {
-    public:
-        /// Loads a GLSL or HLSL shader from source code. For portability it's better to call the other
-        /// load method that can take all shaders as input.
-        /// \param vertexSource Vertex shader source. Language depends on the renderer.
-        /// \param fragmentSource Fragment shader source. Language depends on the renderer.
-        void Load( const char* vertexSource, const char* fragmentSource );
-#if RENDERER_VULKAN
-        bool IsValid() const { return true; }
-
-        /// Loads SPIR-V shader.
-        /// \param spirvData SPIR-V file contents.
-        void LoadSPIRV( const FileSystem::FileContentsData& vertexData, const FileSystem::FileContentsData& fragmentData );
-#endif
-        /// \param vertexDataGLSL GLSL Vertex shader file contents.
-        /// \param fragmentDataGLSL GLSL Fragment shader file contents.
-        /// \param metalVertexShaderName Vertex shader name for Metal renderer. Must be referenced by the application's Xcode project.
-        /// \param metalFragmentShaderName Fragment shader name for Metal renderer. Must be referenced by the application's Xcode project.
-        /// \param vertexDataHLSL HLSL Vertex shader file contents.
-        /// \param fragmentDataHLSL HLSL Fragment shader file contents.
-        /// \param vertexDataSPIRV SPIR-V vertex shader file contents.
-        /// \param fragmentDataSPIRV SPIR-V fragment shader file contents.
-        void Load( const FileSystem::FileContentsData& vertexDataGLSL, const FileSystem::FileContentsData& fragmentDataGLSL,
-                   const char* metalVertexShaderName, const char* metalFragmentShaderName,
-                   const FileSystem::FileContentsData& vertexDataHLSL, const FileSystem::FileContentsData& fragmentDataHLSL,
-                   const FileSystem::FileContentsData& vertexDataSPIRV, const FileSystem::FileContentsData& fragmentDataSPIRV );
-        
-#if RENDERER_METAL
-        void LoadFromLibrary( const char* vertexShaderName, const char* fragmentShaderName );
-#endif
-#if RENDERER_OPENGL
-        /// \return True if the shader has been succesfully compiled and linked.
-        bool IsValid() const { return handle != 0; }
-        // Checks that the rendering state is valid.
-        void Validate();
-        unsigned GetHandle() const { return handle; }
-#endif
-        
-        /// Activates the shader to be used in a draw call.
-        void Use();
-
-        /// \param name Matrix uniform name.
-        /// \param matrix4x4 Contents of Matrix44.
-        void SetMatrix( const char* name, const float* matrix4x4 );
-
-        /// \param name Texture uniform name.
-        /// \param texture Texture.
-        /// \param textureUnit Texture unit.
-        void SetTexture( const char* name, class Texture2D* texture, int textureUnit );
-
-        /// \param name Texture uniform name.
-        /// \param texture Texture.
-        /// \param textureUnit Texture unit.
-        void SetTexture( const char* name, class TextureCube* texture, int textureUnit );
-
-        /// \param name Texture uniform name.
-        /// \param renderTexture RenderTexture.
-        /// \param textureUnit Texture unit.
-        void SetRenderTexture( const char* name, class RenderTexture* renderTexture, int textureUnit );
-
-        /// \param name Integer uniform name.
-        /// \param value Value.
-        void SetInt( const char* name, int value );
-
-        /// \param name Float uniform name.
-        /// \param value Value.
-        void SetFloat( const char* name, float value );
-
-        /// \param name Vector uniform name.
-        /// \param vec3 Vec3 contents.
-        void SetVector3( const char* name, const float* vec3 );
-
-        /// \param name Vector uniform name.
-        /// \param vec4 Vec4 contents.
-        void SetVector4( const char* name, const float* vec4 );
-
-#if RENDERER_NULL
-        bool IsValid() const { return true; }
-#endif
-#if RENDERER_D3D12
-        bool IsValid() const { return blobShaderVertex != nullptr; }
-        ID3DBlob* blobShaderVertex = nullptr;
-        ID3DBlob* blobShaderPixel = nullptr;
-#endif
-
-#if RENDERER_METAL
-        bool IsValid() const { return vertexProgram != nullptr; }
-
-        const std::string& GetMetalVertexShaderName() const { return metalVertexShaderName; }
-        
-        enum class UniformType { Float, Float2, Float3, Float4, Matrix4x4 };
-        
-        struct Uniform
-        {
-            UniformType type = UniformType::Float;
-            unsigned long offsetFromBufferStart = 0;
-            float floatValue[ 4 ];
-            float matrix4x4[ 16 ];
-        };
-
-        // TODO: make private
-        std::map< std::string, Uniform > uniforms;
-        
-        void LoadUniforms( MTLRenderPipelineReflection* reflection );
-
-        id <MTLFunction> vertexProgram;
-        id <MTLFunction> fragmentProgram;
-#endif
-#if RENDERER_VULKAN
-        VkPipelineShaderStageCreateInfo& GetVertexInfo() { return vertexInfo; }
-        VkPipelineShaderStageCreateInfo& GetFragmentInfo() { return fragmentInfo; }
-#endif
-        static void DestroyShaders();
-
-        /// Wraps an int that is defaulted to -1. Needed for uniform handling.
-        struct IntDefaultedToMinusOne
-        {
-            /// -1 means unused/missing uniform.
-            int i = -1;
-        };
-
-    private:
-        std::string vertexPath;
-        std::string fragmentPath;
-
-#if RENDERER_D3D12
-        void ReflectVariables();
-
-        ID3D12ShaderReflection* reflector = nullptr;
-        std::map<std::string, IntDefaultedToMinusOne > uniformLocations;
-#endif
-#if RENDERER_VULKAN
-        VkPipelineShaderStageCreateInfo vertexInfo;
-        VkPipelineShaderStageCreateInfo fragmentInfo;        
-#endif
-#if RENDERER_OPENGL
-        unsigned handle = 0;
-        std::map<std::string, IntDefaultedToMinusOne > uniformLocations;
-#endif
-#if RENDERER_METAL
-        std::string metalVertexShaderName;
-#endif
-    };
-}
-#endif
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#if RENDERER_METAL
+#import <Metal/Metal.h>
+#endif
+#if RENDERER_D3D12
+#include <d3d12.h>
+#include <d3dcompiler.h>
+#endif
+#if RENDERER_VULKAN
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#endif
+
+namespace ae3d
+{
+    namespace FileSystem
+    {
+        struct FileContentsData;
+    }
+    
+    /// Shader program containing a vertex and pixel shader.
+    class Shader
+    {
+    public:
+        /// Loads a GLSL or HLSL shader from source code. For portability it's better to call the other
+        /// load method that can take all shaders as input.
+        /// \param vertexSource Vertex shader source. Language depends on the renderer.
+        /// \param fragmentSource Fragment shader source. Language depends on the renderer.
+        void Load( const char* vertexSource, const char* fragmentSource );
+#if RENDERER_VULKAN
+        bool IsValid() const { return true; }
+
+        /// Loads SPIR-V shader.
+        /// \param spirvData SPIR-V file contents.
+        void LoadSPIRV( const FileSystem::FileContentsData& vertexData, const FileSystem::FileContentsData& fragmentData );
+#endif
+        /// \param vertexDataGLSL GLSL Vertex shader file contents.
+        /// \param fragmentDataGLSL GLSL Fragment shader file contents.
+        /// \param metalVertexShaderName Vertex shader name for Metal renderer. Must be referenced by the application's Xcode project.
+        /// \param metalFragmentShaderName Fragment shader name for Metal renderer. Must be referenced by the application's Xcode project.
+        /// \param vertexDataHLSL HLSL Vertex shader file contents.
+        /// \param fragmentDataHLSL HLSL Fragment shader file contents.
+        /// \param vertexDataSPIRV SPIR-V vertex shader file contents.
+        /// \param fragmentDataSPIRV SPIR-V fragment shader file contents.
+        void Load( const FileSystem::FileContentsData& vertexDataGLSL, const FileSystem::FileContentsData& fragmentDataGLSL,
+                   const char* metalVertexShaderName, const char* metalFragmentShaderName,
+                   const FileSystem::FileContentsData& vertexDataHLSL, const FileSystem::FileContentsData& fragmentDataHLSL,
+                   const FileSystem::FileContentsData& vertexDataSPIRV, const FileSystem::FileContentsData& fragmentDataSPIRV );
+        
+#if RENDERER_METAL
+        void LoadFromLibrary( const char* vertexShaderName, const char* fragmentShaderName );
+#endif
+#if RENDERER_OPENGL
+        /// \return True if the shader has been succesfully compiled and linked.
+        bool IsValid() const { return handle != 0; }
+        // Checks that the rendering state is valid.
+        void Validate();
+        unsigned GetHandle() const { return handle; }
+
+        /// Uploads changed PerObject and PerFrame uniform block contents into the uniform ring and binds them. Called internally before a draw.
+        void UploadUniformBlocks();
+
+        /// Binding point of the std140 uniform block PerObject. Its members are written by the setters and uploaded into
+        /// the uniform ring as one block instead of separate glProgramUniform calls.
+        static const unsigned PerObjectBinding = 0;
+
+        /// Binding point of the std140 uniform block PerFrame. It must be declared identically in all shaders,
+        /// because its contents are shared and uploaded once per frame or when a member changes. Used for Material's globals.
+        static const unsigned PerFrameBinding = 1;
+
+        /// Binding point of the std430 storage block PerDraw that DrawIndirect fills with model matrices, one per gl_DrawID.
+        static const unsigned PerDrawBinding = 2;
+
+        /// Binding points of the std430 storage blocks that GfxDevice::UploadLightClusters fills for clustered forward shading.
+        /// ClusteredLights holds LightClusterer::Light structs, LightClusters one uvec2 offset and count per cluster into LightIndices.
+        static const unsigned ClusteredLightsBinding = 4;
+        static const unsigned LightIndicesBinding = 5;
+        static const unsigned LightClustersBinding = 6;
+#endif
+        
+        /// Activates the shader to be used in a draw call.
+        void Use();
+
+        /// \return True, if the vertex shader reads its model matrix from the per-instance attribute aInstanceModelMatrix
+        /// instead of uniforms. Scene then draws repeated meshes with one instanced draw. Instanced shaders get
+        /// _ViewProjectionMatrix and _ShadowViewProjectionMatrix uniforms.
+        bool IsInstanced() const { return isInstanced; }
+
+        /// \return True, if the vertex shader reads its model matrix from the storage block PerDraw, indexed by gl_DrawID.
+        /// Scene then draws opaque sub-meshes that share a material and a MeshArena page with one multi-draw-indirect call.
+        /// These shaders get the same uniforms as instanced shaders. OpenGL only.
+        bool IsDrawIndirect() const { return isDrawIndirect; }
+
+        /// \param name Matrix uniform name.
+        /// \param matrix4x4 Contents of Matrix44.
+        void SetMatrix( const char* name, const float* matrix4x4 );
+
+        /// \param name Texture uniform name.
+        /// \param texture Texture.
+        /// \param textureUnit Texture unit.
+        void SetTexture( const char* name, class Texture2D* texture, int textureUnit );
+
+        /// \param name Texture uniform name.
+        /// \param texture Texture.
+        /// \param textureUnit Texture unit.
+        void SetTexture( const char* name, class TextureCube* texture, int textureUnit );
+
+        /// \param name Texture uniform name.
+        /// \param renderTexture RenderTexture.
+        /// \param textureUnit Texture unit.
+        void SetRenderTexture( const char* name, class RenderTexture* renderTexture, int textureUnit );
+
+        /// \param name Integer uniform name.
+        /// \param value Value.
+        void SetInt( const char* name, int value );
+
+        /// \param name Float uniform name.
+        /// \param value Value.
+        void SetFloat( const char* name, float value );
+
+        /// \param name Vector uniform name.
+        /// \param vec3 Vec3 contents.
+        void SetVector3( const char* name, const float* vec3 );
+
+        /// \param name Vector uniform name.
+        /// \param vec4 Vec4 contents.
+        void SetVector4( const char* name, const float* vec4 );
+
+        /// Interns a uniform name. Ids are stable for the lifetime of the application and shared by all shaders,
+        /// so they can be looked up once and stored, avoiding string hashing in per-draw code.
+        /// \param name Uniform name.
+        /// \return Property id.
+        static int GetPropertyId( const char* name );
+
+        /// \param propertyId Id returned by GetPropertyId.
+        /// \return Uniform name.
+        static const char* GetPropertyName( int propertyId );
+
+        /// \param propertyId Matrix uniform id from GetPropertyId.
+        /// \param matrix4x4 Contents of Matrix44.
+        void SetMatrix( int propertyId, const float* matrix4x4 );
+
+        /// \param propertyId Texture uniform id from GetPropertyId.
+        /// \param texture Texture.
+        /// \param textureUnit Texture unit.
+        void SetTexture( int propertyId, class Texture2D* texture, int textureUnit );
+
+        /// \param propertyId Texture uniform id from GetPropertyId.
+        /// \param texture Texture.
+        /// \param textureUnit Texture unit.
+        void SetTexture( int propertyId, class TextureCube* texture, int textureUnit );
+
+        /// \param propertyId Texture uniform id from GetPropertyId.
+        /// \param renderTexture RenderTexture.
+        /// \param textureUnit Texture unit.
+        void SetRenderTexture( int propertyId, class RenderTexture* renderTexture, int textureUnit );
+
+        /// \param propertyId Integer uniform id from GetPropertyId.
+        /// \param value Value.
+        void SetInt( int propertyId, int value );
+
+        /// \param propertyId Float uniform id from GetPropertyId.
+        /// \param value Value.
+        void SetFloat( int propertyId, float value );
+
+        /// \param propertyId Vector uniform id from GetPropertyId.
+        /// \param vec3 Vec3 contents.
+        void SetVector3( int propertyId, const float* vec3 );
+
+        /// \param propertyId Vector uniform id from GetPropertyId.
+        /// \param vec4 Vec4 contents.
+        void SetVector4( int propertyId, const float* vec4 );
+
+        /// Stamp of the Material::Apply that last uploaded its values into this shader. Used by Material to skip
+        /// values that are already in the shader. Reset when the shader is reloaded.
+        unsigned appliedMaterialStamp = 0;
+
+        /// Material's global value version that was last uploaded into this shader.
+        unsigned appliedGlobalsVersion = 0;
+
+#if RENDERER_NULL
+        bool IsValid() const { return true; }
+#endif
+#if RENDERER_D3D12
+        bool IsValid() const { return blobShaderVertex != nullptr; }
+        ID3DBlob* blobShaderVertex = nullptr;
+        ID3DBlob* blobShaderPixel = nullptr;
+#endif
+
+#if RENDERER_METAL
+        bool IsValid() const { return vertexProgram != nullptr; }
+
+        const std::string& GetMetalVertexShaderName() const { return metalVertexShaderName; }
+        
+        enum class UniformType { Float, Float2, Float3, Float4, Matrix4x4 };
+        
+        struct Uniform
+        {
+            UniformType type = UniformType::Float;
+            unsigned long offsetFromBufferStart = 0;
+            float floatValue[ 4 ];
+            float matrix4x4[ 16 ];
+        };
+
+        // TODO: make private
+        std::map< std::string, Uniform > uniforms;
+        
+        void LoadUniforms( MTLRenderPipelineReflection* reflection );
+
+        id <MTLFunction> vertexProgram;
+        id <MTLFunction> fragmentProgram;
+#endif
+#if RENDERER_VULKAN
+        VkPipelineShaderStageCreateInfo& GetVertexInfo() { return vertexInfo; }
+        VkPipelineShaderStageCreateInfo& GetFragmentInfo() { return fragmentInfo; }
+#endif
+        static void DestroyShaders();
+
+        /// Wraps an int that is defaulted to -1. Needed for uniform handling.
+        struct IntDefaultedToMinusOne
+        {
+            /// -1 means unused/missing uniform.
+            int i = -1;
+        };
+
+    private:
+        std::string vertexPath;
+        std::string fragmentPath;
+        bool isInstanced = false;
+        bool isDrawIndirect = false;
+
+#if RENDERER_D3D12
+        void ReflectVariables();
+
+        ID3D12ShaderReflection* reflector = nullptr;
+        std::map<std::string, IntDefaultedToMinusOne > uniformLocations;
+#endif
+#if RENDERER_VULKAN
+        VkPipelineShaderStageCreateInfo vertexInfo;
+        VkPipelineShaderStageCreateInfo fragmentInfo;        
+#endif
+#if RENDERER_OPENGL
+        /// Compiled layout entry of a property id.
+        struct PropertyLocation
+        {
+            /// -2 means not resolved yet, -1 means the shader doesn't have the uniform or it's in a uniform block.
+            int location = -2;
+            /// Location of <name>_ST that textures use for their scale and offset.
+            int scaleOffsetLocation = -1;
+            /// Byte offset in the PerObject or PerFrame block, -1 if the uniform is not in either.
+            int blockOffset = -1;
+            /// True, if blockOffset is in the PerFrame block.
+            bool isPerFrame = false;
+        };
+
+        /// CPU copy of a uniform block's contents.
+        struct UniformBlock
+        {
+            std::vector< unsigned char > data;
+            /// Offset of the latest upload in the uniform ring.
+            unsigned ringOffset = 0;
+            /// Uniform ring frame of the latest upload. The upload is not valid in later frames.
+            unsigned ringFrame = ~0u;
+            bool isDirty = true;
+        };
+
+        /// Writes a uniform into PerObject or PerFrame if it's a member of either.
+        /// \return True, if the uniform is in a block.
+        bool WriteBlockMember( const PropertyLocation& property, const void* value, unsigned byteCount );
+
+        /// Uploads the block if it has changed or was uploaded in an earlier frame and binds it.
+        static void UploadUniformBlock( UniformBlock& block, unsigned binding );
+
+        /// Shared by all shaders that declare PerFrame.
+        static UniformBlock perFrameBlock;
+
+        /// \return Location of a property id, resolved from uniformLocations on first use.
+        const PropertyLocation& GetPropertyLocation( int propertyId );
+
+        unsigned handle = 0;
+        std::map<std::string, IntDefaultedToMinusOne > uniformLocations;
+        /// Indexed by property id.
+        std::vector< PropertyLocation > propertyLayout;
+        UniformBlock perObjectBlock;
+        /// GL block indices, -1 if the shader doesn't declare the block.
+        int perObjectBlockIndex = -1;
+        int perFrameBlockIndex = -1;
+#endif
+#if RENDERER_METAL
+        std::string metalVertexShaderName;
+#endif
+    };
+}
+#endif
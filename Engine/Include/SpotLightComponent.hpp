@@ -33,6 +33,12 @@ namespace ae3d
         /// \param degrees Angle in degrees.
         void SetConeAngle( float degrees ) { coneAngle = degrees; }
 
+        /// \return Range along the cone. Used by clustered light culling.
+        float GetRadius() const { return radius; }
+
+        /// \param aRadius Range along the cone.
+        void SetRadius( float aRadius ) { radius = aRadius; }
+
         /// \param aColor Color in range 0-1.
         void SetColor( const Vec3& aColor ) { color = aColor; }
 
@@ -49,13 +55,19 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static SpotLightComponent* Get( unsigned index );
+        /// \param handle Handle returned by New.
+        /// \return Component or null if the handle is stale.
+        static SpotLightComponent* Get( unsigned handle );
+
+        /// Releases the component's slot for reuse.
+        /// \param handle Handle returned by New.
+        static void Delete( unsigned handle );
         
         RenderTexture shadowMap;
         GameObject* gameObject = nullptr;
         Vec3 color{ 1, 1, 1 };
         float coneAngle = 45;
+        float radius = 10;
         bool castsShadow = false;
     };
 }
@@ -99,7 +99,10 @@
  
    Aether3D internals almost never read raw files, all file access is abstracted by FileSystem to allow file contents to come from various sources.
    CombineFiles creates .pak files that contain contents of multiple files. You run it with command <code>CombineFiles inputFile outputFile</code> where
-   inputFile is just a text file containing a list of file paths, each on their own line.
+   inputFile is just a text file containing a list of file paths, each on their own line. The .pak has a hashed table of contents
+   and is memory-mapped when loaded, so only the entries that are read take memory. The layout is documented in PakFormat.hpp.
+   With <code>CombineFiles -compress inputFile outputFile</code> entries are compressed with LZ4 in parallel and each entry's ratio
+   and throughput is printed. Entries that don't compress are stored as is. FileSystem decompresses entries when they are read.
 
    \subsection SDF_Generator
 
@@ -119,6 +122,10 @@ namespace ae3d
         /// Inits the gamepad.
         void InitGamePad();
 
+        /// Starts JobSystem's worker threads. If not called, they're started on first use.
+        /// \param workerCount Worker thread count. If negative, uses one less than the number of hardware threads.
+        void InitJobSystem( int workerCount );
+
         /// Creates a buffer for line drawing.
         /// \param lines Lines.
         /// \param color Color.
@@ -156,10 +163,12 @@ namespace ae3d
 #if RENDERER_METAL
         void InitMetal( id< MTLDevice > metalDevice, MTKView* view, int sampleCount );
         void SetCurrentDrawableMetal( id <CAMetalDrawable> drawable, MTLRenderPassDescriptor* renderPass );
-        void BeginFrame();
         void EndFrame();
 #endif
 
+        /// Call at the start of every frame, before Scene::Render(). Runs uploads queued by AssetLoader within its budget.
+        void BeginFrame();
+
         /**
           \param condition Condition that causes the assert to fire when true.
           \param message Assert message to be displayed when condition is true.
@@ -177,7 +186,7 @@ namespace ae3d
         */
         void Print( const char* format, ... );
 
-        /// Reloads assets that have been changed on disk. Relatively slow operation, so avoid calling too often.
+        /// Reloads assets that have been changed on disk. On Linux only files that had inotify events are checked, elsewhere every loaded asset file is checked, so avoid calling too often.
         void ReloadChangedAssets();
 
         /// Tests internal functionality.
@@ -190,6 +199,18 @@ namespace ae3d
             int GetVertexBufferBindCount();
             int GetTextureBindCount();
             int GetShaderBindCount();
+            /// \return Shader binds that sorting draws by state saved compared to drawing in scene order.
+            int GetShaderBindSavedCount();
+            /// \return Texture binds that sorting draws by material saved.
+            int GetTextureBindSavedCount();
+            /// \return Draws that CPU culling found visible, counted only in Scene::CullingMode::CompareCPUAndGPU.
+            int GetCpuVisibleDrawCount();
+            /// \return Draws that GPU culling found visible, counted only in Scene::CullingMode::CompareCPUAndGPU.
+            int GetGpuVisibleDrawCount();
+            /// \return Mesh renderers that Scene's occlusion culling found hidden behind occluders.
+            int GetOccludedMeshCount();
+            /// \return Time LightClusterer spent assigning lights to clusters in the last Scene::LightCullingMode::CPUClustered frame.
+            float GetLightAssignmentTimeMS();
             int GetRenderTargetBindCount();
             int GetBarrierCallCount();
             int GetFenceCallCount();
@@ -53,8 +53,11 @@ namespace ae3d
         /** \return Component handle that uniquely identifies the instance. */
         static unsigned New();
         
-        /** \return Component at index or null if index is invalid. */
-        static TextRendererComponent* Get( unsigned index );
+        /** \return Component or null if the handle is stale. */
+        static TextRendererComponent* Get( unsigned handle );
+
+        /** Releases the component's slot for reuse. */
+        static void Delete( unsigned handle );
 
         /** \param projectionModelMatrix Projection and model matrix combined. */
         void Render( const float* projectionModelMatrix );
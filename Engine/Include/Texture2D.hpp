@@ -10,7 +10,7 @@ namespace ae3d
 {
     namespace FileSystem
     {
-        struct FileContentsData;
+        struct FileView;
     }
 
     /// 2D texture.
@@ -26,7 +26,7 @@ namespace ae3d
         /// \param mipmaps Mipmaps
         /// \param colorSpace Color space.
         /// \param anisotropy Anisotropy. Value range is 1-16 depending on support. On Metal the value is bucketed into 1, 2, 4, 8 and 16.
-        void Load( const FileSystem::FileContentsData& textureData, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy );
+        void Load( const FileSystem::FileView& textureData, TextureWrap wrap, TextureFilter filter, Mipmaps mipmaps, ColorSpace colorSpace, Anisotropy anisotropy );
         
         /// \param atlasTextureData Atlas texture image data. File format must be dds, png, tga, jpg, bmp or bmp.
         /// \param atlasMetaData Atlas metadata. Format is Ogre/CEGUI. Example atlas tool: Texture Packer.
@@ -35,7 +35,7 @@ namespace ae3d
         /// \param filter Filter mode.
         /// \param colorSpace Color space.
         /// \param anisotropy Anisotropy. Value range is 1-16 depending on support. On Metal the value is bucketed into 1, 2, 4, 8 and 16.
-        void LoadFromAtlas( const FileSystem::FileContentsData& atlasTextureData, const FileSystem::FileContentsData& atlasMetaData, const char* textureName, TextureWrap wrap, TextureFilter filter, ColorSpace colorSpace, Anisotropy anisotropy );
+        void LoadFromAtlas( const FileSystem::FileView& atlasTextureData, const FileSystem::FileView& atlasMetaData, const char* textureName, TextureWrap wrap, TextureFilter filter, ColorSpace colorSpace, Anisotropy anisotropy );
 
 #if RENDERER_VULKAN
         VkImageView& GetView() { return view; }
@@ -51,13 +51,13 @@ namespace ae3d
 
           \param textureData Texture data.
           */
-        void LoadSTB( const FileSystem::FileContentsData& textureData );
+        void LoadSTB( const FileSystem::FileView& textureData );
 #if RENDERER_METAL
         void LoadPVRv2( const char* path );
         void LoadPVRv3( const char* path );
 #endif
 #if RENDERER_VULKAN
-        void CreateVulkanObjects( void* data, int bytesPerPixel, VkFormat format );
+        void CreateVulkanObjects( const void* data, int bytesPerPixel, VkFormat format );
         VkImage image = VK_NULL_HANDLE;
         VkImageView view = VK_NULL_HANDLE;
         VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
@@ -94,12 +94,18 @@ namespace ae3d
         /// \return Component handle that uniquely identifies the instance.
         static unsigned New();
         
-        /// \return Component at index or null if index is invalid.
-        static TransformComponent* Get( unsigned index );
+        /// \return Component or null if the handle is stale.
+        static TransformComponent* Get( unsigned handle );
 
-        /// Updates matrices.
+        /// Releases the component's slot for reuse. Children of the component lose their parent.
+        static void Delete( unsigned handle );
+
+        /// Updates matrices of transforms that have changed since the last call, and their descendants.
         static void UpdateLocalMatrices();
 
+        /// Sorts transforms so that parents are updated before their children, and drops deleted transforms from the order.
+        static void SortHierarchy();
+
         void SolveLocalMatrix();
 
         Vec3 localPosition;
@@ -109,7 +115,11 @@ namespace ae3d
         Quaternion globalRotation;
         Matrix44 localMatrix;
         Matrix44 localToWorldMatrix;
-        int parent = -1;
+        // Parent's handle or 0 if there is no parent.
+        unsigned parent = 0;
+        bool isDirty = true;
+        // Set when a transform gets this as its parent. Not cleared, so it may be set for a former parent.
+        bool hasChildren = false;
 #if defined( OCULUS_RIFT ) || defined( AE3D_OPENVR )
         Matrix44 hmdView; // For VR
 #endif
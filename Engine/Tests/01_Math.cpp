@@ -1,4 +1,8 @@
 #include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "Frustum.hpp"
 #include "Vec3.hpp"
 #include "Matrix.hpp"
 #include "Quaternion.hpp"
@@ -308,6 +312,44 @@ void TestQuaternion()
     }
 }
 
+void TestFrustumBatch()
+{
+    Frustum frustum;
+    frustum.SetProjection( 45, 4.0f / 3.0f, 1, 200 );
+    frustum.Update( Vec3( 0, 0, 0 ), Vec3( 0, 0, 1 ) );
+
+    // Not a multiple of 8 or 4 so that the scalar tail is tested too.
+    const int count = 75;
+    std::vector< float > centers[ 3 ];
+    std::vector< float > extents[ 3 ];
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            centers[ axis ].push_back( (std::rand() % 400) - 200.0f );
+            extents[ axis ].push_back( (std::rand() % 20) + 0.5f );
+        }
+    }
+
+    std::vector< std::uint32_t > visibleMask( (count + 31) / 32 );
+    frustum.BoxesInFrustum( centers[ 0 ].data(), centers[ 1 ].data(), centers[ 2 ].data(),
+                            extents[ 0 ].data(), extents[ 1 ].data(), extents[ 2 ].data(), count, visibleMask.data() );
+
+    for (int i = 0; i < count; ++i)
+    {
+        const Vec3 center( centers[ 0 ][ i ], centers[ 1 ][ i ], centers[ 2 ][ i ] );
+        const Vec3 extent( extents[ 0 ][ i ], extents[ 1 ][ i ], extents[ 2 ][ i ] );
+        const bool isVisible = ((visibleMask[ i / 32 ] >> (i % 32)) & 1) != 0;
+
+        if (isVisible != frustum.BoxInFrustum( center - extent, center + extent ))
+        {
+            std::cerr << "Frustum::BoxesInFrustum failed!" << std::endl;
+            return;
+        }
+    }
+}
+
 int main()
 {
     TestVec3();
@@ -316,6 +358,7 @@ int main()
     TestMatrixMultiply();
     TestMatrixInverse();
     TestQuaternion();
+    TestFrustumBatch();
 }
 
     
@@ -0,0 +1,620 @@
+// Renders a scene with the headless null renderer and inspects the recorded commands.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "CameraComponent.hpp"
+#include "FileSystem.hpp"
+#include "GameObject.hpp"
+#include "GfxDevice.hpp"
+#include "LightTiler.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "PointLightComponent.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "System.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+namespace GfxDeviceGlobal
+{
+    extern ae3d::LightTiler lightTiler;
+}
+
+int CountCommands( GfxDevice::Command::Type type )
+{
+    int count = 0;
+
+    for (const auto& command : GfxDevice::GetCommandLog())
+    {
+        count += command.type == type ? 1 : 0;
+    }
+
+    return count;
+}
+
+bool HasUniform( const char* name )
+{
+    for (const auto& command : GfxDevice::GetCommandLog())
+    {
+        if (command.type == GfxDevice::Command::Type::SetUniform && command.uniformName == name)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main()
+{
+    const int width = 512;
+    const int height = 512;
+
+    Window::Create( width, height, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    GameObject camera;
+    camera.AddComponent< CameraComponent >();
+    camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    camera.GetComponent< CameraComponent >()->SetProjection( 45, (float)width / (float)height, 1, 200 );
+    camera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    camera.AddComponent< TransformComponent >();
+
+    Mesh cubeMesh;
+    const Mesh::LoadResult loadResult = cubeMesh.Load( FileSystem::FileContents( "../../Tools/Editor/copy_to_output/textured_cube.ae3d" ) );
+    System::Assert( loadResult == Mesh::LoadResult::Success, "could not load cube mesh" );
+
+    Shader shader;
+    shader.Load( "", "" );
+
+    Material material;
+    material.SetShader( &shader );
+    material.SetVector( "tint", Vec4( 1, 1, 1, 1 ) );
+
+    GameObject visibleCube;
+    visibleCube.AddComponent< MeshRendererComponent >();
+    visibleCube.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+    visibleCube.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+    visibleCube.AddComponent< TransformComponent >();
+    visibleCube.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -50 } );
+
+    GameObject culledCube;
+    culledCube.AddComponent< MeshRendererComponent >();
+    culledCube.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+    culledCube.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+    culledCube.AddComponent< TransformComponent >();
+    culledCube.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, 50 } );
+
+    Scene scene;
+    scene.Add( &camera );
+    scene.Add( &visibleCube );
+    scene.Add( &culledCube );
+
+    GfxDevice::ClearCommandLog();
+    scene.Render();
+
+    System::Assert( CountCommands( GfxDevice::Command::Type::ClearScreen ) == 1, "camera should clear once" );
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "only the cube in front of the camera should be drawn" );
+    System::Assert( HasUniform( "_ModelViewProjectionMatrix" ), "draw should set the MVP matrix" );
+    System::Assert( HasUniform( "tint" ), "draw should apply material uniforms" );
+
+    for (const auto& command : GfxDevice::GetCommandLog())
+    {
+        if (command.type == GfxDevice::Command::Type::Draw)
+        {
+            System::Assert( command.shader == &shader, "draw should use the material's shader" );
+            System::Assert( command.depthFunc == GfxDevice::DepthFunc::LessOrEqualWriteOn, "opaque draw should write depth" );
+        }
+    }
+
+    Window::SwapBuffers();
+    System::Assert( GfxDevice::GetCommandLog().empty(), "present should clear the command log" );
+
+    culledCube.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -60 } );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 2 * (int)cubeMesh.GetSubMeshCount(), "moved cube should be drawn" );
+    System::Assert( !HasUniform( "tint" ), "unchanged material values should not be uploaded again" );
+    Window::SwapBuffers();
+
+    material.SetVector( "tint", Vec4( 1, 0, 0, 1 ) );
+    scene.Render();
+    System::Assert( HasUniform( "tint" ), "changed material value should be uploaded" );
+    Window::SwapBuffers();
+
+    // Moving a parent must update its child even though the child itself didn't change.
+    GameObject parent;
+    parent.AddComponent< TransformComponent >();
+    parent.GetComponent< TransformComponent >()->SetLocalPosition( { 10, 0, 0 } );
+    culledCube.GetComponent< TransformComponent >()->SetParent( parent.GetComponent< TransformComponent >() );
+    scene.Add( &parent );
+    scene.Render();
+    System::Assert( culledCube.GetComponent< TransformComponent >()->GetLocalToWorldMatrix().m[ 12 ] == 10, "child should follow its parent" );
+    Window::SwapBuffers();
+
+    parent.GetComponent< TransformComponent >()->SetLocalPosition( { 20, 0, 0 } );
+    scene.Render();
+    System::Assert( culledCube.GetComponent< TransformComponent >()->GetLocalToWorldMatrix().m[ 12 ] == 20, "child should follow its moved parent" );
+    System::Assert( culledCube.GetComponent< TransformComponent >()->GetLocalToWorldMatrix().m[ 14 ] == -60, "child's own position should be kept" );
+    Window::SwapBuffers();
+
+    // Render lists are cached, so state changes must still be seen.
+    visibleCube.SetEnabled( false );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "disabled cube should not be drawn" );
+    Window::SwapBuffers();
+
+    visibleCube.SetEnabled( true );
+    visibleCube.SetLayer( 2 );
+    camera.GetComponent< CameraComponent >()->SetLayerMask( 1 );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "cube in another layer should not be drawn" );
+    Window::SwapBuffers();
+
+    visibleCube.SetLayer( 1 );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 2 * (int)cubeMesh.GetSubMeshCount(), "cube moved back to the camera's layer should be drawn" );
+    Window::SwapBuffers();
+
+    parent.SetEnabled( false );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "child of a disabled parent should not be drawn" );
+    Window::SwapBuffers();
+
+    parent.SetEnabled( true );
+    culledCube.GetComponent< MeshRendererComponent >()->SetMesh( nullptr );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "cube without a mesh should not be drawn" );
+    Window::SwapBuffers();
+
+    culledCube.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 2 * (int)cubeMesh.GetSubMeshCount(), "cube with a mesh again should be drawn" );
+    Window::SwapBuffers();
+
+    int meshObjectCount = 0;
+    scene.ForEach< TransformComponent, MeshRendererComponent >( [&]( GameObject& gameObject, TransformComponent&, MeshRendererComponent& meshRenderer )
+    {
+        System::Assert( gameObject.GetComponent< MeshRendererComponent >() == &meshRenderer, "query should pass the game object's component" );
+        ++meshObjectCount;
+    } );
+    System::Assert( meshObjectCount == 2, "query should visit only game objects with all the components" );
+
+    scene.Remove( &visibleCube );
+    scene.Render();
+    System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "removed cube should not be drawn" );
+    Window::SwapBuffers();
+
+    // Batch spawning and despawning.
+    {
+        std::vector< GameObject > spawned( 100 );
+        std::vector< GameObject* > spawnedPointers;
+
+        for (auto& gameObject : spawned)
+        {
+            gameObject.AddComponent< MeshRendererComponent >();
+            gameObject.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+            gameObject.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+            gameObject.AddComponent< TransformComponent >();
+            gameObject.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -70 } );
+            spawnedPointers.push_back( &gameObject );
+        }
+
+        scene.AddRange( spawnedPointers );
+        scene.AddRange( spawnedPointers );
+        scene.Render();
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 101 * (int)cubeMesh.GetSubMeshCount(), "spawned cubes should be drawn once each" );
+        Window::SwapBuffers();
+
+        scene.RemoveRange( spawnedPointers );
+        scene.Render();
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)cubeMesh.GetSubMeshCount(), "despawned cubes should not be drawn" );
+        Window::SwapBuffers();
+    }
+
+    // Draws are sorted by state, and transparent draws back-to-front.
+    {
+        Shader otherShader;
+        otherShader.Load( "", "" );
+
+        Material otherMaterial;
+        otherMaterial.SetShader( &otherShader );
+
+        Material transparentMaterial;
+        transparentMaterial.SetShader( &shader );
+        transparentMaterial.SetBlendingMode( Material::BlendingMode::Alpha );
+
+        Scene sortScene;
+        sortScene.Add( &camera );
+
+        std::vector< GameObject > cubes( 6 );
+        Material* cubeMaterials[] = { &material, &otherMaterial, &material, &otherMaterial, &transparentMaterial, &transparentMaterial };
+        const float cubeDepths[] = { -50, -55, -60, -65, -50, -70 };
+
+        for (std::size_t i = 0; i < cubes.size(); ++i)
+        {
+            cubes[ i ].AddComponent< MeshRendererComponent >();
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( cubeMaterials[ i ], 0 );
+            cubes[ i ].AddComponent< TransformComponent >();
+            cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, cubeDepths[ i ] } );
+            sortScene.Add( &cubes[ i ] );
+        }
+
+        sortScene.Render();
+
+        int shaderChanges = 0;
+        const Shader* previousShader = nullptr;
+        std::vector< float > transparentDepths;
+        float worldZ = 0;
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::SetUniform && command.uniformName == "_ModelMatrix")
+            {
+                worldZ = command.uniformValue[ 14 ];
+            }
+            else if (command.type == GfxDevice::Command::Type::Draw)
+            {
+                shaderChanges += command.shader != previousShader ? 1 : 0;
+                previousShader = command.shader;
+
+                if (command.blendMode == GfxDevice::BlendMode::AlphaBlend)
+                {
+                    transparentDepths.push_back( worldZ );
+                }
+            }
+        }
+
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 6 * (int)cubeMesh.GetSubMeshCount(), "all sorted cubes should be drawn" );
+        System::Assert( shaderChanges == 3, "opaque draws should be grouped by shader" );
+        System::Assert( System::Statistics::GetShaderBindSavedCount() == 2, "sorting should save shader binds" );
+        System::Assert( transparentDepths.size() == 2 && transparentDepths[ 0 ] < transparentDepths[ 1 ], "transparent draws should be back-to-front" );
+        Window::SwapBuffers();
+    }
+
+    // Repeated meshes with an instanced shader are drawn with one instanced draw.
+    {
+        Shader instancedShader;
+        instancedShader.Load( "layout (location = 5) in mat4 aInstanceModelMatrix;", "" );
+        System::Assert( instancedShader.IsInstanced(), "shader with instance attribute should be instanced" );
+
+        Material instancedMaterial;
+        instancedMaterial.SetShader( &instancedShader );
+
+        Scene instanceScene;
+        instanceScene.Add( &camera );
+
+        std::vector< GameObject > cubes( 5 );
+
+        for (std::size_t i = 0; i < cubes.size(); ++i)
+        {
+            cubes[ i ].AddComponent< MeshRendererComponent >();
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &instancedMaterial, 0 );
+            cubes[ i ].AddComponent< TransformComponent >();
+            cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (float)i, 0, -50 - (float)i } );
+            instanceScene.Add( &cubes[ i ] );
+        }
+
+        instanceScene.Render();
+
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 0, "instanced cubes should not be drawn one by one" );
+        System::Assert( CountCommands( GfxDevice::Command::Type::DrawInstanced ) == (int)cubeMesh.GetSubMeshCount(), "cubes should be drawn with one instanced draw" );
+        System::Assert( HasUniform( "_ViewProjectionMatrix" ), "instanced draw should set the view-projection matrix" );
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::DrawInstanced)
+            {
+                System::Assert( command.instanceCount == 5 && command.firstInstance == 0, "instanced draw should draw every cube" );
+            }
+        }
+
+        Window::SwapBuffers();
+    }
+
+    // A lone or transparent draw with an instanced shader is an instanced draw of one, because the shader reads its matrix from instance data.
+    {
+        Shader instancedShader;
+        instancedShader.Load( "layout (location = 5) in mat4 aInstanceModelMatrix;", "" );
+
+        Material instancedMaterial;
+        instancedMaterial.SetShader( &instancedShader );
+
+        Material transparentInstancedMaterial;
+        transparentInstancedMaterial.SetShader( &instancedShader );
+        transparentInstancedMaterial.SetBlendingMode( Material::BlendingMode::Alpha );
+
+        Scene instanceScene;
+        instanceScene.Add( &camera );
+
+        std::vector< GameObject > cubes( 2 );
+        Material* cubeMaterials[] = { &instancedMaterial, &transparentInstancedMaterial };
+
+        for (std::size_t i = 0; i < cubes.size(); ++i)
+        {
+            cubes[ i ].AddComponent< MeshRendererComponent >();
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( cubeMaterials[ i ], 0 );
+            cubes[ i ].AddComponent< TransformComponent >();
+            cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (float)i, 0, -50 - (float)i } );
+            instanceScene.Add( &cubes[ i ] );
+        }
+
+        instanceScene.Render();
+
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 0, "instanced shader should not be drawn with Draw" );
+        System::Assert( CountCommands( GfxDevice::Command::Type::DrawInstanced ) == 2 * (int)cubeMesh.GetSubMeshCount(), "each cube should be an instanced draw" );
+        System::Assert( HasUniform( "_ViewProjectionMatrix" ), "instanced draw should set the view-projection matrix" );
+
+        int firstInstance = 0;
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::DrawInstanced)
+            {
+                System::Assert( command.instanceCount == 1 && command.firstInstance == firstInstance, "each cube should have its own instance" );
+                ++firstInstance;
+            }
+        }
+
+        Window::SwapBuffers();
+    }
+
+    // Different meshes in the same MeshArena page with a draw-indirect shader are drawn with one indirect draw.
+    {
+        Shader indirectShader;
+        indirectShader.Load( "layout (std430, binding = 2) buffer PerDraw { mat4 _ModelMatrices[]; };", "" );
+        System::Assert( indirectShader.IsDrawIndirect(), "shader with PerDraw block should be draw-indirect" );
+
+        Material indirectMaterial;
+        indirectMaterial.SetShader( &indirectShader );
+
+        Mesh otherCubeMesh;
+        otherCubeMesh.Load( FileSystem::FileContents( "../../Tools/Editor/copy_to_output/textured_cube.ae3d" ) );
+
+        Scene indirectScene;
+        indirectScene.Add( &camera );
+
+        std::vector< GameObject > cubes( 5 );
+
+        for (std::size_t i = 0; i < cubes.size(); ++i)
+        {
+            cubes[ i ].AddComponent< MeshRendererComponent >();
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMesh( i < 3 ? &cubeMesh : &otherCubeMesh );
+            cubes[ i ].GetComponent< MeshRendererComponent >()->SetMaterial( &indirectMaterial, 0 );
+            cubes[ i ].AddComponent< TransformComponent >();
+            cubes[ i ].GetComponent< TransformComponent >()->SetLocalPosition( { (float)i, 0, -50 - (float)i } );
+            indirectScene.Add( &cubes[ i ] );
+        }
+
+        indirectScene.Render();
+
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 0, "indirect cubes should not be drawn one by one" );
+        System::Assert( CountCommands( GfxDevice::Command::Type::DrawIndirect ) == 1, "cubes should be drawn with one indirect draw" );
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::DrawIndirect)
+            {
+                System::Assert( command.instanceCount == 5 * (int)cubeMesh.GetSubMeshCount(), "indirect draw should draw every cube" );
+            }
+        }
+
+        Window::SwapBuffers();
+
+        // GPU culling skips the cube behind the camera just like CPU culling.
+        cubes[ 4 ].GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, 500 } );
+        indirectScene.SetCullingMode( Scene::CullingMode::CompareCPUAndGPU );
+        indirectScene.Render();
+
+        System::Assert( System::Statistics::GetCpuVisibleDrawCount() == 4 * (int)cubeMesh.GetSubMeshCount(), "CPU culling should skip the cube behind the camera" );
+        System::Assert( System::Statistics::GetGpuVisibleDrawCount() == System::Statistics::GetCpuVisibleDrawCount(), "GPU and CPU culling should agree" );
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::DrawIndirect)
+            {
+                System::Assert( command.instanceCount == 4 * (int)cubeMesh.GetSubMeshCount(), "GPU-culled indirect draw should draw the visible cubes" );
+            }
+        }
+
+        Window::SwapBuffers();
+
+        // Without comparing, cubes that only have GPU-culled draws are not culled on the CPU, but the result is the same.
+        indirectScene.SetCullingMode( Scene::CullingMode::GPU );
+        indirectScene.Render();
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::DrawIndirect)
+            {
+                System::Assert( command.instanceCount == 4 * (int)cubeMesh.GetSubMeshCount(), "GPU culling should draw the visible cubes without CPU culling" );
+            }
+        }
+
+        Window::SwapBuffers();
+
+        // Transparent draws with a draw-indirect shader are sorted back-to-front, so they are indirect draws of one.
+        Material transparentIndirectMaterial;
+        transparentIndirectMaterial.SetShader( &indirectShader );
+        transparentIndirectMaterial.SetBlendingMode( Material::BlendingMode::Alpha );
+        cubes[ 0 ].GetComponent< MeshRendererComponent >()->SetMaterial( &transparentIndirectMaterial, 0 );
+        cubes[ 1 ].GetComponent< MeshRendererComponent >()->SetMaterial( &transparentIndirectMaterial, 0 );
+        indirectScene.Render();
+
+        int transparentIndirectDraws = 0;
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            if (command.type == GfxDevice::Command::Type::DrawIndirect && command.blendMode == GfxDevice::BlendMode::AlphaBlend)
+            {
+                System::Assert( command.instanceCount == 1, "transparent indirect draw should draw one cube" );
+                ++transparentIndirectDraws;
+            }
+        }
+
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 0, "draw-indirect shader should not be drawn with Draw" );
+        System::Assert( transparentIndirectDraws == 2, "each transparent cube should be an indirect draw" );
+
+        Window::SwapBuffers();
+    }
+
+    // Point lights are counted in the tiles that their spheres touch.
+    {
+        GameObject lightCamera;
+        lightCamera.AddComponent< CameraComponent >();
+        lightCamera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+        lightCamera.GetComponent< CameraComponent >()->SetProjection( 45, (float)width / (float)height, 1, 200 );
+        lightCamera.GetComponent< CameraComponent >()->GetDepthNormalsTexture().Create2D( width, height, RenderTexture::DataType::Float, TextureWrap::Clamp, TextureFilter::Nearest );
+        lightCamera.AddComponent< TransformComponent >();
+
+        GameObject centerLight;
+        centerLight.AddComponent< PointLightComponent >();
+        centerLight.GetComponent< PointLightComponent >()->SetRadius( 1 );
+        centerLight.AddComponent< TransformComponent >();
+        centerLight.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -20 } );
+
+        GameObject lightBehindCamera;
+        lightBehindCamera.AddComponent< PointLightComponent >();
+        lightBehindCamera.GetComponent< PointLightComponent >()->SetRadius( 1 );
+        lightBehindCamera.AddComponent< TransformComponent >();
+        lightBehindCamera.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, 20 } );
+
+        Scene lightScene;
+        lightScene.Add( &lightCamera );
+        lightScene.Add( &centerLight );
+        lightScene.Add( &lightBehindCamera );
+        lightScene.Render();
+
+        std::vector< unsigned > lightCounts;
+        GfxDeviceGlobal::lightTiler.GetLightCountPerTile( lightCounts );
+        const unsigned numTilesX = GfxDeviceGlobal::lightTiler.GetNumTilesX();
+        const unsigned numTilesY = GfxDeviceGlobal::lightTiler.GetNumTilesY();
+
+        System::Assert( lightCounts.size() == numTilesX * numTilesY, "every tile should have a light count" );
+        System::Assert( lightCounts[ (numTilesY / 2) * numTilesX + numTilesX / 2 ] == 1, "light in front of the camera should be in the center tile" );
+        System::Assert( lightCounts[ 0 ] == 0 && lightCounts.back() == 0, "corner tiles should have no lights" );
+
+        Window::SwapBuffers();
+    }
+
+    // Meshes behind an occluder are culled before they are drawn.
+    {
+        GameObject wall;
+        wall.AddComponent< MeshRendererComponent >();
+        wall.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        wall.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        wall.GetComponent< MeshRendererComponent >()->SetOccluder( true );
+        wall.AddComponent< TransformComponent >();
+        wall.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -20 } );
+        wall.GetComponent< TransformComponent >()->SetLocalScale( 5 );
+
+        GameObject hiddenCube;
+        hiddenCube.AddComponent< MeshRendererComponent >();
+        hiddenCube.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        hiddenCube.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        hiddenCube.AddComponent< TransformComponent >();
+        hiddenCube.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -60 } );
+
+        GameObject sideCube;
+        sideCube.AddComponent< MeshRendererComponent >();
+        sideCube.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        sideCube.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        sideCube.AddComponent< TransformComponent >();
+        sideCube.GetComponent< TransformComponent >()->SetLocalPosition( { 22, 0, -60 } );
+
+        Scene occlusionScene;
+        occlusionScene.Add( &camera );
+        occlusionScene.Add( &wall );
+        occlusionScene.Add( &hiddenCube );
+        occlusionScene.Add( &sideCube );
+        occlusionScene.SetOcclusionCulling( true );
+
+        GfxDevice::ClearCommandLog();
+        occlusionScene.Render();
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 2 * (int)cubeMesh.GetSubMeshCount(), "cube behind the wall should not be drawn" );
+        System::Assert( System::Statistics::GetOccludedMeshCount() == 1, "only the cube behind the wall should be occluded" );
+        System::Assert( occlusionScene.WriteOcclusionDepthImage( "occlusion_depth.pgm" ), "occlusion depth buffer should be written" );
+        std::remove( "occlusion_depth.pgm" );
+        Window::SwapBuffers();
+
+        hiddenCube.GetComponent< MeshRendererComponent >()->SetOccludee( false );
+        GfxDevice::ClearCommandLog();
+        occlusionScene.Render();
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 3 * (int)cubeMesh.GetSubMeshCount(), "cube that is not an occludee should be drawn" );
+        Window::SwapBuffers();
+    }
+
+    // Loading a mesh again in place refits its bounds in the scene's AABB tree.
+    {
+        Mesh reloadedMesh;
+        reloadedMesh.Load( FileSystem::FileContents( "../../Tools/Editor/copy_to_output/textured_cube.ae3d" ) );
+
+        // The same cube, with its mesh and sub-mesh bounds reaching past the near plane.
+        FileSystem::FileContentsData longCube = FileSystem::FileContents( "../../Tools/Editor/copy_to_output/textured_cube.ae3d" );
+        const float longMinZ = -5;
+        const std::size_t meshMinZOffset = 2 + 2 * sizeof( float );
+        const std::size_t subMeshMinZOffset = 2 + 6 * sizeof( float ) + 2 + 2 * sizeof( float );
+        std::memcpy( &longCube.data[ meshMinZOffset ], &longMinZ, sizeof( float ) );
+        std::memcpy( &longCube.data[ subMeshMinZOffset ], &longMinZ, sizeof( float ) );
+        std::ofstream( "long_cube.ae3d", std::ios::binary ).write( (const char*)longCube.data.data(), (std::streamsize)longCube.data.size() );
+
+        // Between the camera and the near plane.
+        GameObject nearCube;
+        nearCube.AddComponent< MeshRendererComponent >();
+        nearCube.GetComponent< MeshRendererComponent >()->SetMesh( &reloadedMesh );
+        nearCube.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        nearCube.AddComponent< TransformComponent >();
+        nearCube.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, 0.5f } );
+
+        Scene reloadScene;
+        reloadScene.Add( &camera );
+        reloadScene.Add( &nearCube );
+        GfxDevice::ClearCommandLog();
+        reloadScene.Render();
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == 0, "cube before the near plane should be culled" );
+        Window::SwapBuffers();
+
+        System::Assert( reloadedMesh.Load( FileSystem::FileContents( "long_cube.ae3d" ) ) == Mesh::LoadResult::Success, "could not load long cube" );
+        reloadScene.Render();
+        System::Assert( CountCommands( GfxDevice::Command::Type::Draw ) == (int)reloadedMesh.GetSubMeshCount(), "reloaded cube reaching past the near plane should be drawn" );
+        Window::SwapBuffers();
+
+        std::remove( "long_cube.ae3d" );
+    }
+
+    // Removed components free their slots, and slots are reused by later components.
+    {
+        GameObject temporary;
+        temporary.AddComponent< TransformComponent >();
+        TransformComponent* removedTransform = temporary.GetComponent< TransformComponent >();
+        temporary.RemoveComponent< TransformComponent >();
+        System::Assert( temporary.GetComponent< TransformComponent >() == nullptr, "removed component should not be found" );
+
+        temporary.AddComponent< TransformComponent >();
+        System::Assert( temporary.GetComponent< TransformComponent >() == removedTransform, "freed slot should be reused" );
+        System::Assert( temporary.GetComponent< TransformComponent >()->GetLocalPosition().x == 0, "reused slot should be reset" );
+    }
+
+    // Destroying a parent detaches its children.
+    {
+        GameObject temporaryParent;
+        temporaryParent.AddComponent< TransformComponent >();
+        culledCube.GetComponent< TransformComponent >()->SetParent( temporaryParent.GetComponent< TransformComponent >() );
+    }
+
+    System::Assert( culledCube.GetComponent< TransformComponent >()->GetParent() == nullptr, "child of a destroyed parent should have no parent" );
+    scene.Render();
+    System::Assert( culledCube.GetComponent< TransformComponent >()->GetLocalToWorldMatrix().m[ 12 ] == 0, "child of a destroyed parent should move to its local position" );
+    Window::SwapBuffers();
+
+    System::Deinit();
+}
@@ -0,0 +1,64 @@
+// Runs jobs with dependencies and a ParallelFor on the job system's worker threads.
+#include <atomic>
+#include <vector>
+#include "JobSystem.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+void TestDependencies()
+{
+    std::atomic< int > firstDone{ 0 };
+    std::atomic< bool > isOrderCorrect{ true };
+
+    JobSystem::Counter first;
+    JobSystem::Counter second;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        JobSystem::Run( [ &firstDone ]() { ++firstDone; }, &first );
+    }
+
+    for (int i = 0; i < 64; ++i)
+    {
+        JobSystem::Run( [ &firstDone, &isOrderCorrect ]() { if (firstDone != 64) { isOrderCorrect = false; } }, &second, &first );
+    }
+
+    JobSystem::Wait( &second );
+
+    System::Assert( first.IsDone() && second.IsDone(), "counters should be done after Wait" );
+    System::Assert( isOrderCorrect, "dependent jobs should start after their dependency is done" );
+}
+
+void TestParallelFor()
+{
+    const int count = 100000;
+    std::vector< int > values( count, 0 );
+
+    JobSystem::ParallelFor( count, 1000, [ &values ]( int begin, int end )
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            values[ i ] += i;
+        }
+    } );
+
+    for (int i = 0; i < count; ++i)
+    {
+        System::Assert( values[ i ] == i, "ParallelFor should visit every index once" );
+    }
+}
+
+int main()
+{
+    System::InitJobSystem( 4 );
+    System::Assert( JobSystem::GetWorkerCount() == 4, "worker count should match InitJobSystem" );
+
+    TestDependencies();
+    TestParallelFor();
+
+    JobSystem::Deinit();
+
+    // Restarts on demand.
+    TestParallelFor();
+}
@@ -0,0 +1,26 @@
+// Allocates, frees and reuses ranges with the allocator that sub-allocates mesh arena buffers.
+#include "FreeListAllocator.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+int main()
+{
+    FreeListAllocator allocator( 100 );
+
+    const unsigned a = allocator.Allocate( 30 );
+    const unsigned b = allocator.Allocate( 30 );
+    const unsigned c = allocator.Allocate( 30 );
+    System::Assert( a == 0 && b == 30 && c == 60, "allocations should be packed from the start" );
+    System::Assert( allocator.Allocate( 20 ) == FreeListAllocator::InvalidOffset, "allocation larger than the free space should fail" );
+
+    allocator.Free( b, 30 );
+    System::Assert( allocator.GetFreeSize() == 40 && allocator.GetLargestFreeSize() == 30, "freed range should not merge with a used neighbour" );
+    System::Assert( allocator.Allocate( 20 ) == 30, "first fitting free range should be reused" );
+
+    allocator.Free( 30, 20 );
+    allocator.Free( a, 30 );
+    allocator.Free( c, 30 );
+    System::Assert( allocator.GetLargestFreeSize() == 100, "freeing everything should merge all ranges" );
+    System::Assert( allocator.Allocate( 100 ) == 0, "merged range should fit the whole capacity" );
+}
@@ -0,0 +1,121 @@
+// Assigns synthetic point and spot light sets to clusters and prints the assignment time and the lights-per-cluster histogram.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "LightClusterer.hpp"
+#include "Matrix.hpp"
+#include "System.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+const float FovDegrees = 45;
+const float Aspect = 16.0f / 9.0f;
+
+bool ClusterHasLight( const LightClusterer& clusterer, int clusterIndex, unsigned lightIndex )
+{
+    const LightClusterer::Cluster& cluster = clusterer.GetClusters()[ clusterIndex ];
+    const unsigned* begin = clusterer.GetLightIndices().data() + cluster.offset;
+    return std::find( begin, begin + cluster.count, lightIndex ) != begin + cluster.count;
+}
+
+// \return Cluster that contains a view space point in front of the camera.
+int GetClusterOfPoint( const LightClusterer& clusterer, const Vec3& viewPosition )
+{
+    const float tanHalfFovY = std::tan( FovDegrees * 0.5f * 3.14159265f / 180.0f );
+    const float depth = -viewPosition.z;
+    const float ndcX = viewPosition.x / (depth * tanHalfFovY * Aspect);
+    const float ndcY = viewPosition.y / (depth * tanHalfFovY);
+    const int x = std::min( (int)((ndcX + 1) * 0.5f * LightClusterer::ClustersX), LightClusterer::ClustersX - 1 );
+    const int y = std::min( (int)((ndcY + 1) * 0.5f * LightClusterer::ClustersY), LightClusterer::ClustersY - 1 );
+    return LightClusterer::GetClusterIndex( x, y, clusterer.GetDepthSlice( depth ) );
+}
+
+float Random( float min, float max )
+{
+    return min + (max - min) * (std::rand() / (float)RAND_MAX);
+}
+
+int main()
+{
+    LightClusterer clusterer;
+    clusterer.SetPerspective( FovDegrees, Aspect, 0.1f, 100 );
+    Matrix44 view;
+
+    System::Assert( clusterer.GetDepthSlice( 0.1f ) == 0 && clusterer.GetDepthSlice( 100 ) == LightClusterer::ClustersZ - 1, "near and far should map to the first and last slice" );
+    System::Assert( clusterer.GetDepthSlice( 1 ) < clusterer.GetDepthSlice( 10 ), "slices should grow with depth" );
+
+    // Small lights in front of the camera, behind it and beyond the far plane.
+    clusterer.AddPointLight( Vec3( 0, 0, -20 ), 1, Vec3( 1, 1, 1 ) );
+    clusterer.AddPointLight( Vec3( 0, 0, 20 ), 1, Vec3( 1, 1, 1 ) );
+    clusterer.AddPointLight( Vec3( 0, 0, -200 ), 1, Vec3( 1, 1, 1 ) );
+    // Narrow spot lights at the camera looking forward and backward.
+    clusterer.AddSpotLight( Vec3( 0, 0, 0 ), Vec3( 0, 0, -1 ), 50, 5, Vec3( 1, 1, 1 ) );
+    clusterer.AddSpotLight( Vec3( 0, 0, 0 ), Vec3( 0, 0, 1 ), 50, 5, Vec3( 1, 1, 1 ) );
+    clusterer.AssignLights( view );
+
+    const int centerSlice = clusterer.GetDepthSlice( 20 );
+    const int centerCluster = GetClusterOfPoint( clusterer, Vec3( 0, 0, -20 ) );
+    const int cornerCluster = LightClusterer::GetClusterIndex( 0, 0, centerSlice );
+    const int farCluster = GetClusterOfPoint( clusterer, Vec3( 0, 0, -90 ) );
+
+    System::Assert( ClusterHasLight( clusterer, centerCluster, 0 ), "point light should be in the cluster at its center" );
+    System::Assert( !ClusterHasLight( clusterer, cornerCluster, 0 ), "point light should not be in a corner cluster" );
+    System::Assert( !ClusterHasLight( clusterer, farCluster, 0 ), "point light should not be in a cluster behind it" );
+    System::Assert( ClusterHasLight( clusterer, centerCluster, 3 ) && ClusterHasLight( clusterer, GetClusterOfPoint( clusterer, Vec3( 0, 0, -40 ) ), 3 ),
+                    "spot light should be in the clusters along its axis" );
+    System::Assert( !ClusterHasLight( clusterer, cornerCluster, 3 ), "spot light should not be in a corner cluster outside its cone" );
+    System::Assert( !ClusterHasLight( clusterer, farCluster, 3 ), "spot light should not be in a cluster past its range" );
+
+    for (unsigned lightIndex : clusterer.GetLightIndices())
+    {
+        System::Assert( lightIndex == 0 || lightIndex == 3, "lights behind the camera, past the far plane or pointing away should not be assigned" );
+    }
+
+    // Many random point lights, each must at least be in the cluster that contains its center.
+    clusterer.ClearLights();
+    std::vector< Vec3 > positions;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const float depth = Random( 1, 90 );
+        const float tanHalfFovY = std::tan( FovDegrees * 0.5f * 3.14159265f / 180.0f );
+        positions.push_back( Vec3( Random( -0.9f, 0.9f ) * depth * tanHalfFovY * Aspect, Random( -0.9f, 0.9f ) * depth * tanHalfFovY, -depth ) );
+        clusterer.AddPointLight( positions.back(), Random( 0.5f, 4 ), Vec3( 1, 1, 1 ) );
+    }
+
+    for (int i = 0; i < 200; ++i)
+    {
+        clusterer.AddSpotLight( Vec3( Random( -20, 20 ), Random( -5, 5 ), Random( -80, -5 ) ), Vec3( 0, -1, 0 ), Random( 2, 10 ), Random( 10, 60 ), Vec3( 1, 1, 1 ) );
+    }
+
+    clusterer.AssignLights( view );
+
+    for (unsigned i = 0; i < positions.size(); ++i)
+    {
+        System::Assert( ClusterHasLight( clusterer, GetClusterOfPoint( clusterer, positions[ i ] ), i ), "random point light should be in the cluster at its center" );
+    }
+
+    std::size_t indexCount = 0;
+
+    for (const LightClusterer::Cluster& cluster : clusterer.GetClusters())
+    {
+        System::Assert( cluster.offset == indexCount, "cluster ranges should be packed in cluster order" );
+        indexCount += cluster.count;
+    }
+
+    System::Assert( indexCount == clusterer.GetLightIndices().size(), "cluster ranges should cover the light index list" );
+
+    std::vector< int > histogram;
+    clusterer.GetLightsPerClusterHistogram( 16, histogram );
+
+    System::Print( "Assigned %d lights to %d clusters in %.3f ms, %d light indices.\n", (int)clusterer.GetLights().size(), LightClusterer::ClusterCount,
+                   System::Statistics::GetLightAssignmentTimeMS(), (int)clusterer.GetLightIndices().size() );
+    System::Print( "Lights per cluster:\n" );
+
+    for (std::size_t i = 0; i < histogram.size(); ++i)
+    {
+        System::Print( "%s%2d: %d\n", i + 1 == histogram.size() ? ">=" : "  ", (int)i, histogram[ i ] );
+    }
+}
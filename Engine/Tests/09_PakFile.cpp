@@ -0,0 +1,171 @@
+// Combines files into .pak files with CombineFiles with and without compression, writes a version 1 .pak by hand and reads entries through FileSystem.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "FileSystem.hpp"
+#include "PakFormat.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+const int EntryCount = 100;
+
+std::string GetEntryPath( int i )
+{
+    return "pak_entry_" + std::to_string( i ) + ".txt";
+}
+
+std::string GetEntryContents( int i )
+{
+    return std::string( (std::size_t)(i * 37), (char)('a' + i % 26) ) + std::to_string( i );
+}
+
+bool HasContents( const FileSystem::FileContentsData& contents, const std::string& expected )
+{
+    return contents.isLoaded && contents.data.size() == expected.size() && std::memcmp( contents.data.data(), expected.data(), expected.size() ) == 0;
+}
+
+bool HasContents( const FileSystem::FileView& view, const std::string& expected )
+{
+    return view.isLoaded && view.size == expected.size() && std::memcmp( view.data, expected.data(), expected.size() ) == 0;
+}
+
+int main()
+{
+    std::ofstream list( "pak_list.txt" );
+
+    for (int i = 0; i < EntryCount; ++i)
+    {
+        std::ofstream( GetEntryPath( i ), std::ios::binary ) << GetEntryContents( i );
+        list << GetEntryPath( i ) << "\n";
+    }
+
+    // Spans many compression chunks, so it's decompressed in parallel.
+    std::string largeContents;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        largeContents += "line " + std::to_string( i * 7 ) + "\n";
+    }
+
+    std::ofstream( "pak_large.txt", std::ios::binary ) << largeContents;
+    list << "pak_large.txt\n";
+    list.close();
+
+    int result = std::system( "../../Tools/CombineFiles/CombineFiles pak_list.txt test_v2.pak" );
+    System::Assert( result == 0, "CombineFiles failed" );
+    result = std::system( "../../Tools/CombineFiles/CombineFiles -compress pak_list.txt test_compressed.pak > pak_report.txt" );
+    System::Assert( result == 0, "CombineFiles -compress failed" );
+
+    PakFormat::Header header = {};
+    std::ifstream( "test_v2.pak", std::ios::binary ).read( (char*)&header, sizeof( header ) );
+    System::Assert( PakFormat::HasMagic( header ) && header.version == PakFormat::Version && header.entryCount == EntryCount + 1, "pak header is wrong" );
+
+    std::ifstream compressed( "test_compressed.pak", std::ios::binary | std::ios::ate );
+    System::Assert( (std::size_t)compressed.tellg() * 2 < largeContents.size(), "compressed pak should be smaller" );
+    compressed.close();
+
+    // Source files are removed, so the contents can only come from the pak.
+    for (int i = 0; i < EntryCount; ++i)
+    {
+        std::remove( GetEntryPath( i ).c_str() );
+    }
+
+    std::remove( "pak_large.txt" );
+
+    const char* pakPaths[] = { "test_v2.pak", "test_compressed.pak" };
+
+    for (const char* pakPath : pakPaths)
+    {
+        FileSystem::LoadPakFile( pakPath );
+
+        for (int i = 0; i < EntryCount; ++i)
+        {
+            System::Assert( HasContents( FileSystem::FileContents( GetEntryPath( i ).c_str() ), GetEntryContents( i ) ), "pak entry has wrong contents" );
+        }
+
+        System::Assert( HasContents( FileSystem::FileContents( "pak_large.txt" ), largeContents ), "large pak entry has wrong contents" );
+        System::Assert( !FileSystem::FileContents( "pak_entry_missing.txt" ).isLoaded, "missing entry should not be found" );
+        System::Assert( !FileSystem::FileContentsView( "pak_entry_missing.txt" ).isLoaded, "missing entry should not be viewed" );
+
+        // Views keep the mapping or decompressed contents alive after the pak is unloaded.
+        const FileSystem::FileView largeView = FileSystem::FileContentsView( "pak_large.txt" );
+        const FileSystem::FileView entryView = FileSystem::FileContentsView( GetEntryPath( 5 ).c_str() );
+        FileSystem::UnloadPakFile( pakPath );
+        System::Assert( HasContents( largeView, largeContents ), "large pak entry view has wrong contents" );
+        System::Assert( HasContents( entryView, GetEntryContents( 5 ) ), "pak entry view has wrong contents" );
+    }
+
+    // A compressed entry with a zero chunk size has no chunks, so it must be rejected instead of returning uninitialized contents.
+    {
+        std::fstream corrupt( "test_compressed.pak", std::ios::binary | std::ios::in | std::ios::out );
+        PakFormat::Header compressedHeader = {};
+        corrupt.read( (char*)&compressedHeader, sizeof( compressedHeader ) );
+        const std::uint64_t largeHash = PakFormat::HashPath( "pak_large.txt", (std::uint32_t)std::strlen( "pak_large.txt" ) );
+
+        for (std::uint32_t i = 0; i < compressedHeader.entryCount; ++i)
+        {
+            const std::streamoff entryOffset = (std::streamoff)(compressedHeader.tocOffset + i * sizeof( PakFormat::TocEntry ));
+            PakFormat::TocEntry entry = {};
+            corrupt.seekg( entryOffset );
+            corrupt.read( (char*)&entry, sizeof( entry ) );
+
+            if (entry.pathHash == largeHash)
+            {
+                entry.chunkSize = 0;
+                corrupt.seekp( entryOffset );
+                corrupt.write( (const char*)&entry, sizeof( entry ) );
+            }
+        }
+    }
+
+    FileSystem::LoadPakFile( "test_compressed.pak" );
+    System::Assert( !FileSystem::FileContents( "pak_large.txt" ).isLoaded, "entry with zero chunk size should be corrupt" );
+    System::Assert( !FileSystem::FileContentsView( "pak_large.txt" ).isLoaded, "entry with zero chunk size should not be viewed" );
+    System::Assert( HasContents( FileSystem::FileContents( GetEntryPath( 7 ).c_str() ), GetEntryContents( 7 ) ), "other entries should still be read" );
+    FileSystem::UnloadPakFile( "test_compressed.pak" );
+
+    FileSystem::LoadPakFile( "test_v2.pak" );
+
+    // Version 1: entry count, then a 128 byte path, size and contents for each entry.
+    {
+        std::ofstream legacy( "test_v1.pak", std::ios::binary );
+        const unsigned legacyEntryCount = 2;
+        legacy.write( (const char*)&legacyEntryCount, 4 );
+
+        for (unsigned i = 0; i < legacyEntryCount; ++i)
+        {
+            char path[ 128 ] = {};
+            std::strcpy( path, ("legacy_" + GetEntryPath( (int)i )).c_str() );
+            const std::string contents = GetEntryContents( (int)i + 1 );
+            const unsigned size = (unsigned)contents.size();
+            legacy.write( path, 128 );
+            legacy.write( (const char*)&size, 4 );
+            legacy.write( contents.data(), size );
+        }
+    }
+
+    FileSystem::LoadPakFile( "test_v1.pak" );
+    System::Assert( HasContents( FileSystem::FileContents( ("legacy_" + GetEntryPath( 1 )).c_str() ), GetEntryContents( 2 ) ), "version 1 pak entry has wrong contents" );
+
+    FileSystem::UnloadPakFile( "test_v2.pak" );
+    System::Assert( !FileSystem::FileContents( GetEntryPath( 0 ).c_str() ).isLoaded, "unloaded pak should not be searched" );
+    System::Assert( HasContents( FileSystem::FileContents( ("legacy_" + GetEntryPath( 0 )).c_str() ), GetEntryContents( 1 ) ), "other pak should stay loaded" );
+    FileSystem::UnloadPakFile( "test_v1.pak" );
+
+    // Files that are not in a pak are mapped directly.
+    std::ofstream( "pak_loose.txt", std::ios::binary ) << GetEntryContents( 3 );
+    System::Assert( HasContents( FileSystem::FileContentsView( "pak_loose.txt" ), GetEntryContents( 3 ) ), "loose file view has wrong contents" );
+    std::remove( "pak_loose.txt" );
+
+    std::remove( "pak_list.txt" );
+    std::remove( "test_v2.pak" );
+    std::remove( "test_v1.pak" );
+    std::remove( "test_compressed.pak" );
+    std::remove( "pak_report.txt" );
+
+    System::Print( "Read %d entries from uncompressed and compressed paks.\n", EntryCount + 1 );
+}
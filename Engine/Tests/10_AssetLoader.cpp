@@ -0,0 +1,135 @@
+// Loads assets with AssetLoader on the null renderer and checks placeholders, the per-frame upload budget and failures.
+#include <cstdio>
+#include <string>
+#include "AssetLoader.hpp"
+#include "CameraComponent.hpp"
+#include "GameObject.hpp"
+#include "GfxDevice.hpp"
+#include "Material.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TransformComponent.hpp"
+#include "Window.hpp"
+
+using namespace ae3d;
+
+int main()
+{
+    Window::Create( 512, 512, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+    // Reads run on AssetLoader's I/O thread, so they finish without JobSystem workers.
+    System::InitJobSystem( 0 );
+
+    const char* assetPath = "../../Tools/Editor/copy_to_output/";
+    const std::string texturePath = std::string( assetPath ) + "camera.png";
+    const std::string otherTexturePath = std::string( assetPath ) + "light.png";
+    const std::string meshPath = std::string( assetPath ) + "textured_cube.ae3d";
+
+    Texture2D texture;
+    Texture2D otherTexture;
+    Texture2D missingTexture;
+    Mesh mesh;
+
+    const AssetLoader::Handle textureHandle = AssetLoader::LoadTexture( &texture, texturePath.c_str(), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::None, ColorSpace::SRGB, Anisotropy::k1 );
+    const AssetLoader::Handle otherTextureHandle = AssetLoader::LoadTexture( &otherTexture, otherTexturePath.c_str(), TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::None, ColorSpace::SRGB, Anisotropy::k1 );
+    const AssetLoader::Handle missingHandle = AssetLoader::LoadTexture( &missingTexture, "asset_loader_missing.png", TextureWrap::Repeat, TextureFilter::Linear, Mipmaps::None, ColorSpace::SRGB, Anisotropy::k1 );
+    const AssetLoader::Handle meshHandle = AssetLoader::LoadMesh( &mesh, meshPath.c_str() );
+
+    // Nothing is uploaded before BeginFrame, so placeholders are in use.
+    System::Assert( AssetLoader::GetLoadingCount() == 4, "all loads should be pending" );
+    System::Assert( textureHandle.GetState() == AssetLoader::State::Loading, "texture should be loading" );
+    System::Assert( texture.GetID() == Texture2D::GetDefaultTexture()->GetID(), "texture should be the default texture while loading" );
+    System::Assert( mesh.GetSubMeshCount() == 1 && mesh.GetPath().empty(), "mesh should be the default cube while loading" );
+
+    // A zero budget runs one upload per frame.
+    AssetLoader::SetUploadBudget( 0 );
+    int frameCount = 0;
+
+    while (AssetLoader::GetLoadingCount() > 0)
+    {
+        const int loadingCountBefore = AssetLoader::GetLoadingCount();
+        System::BeginFrame();
+        System::Assert( AssetLoader::GetLoadingCount() >= loadingCountBefore - 1, "budget should limit uploads to one per frame" );
+        ++frameCount;
+        System::Assert( frameCount < 100000, "loads did not finish" );
+    }
+
+    System::Assert( frameCount >= 4, "uploads should be spread over frames" );
+    System::Assert( textureHandle.IsReady() && otherTextureHandle.IsReady() && meshHandle.IsReady(), "loads should be ready" );
+    System::Assert( texture.GetWidth() == 64 && texture.GetHeight() == 64, "texture has wrong size" );
+    System::Assert( texture.GetID() != Texture2D::GetDefaultTexture()->GetID(), "texture should not share the default texture's handle" );
+    System::Assert( mesh.GetPath() == meshPath, "mesh has wrong path" );
+
+    System::Assert( missingHandle.GetState() == AssetLoader::State::Failed, "missing texture should fail" );
+    System::Assert( missingTexture.GetID() == Texture2D::GetDefaultTexture()->GetID(), "failed texture should keep the placeholder" );
+
+    // WaitForAll finishes loads without frames.
+    Mesh otherMesh;
+    const AssetLoader::Handle otherMeshHandle = AssetLoader::LoadMesh( &otherMesh, meshPath.c_str() );
+    AssetLoader::WaitForAll();
+    System::Assert( otherMeshHandle.IsReady() && otherMesh.GetPath() == meshPath, "WaitForAll should finish loads" );
+
+    // A renderer that shows the placeholder cube while the mesh is uploaded gets the uploaded mesh's sub-meshes.
+    {
+        Shader shader;
+        shader.Load( "", "" );
+        Material material;
+        material.SetShader( &shader );
+
+        GameObject camera;
+        camera.AddComponent< CameraComponent >();
+        camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+        camera.GetComponent< CameraComponent >()->SetProjection( 45, 1, 1, 200 );
+        camera.AddComponent< TransformComponent >();
+
+        Mesh multiMesh;
+        const std::string multiMeshPath = std::string( assetPath ) + "cursor_translate.ae3d";
+        const AssetLoader::Handle multiMeshHandle = AssetLoader::LoadMesh( &multiMesh, multiMeshPath.c_str() );
+
+        GameObject meshObject;
+        meshObject.AddComponent< MeshRendererComponent >();
+        meshObject.GetComponent< MeshRendererComponent >()->SetMesh( &multiMesh );
+        meshObject.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        meshObject.AddComponent< TransformComponent >();
+        meshObject.GetComponent< TransformComponent >()->SetLocalPosition( { 0, 0, -10 } );
+
+        Scene scene;
+        scene.Add( &camera );
+        scene.Add( &meshObject );
+
+        while (!multiMeshHandle.IsReady())
+        {
+            System::Assert( multiMeshHandle.GetState() == AssetLoader::State::Loading, "multi-sub-mesh mesh failed to load" );
+            System::BeginFrame();
+            scene.Render();
+            Window::SwapBuffers();
+        }
+
+        System::Assert( multiMesh.GetSubMeshCount() > 1, "uploaded mesh should have several sub-meshes" );
+        scene.Render();
+        Window::SwapBuffers();
+
+        for (unsigned i = 0; i < multiMesh.GetSubMeshCount(); ++i)
+        {
+            meshObject.GetComponent< MeshRendererComponent >()->SetMaterial( &material, (int)i );
+        }
+
+        int drawCount = 0;
+        scene.Render();
+
+        for (const auto& command : GfxDevice::GetCommandLog())
+        {
+            drawCount += command.type == GfxDevice::Command::Type::Draw ? 1 : 0;
+        }
+
+        System::Assert( drawCount == (int)multiMesh.GetSubMeshCount(), "every sub-mesh of the uploaded mesh should be drawn" );
+        Window::SwapBuffers();
+    }
+
+    System::Deinit();
+    System::Print( "Loaded assets over %d frames.\n", frameCount );
+}
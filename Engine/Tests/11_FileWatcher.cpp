@@ -0,0 +1,94 @@
+// Changes watched files with inotify and with polling and checks that update functions are called once per settled change, in a batch.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileWatcher.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+std::vector< std::string > gUpdatedPaths;
+
+void Write( const std::string& path, const std::string& contents )
+{
+    std::ofstream( path, std::ios::binary ) << contents;
+}
+
+void OnUpdate( const std::string& path )
+{
+    gUpdatedPaths.push_back( path );
+}
+
+// \return Paths updated by the first Poll that updated any, or none after pollCount polls.
+std::vector< std::string > PollUntilUpdated( FileWatcher& watcher, int pollCount )
+{
+    gUpdatedPaths.clear();
+
+    for (int i = 0; i < pollCount && gUpdatedPaths.empty(); ++i)
+    {
+        watcher.Poll();
+    }
+
+    return gUpdatedPaths;
+}
+
+void Test( bool usePolling )
+{
+    FileWatcher watcher;
+    watcher.SetUsePolling( usePolling );
+    watcher.SetDebounceTime( 0 );
+
+    Write( "watched_a.txt", "one" );
+    Write( "watched_b.txt", "one" );
+    watcher.AddFile( "watched_a.txt", OnUpdate );
+    // Reloads add their file again, which must not break the update that is running.
+    watcher.AddFile( "watched_b.txt", [&watcher]( const std::string& path ) { OnUpdate( path ); watcher.AddFile( path, OnUpdate ); } );
+
+    System::Assert( PollUntilUpdated( watcher, 3 ).empty(), "unchanged files should not be updated" );
+
+    // Well within the same second as the first write.
+    Write( "watched_a.txt", "two!" );
+    std::vector< std::string > updated = PollUntilUpdated( watcher, 3 );
+    System::Assert( updated.size() == 1 && updated[ 0 ] == "watched_a.txt", "change in the same second should be detected" );
+
+    Write( "watched_a.txt", "three" );
+    Write( "watched_b.txt", "three" );
+    updated = PollUntilUpdated( watcher, 3 );
+    System::Assert( updated.size() == 2, "changes should be reported in one batch" );
+
+    // Saving through a temporary file and a rename.
+    Write( "watched_tmp.txt", "four!!" );
+    std::rename( "watched_tmp.txt", "watched_b.txt" );
+    updated = PollUntilUpdated( watcher, 3 );
+    System::Assert( updated.size() == 1 && updated[ 0 ] == "watched_b.txt", "renamed file should be detected" );
+
+    // A burst of writes is reported once after it settles.
+    watcher.SetDebounceTime( 200 );
+
+    for (int i = 0; i < 5; ++i)
+    {
+        Write( "watched_a.txt", std::string( (std::size_t)(10 + i), 'x' ) );
+        watcher.Poll();
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    System::Assert( PollUntilUpdated( watcher, 1 ).empty(), "update should wait for the debounce time" );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+    updated = PollUntilUpdated( watcher, 3 );
+    System::Assert( updated.size() == 1 && updated[ 0 ] == "watched_a.txt", "burst should be reported once" );
+    System::Assert( PollUntilUpdated( watcher, 3 ).empty(), "burst should not be reported again" );
+
+    std::remove( "watched_a.txt" );
+    std::remove( "watched_b.txt" );
+}
+
+int main()
+{
+    Test( false );
+    Test( true );
+
+    System::Print( "Detected changes with inotify and polling.\n" );
+}
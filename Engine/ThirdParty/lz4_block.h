@@ -0,0 +1,288 @@
+/* lz4_block - v1.0 - public domain LZ4 block compressor and decompressor
+
+   Writes and reads the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md),
+   so blocks are interchangeable with LZ4_compress_default() and LZ4_decompress_safe().
+   This is a small greedy compressor with a 4096 entry hash table, not the reference implementation;
+   it trades some ratio for fitting in one file without dependencies.
+
+   Do this:
+      #define LZ4_BLOCK_IMPLEMENTATION
+   before you include this file in *one* C or C++ file to create the implementation.
+
+   Functions are reentrant and don't allocate, so blocks can be compressed and decompressed in parallel.
+
+   int lz4b_compress_bound( int inputSize );
+      Returns the largest possible compressed size of inputSize bytes.
+
+   int lz4b_compress( const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity );
+      Returns the compressed size, or 0 if the result does not fit into dstCapacity bytes.
+
+   int lz4b_decompress( const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity );
+      Returns the decompressed size, or -1 if src is malformed or the result does not fit into dstCapacity bytes.
+      Never reads or writes out of bounds, even with malformed input.
+*/
+#ifndef LZ4_BLOCK_INCLUDE_LZ4_BLOCK_H
+#define LZ4_BLOCK_INCLUDE_LZ4_BLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lz4b_compress_bound( int inputSize );
+int lz4b_compress( const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity );
+int lz4b_decompress( const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LZ4_BLOCK_INCLUDE_LZ4_BLOCK_H */
+
+#ifdef LZ4_BLOCK_IMPLEMENTATION
+
+#include <string.h>
+
+#define LZ4B_MIN_MATCH 4
+/* The last match must start at least this many bytes before the end of the block. */
+#define LZ4B_MF_LIMIT 12
+/* The last bytes of a block are always literals. */
+#define LZ4B_LAST_LITERALS 5
+#define LZ4B_MAX_OFFSET 65535
+#define LZ4B_HASH_LOG 12
+
+static unsigned lz4b__read32( const unsigned char* p )
+{
+    unsigned v;
+    memcpy( &v, p, 4 );
+    return v;
+}
+
+static unsigned lz4b__hash( unsigned sequence )
+{
+    return (sequence * 2654435761u) >> (32 - LZ4B_HASH_LOG);
+}
+
+/* Writes the extra bytes of a length that did not fit into the token's 4 bits. */
+static unsigned char* lz4b__write_length( unsigned char* op, size_t length )
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+/* Returns the largest size that a token, literalLength literals and the extra length bytes of both lengths can take. */
+static size_t lz4b__sequence_bound( size_t literalLength, size_t matchLength )
+{
+    return 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+}
+
+int lz4b_compress_bound( int inputSize )
+{
+    return inputSize + inputSize / 255 + 16;
+}
+
+int lz4b_compress( const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity )
+{
+    /* Position + 1 of the last sequence with each hash, 0 if there is none. */
+    unsigned table[ 1 << LZ4B_HASH_LOG ];
+    const size_t size = srcSize > 0 ? (size_t)srcSize : 0;
+    /* Positions are unsigned, so blocks shorter than LZ4B_MF_LIMIT skip the search instead of wrapping around. */
+    const size_t lastMatchStart = size >= LZ4B_MF_LIMIT ? size - LZ4B_MF_LIMIT : 0;
+    const size_t matchLimit = size >= LZ4B_LAST_LITERALS ? size - LZ4B_LAST_LITERALS : 0;
+    unsigned char* op = dst;
+    unsigned char* const opEnd = dst + (dstCapacity > 0 ? dstCapacity : 0);
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t literalLength;
+
+    memset( table, 0, sizeof( table ) );
+
+    while (size >= LZ4B_MF_LIMIT && ip <= lastMatchStart)
+    {
+        const unsigned sequence = lz4b__read32( src + ip );
+        const unsigned h = lz4b__hash( sequence );
+        const size_t ref = table[ h ];
+        table[ h ] = (unsigned)ip + 1;
+
+        if (ref != 0 && ip - (ref - 1) <= LZ4B_MAX_OFFSET && lz4b__read32( src + ref - 1 ) == sequence)
+        {
+            const size_t matchStart = ref - 1;
+            size_t matchLength = LZ4B_MIN_MATCH;
+            unsigned char* token;
+
+            while (ip + matchLength < matchLimit && src[ matchStart + matchLength ] == src[ ip + matchLength ])
+            {
+                ++matchLength;
+            }
+
+            literalLength = ip - anchor;
+
+            if (lz4b__sequence_bound( literalLength, matchLength ) > (size_t)(opEnd - op))
+            {
+                return 0;
+            }
+
+            token = op++;
+            *token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+
+            if (literalLength >= 15)
+            {
+                op = lz4b__write_length( op, literalLength - 15 );
+            }
+
+            memcpy( op, src + anchor, literalLength );
+            op += literalLength;
+            *op++ = (unsigned char)((ip - matchStart) & 0xFF);
+            *op++ = (unsigned char)((ip - matchStart) >> 8);
+
+            *token |= (unsigned char)(matchLength - LZ4B_MIN_MATCH >= 15 ? 15 : matchLength - LZ4B_MIN_MATCH);
+
+            if (matchLength - LZ4B_MIN_MATCH >= 15)
+            {
+                op = lz4b__write_length( op, matchLength - LZ4B_MIN_MATCH - 15 );
+            }
+
+            ip += matchLength;
+            anchor = ip;
+
+            /* Makes the position just before the next search findable, which helps runs. */
+            if (ip - 2 <= lastMatchStart)
+            {
+                table[ lz4b__hash( lz4b__read32( src + ip - 2 ) ) ] = (unsigned)(ip - 2) + 1;
+            }
+        }
+        else
+        {
+            /* Steps faster through data that doesn't compress. */
+            ip += 1 + ((ip - anchor) >> 6);
+        }
+    }
+
+    literalLength = size - anchor;
+
+    if (1 + literalLength / 255 + 1 + literalLength > (size_t)(opEnd - op))
+    {
+        return 0;
+    }
+
+    *op++ = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+
+    if (literalLength >= 15)
+    {
+        op = lz4b__write_length( op, literalLength - 15 );
+    }
+
+    memcpy( op, src + anchor, literalLength );
+    op += literalLength;
+
+    return (int)(op - dst);
+}
+
+int lz4b_decompress( const unsigned char* src, int srcSize, unsigned char* dst, int dstCapacity )
+{
+    const unsigned char* ip = src;
+    const unsigned char* const ipEnd = src + (srcSize > 0 ? srcSize : 0);
+    unsigned char* op = dst;
+    unsigned char* const opEnd = dst + (dstCapacity > 0 ? dstCapacity : 0);
+
+    while (ip < ipEnd)
+    {
+        const unsigned token = *ip++;
+        size_t literalLength = token >> 4;
+        size_t matchLength = token & 15;
+        size_t offset;
+        const unsigned char* match;
+
+        if (literalLength == 15)
+        {
+            unsigned char b;
+
+            do
+            {
+                if (ip >= ipEnd)
+                {
+                    return -1;
+                }
+
+                b = *ip++;
+                literalLength += b;
+            } while (b == 255);
+        }
+
+        if (literalLength > (size_t)(ipEnd - ip) || literalLength > (size_t)(opEnd - op))
+        {
+            return -1;
+        }
+
+        memcpy( op, ip, literalLength );
+        ip += literalLength;
+        op += literalLength;
+
+        /* The last sequence has only literals. */
+        if (ip == ipEnd)
+        {
+            break;
+        }
+
+        if ((size_t)(ipEnd - ip) < 2)
+        {
+            return -1;
+        }
+
+        offset = (size_t)ip[ 0 ] | ((size_t)ip[ 1 ] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > (size_t)(op - dst))
+        {
+            return -1;
+        }
+
+        if (matchLength == 15)
+        {
+            unsigned char b;
+
+            do
+            {
+                if (ip >= ipEnd)
+                {
+                    return -1;
+                }
+
+                b = *ip++;
+                matchLength += b;
+            } while (b == 255);
+        }
+
+        matchLength += LZ4B_MIN_MATCH;
+
+        if (matchLength > (size_t)(opEnd - op))
+        {
+            return -1;
+        }
+
+        match = op - offset;
+
+        if (offset >= matchLength)
+        {
+            memcpy( op, match, matchLength );
+            op += matchLength;
+        }
+        else
+        {
+            /* Overlapping match repeats the last offset bytes. */
+            while (matchLength-- > 0)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return (int)(op - dst);
+}
+
+#endif /* LZ4_BLOCK_IMPLEMENTATION */
@@ -15,6 +15,7 @@
 
 extern ae3d::FileWatcher fileWatcher;
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+unsigned char* DecodeSTB( const ae3d::FileSystem::FileView& fileContents, int& outWidth, int& outHeight, int& outComponents ); // Defined in TextureCommon.cpp
 float GetFloatAnisotropy( ae3d::Anisotropy anisotropy );
 void TransitionResource( GpuResource& gpuResource, D3D12_RESOURCE_STATES newState );
 
@@ -110,7 +111,7 @@ void TexReload( const std::string& path )
 {
     auto& tex = Texture2DGlobal::pathToCachedTexture[ path ];
 
-    tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+    tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
 }
 
 ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
@@ -181,7 +182,7 @@ ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
     return &Texture2DGlobal::defaultTexture;
 }
 
-void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+void ae3d::Texture2D::Load( const FileSystem::FileView& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     filter = aFilter;
     wrap = aWrap;
@@ -247,7 +248,7 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
 void ae3d::Texture2D::LoadDDS( const char* aPath )
 {
     DDSLoader::Output ddsOutput;
-    auto fileContents = FileSystem::FileContents( aPath );
+    auto fileContents = FileSystem::FileContentsView( aPath );
     const DDSLoader::LoadResult loadResult = DDSLoader::Load( fileContents, 0, width, height, opaque, ddsOutput );
 
     if (loadResult != DDSLoader::LoadResult::Success)
@@ -322,10 +323,10 @@ void ae3d::Texture2D::LoadDDS( const char* aPath )
     InitializeTexture( gpuResource, texResources.data(), mipLevelCount );
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileView& fileContents )
 {
     int components;
-    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
+    unsigned char* data = DecodeSTB( fileContents, width, height, components );
     System::Assert( width > 0 && height > 0, "Invalid texture dimension" );
 
     if (data == nullptr)
@@ -82,7 +82,7 @@ DDSInfo loadInfoBGR565 = { false, true, false, 1, 2 };
 DDSInfo loadInfoIndex8 = { false, false, true, 1, 1 };
 #endif
 
-DDSLoader::LoadResult DDSLoader::Load( const ae3d::FileSystem::FileContentsData& fileContents, int cubeMapFace, int& outWidth, int& outHeight, bool& outOpaque, Output& output )
+DDSLoader::LoadResult DDSLoader::Load( const ae3d::FileSystem::FileView& fileContents, int cubeMapFace, int& outWidth, int& outHeight, bool& outOpaque, Output& output )
 {
     assert( cubeMapFace >= 0 && cubeMapFace < 7 );
 
@@ -96,7 +96,7 @@ DDSLoader::LoadResult DDSLoader::Load( const ae3d::FileSystem::FileContentsData&
         return LoadResult::FileNotFound;
     }
 
-    std::memcpy( &header, fileContents.data.data(), sizeof( header ) );
+    std::memcpy( &header, fileContents.data, sizeof( header ) );
 
     assert( header.sHeader.dwMagic == DDS_MAGIC );
     assert( header.sHeader.dwSize == 124 );
@@ -208,12 +208,12 @@ DDSLoader::LoadResult DDSLoader::Load( const ae3d::FileSystem::FileContentsData&
             return LoadResult::FileNotFound;
         }
 
-        output.imageData = fileContents.data;
+        output.imageData.assign( fileContents.data, fileContents.data + fileContents.size );
         output.dataOffsets.resize( mipMapCount );
 
         for (int ix = 0; ix < mipMapCount; ++ix)
         {
-            std::memcpy( data.data(), fileContents.data.data() + fileOffset, size );
+            std::memcpy( data.data(), fileContents.data + fileOffset, size );
             output.dataOffsets[ ix ] = fileOffset;
 
             fileOffset += size;
@@ -236,12 +236,12 @@ DDSLoader::LoadResult DDSLoader::Load( const ae3d::FileSystem::FileContentsData&
 #if RENDERER_OPENGL
         std::vector< unsigned > unpacked( size * 4 );
 #endif
-        std::memcpy( &palette[ 0 ], fileContents.data.data() + fileOffset, 4 * 256 );
+        std::memcpy( &palette[ 0 ], fileContents.data + fileOffset, 4 * 256 );
         fileOffset += 4 * 256;
 
         for (int ix = 0; ix < mipMapCount; ++ix)
         {
-            std::memcpy( data.data(), fileContents.data.data() + fileOffset, size );
+            std::memcpy( data.data(), fileContents.data + fileOffset, size );
             fileOffset += size;
 
 #if RENDERER_OPENGL
@@ -272,7 +272,7 @@ DDSLoader::LoadResult DDSLoader::Load( const ae3d::FileSystem::FileContentsData&
 
         for (int ix = 0; ix < mipMapCount; ++ix)
         {
-            std::memcpy( data.data(), fileContents.data.data() + fileOffset, size );
+            std::memcpy( data.data(), fileContents.data + fileOffset, size );
             fileOffset += size;
 
 #if RENDERER_OPENGL
@@ -156,7 +156,7 @@ namespace DDSLoader
      \param outOutput Stores information needed to create D3D12 and Metal API objects. Not used in OpenGL.
      \return Load result.
      */
-    LoadResult Load( const ae3d::FileSystem::FileContentsData& fileContents, int cubeMapFace, int& outWidth, int& outHeight, bool& outOpaque, Output& outOutput );
+    LoadResult Load( const ae3d::FileSystem::FileView& fileContents, int cubeMapFace, int& outWidth, int& outHeight, bool& outOpaque, Output& outOutput );
 
     namespace
     {
@@ -3,6 +3,9 @@
 
 #include <cstdint>
 #include <vector>
+#if RENDERER_NULL
+#include <string>
+#endif
 #if RENDERER_METAL
 #import <Metal/Metal.h>
 #import <MetalKit/MetalKit.h>
@@ -12,6 +15,8 @@
 
 namespace ae3d
 {
+    class ComputeShader;
+    class LightClusterer;
     class RenderTexture;
     class VertexBuffer;
     class Shader;
@@ -83,6 +88,42 @@ namespace ae3d
 #endif
         void ClearScreen( unsigned clearFlags );
         void Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode );
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+        /// Replaces the contents of the instance buffer that DrawInstanced reads.
+        /// \param modelMatrices Model matrices, 16 floats per instance.
+        /// \param instanceCount Instance count.
+        void UploadInstanceData( const float* modelMatrices, int instanceCount );
+        /// Draws instanceCount copies of a vertex buffer range. The shader reads each instance's model matrix from the
+        /// attribute aInstanceModelMatrix at location VertexBuffer::instanceChannel.
+        /// \param firstInstance Index of the first instance's model matrix in the instance buffer.
+        /// \param instanceCount Instance count.
+        void DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, int firstInstance, int instanceCount, Shader& shader,
+                            BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode );
+#endif
+#if RENDERER_OPENGL || RENDERER_NULL
+        /// Draws whole vertex buffers with one multi-draw-indirect call. The vertex buffers must share a VAO, ie. be in the same
+        /// MeshArena page, unless there's only one. The shader reads draw i's model matrix from its PerDraw storage block with gl_DrawID.
+        /// \param vertexBuffers Vertex buffers, one per draw.
+        /// \param modelMatrices Model matrices, 16 floats per draw.
+        /// \param drawCount Draw count.
+        void DrawIndirect( VertexBuffer* const* vertexBuffers, const float* modelMatrices, int drawCount, Shader& shader,
+                           BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode );
+
+        /// Like DrawIndirect, but culls first: cullShader tests each draw's bounds against the frustum on the GPU and writes
+        /// the visible draws' commands and model matrices, so the CPU doesn't cull the draws.
+        /// \param localBounds Vertex buffers' local AABBs, 6 floats per draw: min x, y, z and max x, y, z.
+        /// \param cullShader BuiltinShaders::frustumCullShader.
+        /// \param frustumPlanes Planes from Frustum::GetPlanes.
+        /// \param outVisibleCount If not null, receives the visible draw count. Waits for the GPU, so meant for validation.
+        void DrawIndirectCulled( VertexBuffer* const* vertexBuffers, const float* modelMatrices, const float* localBounds, int drawCount,
+                                 ComputeShader& cullShader, const float* frustumPlanes, int* outVisibleCount, Shader& shader,
+                                 BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode );
+
+        /// Uploads the clusterer's lights, light index list and cluster table into the uniform ring and binds them to
+        /// Shader::ClusteredLightsBinding, Shader::LightIndicesBinding and Shader::LightClustersBinding for the following draws.
+        /// \param clusterer Clusterer whose AssignLights has been called this frame.
+        void UploadLightClusters( const LightClusterer& clusterer );
+#endif
         void DrawLines( int handle );
         void ErrorCheck( const char* info );
 
@@ -117,7 +158,77 @@ namespace ae3d
         void SetBackBufferDimensionAndFBO( int width, int height );
         void ErrorCheckFBO();
         bool HasExtension( const char* glExtension );
+
+        /// Extensions that the renderer checks at runtime.
+        struct Extensions
+        {
+            bool KHR_debug = false;
+            bool ARB_buffer_storage = false;
+            bool EXT_texture_filter_anisotropic = false;
+            bool NVX_gpu_memory_info = false;
+            bool ARB_shader_draw_parameters = false;
+            bool ARB_indirect_parameters = false;
+        };
+
+        /// \return Extensions, resolved once in Init.
+        const Extensions& GetExtensions();
+
+        /// Copies uniform block contents into this frame's part of the persistently mapped uniform ring. Grows the ring if the part is full.
+        /// \param data Block contents.
+        /// \param size Block size in bytes.
+        /// \return Offset of the copy in the ring. Valid until GetUniformRingFrame changes.
+        unsigned UploadUniforms( const void* data, unsigned size );
+
+        /// Binds a range of the uniform ring with glBindBufferRange, unless the range is already bound.
+        /// \param binding Uniform block binding point.
+        /// \param offset Offset returned by UploadUniforms.
+        /// \param size Block size in bytes.
+        void BindUniforms( unsigned binding, unsigned offset, unsigned size );
+
+        /// \return Frame counter of the uniform ring, incremented by Present and when the ring grows.
+        unsigned GetUniformRingFrame();
+
+        /// Forgets the shadowed blend, depth, cull, fill and polygon offset state so that the next draw sets it again.
+        /// Call after changing that state with GL calls outside of GfxDevice.
+        void InvalidateStateCache();
         void DebugBlitFBO( unsigned handle, int width, int height );
+#endif
+#if RENDERER_NULL
+        /// Call recorded by the null renderer instead of being sent to a graphics API.
+        struct Command
+        {
+            enum class Type { ClearScreen, Draw, DrawInstanced, DrawIndirect, DrawLines, SetRenderTarget, SetUniform, UploadLightClusters };
+
+            Type type = Type::Draw;
+            /// Draw and DrawInstanced: vertex buffer. DrawIndirect: first vertex buffer. SetRenderTarget: render texture or nullptr for the back buffer.
+            /// UploadLightClusters: LightClusterer.
+            const void* object = nullptr;
+            /// Draw, DrawInstanced, DrawIndirect and SetUniform: shader.
+            const Shader* shader = nullptr;
+            /// SetUniform: uniform name.
+            std::string uniformName;
+            /// SetUniform: value. Scalars are stored in the first element, texture units are stored as float.
+            float uniformValue[ 16 ] = {};
+            /// Draw and DrawInstanced: start index. DrawLines: line buffer handle. SetRenderTarget: cube map face. ClearScreen: clear flags.
+            /// UploadLightClusters: light count.
+            int startIndex = 0;
+            /// Draw and DrawInstanced: end index. UploadLightClusters: light index count.
+            int endIndex = 0;
+            /// DrawInstanced: index of the first instance in the instance buffer.
+            int firstInstance = 0;
+            /// DrawInstanced: instance count. DrawIndirect: draw count, or visible draw count if recorded by DrawIndirectCulled.
+            int instanceCount = 1;
+            BlendMode blendMode = BlendMode::Off;
+            DepthFunc depthFunc = DepthFunc::LessOrEqualWriteOn;
+            CullMode cullMode = CullMode::Off;
+            FillMode fillMode = FillMode::Solid;
+        };
+
+        unsigned CreateTextureId();
+        void RecordCommand( const Command& command );
+        /// \return Commands recorded since the last Present() or ClearCommandLog().
+        const std::vector< Command >& GetCommandLog();
+        void ClearCommandLog();
 #endif
     }
 }
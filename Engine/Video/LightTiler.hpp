@@ -5,6 +5,9 @@
 #if RENDERER_METAL
 #import <Metal/Metal.h>
 #endif
+#if RENDERER_VULKAN
+#include <vulkan/vulkan.h>
+#endif
 #include "Vec3.hpp"
 
 struct ID3D12Resource;
@@ -25,15 +28,58 @@ namespace ae3d
         id< MTLBuffer > GetPerTileLightIndexBuffer() { return perTileLightIndexBuffer; }
         id< MTLBuffer > GetPointLightCenterAndRadiusBuffer() { return pointLightCenterAndRadiusBuffer; }
         id< MTLBuffer > GetCullerUniforms() { return uniformBuffer; }
+#endif
+#if RENDERER_OPENGL
+        /// \return Shader storage buffer of per-tile light index lists. Each list has GetMaxNumLightsPerTile() entries and ends in 0x7fffffff.
+        unsigned GetPerTileLightIndexBuffer() const { return perTileLightIndexBuffer; }
+        /// \return Shader storage buffer of point lights' world-space center in xyz and radius in w.
+        unsigned GetPointLightCenterAndRadiusBuffer() const { return pointLightCenterAndRadiusBuffer; }
+        /// \return Shader storage buffer of point light counts per tile. Tile 0 is the bottom-left one.
+        unsigned GetLightCountPerTileBuffer() const { return lightCountPerTileBuffer; }
+#endif
+#if RENDERER_VULKAN
+        VkBuffer GetPerTileLightIndexBuffer() const { return perTileLightIndexBuffer.buffer; }
+        VkBuffer GetPointLightCenterAndRadiusBuffer() const { return pointLightCenterAndRadiusBuffer.buffer; }
+        /// \return Storage buffer of the last CullLights' CullerUniforms, which has the tile layout that the forward pass needs.
+        VkBuffer GetCullerUniforms() const { return uniformBuffer.buffer; }
+#endif
+#if RENDERER_OPENGL || RENDERER_VULKAN
+        /// Storage buffer binding points where GfxDevice's draws bind the per-tile light index lists, the point lights and CullerUniforms
+        /// for Forward+ shading. They are above the ones in Shader, because the light culler's own bindings 0-3 overlap Shader::PerDrawBinding.
+        static const unsigned PerTileLightIndicesBinding = 7;
+        static const unsigned PointLightsBinding = 8;
+        static const unsigned CullerUniformsBinding = 9;
+
+        /// \return True, if CullLights has created the per-tile light lists, so draws can bind them.
+        bool HasLightLists() const;
+#endif
+#if RENDERER_OPENGL
+        /// Binds the per-tile light lists at PerTileLightIndicesBinding, PointLightsBinding and CullerUniformsBinding. Called by GfxDevice's draws.
+        void BindLightLists() const;
+#endif
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+        /// Reads back point light counts of the last CullLights. Waits for the GPU.
+        /// \param outLightCounts Receives GetNumTilesX() * GetNumTilesY() counts, row by row from the top-left tile.
+        void GetLightCountPerTile( std::vector< unsigned >& outLightCounts );
+
+        /// Writes the last CullLights' point light counts as a binary PPM heatmap, one pixel per tile.
+        /// Empty tiles are black and the others go from blue to red as the count approaches the busiest tile's count.
+        /// \param path Output file path.
+        /// \return True, if the file was written.
+        bool WriteTileHeatmap( const char* path );
 #endif
         /// Destroys graphics API objects.
         void DestroyBuffers();
 
-    private:
+        /// \return Tile count in X direction.
         unsigned GetNumTilesX() const;
+        /// \return Tile count in Y direction.
         unsigned GetNumTilesY() const;
+        /// \return Length of one tile's light index list, including the sentinel.
         unsigned GetMaxNumLightsPerTile() const;
 
+    private:
+
 #if RENDERER_METAL
         id< MTLBuffer > uniformBuffer;
         id< MTLBuffer > pointLightCenterAndRadiusBuffer;
@@ -43,6 +89,38 @@ namespace ae3d
         ID3D12Resource* uniformBuffer = nullptr;
         ID3D12Resource* perTileLightIndexBuffer = nullptr;
         ID3D12Resource* pointLightCenterAndRadiusBuffer = nullptr;
+#endif
+#if RENDERER_OPENGL
+        unsigned uniformBuffer = 0;
+        unsigned pointLightCenterAndRadiusBuffer = 0;
+        unsigned perTileLightIndexBuffer = 0;
+        unsigned lightCountPerTileBuffer = 0;
+        // Tile count that the per-tile buffers were created for. They are recreated when the back buffer is resized.
+        unsigned bufferTileCount = 0;
+#endif
+#if RENDERER_VULKAN
+        struct Buffer
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void* mappedData = nullptr;
+        };
+
+        Buffer uniformBuffer;
+        Buffer pointLightCenterAndRadiusBuffer;
+        Buffer perTileLightIndexBuffer;
+        Buffer lightCountPerTileBuffer;
+        unsigned bufferTileCount = 0;
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkSampler depthNormalsSampler = VK_NULL_HANDLE;
+#endif
+#if RENDERER_NULL
+        // Filled by CullLights, which culls on the CPU.
+        std::vector< unsigned > lightCountPerTile;
 #endif
         std::vector< Vec4 > pointLightCenterAndRadius;
         int activePointLights = 0;
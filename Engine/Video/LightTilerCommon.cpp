@@ -0,0 +1,92 @@
+#include "LightTiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "System.hpp"
+
+// Metal and D3D12 implement these in their LightTiler files.
+#if RENDERER_OPENGL || RENDERER_VULKAN || RENDERER_NULL
+
+namespace GfxDeviceGlobal
+{
+    extern int backBufferWidth;
+    extern int backBufferHeight;
+}
+
+unsigned ae3d::LightTiler::GetNumTilesX() const
+{
+    return (unsigned)((GfxDeviceGlobal::backBufferWidth + TileRes - 1) / TileRes);
+}
+
+unsigned ae3d::LightTiler::GetNumTilesY() const
+{
+    return (unsigned)((GfxDeviceGlobal::backBufferHeight + TileRes - 1) / TileRes);
+}
+
+unsigned ae3d::LightTiler::GetMaxNumLightsPerTile() const
+{
+    const unsigned adjustmentMultipier = 32;
+
+    // I haven't tested at greater than 1080p, so cap it
+    const unsigned height = (GfxDeviceGlobal::backBufferHeight > 1080) ? 1080 : GfxDeviceGlobal::backBufferHeight;
+
+    // adjust max lights per tile down as height increases
+    return (MaxLightsPerTile - (adjustmentMultipier * (height / 120)));
+}
+
+void ae3d::LightTiler::SetPointLightPositionAndRadius( int handle, Vec3& position, float radius )
+{
+    System::Assert( handle < MaxLights, "tried to set a too high light index" );
+
+    if (handle < MaxLights)
+    {
+        activePointLights = std::max( handle + 1, activePointLights );
+        pointLightCenterAndRadius[ handle ] = Vec4( position.x, position.y, position.z, radius );
+    }
+}
+
+bool ae3d::LightTiler::WriteTileHeatmap( const char* path )
+{
+    std::vector< unsigned > lightCounts;
+    GetLightCountPerTile( lightCounts );
+
+    if (lightCounts.empty())
+    {
+        System::Print( "Light tile heatmap is empty, has CullLights been called?\n" );
+        return false;
+    }
+
+    std::ofstream file( path, std::ios::binary );
+
+    if (!file)
+    {
+        System::Print( "Could not open %s for writing the light tile heatmap.\n", path );
+        return false;
+    }
+
+    const unsigned busiestCount = *std::max_element( std::begin( lightCounts ), std::end( lightCounts ) );
+    const unsigned maxCount = std::max( busiestCount, 1u );
+    std::vector< unsigned char > pixels( lightCounts.size() * 3 );
+
+    for (std::size_t i = 0; i < lightCounts.size(); ++i)
+    {
+        if (lightCounts[ i ] == 0)
+        {
+            continue;
+        }
+
+        // Blue at one light, red at maxCount.
+        const float t = maxCount > 1 ? (lightCounts[ i ] - 1) / (float)(maxCount - 1) : 1;
+        pixels[ i * 3 + 0 ] = (unsigned char)(255 * t);
+        pixels[ i * 3 + 1 ] = (unsigned char)(255 * (1 - std::abs( t * 2 - 1 )));
+        pixels[ i * 3 + 2 ] = (unsigned char)(255 * (1 - t));
+    }
+
+    file << "P6\n" << GetNumTilesX() << " " << GetNumTilesY() << "\n255\n";
+    file.write( (const char*)pixels.data(), pixels.size() );
+
+    System::Print( "Wrote light tile heatmap %s, busiest tile has %u lights.\n", path, busiestCount );
+    return file.good();
+}
+
+#endif
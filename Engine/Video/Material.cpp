@@ -4,99 +4,201 @@
 #include "RenderTexture.hpp"
 #include "Shader.hpp"
 #include <cmath>
+#include <cstring>
 
-std::unordered_map< std::string, ae3d::RenderTexture* > ae3d::Material::sTexRTs;
-std::unordered_map< std::string, ae3d::Texture2D* > ae3d::Material::sTex2ds;
-std::unordered_map< std::string, float > ae3d::Material::sFloats;
-std::unordered_map< std::string, int > ae3d::Material::sInts;
-std::unordered_map< std::string, ae3d::Vec3 > ae3d::Material::sVec3s;
+ae3d::Material::PropertyBlock ae3d::Material::globals;
+unsigned ae3d::Material::globalsVersion = 1;
+std::vector< bool > ae3d::Material::isGlobalProperty;
+unsigned ae3d::Material::applyCounter = 0;
 
-bool ae3d::Material::IsValidShader() const
-{
-    return shader && shader->IsValid();
-}
-
-void ae3d::Material::Apply()
+unsigned ae3d::Material::PropertyBlock::Find( int id, PropertyType type )
 {
-    if (shader == nullptr)
+    for (unsigned i = 0; i < properties.size(); ++i)
     {
-        return;
+        if (properties[ i ].id == id && properties[ i ].type == type)
+        {
+            return i;
+        }
     }
 
-    shader->Use();
+    Property property;
+    property.id = id;
+    property.type = type;
+    property.slot = static_cast< unsigned >( slots.size() );
 
-    for (const auto& vec : vec3s)
+    if (type == PropertyType::Matrix)
     {
-        shader->SetVector3( vec.first.c_str(), &vec.second.x );
+        slots.resize( slots.size() + 4 );
     }
-
-    for (const auto& vec : vec4s)
+    else if (!property.IsTexture())
     {
-        shader->SetVector4( vec.first.c_str(), &vec.second.x );
+        slots.resize( slots.size() + 1 );
     }
 
-    for (const auto& i : ints)
-    {
-        shader->SetInt( i.first.c_str(), i.second );
-    }
+    properties.push_back( property );
+    isDirty.push_back( true );
+    return static_cast< unsigned >( properties.size() - 1 );
+}
+
+bool ae3d::Material::PropertyBlock::SetValue( int id, PropertyType type, const float* value, unsigned floatCount )
+{
+    const unsigned index = Find( id, type );
+    float* slot = &slots[ properties[ index ].slot ].x;
 
-    for (const auto& f : floats)
+    if (std::memcmp( slot, value, floatCount * sizeof( float ) ) != 0)
     {
-        shader->SetFloat( f.first.c_str(), f.second );
+        std::memcpy( slot, value, floatCount * sizeof( float ) );
+        isDirty[ index ] = true;
+        return true;
     }
 
-    int texUnit = 0;
-    
-    for (const auto& tex2d : tex2ds)
+    return false;
+}
+
+void ae3d::Material::PropertyBlock::SetTexture( int id, PropertyType type, void* texture )
+{
+    const unsigned index = Find( id, type );
+
+    if (properties[ index ].texture != texture)
     {
-        shader->SetTexture( tex2d.first.c_str(), tex2d.second, texUnit );
-        ++texUnit;
+        properties[ index ].texture = texture;
+        isDirty[ index ] = true;
     }
+}
 
-    for (const auto& texCube : texCubes)
+bool ae3d::Material::IsOverriddenByGlobal( int propertyId )
+{
+    return propertyId < static_cast< int >( isGlobalProperty.size() ) && isGlobalProperty[ propertyId ];
+}
+
+bool ae3d::Material::IsValidShader() const
+{
+    return shader && shader->IsValid();
+}
+
+void ae3d::Material::UploadValue( const PropertyBlock& propertyBlock, const Property& property )
+{
+    const float* value = &propertyBlock.slots[ property.slot ].x;
+
+    switch (property.type)
     {
-        shader->SetTexture( texCube.first.c_str(), texCube.second, texUnit );
-        ++texUnit;
+    case PropertyType::Int:
+    {
+        int i;
+        std::memcpy( &i, value, sizeof( int ) );
+        shader->SetInt( property.id, i );
+        break;
+    }
+    case PropertyType::Float:
+        shader->SetFloat( property.id, value[ 0 ] );
+        break;
+    case PropertyType::Vec3:
+        shader->SetVector3( property.id, value );
+        break;
+    case PropertyType::Vec4:
+        shader->SetVector4( property.id, value );
+        break;
+    case PropertyType::Matrix:
+        shader->SetMatrix( property.id, value );
+        break;
+    default:
+        break;
     }
+}
 
-    for (const auto& texRT : texRTs)
+void ae3d::Material::BindTexture( const Property& property, int textureUnit )
+{
+    if (property.type == PropertyType::Texture2D)
     {
-        shader->SetRenderTexture( texRT.first.c_str(), texRT.second, texUnit );
-        ++texUnit;
+        shader->SetTexture( property.id, static_cast< Texture2D* >( property.texture ), textureUnit );
     }
-
-    for (const auto& mat4 : mat4s)
+    else if (property.type == PropertyType::TextureCube)
     {
-        shader->SetMatrix( mat4.first.c_str(), &mat4.second.m[ 0 ] );
+        shader->SetTexture( property.id, static_cast< TextureCube* >( property.texture ), textureUnit );
     }
-
-    for (const auto& globalTexRT : sTexRTs)
+    else
     {
-        shader->SetRenderTexture( globalTexRT.first.c_str(), globalTexRT.second, texUnit );
-        ++texUnit;
+        shader->SetRenderTexture( property.id, static_cast< RenderTexture* >( property.texture ), textureUnit );
     }
+}
 
-    for (const auto& globalTex2d : sTex2ds)
+void ae3d::Material::Apply( bool bindTextures )
+{
+    if (shader == nullptr)
     {
-        shader->SetTexture( globalTex2d.first.c_str(), globalTex2d.second, texUnit );
-        ++texUnit;
+        return;
     }
 
-    for (const auto& globalFloat : sFloats)
+#if RENDERER_D3D12
+    // D3D12 resets texture slots after each draw.
+    bindTextures = true;
+#endif
+
+    shader->Use();
+
+#if RENDERER_OPENGL || RENDERER_NULL
+    // Uniforms are program state, so if no other material has been applied into the shader since this material,
+    // only values that changed after that must be uploaded.
+    const bool uploadAll = appliedShader != shader || shader->appliedMaterialStamp != applyStamp;
+    const bool uploadGlobals = uploadAll || shader->appliedGlobalsVersion != globalsVersion;
+#else
+    // Uniforms are written into a new buffer for each draw.
+    const bool uploadAll = true;
+    const bool uploadGlobals = true;
+#endif
+
+    for (std::size_t i = 0; i < block.properties.size(); ++i)
     {
-        shader->SetFloat( globalFloat.first.c_str(), globalFloat.second );
+        const Property& property = block.properties[ i ];
+
+        if (!property.IsTexture() && (uploadAll || block.isDirty[ i ]) && !IsOverriddenByGlobal( property.id ))
+        {
+            UploadValue( block, property );
+        }
+
+        block.isDirty[ i ] = false;
     }
 
-    for (const auto& globalInt : sInts)
+    if (bindTextures)
     {
-        shader->SetInt( globalInt.first.c_str(), globalInt.second );
+        int texUnit = 0;
+
+        for (const auto& property : block.properties)
+        {
+            if (property.IsTexture() && property.texture != nullptr && !IsOverriddenByGlobal( property.id ))
+            {
+                BindTexture( property, texUnit );
+                ++texUnit;
+            }
+        }
+
+        for (const auto& property : globals.properties)
+        {
+            if (property.IsTexture() && property.texture != nullptr)
+            {
+                BindTexture( property, texUnit );
+                ++texUnit;
+            }
+        }
     }
 
-    for (const auto& globalVec3 : sVec3s)
+    if (uploadGlobals)
     {
-        shader->SetVector3( globalVec3.first.c_str(), &globalVec3.second.x );
+        for (const auto& property : globals.properties)
+        {
+            if (!property.IsTexture())
+            {
+                UploadValue( globals, property );
+            }
+        }
     }
 
+    // Zero is never a stamp, so a reloaded shader doesn't match any material.
+    applyStamp = ++applyCounter == 0 ? ++applyCounter : applyCounter;
+    appliedShader = shader;
+    shader->appliedMaterialStamp = applyStamp;
+    shader->appliedGlobalsVersion = globalsVersion;
+
     if (std::abs( depthUnits ) > 0.0001f || std::abs( depthFactor ) > 0.0001f)
     {
         GfxDevice::SetPolygonOffset( true, depthFactor, depthUnits );
@@ -107,9 +209,44 @@ void ae3d::Material::Apply()
     }
 }
 
+int ae3d::Material::GetTextureCount() const
+{
+    int count = 0;
+
+    for (const auto& property : block.properties)
+    {
+        count += (property.IsTexture() && property.texture != nullptr && !IsOverriddenByGlobal( property.id )) ? 1 : 0;
+    }
+
+    for (const auto& property : globals.properties)
+    {
+        count += (property.IsTexture() && property.texture != nullptr) ? 1 : 0;
+    }
+
+    return count;
+}
+
+namespace
+{
+    void MarkGlobal( std::vector< bool >& isGlobalProperty, int propertyId )
+    {
+        if (propertyId >= static_cast< int >( isGlobalProperty.size() ))
+        {
+            isGlobalProperty.resize( propertyId + 1, false );
+        }
+
+        isGlobalProperty[ propertyId ] = true;
+    }
+}
+
 void ae3d::Material::SetMatrix( const char* name, const Matrix44& matrix )
 {
-    mat4s[ name ] = matrix;
+    SetMatrix( Shader::GetPropertyId( name ), matrix );
+}
+
+void ae3d::Material::SetMatrix( int propertyId, const Matrix44& matrix )
+{
+    block.SetValue( propertyId, PropertyType::Matrix, &matrix.m[ 0 ], 16 );
 }
 
 void ae3d::Material::SetShader( Shader* aShader )
@@ -119,61 +256,103 @@ void ae3d::Material::SetShader( Shader* aShader )
 
 void ae3d::Material::SetTexture( const char* name, Texture2D* texture )
 {
-    tex2ds[ name ] = texture;
+    block.SetTexture( Shader::GetPropertyId( name ), PropertyType::Texture2D, texture );
 }
 
 void ae3d::Material::SetTexture( const char* name, TextureCube* texture )
 {
-    texCubes[ name ] = texture;
+    block.SetTexture( Shader::GetPropertyId( name ), PropertyType::TextureCube, texture );
 }
 
 void ae3d::Material::SetRenderTexture( const char* name, RenderTexture* renderTexture )
 {
-    texRTs[ name ] = renderTexture;
+    block.SetTexture( Shader::GetPropertyId( name ), PropertyType::RenderTexture, renderTexture );
 }
 
 void ae3d::Material::SetGlobalRenderTexture( const char* name, RenderTexture* renderTexture )
 {
-    sTexRTs[ name ] = renderTexture;
+    const int id = Shader::GetPropertyId( name );
+    MarkGlobal( isGlobalProperty, id );
+    globals.SetTexture( id, PropertyType::RenderTexture, renderTexture );
 }
 
 void ae3d::Material::SetGlobalTexture2D( const char* name, Texture2D* texture2d )
 {
-    sTex2ds[ name ] = texture2d;
+    const int id = Shader::GetPropertyId( name );
+    MarkGlobal( isGlobalProperty, id );
+    globals.SetTexture( id, PropertyType::Texture2D, texture2d );
 }
 
 void ae3d::Material::SetGlobalFloat( const char* name, float value )
 {
-    sFloats[ name ] = value;
+    const int id = Shader::GetPropertyId( name );
+    MarkGlobal( isGlobalProperty, id );
+    if (globals.SetValue( id, PropertyType::Float, &value, 1 ))
+    {
+        ++globalsVersion;
+    }
 }
 
 void ae3d::Material::SetGlobalInt( const char* name, int value )
 {
-    sInts[ name ] = value;
+    const int id = Shader::GetPropertyId( name );
+    MarkGlobal( isGlobalProperty, id );
+    float bits;
+    std::memcpy( &bits, &value, sizeof( int ) );
+    if (globals.SetValue( id, PropertyType::Int, &bits, 1 ))
+    {
+        ++globalsVersion;
+    }
 }
 
 void ae3d::Material::SetGlobalVector( const char* name, const Vec3& value )
 {
-    sVec3s[ name ] = value;
+    const int id = Shader::GetPropertyId( name );
+    MarkGlobal( isGlobalProperty, id );
+    if (globals.SetValue( id, PropertyType::Vec3, &value.x, 3 ))
+    {
+        ++globalsVersion;
+    }
 }
 
 void ae3d::Material::SetInt( const char* name, int value )
 {
-    ints[ name ] = value;
+    SetInt( Shader::GetPropertyId( name ), value );
+}
+
+void ae3d::Material::SetInt( int propertyId, int value )
+{
+    float bits;
+    std::memcpy( &bits, &value, sizeof( int ) );
+    block.SetValue( propertyId, PropertyType::Int, &bits, 1 );
 }
 
 void ae3d::Material::SetFloat( const char* name, float value )
 {
-    floats[ name ] = value;
+    SetFloat( Shader::GetPropertyId( name ), value );
+}
+
+void ae3d::Material::SetFloat( int propertyId, float value )
+{
+    block.SetValue( propertyId, PropertyType::Float, &value, 1 );
 }
 
 void ae3d::Material::SetVector( const char* name, const Vec3& vec )
 {
-    vec3s[ name ] = vec;
+    SetVector( Shader::GetPropertyId( name ), vec );
+}
+
+void ae3d::Material::SetVector( int propertyId, const Vec3& vec )
+{
+    block.SetValue( propertyId, PropertyType::Vec3, &vec.x, 3 );
 }
 
 void ae3d::Material::SetVector( const char* name, const Vec4& vec )
 {
-    vec4s[ name ] = vec;
+    SetVector( Shader::GetPropertyId( name ), vec );
 }
 
+void ae3d::Material::SetVector( int propertyId, const Vec4& vec )
+{
+    block.SetValue( propertyId, PropertyType::Vec4, &vec.x, 4 );
+}
@@ -0,0 +1,44 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include "VertexBuffer.hpp"
+
+namespace ae3d
+{
+    /// Sub-allocates vertex and index ranges of static geometry from a few large buffers per vertex format.
+    /// Geometry with the same vertex format shares buffers and a VAO, so drawing it doesn't rebind buffers,
+    /// and draws address their range with a base vertex and an index offset.
+    namespace MeshArena
+    {
+        /// Vertex and index ranges of one allocation.
+        struct Range
+        {
+            /// Page (one vertex buffer, index buffer and VAO) that contains the ranges, -1 if none.
+            int page = -1;
+            /// Index of the first vertex in the page's vertex buffer.
+            unsigned firstVertex = 0;
+            unsigned vertexCount = 0;
+            /// Index of the first index in the page's index buffer.
+            unsigned firstIndex = 0;
+            unsigned indexCount = 0;
+        };
+
+        /// Copies geometry into a page of its vertex format. Creates a new page if none has room.
+        /// \param format Vertex format.
+        /// \param vertices Vertices of format.
+        /// \param vertexCount Vertex count.
+        /// \param faces Faces. Indices are relative to the first vertex.
+        /// \param faceCount Face count.
+        /// \return Allocated ranges.
+        Range Allocate( VertexBuffer::VertexFormat format, const void* vertices, unsigned vertexCount, const VertexBuffer::Face* faces, unsigned faceCount );
+
+        /// Returns ranges for reuse.
+        /// \param range Range returned by Allocate.
+        void Free( const Range& range );
+
+        /// \param page Page index of a Range.
+        /// \return VAO that has the page's buffers and the vertex format's attributes.
+        unsigned GetVao( int page );
+    }
+}
+#endif
@@ -16,6 +16,7 @@
 #define MYMAX(x, y) ((x) > (y) ? (x) : (y))
 
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+unsigned char* DecodeSTB( const ae3d::FileSystem::FileView& fileContents, int& outWidth, int& outHeight, int& outComponents ); // Defined in TextureCommon.cpp
 
 namespace PVRType
 {
@@ -91,7 +92,7 @@ ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
     return &defaultTexture;
 }
 
-void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+void ae3d::Texture2D::Load( const FileSystem::FileView& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     if (!fileContents.isLoaded)
     {
@@ -198,10 +199,10 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
     }
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileView& fileContents )
 {
     int components;
-    unsigned char* data = stbi_load_from_memory( &fileContents.data[ 0 ], static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
+    unsigned char* data = DecodeSTB( fileContents, width, height, components );
     
     if (data == nullptr)
     {
@@ -0,0 +1,25 @@
+#include "ComputeShader.hpp"
+#include "FileSystem.hpp"
+#include "RenderTexture.hpp"
+
+void ae3d::ComputeShader::Load( const char* /*source*/ )
+{
+}
+
+void ae3d::ComputeShader::Load( const char* /*metalShaderName*/, const FileSystem::FileContentsData& /*dataHLSL*/, const FileSystem::FileContentsData& /*dataSPIRV*/ )
+{
+}
+
+void ae3d::ComputeShader::SetRenderTexture( RenderTexture* renderTexture, unsigned slot )
+{
+    if (renderTextures.size() <= slot)
+    {
+        renderTextures.resize( slot + 1, nullptr );
+    }
+
+    renderTextures[ slot ] = renderTexture;
+}
+
+void ae3d::ComputeShader::Dispatch( unsigned /*groupCountX*/, unsigned /*groupCountY*/, unsigned /*groupCountZ*/ )
+{
+}
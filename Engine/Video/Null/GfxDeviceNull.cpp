@@ -0,0 +1,379 @@
+#include "GfxDevice.hpp"
+#include <cstring>
+#include <vector>
+#include <string>
+#include <sstream>
+#include "LightClusterer.hpp"
+#include "LightTiler.hpp"
+#include "Matrix.hpp"
+#include "System.hpp"
+#include "Statistics.hpp"
+#include "RenderTexture.hpp"
+#include "Shader.hpp"
+#include "VertexBuffer.hpp"
+
+// Headless renderer: no window or graphics API context is created. Calls that would reach the
+// graphics API are appended to a command log that tests and benchmarks can inspect.
+
+namespace MathUtil
+{
+    void TransformAABB( const ae3d::Vec3& aabbMin, const ae3d::Vec3& aabbMax, const ae3d::Matrix44& localToWorld, ae3d::Vec3& outCenter, ae3d::Vec3& outExtent );
+}
+
+namespace GfxDeviceGlobal
+{
+    std::vector< ae3d::GfxDevice::Command > commands;
+    std::vector< ae3d::VertexBuffer > lineBuffers;
+    int instanceBufferCount = 0;
+
+    ae3d::LightTiler lightTiler;
+    int backBufferWidth = 640;
+    int backBufferHeight = 400;
+    unsigned nextTextureId = 1;
+    const ae3d::RenderTexture* cachedRenderTarget = nullptr;
+    unsigned cachedCubeMapFace = 0;
+}
+
+namespace ae3d
+{
+    namespace System
+    {
+        namespace Statistics
+        {
+            std::string GetStatistics()
+            {
+                std::stringstream stm;
+                stm << "frame time: " << ::Statistics::GetFrameTimeMS() << " ms\n";
+                stm << "shadow map time: " << ::Statistics::GetShadowMapTimeMS() << " ms\n";
+                stm << "depth pass time: " << ::Statistics::GetDepthNormalsTimeMS() << " ms\n";
+                stm << "light assignment time: " << ::Statistics::GetLightAssignmentTimeMS() << " ms\n";
+                stm << "draw calls: " << ::Statistics::GetDrawCalls() << "\n";
+                stm << "shader binds: " << ::Statistics::GetShaderBinds() << "\n";
+                stm << "texture binds: " << ::Statistics::GetTextureBinds() << "\n";
+                stm << "shader binds saved by sorting: " << ::Statistics::GetShaderBindsSaved() << "\n";
+                stm << "texture binds saved by sorting: " << ::Statistics::GetTextureBindsSaved() << "\n";
+                stm << "render target binds: " << ::Statistics::GetRenderTargetBinds() << "\n";
+                stm << "vertex buffer binds: " << ::Statistics::GetVertexBufferBinds() << "\n";
+                stm << "occluded meshes: " << ::Statistics::GetOccludedMeshes() << "\n";
+                stm << "triangles: " << ::Statistics::GetTriangleCount() << "\n";
+                stm << "recorded commands: " << GfxDeviceGlobal::commands.size() << "\n";
+
+                return stm.str();
+            }
+        }
+    }
+}
+
+void ae3d::GfxDevice::Init( int width, int height )
+{
+    if (width <= 0 || height <= 0)
+    {
+        System::Print( "Window's dimension is invalid." );
+        width = 640;
+        height = 480;
+    }
+
+    GfxDeviceGlobal::backBufferWidth = width;
+    GfxDeviceGlobal::backBufferHeight = height;
+    GfxDeviceGlobal::commands.reserve( 1024 );
+    GfxDeviceGlobal::lightTiler.Init();
+}
+
+void ae3d::GfxDevice::RecordCommand( const Command& command )
+{
+    GfxDeviceGlobal::commands.push_back( command );
+}
+
+const std::vector< ae3d::GfxDevice::Command >& ae3d::GfxDevice::GetCommandLog()
+{
+    return GfxDeviceGlobal::commands;
+}
+
+void ae3d::GfxDevice::ClearCommandLog()
+{
+    GfxDeviceGlobal::commands.clear();
+}
+
+unsigned ae3d::GfxDevice::CreateTextureId()
+{
+    return GfxDeviceGlobal::nextTextureId++;
+}
+
+void ae3d::GfxDevice::SetPolygonOffset( bool /*enable*/, float /*factor*/, float /*units*/ )
+{
+}
+
+void ae3d::GfxDevice::PushGroupMarker( const char* /*name*/ )
+{
+}
+
+void ae3d::GfxDevice::PopGroupMarker()
+{
+}
+
+void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                            CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
+    ae3d::System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
+
+    shader.Use();
+    vertexBuffer.Bind();
+    Statistics::IncDrawCalls();
+    Statistics::IncTriangleCount( endIndex - startIndex );
+
+    Command command;
+    command.type = Command::Type::Draw;
+    command.object = &vertexBuffer;
+    command.shader = &shader;
+    command.startIndex = startIndex;
+    command.endIndex = endIndex;
+    command.blendMode = blendMode;
+    command.depthFunc = depthFunc;
+    command.cullMode = cullMode;
+    command.fillMode = fillMode;
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::UploadInstanceData( const float* /*modelMatrices*/, int instanceCount )
+{
+    GfxDeviceGlobal::instanceBufferCount = instanceCount;
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, int firstInstance, int instanceCount, Shader& shader,
+                                     BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
+    ae3d::System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
+    ae3d::System::Assert( firstInstance > -1 && instanceCount > 0 && firstInstance + instanceCount <= GfxDeviceGlobal::instanceBufferCount, "Invalid instance range" );
+
+    shader.Use();
+    vertexBuffer.Bind();
+    Statistics::IncDrawCalls();
+    Statistics::IncTriangleCount( (endIndex - startIndex) * instanceCount );
+
+    Command command;
+    command.type = Command::Type::DrawInstanced;
+    command.object = &vertexBuffer;
+    command.shader = &shader;
+    command.startIndex = startIndex;
+    command.endIndex = endIndex;
+    command.firstInstance = firstInstance;
+    command.instanceCount = instanceCount;
+    command.blendMode = blendMode;
+    command.depthFunc = depthFunc;
+    command.cullMode = cullMode;
+    command.fillMode = fillMode;
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::DrawIndirect( VertexBuffer* const* vertexBuffers, const float* /*modelMatrices*/, int drawCount, Shader& shader,
+                                    BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( drawCount > 0, "DrawIndirect needs at least one draw" );
+    ae3d::System::Assert( shader.IsDrawIndirect(), "DrawIndirect needs a shader with a PerDraw storage block" );
+
+    int triangleCount = 0;
+
+    for (int i = 0; i < drawCount; ++i)
+    {
+        ae3d::System::Assert( drawCount == 1 || (vertexBuffers[ i ]->GetMeshArenaPage() != -1 && vertexBuffers[ i ]->GetMeshArenaPage() == vertexBuffers[ 0 ]->GetMeshArenaPage()),
+                              "DrawIndirect vertex buffers must be in the same MeshArena page" );
+        triangleCount += vertexBuffers[ i ]->GetFaceCount() / 3;
+    }
+
+    shader.Use();
+    vertexBuffers[ 0 ]->Bind();
+    Statistics::IncDrawCalls();
+    Statistics::IncTriangleCount( triangleCount );
+
+    Command command;
+    command.type = Command::Type::DrawIndirect;
+    command.object = vertexBuffers[ 0 ];
+    command.shader = &shader;
+    command.instanceCount = drawCount;
+    command.blendMode = blendMode;
+    command.depthFunc = depthFunc;
+    command.cullMode = cullMode;
+    command.fillMode = fillMode;
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::DrawIndirectCulled( VertexBuffer* const* vertexBuffers, const float* modelMatrices, const float* localBounds, int drawCount,
+                                          ComputeShader& /*cullShader*/, const float* frustumPlanes, int* outVisibleCount, Shader& shader,
+                                          BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( drawCount > 0, "DrawIndirectCulled needs at least one draw" );
+    ae3d::System::Assert( shader.IsDrawIndirect(), "DrawIndirectCulled needs a shader with a PerDraw storage block" );
+
+    // Runs the OpenGL renderer's cull shader on the CPU, so that scenes can be validated headless.
+    int visibleCount = 0;
+
+    for (int i = 0; i < drawCount; ++i)
+    {
+        const float* bounds = &localBounds[ i * 6 ];
+        Matrix44 modelMatrix;
+        std::memcpy( modelMatrix.m, &modelMatrices[ i * 16 ], sizeof( modelMatrix.m ) );
+
+        Vec3 center, extent;
+        MathUtil::TransformAABB( Vec3( bounds[ 0 ], bounds[ 1 ], bounds[ 2 ] ), Vec3( bounds[ 3 ], bounds[ 4 ], bounds[ 5 ] ), modelMatrix, center, extent );
+        bool isVisible = true;
+
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* plane = &frustumPlanes[ p * 4 ];
+            const Vec3 positiveVertex( center.x + (plane[ 0 ] >= 0 ? extent.x : -extent.x),
+                                       center.y + (plane[ 1 ] >= 0 ? extent.y : -extent.y),
+                                       center.z + (plane[ 2 ] >= 0 ? extent.z : -extent.z) );
+
+            if (plane[ 0 ] * positiveVertex.x + plane[ 1 ] * positiveVertex.y + plane[ 2 ] * positiveVertex.z + plane[ 3 ] < 0)
+            {
+                isVisible = false;
+            }
+        }
+
+        visibleCount += isVisible ? 1 : 0;
+    }
+
+    if (outVisibleCount != nullptr)
+    {
+        *outVisibleCount = visibleCount;
+    }
+
+    shader.Use();
+    vertexBuffers[ 0 ]->Bind();
+    Statistics::IncDrawCalls();
+
+    Command command;
+    command.type = Command::Type::DrawIndirect;
+    command.object = vertexBuffers[ 0 ];
+    command.shader = &shader;
+    command.instanceCount = visibleCount;
+    command.blendMode = blendMode;
+    command.depthFunc = depthFunc;
+    command.cullMode = cullMode;
+    command.fillMode = fillMode;
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::UploadLightClusters( const LightClusterer& clusterer )
+{
+    Command command;
+    command.type = Command::Type::UploadLightClusters;
+    command.object = &clusterer;
+    command.startIndex = static_cast< int >( clusterer.GetLights().size() );
+    command.endIndex = static_cast< int >( clusterer.GetLightIndices().size() );
+    RecordCommand( command );
+}
+
+int ae3d::GfxDevice::CreateLineBuffer( const std::vector< Vec3 >& lines, const Vec3& color )
+{
+    if (lines.empty())
+    {
+        return -1;
+    }
+
+    std::vector< VertexBuffer::Face > faces( lines.size() * 2 );
+    std::vector< VertexBuffer::VertexPTC > vertices( lines.size() );
+
+    for (std::size_t lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
+    {
+        vertices[ lineIndex ].position = lines[ lineIndex ];
+        vertices[ lineIndex ].color = Vec4( color, 1 );
+    }
+
+    GfxDeviceGlobal::lineBuffers.push_back( VertexBuffer() );
+    GfxDeviceGlobal::lineBuffers.back().Generate( faces.data(), int( faces.size() ), vertices.data(), int( vertices.size() ) );
+
+    return int( GfxDeviceGlobal::lineBuffers.size() ) - 1;
+}
+
+void ae3d::GfxDevice::DrawLines( int handle )
+{
+    if (handle < 0)
+    {
+        return;
+    }
+
+    GfxDeviceGlobal::lineBuffers[ handle ].Bind();
+
+    Command command;
+    command.type = Command::Type::DrawLines;
+    command.object = &GfxDeviceGlobal::lineBuffers[ handle ];
+    command.startIndex = handle;
+    command.endIndex = GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount();
+    command.depthFunc = DepthFunc::NoneWriteOff;
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::SetMultiSampling( bool /*enable*/ )
+{
+}
+
+void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outGpuUsageMBytes, unsigned& outGpuBudgetMBytes )
+{
+    outGpuUsageMBytes = 0;
+    outGpuBudgetMBytes = 0;
+}
+
+void ae3d::GfxDevice::ReleaseGPUObjects()
+{
+    GfxDeviceGlobal::lineBuffers.clear();
+    GfxDeviceGlobal::commands.clear();
+    GfxDeviceGlobal::lightTiler.DestroyBuffers();
+}
+
+void ae3d::GfxDevice::ClearScreen( unsigned clearFlags )
+{
+    if ((clearFlags & (ClearFlags::Color | ClearFlags::Depth)) == 0)
+    {
+        return;
+    }
+
+    Command command;
+    command.type = Command::Type::ClearScreen;
+    command.startIndex = static_cast< int >( clearFlags );
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::SetClearColor( float /*red*/, float /*green*/, float /*blue*/ )
+{
+}
+
+void ae3d::GfxDevice::ErrorCheck( const char* /*info*/ )
+{
+}
+
+void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned cubeMapFace )
+{
+    if (target == GfxDeviceGlobal::cachedRenderTarget && cubeMapFace == GfxDeviceGlobal::cachedCubeMapFace)
+    {
+        return;
+    }
+
+    ae3d::System::Assert( cubeMapFace < 6, "Invalid cube map face." );
+    Statistics::IncRenderTargetBinds();
+    GfxDeviceGlobal::cachedRenderTarget = target;
+    GfxDeviceGlobal::cachedCubeMapFace = cubeMapFace;
+
+    Command command;
+    command.type = Command::Type::SetRenderTarget;
+    command.object = target;
+    command.startIndex = static_cast< int >( cubeMapFace );
+    RecordCommand( command );
+}
+
+void ae3d::GfxDevice::UnsetRenderTarget()
+{
+    SetRenderTarget( nullptr, 0 );
+}
+
+void ae3d::GfxDevice::Set_sRGB_Writes( bool /*enable*/ )
+{
+}
+
+void ae3d::GfxDevice::Present()
+{
+    Statistics::EndFrameTimeProfiling();
+    GfxDeviceGlobal::commands.clear();
+}
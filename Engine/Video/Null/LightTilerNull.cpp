@@ -0,0 +1,113 @@
+#include "LightTiler.hpp"
+#include "ComputeShader.hpp"
+#include "Matrix.hpp"
+#include "RenderTexture.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    Vec3 ConvertProjToView( float x, float y, const Matrix44& invProjection )
+    {
+        Vec4 p;
+        Matrix44::TransformPoint( Vec4( x, y, 1, 1 ), invProjection, &p );
+        return Vec3( p.x / p.w, p.y / p.w, p.z / p.w );
+    }
+}
+
+void ae3d::LightTiler::Init()
+{
+    pointLightCenterAndRadius.resize( MaxLights );
+}
+
+void ae3d::LightTiler::DestroyBuffers()
+{
+    lightCountPerTile.clear();
+}
+
+void ae3d::LightTiler::UpdateLightBuffers()
+{
+}
+
+// Same tests as the GL culler, but the null renderer has no depth so tiles span the whole depth range in front of the camera.
+void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& view, RenderTexture& depthNormalTarget )
+{
+    Matrix44 invProjection;
+    Matrix44::Invert( projection, invProjection );
+
+    std::vector< Vec4 > viewSpaceLights( activePointLights );
+
+    for (int i = 0; i < activePointLights; ++i)
+    {
+        const Vec4& light = pointLightCenterAndRadius[ i ];
+        Matrix44::TransformPoint( Vec4( light.x, light.y, light.z, 1 ), view, &viewSpaceLights[ i ] );
+        viewSpaceLights[ i ].w = light.w;
+    }
+
+    const unsigned numTilesX = GetNumTilesX();
+    const unsigned numTilesY = GetNumTilesY();
+    const float winWidth = float( TileRes * numTilesX );
+    const float winHeight = float( TileRes * numTilesY );
+    const unsigned maxLightsInTile = GetMaxNumLightsPerTile() - 1;
+
+    lightCountPerTile.assign( numTilesX * numTilesY, 0 );
+
+    for (unsigned y = 0; y < numTilesY; ++y)
+    {
+        for (unsigned x = 0; x < numTilesX; ++x)
+        {
+            // Row 0 is at the top.
+            const float left = TileRes * x / winWidth * 2 - 1;
+            const float right = TileRes * (x + 1) / winWidth * 2 - 1;
+            const float top = 1 - TileRes * y / winHeight * 2;
+            const float bottom = 1 - TileRes * (y + 1) / winHeight * 2;
+
+            const Vec3 frustum[ 4 ] =
+            {
+                ConvertProjToView( left, top, invProjection ),
+                ConvertProjToView( right, top, invProjection ),
+                ConvertProjToView( right, bottom, invProjection ),
+                ConvertProjToView( left, bottom, invProjection )
+            };
+
+            const Vec3 tileCenter = frustum[ 0 ] + frustum[ 1 ] + frustum[ 2 ] + frustum[ 3 ];
+            Vec3 frustumEqn[ 4 ];
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const Vec3 n = Vec3::Cross( frustum[ i ], frustum[ (i + 1) & 3 ] ).Normalized();
+                frustumEqn[ i ] = Vec3::Dot( n, tileCenter ) > 0 ? -n : n;
+            }
+
+            unsigned count = 0;
+
+            for (const auto& light : viewSpaceLights)
+            {
+                const Vec3 center( light.x, light.y, light.z );
+                const float radius = light.w;
+
+                if (center.z < radius &&
+                    Vec3::Dot( frustumEqn[ 0 ], center ) < radius &&
+                    Vec3::Dot( frustumEqn[ 1 ], center ) < radius &&
+                    Vec3::Dot( frustumEqn[ 2 ], center ) < radius &&
+                    Vec3::Dot( frustumEqn[ 3 ], center ) < radius)
+                {
+                    ++count;
+                }
+            }
+
+            lightCountPerTile[ y * numTilesX + x ] = count < maxLightsInTile ? count : maxLightsInTile;
+        }
+    }
+
+    cullerUniformsCreated = true;
+
+    shader.SetRenderTexture( &depthNormalTarget, 0 );
+    shader.Dispatch( numTilesX, numTilesY, 1 );
+}
+
+void ae3d::LightTiler::GetLightCountPerTile( std::vector< unsigned >& outLightCounts )
+{
+    outLightCounts = lightCountPerTile;
+}
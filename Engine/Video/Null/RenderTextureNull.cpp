@@ -0,0 +1,38 @@
+#include "RenderTexture.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType, TextureWrap aWrap, TextureFilter aFilter )
+{
+    if (aWidth <= 0 || aHeight <= 0)
+    {
+        System::Print( "Render texture has invalid dimension!\n" );
+        return;
+    }
+
+    width = aWidth;
+    height = aHeight;
+    wrap = aWrap;
+    filter = aFilter;
+    isCube = false;
+    isRenderTexture = true;
+    dataType = aDataType;
+    handle = GfxDevice::CreateTextureId();
+}
+
+void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, TextureWrap aWrap, TextureFilter aFilter )
+{
+    if (aDimension <= 0)
+    {
+        System::Print( "Render texture has invalid dimension!\n" );
+        return;
+    }
+
+    width = height = aDimension;
+    wrap = aWrap;
+    filter = aFilter;
+    isCube = true;
+    isRenderTexture = true;
+    dataType = aDataType;
+    handle = GfxDevice::CreateTextureId();
+}
@@ -0,0 +1,15 @@
+#include "Renderer.hpp"
+
+ae3d::Renderer renderer;
+
+void ae3d::BuiltinShaders::Load()
+{
+    // The null renderer does not compile shaders, but every shader is valid so that built-in passes are recorded.
+    spriteRendererShader.Load( "", "" );
+    sdfShader.Load( "", "" );
+    skyboxShader.Load( "", "" );
+    momentsShader.Load( "", "" );
+    depthNormalsShader.Load( "", "" );
+    lightCullShader.Load( "" );
+    frustumCullShader.Load( "" );
+}
@@ -0,0 +1,105 @@
+#include "Shader.hpp"
+#include <cstring>
+#include <string>
+#include "FileSystem.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+#include "Statistics.hpp"
+#include "Texture2D.hpp"
+#include "TextureCube.hpp"
+#include "RenderTexture.hpp"
+
+namespace
+{
+    void RecordUniform( const ae3d::Shader* shader, const char* name, const float* values, int valueCount )
+    {
+        ae3d::GfxDevice::Command command;
+        command.type = ae3d::GfxDevice::Command::Type::SetUniform;
+        command.shader = shader;
+        command.uniformName = name;
+        std::memcpy( command.uniformValue, values, valueCount * sizeof( float ) );
+        ae3d::GfxDevice::RecordCommand( command );
+    }
+}
+
+void ae3d::Shader::Load( const char* vertexSource, const char* /*fragmentSource*/ )
+{
+    isInstanced = vertexSource != nullptr && std::strstr( vertexSource, "aInstanceModelMatrix" ) != nullptr;
+    isDrawIndirect = vertexSource != nullptr && std::strstr( vertexSource, "PerDraw" ) != nullptr;
+}
+
+void ae3d::Shader::Load( const FileSystem::FileContentsData& vertexGLSL, const FileSystem::FileContentsData& fragmentGLSL,
+                         const char* /*metalVertexShaderName*/, const char* /*metalFragmentShaderName*/,
+                         const FileSystem::FileContentsData& /*vertexHLSL*/, const FileSystem::FileContentsData& /*fragmentHLSL*/,
+                         const FileSystem::FileContentsData& /*vertexSPIRV*/, const FileSystem::FileContentsData& /*fragmentSPIRV*/ )
+{
+    vertexPath = vertexGLSL.path;
+    fragmentPath = fragmentGLSL.path;
+
+    const std::string vertexStr = std::string( std::begin( vertexGLSL.data ), std::end( vertexGLSL.data ) );
+    Load( vertexStr.c_str(), "" );
+}
+
+void ae3d::Shader::Use()
+{
+    static const Shader* boundShader = nullptr;
+
+    if (boundShader != this)
+    {
+        Statistics::IncShaderBinds();
+        boundShader = this;
+    }
+}
+
+void ae3d::Shader::SetMatrix( const char* name, const float* matrix4x4 )
+{
+    RecordUniform( this, name, matrix4x4, 16 );
+}
+
+void ae3d::Shader::SetTexture( const char* name, ae3d::Texture2D* texture, int textureUnit )
+{
+    Statistics::IncTextureBinds();
+    SetInt( name, textureUnit );
+
+    const std::string scaleOffsetName = std::string( name ) + std::string( "_ST" );
+    SetVector4( scaleOffsetName.c_str(), &texture->GetScaleOffset().x );
+}
+
+void ae3d::Shader::SetTexture( const char* name, ae3d::TextureCube* texture, int textureUnit )
+{
+    Statistics::IncTextureBinds();
+    SetInt( name, textureUnit );
+
+    const std::string scaleOffsetName = std::string( name ) + std::string( "_ST" );
+    SetVector4( scaleOffsetName.c_str(), &texture->GetScaleOffset().x );
+}
+
+void ae3d::Shader::SetRenderTexture( const char* name, ae3d::RenderTexture* texture, int textureUnit )
+{
+    Statistics::IncTextureBinds();
+    SetInt( name, textureUnit );
+
+    const std::string scaleOffsetName = std::string( name ) + std::string( "_ST" );
+    SetVector4( scaleOffsetName.c_str(), &texture->GetScaleOffset().x );
+}
+
+void ae3d::Shader::SetInt( const char* name, int value )
+{
+    const float floatValue = static_cast< float >( value );
+    RecordUniform( this, name, &floatValue, 1 );
+}
+
+void ae3d::Shader::SetFloat( const char* name, float value )
+{
+    RecordUniform( this, name, &value, 1 );
+}
+
+void ae3d::Shader::SetVector3( const char* name, const float* vec3 )
+{
+    RecordUniform( this, name, vec3, 3 );
+}
+
+void ae3d::Shader::SetVector4( const char* name, const float* vec4 )
+{
+    RecordUniform( this, name, vec4, 4 );
+}
@@ -0,0 +1,103 @@
+#include "Texture2D.hpp"
+#include <map>
+#include <string>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.c"
+#include "DDSLoader.hpp"
+#include "GfxDevice.hpp"
+#include "FileSystem.hpp"
+#include "System.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+
+namespace Texture2DGlobal
+{
+    ae3d::Texture2D defaultTexture;
+
+    std::map< std::string, ae3d::Texture2D > hashToCachedTexture;
+}
+
+ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
+{
+    if (Texture2DGlobal::defaultTexture.GetWidth() == 0)
+    {
+        Texture2DGlobal::defaultTexture.width = 32;
+        Texture2DGlobal::defaultTexture.height = 32;
+        Texture2DGlobal::defaultTexture.handle = GfxDevice::CreateTextureId();
+    }
+
+    return &Texture2DGlobal::defaultTexture;
+}
+
+void ae3d::Texture2D::Load( const FileSystem::FileView& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+{
+    filter = aFilter;
+    wrap = aWrap;
+    mipmaps = aMipmaps;
+    anisotropy = aAnisotropy;
+    colorSpace = aColorSpace;
+    path = fileContents.path;
+
+    if (!fileContents.isLoaded)
+    {
+        *this = *GetDefaultTexture();
+        return;
+    }
+
+    const std::string cacheHash = GetCacheHash( fileContents.path, aWrap, aFilter, aMipmaps, aColorSpace, aAnisotropy );
+    const bool isCached = Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != Texture2DGlobal::hashToCachedTexture.end();
+
+    if (isCached && handle == 0)
+    {
+        *this = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
+        return;
+    }
+
+    if (handle == 0)
+    {
+        handle = GfxDevice::CreateTextureId();
+    }
+
+    const bool isDDS = fileContents.path.find( ".dds" ) != std::string::npos || fileContents.path.find( ".DDS" ) != std::string::npos;
+
+    if (HasStbExtension( fileContents.path ))
+    {
+        LoadSTB( fileContents );
+    }
+    else if (isDDS)
+    {
+        LoadDDS( fileContents.path.c_str() );
+    }
+    else
+    {
+        System::Print( "Unhandled texture extension in file %s\n", fileContents.path.c_str() );
+    }
+
+    Texture2DGlobal::hashToCachedTexture[ cacheHash ] = *this;
+}
+
+void ae3d::Texture2D::LoadDDS( const char* aPath )
+{
+    DDSLoader::Output unusedOutput;
+    const DDSLoader::LoadResult loadResult = DDSLoader::Load( FileSystem::FileContentsView( aPath ), 0, width, height, opaque, unusedOutput );
+
+    if (loadResult != DDSLoader::LoadResult::Success)
+    {
+        ae3d::System::Print( "DDS Loader could not load %s", aPath );
+    }
+}
+
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileView& fileContents )
+{
+    // Pixels are never uploaded, so only the header is parsed.
+    int components;
+
+    if (!stbi_info_from_memory( fileContents.data, static_cast<int>(fileContents.size), &width, &height, &components ))
+    {
+        const std::string reason( stbi_failure_reason() );
+        System::Print( "%s failed to load. stb_image's reason: %s\n", fileContents.path.c_str(), reason.c_str() );
+        return;
+    }
+
+    opaque = (components == 3 || components == 1);
+}
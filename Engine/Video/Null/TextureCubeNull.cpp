@@ -0,0 +1,59 @@
+#include <string>
+#include "stb_image.c"
+#include "TextureCube.hpp"
+#include "DDSLoader.hpp"
+#include "GfxDevice.hpp"
+#include "FileSystem.hpp"
+#include "System.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+
+void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const FileSystem::FileContentsData& posX,
+          const FileSystem::FileContentsData& negY, const FileSystem::FileContentsData& posY,
+          const FileSystem::FileContentsData& negZ, const FileSystem::FileContentsData& posZ,
+          TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace )
+{
+    filter = aFilter;
+    wrap = aWrap;
+    mipmaps = aMipmaps;
+    colorSpace = aColorSpace;
+    path = negX.path;
+    isCube = true;
+
+    if (handle == 0)
+    {
+        handle = GfxDevice::CreateTextureId();
+    }
+
+    posXpath = posX.path;
+    posYpath = posY.path;
+    posZpath = posZ.path;
+    negXpath = negX.path;
+    negYpath = negY.path;
+    negZpath = negZ.path;
+
+    // Pixels are never uploaded, so dimensions are read from the first face's header.
+    if (HasStbExtension( posX.path ))
+    {
+        int components;
+
+        if (!stbi_info_from_memory( posX.data.data(), static_cast<int>(posX.data.size()), &width, &height, &components ))
+        {
+            System::Print( "Could not load cube map face %s\n", posX.path.c_str() );
+        }
+        else
+        {
+            opaque = (components == 3 || components == 1);
+        }
+    }
+    else if (posX.path.find( ".dds" ) != std::string::npos || posX.path.find( ".DDS" ) != std::string::npos)
+    {
+        DDSLoader::Output unusedOutput;
+        const DDSLoader::LoadResult result = DDSLoader::Load( posX, 1, width, height, opaque, unusedOutput );
+
+        if (result != DDSLoader::LoadResult::Success)
+        {
+            System::Print( "Could not load cube map face %s\n", posX.path.c_str() );
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#include "VertexBuffer.hpp"
+#include "Statistics.hpp"
+
+namespace Global
+{
+    const ae3d::VertexBuffer* activeBuffer = nullptr;
+}
+
+// There's no MeshArena, but pages are still reported like the OpenGL renderer's, one per vertex format.
+int MeshArenaPage( bool useMeshArena, ae3d::VertexBuffer::VertexFormat vertexFormat )
+{
+    return useMeshArena ? static_cast< int >( vertexFormat ) : -1;
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTC* /*vertices*/, int /*vertexCount*/ )
+{
+    vertexFormat = VertexFormat::PTC;
+    elementCount = faceCount * 3;
+    arenaPage = MeshArenaPage( useMeshArena, vertexFormat );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTN* /*vertices*/, int /*vertexCount*/ )
+{
+    vertexFormat = VertexFormat::PTN;
+    elementCount = faceCount * 3;
+    arenaPage = MeshArenaPage( useMeshArena, vertexFormat );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTNTC* /*vertices*/, int /*vertexCount*/ )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+    arenaPage = MeshArenaPage( useMeshArena, vertexFormat );
+}
+
+void ae3d::VertexBuffer::SetDebugName( const char* /*name*/ )
+{
+}
+
+void ae3d::VertexBuffer::Bind() const
+{
+    if (Global::activeBuffer != this)
+    {
+        Global::activeBuffer = this;
+        Statistics::IncVertexBufferBinds();
+    }
+}
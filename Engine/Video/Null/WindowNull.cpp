@@ -0,0 +1,54 @@
+#include "Window.hpp"
+#include "GfxDevice.hpp"
+
+// Headless window: nothing is shown and no events are generated.
+
+namespace WindowGlobal
+{
+    bool isOpen = false;
+    int windowWidth = 640;
+    int windowHeight = 480;
+}
+
+void PlatformInitGamePad()
+{
+}
+
+void ae3d::Window::Create( int width, int height, WindowCreateFlags /*flags*/ )
+{
+    WindowGlobal::windowWidth = width == 0 ? 640 : width;
+    WindowGlobal::windowHeight = height == 0 ? 480 : height;
+    WindowGlobal::isOpen = true;
+
+    GfxDevice::Init( WindowGlobal::windowWidth, WindowGlobal::windowHeight );
+}
+
+void ae3d::Window::GetSize( int& outWidth, int& outHeight )
+{
+    outWidth = WindowGlobal::windowWidth;
+    outHeight = WindowGlobal::windowHeight;
+}
+
+bool ae3d::Window::IsOpen()
+{
+    return WindowGlobal::isOpen;
+}
+
+void ae3d::Window::PumpEvents()
+{
+}
+
+bool ae3d::Window::PollEvent( WindowEvent& outEvent )
+{
+    outEvent.type = WindowEventType::None;
+    return false;
+}
+
+void ae3d::Window::SetTitle( const char* /*title*/ )
+{
+}
+
+void ae3d::Window::SwapBuffers()
+{
+    GfxDevice::Present();
+}
@@ -1,21 +1,96 @@
 #include "ComputeShader.hpp"
+#include <vector>
+#include <GL/glxw.h>
 #include "FileSystem.hpp"
 #include "GfxDevice.hpp"
+#include "RenderTexture.hpp"
+#include "Statistics.hpp"
 #include "System.hpp"
 #include "Macros.hpp"
 
-// Unimplemented because OpenGL renderer is 4.1. If Apple updates their GL driver to support 4.3 these will get implemented.
+namespace ShaderGlobal
+{
+    extern unsigned boundHandle;
+}
 
-void ae3d::ComputeShader::Load( const char* /*source*/ )
+void ae3d::ComputeShader::Load( const char* source )
 {
+    const GLuint shader = GfxDevice::CreateShaderId( GL_COMPUTE_SHADER );
+    glShaderSource( shader, 1, &source, nullptr );
+    glCompileShader( shader );
+
+    GLint wasCompiled;
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &wasCompiled );
+
+    if (!wasCompiled)
+    {
+        GLint logLength = 0;
+        glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logLength );
+        std::vector< GLchar > log( logLength > 0 ? logLength : 1 );
+        glGetShaderInfoLog( shader, static_cast< GLsizei >( log.size() ), nullptr, log.data() );
+        System::Print( "Compute shader compile error: %s\n", log.data() );
+        return;
+    }
+
+    const GLuint program = GfxDevice::CreateProgramId();
+
+    if (GfxDevice::GetExtensions().KHR_debug)
+    {
+        glObjectLabel( GL_PROGRAM, program, -1, "compute shader" );
+    }
+
+    glAttachShader( program, shader );
+    glLinkProgram( program );
+    glDeleteShader( shader );
+
+    GLint wasLinked;
+    glGetProgramiv( program, GL_LINK_STATUS, &wasLinked );
+
+    if (!wasLinked)
+    {
+        System::Print( "Compute shader linking failed.\n" );
+        return;
+    }
+
+    handle = program;
 }
 
+// OpenGL loads GLSL with Load( const char* ). HLSL and SPIR-V are for the other renderers.
 void ae3d::ComputeShader::Load( const char* /*metalShaderName*/, const FileSystem::FileContentsData& /*dataHLSL*/, const FileSystem::FileContentsData& /*dataSPIRV*/ )
 {
 
 }
 
-void ae3d::ComputeShader::Dispatch( unsigned /*groupCountX*/, unsigned /*groupCountY*/, unsigned /*groupCountZ*/ )
+void ae3d::ComputeShader::SetRenderTexture( RenderTexture* renderTexture, unsigned slot )
+{
+    if (renderTextures.size() <= slot)
+    {
+        renderTextures.resize( slot + 1, nullptr );
+    }
+
+    renderTextures[ slot ] = renderTexture;
+}
+
+void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY, unsigned groupCountZ )
 {
+    System::Assert( handle != 0, "compute shader is not loaded" );
+
+    if (ShaderGlobal::boundHandle != handle)
+    {
+        glUseProgram( handle );
+        ShaderGlobal::boundHandle = handle;
+    }
+
+    // Slot is the texture unit, set with layout (binding = slot) in the shader.
+    for (std::size_t slot = 0; slot < renderTextures.size(); ++slot)
+    {
+        if (renderTextures[ slot ] != nullptr)
+        {
+            glActiveTexture( GL_TEXTURE0 + static_cast< GLenum >( slot ) );
+            glBindTexture( GL_TEXTURE_2D, renderTextures[ slot ]->GetID() );
+            Statistics::IncTextureBinds();
+        }
+    }
 
+    glDispatchCompute( groupCountX, groupCountY, groupCountZ );
 }
@@ -1,5 +1,6 @@
 #include "GfxDevice.hpp"
 #include <algorithm>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -7,6 +8,9 @@
 #include "System.hpp"
 #include "Statistics.hpp"
 #include "RenderTexture.hpp"
+#include "ComputeShader.hpp"
+#include "LightClusterer.hpp"
+#include "LightTiler.hpp"
 #include "Shader.hpp"
 #include "VertexBuffer.hpp"
 
@@ -73,11 +77,96 @@ namespace GfxDeviceGlobal
     std::vector< GLuint > rboIds;
     std::vector< GLuint > fboIds;
     std::vector< ae3d::VertexBuffer > lineBuffers;
+    GLuint instanceBuffer = 0;
+
+    // Layout that glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER.
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Scratch buffer for DrawIndirect.
+    std::vector< DrawElementsIndirectCommand > indirectCommands;
+
+    // Input of frustumCullShader, one per draw. Layout matches CullDraw in the shader.
+    struct CullDraw
+    {
+        float aabbMin[ 4 ];
+        float aabbMax[ 4 ];
+        // Index count, first index, base vertex, unused.
+        GLint command[ 4 ];
+    };
+
+    // Scratch buffer for DrawIndirectCulled.
+    std::vector< CullDraw > cullDraws;
+
+    // Written by frustumCullShader and read by the draw in DrawIndirectCulled. Grown when a draw has more draws than capacity.
+    struct CullBuffers
+    {
+        GLuint commands = 0;
+        GLuint modelMatrices = 0;
+        GLuint visibleCount = 0;
+        int capacity = 0;
+        GLuint program = 0;
+        GLint frustumPlanesLocation = -1;
+        GLint drawCountLocation = -1;
+    } cullBuffers;
     
+    ae3d::LightTiler lightTiler;
     int backBufferWidth = 640;
     int backBufferHeight = 400;
     GLuint systemFBO = 0;
     GLuint cachedFBO = 0;
+    ae3d::GfxDevice::Extensions extensions;
+    bool areExtensionsResolved = false;
+
+    // Uniform buffer that is written by the CPU while the GPU reads earlier frames' parts.
+    // A frame's part is fenced when the frame is presented and waited on before it's reused.
+    // If a frame's uploads don't fit into its part, the ring is replaced by a bigger one, see GrowUniformRing.
+    struct UniformRing
+    {
+        static const unsigned FrameCount = 3;
+        static const unsigned InitialFrameSize = 4 * 1024 * 1024;
+        static const unsigned BindingCount = 2;
+
+        // Buffer that was replaced by a bigger one. Deleted after the GPU has finished the frame it was retired in.
+        struct RetiredBuffer
+        {
+            GLuint buffer = 0;
+            unsigned frame = 0;
+        };
+
+        GLuint buffer = 0;
+        // Null if GL_ARB_buffer_storage is not supported, then uploads use glBufferSubData.
+        unsigned char* mappedData = nullptr;
+        GLsync fences[ FrameCount ] = {};
+        std::vector< RetiredBuffer > retiredBuffers;
+        unsigned frameSize = InitialFrameSize;
+        unsigned frame = 0;
+        // Changes when offsets from earlier UploadUniforms calls become invalid, ie. on Present and when the ring grows.
+        unsigned generation = 0;
+        // Offset in the current frame's part.
+        unsigned offset = 0;
+        unsigned alignment = 256;
+        unsigned boundOffsets[ BindingCount ] = { ~0u, ~0u };
+        unsigned boundSizes[ BindingCount ] = {};
+    } uniformRing;
+
+    // Shadow of the state that draws set. -1 is not a valid value, so the next call after invalidation is not skipped.
+    struct StateCache
+    {
+        int blendMode = -1;
+        int depthFunc = -1;
+        int cullMode = -1;
+        int fillMode = -1;
+        int polygonOffsetEnable = -1;
+        float polygonOffsetFactor = 0;
+        float polygonOffsetUnits = 0;
+    } stateCache;
 }
 
 namespace ae3d
@@ -92,8 +181,15 @@ namespace ae3d
                 stm << "frame time: " << ::Statistics::GetFrameTimeMS() << " ms\n";
                 stm << "shadow map time: " << ::Statistics::GetShadowMapTimeMS() << " ms\n";
                 stm << "depth pass time: " << ::Statistics::GetDepthNormalsTimeMS() << " ms\n";
+                stm << "light assignment time: " << ::Statistics::GetLightAssignmentTimeMS() << " ms\n";
                 stm << "draw calls: " << ::Statistics::GetDrawCalls() << "\n";
                 stm << "texture binds: " << ::Statistics::GetTextureBinds() << "\n";
+                stm << "shader binds: " << ::Statistics::GetShaderBinds() << "\n";
+                stm << "shader binds saved: " << ::Statistics::GetShaderBindsSaved() << "\n";
+                stm << "texture binds saved: " << ::Statistics::GetTextureBindsSaved() << "\n";
+                stm << "state changes saved: " << ::Statistics::GetStateChangesSaved() << "\n";
+                stm << "visible draws, CPU / GPU culled: " << ::Statistics::GetCpuVisibleDraws() << " / " << ::Statistics::GetGpuVisibleDraws() << "\n";
+                stm << "occluded meshes: " << ::Statistics::GetOccludedMeshes() << "\n";
                 stm << "render target binds: " << ::Statistics::GetRenderTargetBinds() << "\n";
                 stm << "triangles: " << ::Statistics::GetTriangleCount() << "\n";
 
@@ -103,8 +199,26 @@ namespace ae3d
     }
 }
 
+// \return True, if cachedValue already is value. Otherwise stores value into cachedValue.
+bool IsCached( int& cachedValue, int value )
+{
+    if (cachedValue == value)
+    {
+        Statistics::IncStateChangesSaved();
+        return true;
+    }
+
+    cachedValue = value;
+    return false;
+}
+
 void SetBlendMode( ae3d::GfxDevice::BlendMode blendMode )
 {
+    if (IsCached( GfxDeviceGlobal::stateCache.blendMode, static_cast< int >( blendMode ) ))
+    {
+        return;
+    }
+
     if (blendMode == ae3d::GfxDevice::BlendMode::Off)
     {
         glDisable( GL_BLEND );
@@ -127,6 +241,11 @@ void SetBlendMode( ae3d::GfxDevice::BlendMode blendMode )
 
 void SetCullMode( ae3d::GfxDevice::CullMode cullMode )
 {
+    if (IsCached( GfxDeviceGlobal::stateCache.cullMode, static_cast< int >( cullMode ) ))
+    {
+        return;
+    }
+
     if (cullMode == ae3d::GfxDevice::CullMode::Back)
     {
         glEnable( GL_CULL_FACE );
@@ -145,11 +264,21 @@ void SetCullMode( ae3d::GfxDevice::CullMode cullMode )
 
 void SetFillMode( ae3d::GfxDevice::FillMode fillMode )
 {
+    if (IsCached( GfxDeviceGlobal::stateCache.fillMode, static_cast< int >( fillMode ) ))
+    {
+        return;
+    }
+
     glPolygonMode( GL_FRONT_AND_BACK, fillMode == ae3d::GfxDevice::FillMode::Solid ? GL_FILL : GL_LINE );
 }
 
 void SetDepthFunc( ae3d::GfxDevice::DepthFunc depthFunc )
 {
+    if (IsCached( GfxDeviceGlobal::stateCache.depthFunc, static_cast< int >( depthFunc ) ))
+    {
+        return;
+    }
+
     if (depthFunc == ae3d::GfxDevice::DepthFunc::LessOrEqualWriteOn)
     {
         glDepthMask( GL_TRUE );
@@ -175,6 +304,18 @@ void SetDepthFunc( ae3d::GfxDevice::DepthFunc depthFunc )
 
 void ae3d::GfxDevice::SetPolygonOffset( bool enable, float factor, float units )
 {
+    GfxDeviceGlobal::StateCache& cache = GfxDeviceGlobal::stateCache;
+
+    if (cache.polygonOffsetEnable == (enable ? 1 : 0) && cache.polygonOffsetFactor == factor && cache.polygonOffsetUnits == units)
+    {
+        Statistics::IncStateChangesSaved();
+        return;
+    }
+
+    cache.polygonOffsetEnable = enable ? 1 : 0;
+    cache.polygonOffsetFactor = factor;
+    cache.polygonOffsetUnits = units;
+
     if (enable)
     {
         glEnable( GL_POLYGON_OFFSET_FILL );
@@ -205,6 +346,10 @@ void ae3d::GfxDevice::Init( int width, int height )
     SetBackBufferDimensionAndFBO( width, height );
     Set_sRGB_Writes( true );
     glEnable( GL_DEPTH_TEST );
+    GfxDeviceGlobal::areExtensionsResolved = false;
+    GetExtensions();
+    InvalidateStateCache();
+    GfxDeviceGlobal::lightTiler.Init();
 
     GLint v;
     glGetIntegerv( GL_CONTEXT_FLAGS, &v );
@@ -216,9 +361,14 @@ void ae3d::GfxDevice::Init( int width, int height )
     }
 }
 
+void ae3d::GfxDevice::InvalidateStateCache()
+{
+    GfxDeviceGlobal::stateCache = GfxDeviceGlobal::StateCache();
+}
+
 void ae3d::GfxDevice::PushGroupMarker( const char* name )
 {
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDeviceGlobal::extensions.KHR_debug)
     {
         const std::string nameStr( name );
         glPushDebugGroup( GL_DEBUG_SOURCE_APPLICATION, 0, (GLsizei)nameStr.length(), name );
@@ -227,7 +377,7 @@ void ae3d::GfxDevice::PushGroupMarker( const char* name )
 
 void ae3d::GfxDevice::PopGroupMarker()
 {
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDeviceGlobal::extensions.KHR_debug)
     {
         glPopDebugGroup();
     }
@@ -245,6 +395,8 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     SetFillMode( fillMode );
 
     shader.Use();
+    shader.UploadUniformBlocks();
+    GfxDeviceGlobal::lightTiler.BindLightLists();
     vertexBuffer.Bind();
     Statistics::IncDrawCalls();
     Statistics::IncTriangleCount( endIndex - startIndex );
@@ -253,7 +405,371 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     shader.Validate();
 #endif
 
-    glDrawRangeElements( GL_TRIANGLES, startIndex, endIndex, (endIndex - startIndex) * 3, GL_UNSIGNED_SHORT, (const GLvoid*)(startIndex * sizeof( VertexBuffer::Face )) );
+    const std::size_t indexOffset = vertexBuffer.GetIndexByteOffset() + startIndex * sizeof( VertexBuffer::Face );
+    glDrawElementsBaseVertex( GL_TRIANGLES, (endIndex - startIndex) * 3, GL_UNSIGNED_SHORT, (const GLvoid*)indexOffset, vertexBuffer.GetBaseVertex() );
+}
+
+void ae3d::GfxDevice::UploadInstanceData( const float* modelMatrices, int instanceCount )
+{
+    if (GfxDeviceGlobal::instanceBuffer == 0)
+    {
+        GfxDeviceGlobal::instanceBuffer = CreateBufferId();
+    }
+
+    glBindBuffer( GL_ARRAY_BUFFER, GfxDeviceGlobal::instanceBuffer );
+    // Orphans the previous contents so that draws still reading them don't stall the upload.
+    glBufferData( GL_ARRAY_BUFFER, instanceCount * 16 * sizeof( float ), modelMatrices, GL_STREAM_DRAW );
+}
+
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, int firstInstance, int instanceCount, Shader& shader,
+                                     BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
+    ae3d::System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
+    ae3d::System::Assert( GfxDeviceGlobal::instanceBuffer != 0, "UploadInstanceData must be called before DrawInstanced" );
+
+    SetBlendMode( blendMode );
+    SetDepthFunc( depthFunc );
+    SetCullMode( cullMode );
+    SetFillMode( fillMode );
+
+    shader.Use();
+    shader.UploadUniformBlocks();
+    GfxDeviceGlobal::lightTiler.BindLightLists();
+    vertexBuffer.Bind();
+
+    // The instance attributes are stored in the vertex buffer's VAO. Non-instanced shaders don't read them.
+    glBindBuffer( GL_ARRAY_BUFFER, GfxDeviceGlobal::instanceBuffer );
+
+    for (int column = 0; column < 4; ++column)
+    {
+        const GLuint channel = VertexBuffer::instanceChannel + column;
+        const std::size_t offset = (firstInstance * 16 + column * 4) * sizeof( float );
+        glEnableVertexAttribArray( channel );
+        glVertexAttribPointer( channel, 4, GL_FLOAT, GL_FALSE, 16 * sizeof( float ), (const GLvoid*)offset );
+        glVertexAttribDivisor( channel, 1 );
+    }
+
+    Statistics::IncDrawCalls();
+    Statistics::IncTriangleCount( (endIndex - startIndex) * instanceCount );
+
+#if DEBUG
+    shader.Validate();
+#endif
+
+    const std::size_t indexOffset = vertexBuffer.GetIndexByteOffset() + startIndex * sizeof( VertexBuffer::Face );
+    glDrawElementsInstancedBaseVertex( GL_TRIANGLES, (endIndex - startIndex) * 3, GL_UNSIGNED_SHORT, (const GLvoid*)indexOffset, instanceCount, vertexBuffer.GetBaseVertex() );
+}
+
+void CreateUniformRing()
+{
+    GfxDeviceGlobal::UniformRing& ring = GfxDeviceGlobal::uniformRing;
+    const GLsizeiptr ringSize = static_cast< GLsizeiptr >( GfxDeviceGlobal::UniformRing::FrameCount ) * ring.frameSize;
+
+    // Not created with CreateBufferId, because a ring that has grown is deleted before Release.
+    glGenBuffers( 1, &ring.buffer );
+    glBindBuffer( GL_UNIFORM_BUFFER, ring.buffer );
+
+    if (ae3d::GfxDevice::GetExtensions().ARB_buffer_storage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage( GL_UNIFORM_BUFFER, ringSize, nullptr, flags );
+        ring.mappedData = static_cast< unsigned char* >( glMapBufferRange( GL_UNIFORM_BUFFER, 0, ringSize, flags ) );
+    }
+    else
+    {
+        glBufferData( GL_UNIFORM_BUFFER, ringSize, nullptr, GL_STREAM_DRAW );
+    }
+
+    if (ae3d::GfxDevice::GetExtensions().KHR_debug)
+    {
+        glObjectLabel( GL_BUFFER, ring.buffer, -1, "uniform ring" );
+    }
+
+    // DrawIndirect binds parts of the ring as storage buffers too.
+    GLint alignment = 256;
+    glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+    GLint storageAlignment = 256;
+    glGetIntegerv( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment );
+    ring.alignment = static_cast< unsigned >( std::max( alignment, storageAlignment ) );
+}
+
+// Replaces the ring with one whose frame parts fit at least minFrameSize bytes. The old ring is only written before this,
+// so ranges of it that are already bound or used by submitted draws stay valid. It's deleted when its last frame has finished.
+void GrowUniformRing( unsigned minFrameSize )
+{
+    GfxDeviceGlobal::UniformRing& ring = GfxDeviceGlobal::uniformRing;
+
+    GfxDeviceGlobal::UniformRing::RetiredBuffer retired;
+    retired.buffer = ring.buffer;
+    retired.frame = ring.frame;
+    ring.retiredBuffers.push_back( retired );
+
+    unsigned frameSize = ring.frameSize;
+
+    while (frameSize < minFrameSize)
+    {
+        frameSize *= 2;
+    }
+
+    ae3d::System::Print( "Uniform ring is full, growing it to %u bytes per frame.\n", frameSize );
+
+    ring.frameSize = frameSize;
+    ring.buffer = 0;
+    ring.mappedData = nullptr;
+    ring.offset = 0;
+    ++ring.generation;
+
+    for (unsigned binding = 0; binding < GfxDeviceGlobal::UniformRing::BindingCount; ++binding)
+    {
+        ring.boundOffsets[ binding ] = ~0u;
+        ring.boundSizes[ binding ] = 0;
+    }
+
+    CreateUniformRing();
+}
+
+// Grows the ring now if uploadCount uploads of size bytes in total would not fit, so that uploads that are bound together are in the same buffer.
+void ReserveUniforms( unsigned size, unsigned uploadCount )
+{
+    GfxDeviceGlobal::UniformRing& ring = GfxDeviceGlobal::uniformRing;
+
+    if (ring.buffer == 0)
+    {
+        CreateUniformRing();
+    }
+
+    // Every upload can be padded to the alignment.
+    const std::size_t alignedSize = static_cast< std::size_t >( size ) + uploadCount * (ring.alignment - 1);
+
+    if (ring.offset + alignedSize > ring.frameSize)
+    {
+        GrowUniformRing( std::max( ring.frameSize * 2, static_cast< unsigned >( alignedSize ) ) );
+    }
+}
+
+void ae3d::GfxDevice::DrawIndirect( VertexBuffer* const* vertexBuffers, const float* modelMatrices, int drawCount, Shader& shader,
+                                    BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( drawCount > 0, "DrawIndirect needs at least one draw" );
+    ae3d::System::Assert( shader.IsDrawIndirect(), "DrawIndirect needs a shader with a PerDraw storage block" );
+
+    SetBlendMode( blendMode );
+    SetDepthFunc( depthFunc );
+    SetCullMode( cullMode );
+    SetFillMode( fillMode );
+
+    shader.Use();
+    shader.UploadUniformBlocks();
+    GfxDeviceGlobal::lightTiler.BindLightLists();
+    vertexBuffers[ 0 ]->Bind();
+
+    GfxDeviceGlobal::indirectCommands.resize( drawCount );
+    int triangleCount = 0;
+
+    for (int i = 0; i < drawCount; ++i)
+    {
+        const VertexBuffer& vertexBuffer = *vertexBuffers[ i ];
+        ae3d::System::Assert( drawCount == 1 || (vertexBuffer.GetMeshArenaPage() != -1 && vertexBuffer.GetMeshArenaPage() == vertexBuffers[ 0 ]->GetMeshArenaPage()),
+                              "DrawIndirect vertex buffers must be in the same MeshArena page" );
+
+        GfxDeviceGlobal::DrawElementsIndirectCommand& command = GfxDeviceGlobal::indirectCommands[ i ];
+        command.count = static_cast< GLuint >( vertexBuffer.GetFaceCount() );
+        command.instanceCount = 1;
+        command.firstIndex = vertexBuffer.GetIndexByteOffset() / sizeof( unsigned short );
+        command.baseVertex = vertexBuffer.GetBaseVertex();
+        command.baseInstance = 0;
+        triangleCount += vertexBuffer.GetFaceCount() / 3;
+    }
+
+    // Commands and matrices go into the uniform ring, so they are fenced with the rest of the frame's uniforms.
+    const unsigned commandsSize = drawCount * sizeof( GfxDeviceGlobal::DrawElementsIndirectCommand );
+    const unsigned matricesSize = drawCount * 16 * sizeof( float );
+    ReserveUniforms( commandsSize + matricesSize, 2 );
+    const unsigned commandsOffset = UploadUniforms( GfxDeviceGlobal::indirectCommands.data(), commandsSize );
+    const unsigned matricesOffset = UploadUniforms( modelMatrices, matricesSize );
+
+    glBindBufferRange( GL_SHADER_STORAGE_BUFFER, Shader::PerDrawBinding, GfxDeviceGlobal::uniformRing.buffer, matricesOffset, matricesSize );
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, GfxDeviceGlobal::uniformRing.buffer );
+
+    Statistics::IncDrawCalls();
+    Statistics::IncTriangleCount( triangleCount );
+
+#if DEBUG
+    shader.Validate();
+#endif
+
+    glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_SHORT, (const GLvoid*)(std::size_t)commandsOffset, drawCount, 0 );
+}
+
+void EnsureCullBufferCapacity( int drawCount )
+{
+    GfxDeviceGlobal::CullBuffers& buffers = GfxDeviceGlobal::cullBuffers;
+
+    if (buffers.visibleCount == 0)
+    {
+        buffers.commands = ae3d::GfxDevice::CreateBufferId();
+        buffers.modelMatrices = ae3d::GfxDevice::CreateBufferId();
+        buffers.visibleCount = ae3d::GfxDevice::CreateBufferId();
+
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers.visibleCount );
+        glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( GLuint ), nullptr, GL_DYNAMIC_COPY );
+
+        if (ae3d::GfxDevice::GetExtensions().KHR_debug)
+        {
+            glObjectLabel( GL_BUFFER, buffers.commands, -1, "culled draw commands" );
+            glObjectLabel( GL_BUFFER, buffers.modelMatrices, -1, "culled model matrices" );
+            glObjectLabel( GL_BUFFER, buffers.visibleCount, -1, "culled draw count" );
+        }
+    }
+
+    if (drawCount <= buffers.capacity)
+    {
+        return;
+    }
+
+    buffers.capacity = drawCount * 2;
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers.commands );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, buffers.capacity * sizeof( GfxDeviceGlobal::DrawElementsIndirectCommand ), nullptr, GL_DYNAMIC_COPY );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers.modelMatrices );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, buffers.capacity * 16 * sizeof( float ), nullptr, GL_DYNAMIC_COPY );
+}
+
+void ae3d::GfxDevice::DrawIndirectCulled( VertexBuffer* const* vertexBuffers, const float* modelMatrices, const float* localBounds, int drawCount,
+                                          ComputeShader& cullShader, const float* frustumPlanes, int* outVisibleCount, Shader& shader,
+                                          BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    ae3d::System::Assert( drawCount > 0, "DrawIndirectCulled needs at least one draw" );
+    ae3d::System::Assert( shader.IsDrawIndirect(), "DrawIndirectCulled needs a shader with a PerDraw storage block" );
+    ae3d::System::Assert( cullShader.GetHandle() != 0, "frustum cull shader is not loaded, it needs GL 4.3" );
+
+    GfxDeviceGlobal::cullDraws.resize( drawCount );
+
+    for (int i = 0; i < drawCount; ++i)
+    {
+        const VertexBuffer& vertexBuffer = *vertexBuffers[ i ];
+        ae3d::System::Assert( drawCount == 1 || (vertexBuffer.GetMeshArenaPage() != -1 && vertexBuffer.GetMeshArenaPage() == vertexBuffers[ 0 ]->GetMeshArenaPage()),
+                              "DrawIndirectCulled vertex buffers must be in the same MeshArena page" );
+
+        GfxDeviceGlobal::CullDraw& cullDraw = GfxDeviceGlobal::cullDraws[ i ];
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            cullDraw.aabbMin[ axis ] = localBounds[ i * 6 + axis ];
+            cullDraw.aabbMax[ axis ] = localBounds[ i * 6 + 3 + axis ];
+        }
+
+        cullDraw.aabbMin[ 3 ] = 1;
+        cullDraw.aabbMax[ 3 ] = 1;
+        cullDraw.command[ 0 ] = vertexBuffer.GetFaceCount();
+        cullDraw.command[ 1 ] = static_cast< GLint >( vertexBuffer.GetIndexByteOffset() / sizeof( unsigned short ) );
+        cullDraw.command[ 2 ] = vertexBuffer.GetBaseVertex();
+        cullDraw.command[ 3 ] = 0;
+    }
+
+    EnsureCullBufferCapacity( drawCount );
+    GfxDeviceGlobal::CullBuffers& buffers = GfxDeviceGlobal::cullBuffers;
+
+    const unsigned cullDrawsSize = drawCount * sizeof( GfxDeviceGlobal::CullDraw );
+    const unsigned matricesSize = drawCount * 16 * sizeof( float );
+    ReserveUniforms( cullDrawsSize + matricesSize, 2 );
+    const unsigned cullDrawsOffset = UploadUniforms( GfxDeviceGlobal::cullDraws.data(), cullDrawsSize );
+    const unsigned matricesOffset = UploadUniforms( modelMatrices, matricesSize );
+
+    const GLuint zero = 0;
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers.visibleCount );
+    glClearBufferSubData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof( GLuint ), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero );
+
+    // Without a draw count parameter all drawCount commands are read, so the culled ones must draw nothing.
+    if (!GetExtensions().ARB_indirect_parameters)
+    {
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers.commands );
+        glClearBufferSubData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, drawCount * sizeof( GfxDeviceGlobal::DrawElementsIndirectCommand ),
+                              GL_RED_INTEGER, GL_UNSIGNED_INT, &zero );
+    }
+
+    glBindBufferRange( GL_SHADER_STORAGE_BUFFER, 0, GfxDeviceGlobal::uniformRing.buffer, cullDrawsOffset, cullDrawsSize );
+    glBindBufferRange( GL_SHADER_STORAGE_BUFFER, 1, GfxDeviceGlobal::uniformRing.buffer, matricesOffset, matricesSize );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, Shader::PerDrawBinding, buffers.modelMatrices );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 3, buffers.commands );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 4, buffers.visibleCount );
+
+    if (buffers.program != cullShader.GetHandle())
+    {
+        buffers.program = cullShader.GetHandle();
+        buffers.frustumPlanesLocation = glGetUniformLocation( buffers.program, "_FrustumPlanes" );
+        buffers.drawCountLocation = glGetUniformLocation( buffers.program, "_DrawCount" );
+    }
+
+    glProgramUniform4fv( buffers.program, buffers.frustumPlanesLocation, 6, frustumPlanes );
+    glProgramUniform1ui( buffers.program, buffers.drawCountLocation, static_cast< GLuint >( drawCount ) );
+    cullShader.Dispatch( (drawCount + 63) / 64, 1, 1 );
+    glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | (outVisibleCount != nullptr ? GL_BUFFER_UPDATE_BARRIER_BIT : 0) );
+
+    SetBlendMode( blendMode );
+    SetDepthFunc( depthFunc );
+    SetCullMode( cullMode );
+    SetFillMode( fillMode );
+
+    shader.Use();
+    shader.UploadUniformBlocks();
+    GfxDeviceGlobal::lightTiler.BindLightLists();
+    vertexBuffers[ 0 ]->Bind();
+    glBindBuffer( GL_DRAW_INDIRECT_BUFFER, buffers.commands );
+    // Triangles are not counted because the CPU doesn't know which draws are visible.
+    Statistics::IncDrawCalls();
+
+#if DEBUG
+    shader.Validate();
+#endif
+
+    if (GetExtensions().ARB_indirect_parameters)
+    {
+        glBindBuffer( GL_PARAMETER_BUFFER_ARB, buffers.visibleCount );
+        glMultiDrawElementsIndirectCountARB( GL_TRIANGLES, GL_UNSIGNED_SHORT, 0, 0, drawCount, 0 );
+    }
+    else
+    {
+        glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, drawCount, 0 );
+    }
+
+    if (outVisibleCount != nullptr)
+    {
+        GLuint visibleCount = 0;
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers.visibleCount );
+        glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof( GLuint ), &visibleCount );
+        *outVisibleCount = static_cast< int >( visibleCount );
+    }
+}
+
+void ae3d::GfxDevice::UploadLightClusters( const LightClusterer& clusterer )
+{
+    const std::vector< LightClusterer::Light >& lights = clusterer.GetLights();
+    const std::vector< unsigned >& lightIndices = clusterer.GetLightIndices();
+    const std::vector< LightClusterer::Cluster >& clusters = clusterer.GetClusters();
+
+    // Like DrawIndirect's buffers, the lists go into the uniform ring so they are fenced with the rest of the frame.
+    // Empty lists are not bound because zero-sized ranges are invalid and no cluster refers to them.
+    if (!lights.empty())
+    {
+        const unsigned lightsSize = static_cast< unsigned >( lights.size() * sizeof( LightClusterer::Light ) );
+        const unsigned lightsOffset = UploadUniforms( lights.data(), lightsSize );
+        glBindBufferRange( GL_SHADER_STORAGE_BUFFER, Shader::ClusteredLightsBinding, GfxDeviceGlobal::uniformRing.buffer, lightsOffset, lightsSize );
+    }
+
+    if (!lightIndices.empty())
+    {
+        const unsigned indicesSize = static_cast< unsigned >( lightIndices.size() * sizeof( unsigned ) );
+        const unsigned indicesOffset = UploadUniforms( lightIndices.data(), indicesSize );
+        glBindBufferRange( GL_SHADER_STORAGE_BUFFER, Shader::LightIndicesBinding, GfxDeviceGlobal::uniformRing.buffer, indicesOffset, indicesSize );
+    }
+
+    if (!clusters.empty())
+    {
+        const unsigned clustersSize = static_cast< unsigned >( clusters.size() * sizeof( LightClusterer::Cluster ) );
+        const unsigned clustersOffset = UploadUniforms( clusters.data(), clustersSize );
+        glBindBufferRange( GL_SHADER_STORAGE_BUFFER, Shader::LightClustersBinding, GfxDeviceGlobal::uniformRing.buffer, clustersOffset, clustersSize );
+    }
 }
 
 int ae3d::GfxDevice::CreateLineBuffer( const std::vector< Vec3 >& lines, const Vec3& color )
@@ -318,7 +834,7 @@ void ae3d::GfxDevice::SetMultiSampling( bool enable )
 
 void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outGpuUsageMBytes, unsigned& outGpuBudgetMBytes )
 {
-    if (HasExtension( "GL_NVX_gpu_memory_info" ))
+    if (GetExtensions().NVX_gpu_memory_info)
     {
         const unsigned GL_GPU_MEM_INFO_TOTAL_AVAILABLE_MEM_NVX = 0x9048;
         const unsigned GL_GPU_MEM_INFO_CURRENT_AVAILABLE_MEM_NVX = 0x9049;
@@ -371,6 +887,132 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
     {
         glDeleteProgram( i );
     }
+
+    for (auto& fence : GfxDeviceGlobal::uniformRing.fences)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync( fence );
+            fence = nullptr;
+        }
+    }
+
+    for (const auto& retired : GfxDeviceGlobal::uniformRing.retiredBuffers)
+    {
+        glDeleteBuffers( 1, &retired.buffer );
+    }
+
+    GfxDeviceGlobal::uniformRing.retiredBuffers.clear();
+
+    if (GfxDeviceGlobal::uniformRing.buffer != 0)
+    {
+        glDeleteBuffers( 1, &GfxDeviceGlobal::uniformRing.buffer );
+        GfxDeviceGlobal::uniformRing.buffer = 0;
+        GfxDeviceGlobal::uniformRing.mappedData = nullptr;
+    }
+    GfxDeviceGlobal::lightTiler.DestroyBuffers();
+}
+
+unsigned ae3d::GfxDevice::UploadUniforms( const void* data, unsigned size )
+{
+    GfxDeviceGlobal::UniformRing& ring = GfxDeviceGlobal::uniformRing;
+
+    if (ring.buffer == 0)
+    {
+        CreateUniformRing();
+    }
+
+    if (static_cast< std::size_t >( ring.offset ) + size > ring.frameSize)
+    {
+        GrowUniformRing( std::max( ring.frameSize * 2, size ) );
+    }
+
+    const unsigned offset = (ring.frame % GfxDeviceGlobal::UniformRing::FrameCount) * ring.frameSize + ring.offset;
+
+    if (ring.mappedData != nullptr)
+    {
+        std::memcpy( ring.mappedData + offset, data, size );
+    }
+    else
+    {
+        glBindBuffer( GL_UNIFORM_BUFFER, ring.buffer );
+        glBufferSubData( GL_UNIFORM_BUFFER, offset, size, data );
+    }
+
+    ring.offset += (size + ring.alignment - 1) / ring.alignment * ring.alignment;
+    return offset;
+}
+
+void ae3d::GfxDevice::BindUniforms( unsigned binding, unsigned offset, unsigned size )
+{
+    GfxDeviceGlobal::UniformRing& ring = GfxDeviceGlobal::uniformRing;
+    System::Assert( binding < GfxDeviceGlobal::UniformRing::BindingCount, "invalid uniform block binding" );
+
+    if (ring.boundOffsets[ binding ] == offset && ring.boundSizes[ binding ] == size)
+    {
+        Statistics::IncStateChangesSaved();
+        return;
+    }
+
+    glBindBufferRange( GL_UNIFORM_BUFFER, binding, ring.buffer, offset, size );
+    ring.boundOffsets[ binding ] = offset;
+    ring.boundSizes[ binding ] = size;
+}
+
+unsigned ae3d::GfxDevice::GetUniformRingFrame()
+{
+    return GfxDeviceGlobal::uniformRing.generation;
+}
+
+void ae3d::GfxDevice::Present()
+{
+    GfxDeviceGlobal::UniformRing& ring = GfxDeviceGlobal::uniformRing;
+
+    if (ring.buffer != 0)
+    {
+        GLsync& fence = ring.fences[ ring.frame % GfxDeviceGlobal::UniformRing::FrameCount ];
+
+        if (fence != nullptr)
+        {
+            glDeleteSync( fence );
+        }
+
+        fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    }
+
+    ++ring.frame;
+    ++ring.generation;
+    ring.offset = 0;
+
+    GLsync& nextFence = ring.fences[ ring.frame % GfxDeviceGlobal::UniformRing::FrameCount ];
+
+    if (nextFence != nullptr)
+    {
+        // Waits until the GPU has finished the frame that last used this part of the ring.
+        const GLuint64 timeoutNanoseconds = 1000000;
+
+        while (glClientWaitSync( nextFence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNanoseconds ) == GL_TIMEOUT_EXPIRED)
+        {
+            Statistics::IncFenceCalls();
+        }
+
+        glDeleteSync( nextFence );
+        nextFence = nullptr;
+    }
+
+    // Every frame up to the one that last used this part of the ring has finished, so rings retired in them can be deleted.
+    for (std::size_t i = 0; i < ring.retiredBuffers.size(); )
+    {
+        if (ring.frame - ring.retiredBuffers[ i ].frame >= GfxDeviceGlobal::UniformRing::FrameCount)
+        {
+            glDeleteBuffers( 1, &ring.retiredBuffers[ i ].buffer );
+            ring.retiredBuffers.erase( ring.retiredBuffers.begin() + static_cast< std::ptrdiff_t >( i ) );
+        }
+        else
+        {
+            ++i;
+        }
+    }
 }
 
 unsigned ae3d::GfxDevice::CreateTextureId()
@@ -444,6 +1086,11 @@ void ae3d::GfxDevice::ClearScreen( unsigned clearFlags )
     {
         glDepthMask( GL_TRUE );
         glClear( mask );
+
+        if (GfxDeviceGlobal::stateCache.depthFunc != static_cast< int >( DepthFunc::LessOrEqualWriteOn ))
+        {
+            GfxDeviceGlobal::stateCache.depthFunc = -1;
+        }
     }
 }
 
@@ -517,6 +1164,22 @@ bool ae3d::GfxDevice::HasExtension( const char* glExtension )
     return std::find( std::begin( sExtensions ), std::end( sExtensions ), glExtension ) != std::end( sExtensions );
 }
 
+const ae3d::GfxDevice::Extensions& ae3d::GfxDevice::GetExtensions()
+{
+    if (!GfxDeviceGlobal::areExtensionsResolved)
+    {
+        GfxDeviceGlobal::extensions.KHR_debug = HasExtension( "GL_KHR_debug" );
+        GfxDeviceGlobal::extensions.ARB_buffer_storage = HasExtension( "GL_ARB_buffer_storage" );
+        GfxDeviceGlobal::extensions.EXT_texture_filter_anisotropic = HasExtension( "GL_EXT_texture_filter_anisotropic" );
+        GfxDeviceGlobal::extensions.NVX_gpu_memory_info = HasExtension( "GL_NVX_gpu_memory_info" );
+        GfxDeviceGlobal::extensions.ARB_shader_draw_parameters = HasExtension( "GL_ARB_shader_draw_parameters" );
+        GfxDeviceGlobal::extensions.ARB_indirect_parameters = HasExtension( "GL_ARB_indirect_parameters" );
+        GfxDeviceGlobal::areExtensionsResolved = true;
+    }
+
+    return GfxDeviceGlobal::extensions;
+}
+
 void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned cubeMapFace )
 {
     if (target != nullptr && target->GetFBO() == GfxDeviceGlobal::cachedFBO && cubeMapFace == 0)
@@ -0,0 +1,171 @@
+#include "LightTiler.hpp"
+#include <algorithm>
+#include <GL/glxw.h>
+#include "ComputeShader.hpp"
+#include "GfxDevice.hpp"
+#include "Matrix.hpp"
+#include "RenderTexture.hpp"
+#include "System.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+// Layout matches CullerUniforms in the light culler shader in RendererGL.cpp.
+struct CullerUniforms
+{
+    Matrix44 invProjection;
+    Matrix44 viewMatrix;
+    unsigned windowWidth;
+    unsigned windowHeight;
+    unsigned numLights;
+    int maxNumLightsPerTile;
+};
+
+namespace
+{
+    GLuint CreateStorageBuffer( GLsizeiptr size, GLenum usage, const char* debugName )
+    {
+        const GLuint buffer = GfxDevice::CreateBufferId();
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffer );
+        glBufferData( GL_SHADER_STORAGE_BUFFER, size, nullptr, usage );
+
+        if (GfxDevice::GetExtensions().KHR_debug)
+        {
+            glObjectLabel( GL_BUFFER, buffer, -1, debugName );
+        }
+
+        return buffer;
+    }
+}
+
+void ae3d::LightTiler::Init()
+{
+    // Buffers are created on the first CullLights because compute shaders need GL 4.3, which is checked when the shader is loaded.
+    pointLightCenterAndRadius.resize( MaxLights );
+}
+
+void ae3d::LightTiler::DestroyBuffers()
+{
+    // Buffer ids are deleted by GfxDevice::ReleaseGPUObjects.
+    uniformBuffer = 0;
+    pointLightCenterAndRadiusBuffer = 0;
+    perTileLightIndexBuffer = 0;
+    lightCountPerTileBuffer = 0;
+    bufferTileCount = 0;
+}
+
+void ae3d::LightTiler::UpdateLightBuffers()
+{
+    if (pointLightCenterAndRadiusBuffer == 0 || activePointLights == 0)
+    {
+        return;
+    }
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, pointLightCenterAndRadiusBuffer );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, activePointLights * sizeof( Vec4 ), pointLightCenterAndRadius.data() );
+}
+
+void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& view, RenderTexture& depthNormalTarget )
+{
+    if (shader.GetHandle() == 0)
+    {
+        return;
+    }
+
+    if (pointLightCenterAndRadiusBuffer == 0)
+    {
+        uniformBuffer = CreateStorageBuffer( sizeof( CullerUniforms ), GL_DYNAMIC_DRAW, "CullerUniforms" );
+        pointLightCenterAndRadiusBuffer = CreateStorageBuffer( MaxLights * sizeof( Vec4 ), GL_DYNAMIC_DRAW, "pointLightCenterAndRadiusBuffer" );
+        UpdateLightBuffers();
+    }
+
+    const unsigned numTiles = GetNumTilesX() * GetNumTilesY();
+
+    if (numTiles != bufferTileCount)
+    {
+        // Old buffers stay in GfxDevice's list until ReleaseGPUObjects, so they are only orphaned here.
+        if (bufferTileCount != 0)
+        {
+            glBindBuffer( GL_SHADER_STORAGE_BUFFER, perTileLightIndexBuffer );
+            glBufferData( GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_COPY );
+            glBindBuffer( GL_SHADER_STORAGE_BUFFER, lightCountPerTileBuffer );
+            glBufferData( GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_DYNAMIC_COPY );
+        }
+
+        perTileLightIndexBuffer = CreateStorageBuffer( GetMaxNumLightsPerTile() * numTiles * sizeof( unsigned ), GL_DYNAMIC_COPY, "perTileLightIndexBuffer" );
+        lightCountPerTileBuffer = CreateStorageBuffer( numTiles * sizeof( unsigned ), GL_DYNAMIC_COPY, "lightCountPerTileBuffer" );
+        bufferTileCount = numTiles;
+    }
+
+    CullerUniforms uniforms;
+
+    Matrix44::Invert( projection, uniforms.invProjection );
+
+    uniforms.viewMatrix = view;
+    uniforms.windowWidth = depthNormalTarget.GetWidth();
+    uniforms.windowHeight = depthNormalTarget.GetHeight();
+    unsigned activeSpotLights = 0;
+    uniforms.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    uniforms.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+
+    cullerUniformsCreated = true;
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, uniformBuffer );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof( CullerUniforms ), &uniforms );
+
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, uniformBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 1, pointLightCenterAndRadiusBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 2, perTileLightIndexBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 3, lightCountPerTileBuffer );
+
+    shader.SetRenderTexture( &depthNormalTarget, 0 );
+    shader.Dispatch( GetNumTilesX(), GetNumTilesY(), 1 );
+
+    // Forward passes read the lists as storage buffers.
+    glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+}
+
+bool ae3d::LightTiler::HasLightLists() const
+{
+    return perTileLightIndexBuffer != 0;
+}
+
+void ae3d::LightTiler::BindLightLists() const
+{
+    if (!HasLightLists())
+    {
+        return;
+    }
+
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, PerTileLightIndicesBinding, perTileLightIndexBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, PointLightsBinding, pointLightCenterAndRadiusBuffer );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CullerUniformsBinding, uniformBuffer );
+}
+
+void ae3d::LightTiler::GetLightCountPerTile( std::vector< unsigned >& outLightCounts )
+{
+    outLightCounts.clear();
+
+    const unsigned numTilesX = GetNumTilesX();
+    const unsigned numTilesY = GetNumTilesY();
+
+    // The back buffer has been resized after the last CullLights.
+    if (lightCountPerTileBuffer == 0 || numTilesX * numTilesY != bufferTileCount)
+    {
+        return;
+    }
+
+    std::vector< unsigned > bottomUpCounts( numTilesX * numTilesY );
+
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, lightCountPerTileBuffer );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, bottomUpCounts.size() * sizeof( unsigned ), bottomUpCounts.data() );
+
+    // The shader's tile 0 is at GL's bottom-left window origin.
+    outLightCounts.resize( bottomUpCounts.size() );
+
+    for (unsigned y = 0; y < numTilesY; ++y)
+    {
+        std::copy( bottomUpCounts.begin() + (numTilesY - 1 - y) * numTilesX, bottomUpCounts.begin() + (numTilesY - y) * numTilesX,
+                   outLightCounts.begin() + y * numTilesX );
+    }
+}
@@ -0,0 +1,194 @@
+#include "MeshArena.hpp"
+#include <cstddef>
+#include <vector>
+#include <GL/glxw.h>
+#include "FreeListAllocator.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+namespace Global
+{
+    extern GLuint activeVao;
+}
+
+namespace
+{
+    struct Page
+    {
+        Page( ae3d::VertexBuffer::VertexFormat aFormat, unsigned vertexCapacity, unsigned indexCapacity )
+        : format( aFormat )
+        , vertices( vertexCapacity )
+        , indices( indexCapacity )
+        {}
+
+        ae3d::VertexBuffer::VertexFormat format;
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ibo = 0;
+        // In vertices.
+        ae3d::FreeListAllocator vertices;
+        // In indices, not faces.
+        ae3d::FreeListAllocator indices;
+    };
+
+    unsigned GetStride( ae3d::VertexBuffer::VertexFormat format )
+    {
+        switch (format)
+        {
+        case ae3d::VertexBuffer::VertexFormat::PTC: return sizeof( ae3d::VertexBuffer::VertexPTC );
+        case ae3d::VertexBuffer::VertexFormat::PTN: return sizeof( ae3d::VertexBuffer::VertexPTN );
+        case ae3d::VertexBuffer::VertexFormat::PTNTC: return sizeof( ae3d::VertexBuffer::VertexPTNTC );
+        }
+
+        ae3d::System::Assert( false, "unhandled vertex format" );
+        return 0;
+    }
+
+    void SetVertexAttributes( ae3d::VertexBuffer::VertexFormat format )
+    {
+        using ae3d::VertexBuffer;
+        const GLsizei stride = static_cast< GLsizei >( GetStride( format ) );
+
+        glEnableVertexAttribArray( VertexBuffer::posChannel );
+        glVertexAttribPointer( VertexBuffer::posChannel, 3, GL_FLOAT, GL_FALSE, stride, nullptr );
+
+        // Texture coordinate follows position in every format.
+        glEnableVertexAttribArray( VertexBuffer::uvChannel );
+        glVertexAttribPointer( VertexBuffer::uvChannel, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof( VertexBuffer::VertexPTC, u ) );
+
+        if (format == VertexBuffer::VertexFormat::PTC)
+        {
+            glEnableVertexAttribArray( VertexBuffer::colorChannel );
+            glVertexAttribPointer( VertexBuffer::colorChannel, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof( VertexBuffer::VertexPTC, color ) );
+        }
+        else if (format == VertexBuffer::VertexFormat::PTN)
+        {
+            glEnableVertexAttribArray( VertexBuffer::normalChannel );
+            glVertexAttribPointer( VertexBuffer::normalChannel, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof( VertexBuffer::VertexPTN, normal ) );
+        }
+        else
+        {
+            glEnableVertexAttribArray( VertexBuffer::normalChannel );
+            glVertexAttribPointer( VertexBuffer::normalChannel, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof( VertexBuffer::VertexPTNTC, normal ) );
+            glEnableVertexAttribArray( VertexBuffer::tangentChannel );
+            glVertexAttribPointer( VertexBuffer::tangentChannel, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof( VertexBuffer::VertexPTNTC, tangent ) );
+            glEnableVertexAttribArray( VertexBuffer::colorChannel );
+            glVertexAttribPointer( VertexBuffer::colorChannel, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof( VertexBuffer::VertexPTNTC, color ) );
+        }
+    }
+
+    void CreateBufferStorage( GLenum target, GLsizeiptr size )
+    {
+        if (ae3d::GfxDevice::GetExtensions().ARB_buffer_storage)
+        {
+            glBufferStorage( target, size, nullptr, GL_DYNAMIC_STORAGE_BIT );
+        }
+        else
+        {
+            glBufferData( target, size, nullptr, GL_STATIC_DRAW );
+        }
+    }
+}
+
+namespace MeshArenaGlobal
+{
+    std::vector< Page > pages;
+    // Default page size. Larger meshes get a page of their own size.
+    const unsigned PageVertexBytes = 16 * 1024 * 1024;
+    const unsigned PageIndexCount = 4 * 1024 * 1024;
+}
+
+namespace
+{
+    int CreatePage( ae3d::VertexBuffer::VertexFormat format, unsigned minVertexCount, unsigned minIndexCount )
+    {
+        const unsigned stride = GetStride( format );
+        const unsigned defaultVertexCount = MeshArenaGlobal::PageVertexBytes / stride;
+        const unsigned vertexCapacity = minVertexCount > defaultVertexCount ? minVertexCount : defaultVertexCount;
+        const unsigned indexCapacity = minIndexCount > MeshArenaGlobal::PageIndexCount ? minIndexCount : MeshArenaGlobal::PageIndexCount;
+
+        MeshArenaGlobal::pages.push_back( Page( format, vertexCapacity, indexCapacity ) );
+        Page& page = MeshArenaGlobal::pages.back();
+
+        page.vao = ae3d::GfxDevice::CreateVaoId();
+        glBindVertexArray( page.vao );
+        Global::activeVao = page.vao;
+
+        page.vbo = ae3d::GfxDevice::CreateBufferId();
+        glBindBuffer( GL_ARRAY_BUFFER, page.vbo );
+        CreateBufferStorage( GL_ARRAY_BUFFER, static_cast< GLsizeiptr >( vertexCapacity ) * stride );
+
+        page.ibo = ae3d::GfxDevice::CreateBufferId();
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, page.ibo );
+        CreateBufferStorage( GL_ELEMENT_ARRAY_BUFFER, static_cast< GLsizeiptr >( indexCapacity ) * sizeof( unsigned short ) );
+
+        if (ae3d::GfxDevice::GetExtensions().KHR_debug)
+        {
+            glObjectLabel( GL_BUFFER, page.vbo, -1, "mesh arena vbo" );
+            glObjectLabel( GL_BUFFER, page.ibo, -1, "mesh arena ibo" );
+        }
+
+        SetVertexAttributes( format );
+
+        return static_cast< int >( MeshArenaGlobal::pages.size() - 1 );
+    }
+}
+
+ae3d::MeshArena::Range ae3d::MeshArena::Allocate( VertexBuffer::VertexFormat format, const void* vertices, unsigned vertexCount,
+                                                  const VertexBuffer::Face* faces, unsigned faceCount )
+{
+    const unsigned indexCount = faceCount * 3;
+    Range range;
+
+    for (std::size_t pageIndex = 0; pageIndex < MeshArenaGlobal::pages.size() && range.page == -1; ++pageIndex)
+    {
+        Page& page = MeshArenaGlobal::pages[ pageIndex ];
+
+        if (page.format != format || page.vertices.GetLargestFreeSize() < vertexCount || page.indices.GetLargestFreeSize() < indexCount)
+        {
+            continue;
+        }
+
+        range.page = static_cast< int >( pageIndex );
+        range.firstVertex = page.vertices.Allocate( vertexCount );
+        range.firstIndex = page.indices.Allocate( indexCount );
+    }
+
+    if (range.page == -1)
+    {
+        range.page = CreatePage( format, vertexCount, indexCount );
+        range.firstVertex = MeshArenaGlobal::pages[ range.page ].vertices.Allocate( vertexCount );
+        range.firstIndex = MeshArenaGlobal::pages[ range.page ].indices.Allocate( indexCount );
+    }
+
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+
+    const Page& page = MeshArenaGlobal::pages[ range.page ];
+    const unsigned stride = GetStride( format );
+
+    // The copy target doesn't touch the array buffer binding or the bound VAO's index buffer.
+    glBindBuffer( GL_COPY_WRITE_BUFFER, page.vbo );
+    glBufferSubData( GL_COPY_WRITE_BUFFER, static_cast< GLintptr >( range.firstVertex ) * stride, static_cast< GLsizeiptr >( vertexCount ) * stride, vertices );
+    glBindBuffer( GL_COPY_WRITE_BUFFER, page.ibo );
+    glBufferSubData( GL_COPY_WRITE_BUFFER, static_cast< GLintptr >( range.firstIndex ) * sizeof( unsigned short ), static_cast< GLsizeiptr >( indexCount ) * sizeof( unsigned short ), faces );
+
+    return range;
+}
+
+void ae3d::MeshArena::Free( const Range& range )
+{
+    if (range.page == -1)
+    {
+        return;
+    }
+
+    Page& page = MeshArenaGlobal::pages[ range.page ];
+    page.vertices.Free( range.firstVertex, range.vertexCount );
+    page.indices.Free( range.firstIndex, range.indexCount );
+}
+
+unsigned ae3d::MeshArena::GetVao( int page )
+{
+    return MeshArenaGlobal::pages[ page ].vao;
+}
@@ -9,6 +9,7 @@
 #include <GL/glxw.h>
 #include "CameraComponent.hpp"
 #include "GameObject.hpp"
+#include "GfxDevice.hpp"
 #include "Matrix.hpp"
 #include "System.hpp"
 #include "Shader.hpp"
@@ -296,6 +297,7 @@ void RenderDistortion()
     glDisable( GL_CULL_FACE ); // glaze test
 
     glDisable( GL_DEPTH_TEST );
+    GfxDevice::InvalidateStateCache();
     glViewport( 0, 0, Global::width, Global::height );
 
     glBindVertexArray( Global::lensVAO );
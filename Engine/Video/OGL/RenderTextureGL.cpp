@@ -47,7 +47,7 @@ void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType,
     handle = GfxDevice::CreateTextureId();
     glBindTexture( GL_TEXTURE_2D, handle );
 
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_TEXTURE, handle, -1, "render_texture_2d" );
     }
@@ -107,7 +107,7 @@ void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, Textur
     handle = GfxDevice::CreateTextureId();
     glBindTexture( GL_TEXTURE_CUBE_MAP, handle );
     
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_TEXTURE, handle, -1, "render_texture_cube" );
     }
@@ -1,4 +1,5 @@
 #include "Renderer.hpp"
+#include <GL/glxw.h>
 
 ae3d::Renderer renderer;
 
@@ -82,7 +83,10 @@ void ae3d::BuiltinShaders::Load()
     #version 410 core
 
     layout (location = 0) in vec3 aPosition;
-    uniform mat4 _ModelViewProjectionMatrix;
+    layout (std140) uniform PerObject
+    {
+        mat4 _ModelViewProjectionMatrix;
+    };
 
     out vec3 vTexCoord;
 
@@ -112,7 +116,10 @@ void ae3d::BuiltinShaders::Load()
     
     layout (location = 0) in vec3 aPosition;
     
-    uniform mat4 _ModelViewProjectionMatrix;
+    layout (std140) uniform PerObject
+    {
+        mat4 _ModelViewProjectionMatrix;
+    };
     
     void main()
     {
@@ -145,8 +152,11 @@ void ae3d::BuiltinShaders::Load()
     layout (location = 0) in vec4 aPosition;
     layout (location = 3) in vec3 aNormal;
     
-    uniform mat4 _ModelViewProjectionMatrix;
-    uniform mat4 _ModelViewMatrix;
+    layout (std140) uniform PerObject
+    {
+        mat4 _ModelViewProjectionMatrix;
+        mat4 _ModelViewMatrix;
+    };
     
     out vec3 vPosition;
     out vec3 vNormal;
@@ -175,4 +185,228 @@ void ae3d::BuiltinShaders::Load()
     )";
 
     depthNormalsShader.Load( depthNormalsVertexSource, depthNormalsFragmentSource );
+
+    // Tests each draw's bounds against the frustum and appends visible draws' commands and model matrices.
+    // Bounds are transformed like MathUtil::TransformAABB and tested like Frustum::BoxInFrustum so that results match CPU culling.
+    const char* frustumCullSource = R"(
+    #version 430 core
+    layout (local_size_x = 64) in;
+
+    struct CullDraw
+    {
+        vec4 aabbMin;
+        vec4 aabbMax;
+        // Index count, first index, base vertex.
+        ivec4 command;
+    };
+
+    struct DrawCommand
+    {
+        uint count;
+        uint instanceCount;
+        uint firstIndex;
+        int baseVertex;
+        uint baseInstance;
+    };
+
+    layout (std430, binding = 0) readonly buffer CullDraws { CullDraw draws[]; };
+    layout (std430, binding = 1) readonly buffer CullModelMatrices { mat4 modelMatrices[]; };
+    layout (std430, binding = 2) writeonly buffer PerDraw { mat4 visibleModelMatrices[]; };
+    layout (std430, binding = 3) writeonly buffer DrawCommands { DrawCommand commands[]; };
+    layout (std430, binding = 4) buffer DrawCount { uint visibleCount; };
+
+    uniform vec4 _FrustumPlanes[ 6 ];
+    uniform uint _DrawCount;
+
+    void main()
+    {
+        uint i = gl_GlobalInvocationID.x;
+
+        if (i >= _DrawCount)
+        {
+            return;
+        }
+
+        mat4 m = modelMatrices[ i ];
+        vec3 localCenter = (draws[ i ].aabbMin.xyz + draws[ i ].aabbMax.xyz) * 0.5;
+        vec3 localExtent = (draws[ i ].aabbMax.xyz - draws[ i ].aabbMin.xyz) * 0.5;
+        vec3 center = (m * vec4( localCenter, 1.0 )).xyz;
+        vec3 extent = abs( m[ 0 ].xyz ) * localExtent.x + abs( m[ 1 ].xyz ) * localExtent.y + abs( m[ 2 ].xyz ) * localExtent.z;
+
+        for (int p = 0; p < 6; ++p)
+        {
+            vec4 plane = _FrustumPlanes[ p ];
+            vec3 positiveVertex = center + mix( -extent, extent, greaterThanEqual( plane.xyz, vec3( 0.0 ) ) );
+
+            if (dot( plane.xyz, positiveVertex ) + plane.w < 0.0)
+            {
+                return;
+            }
+        }
+
+        uint slot = atomicAdd( visibleCount, 1u );
+        visibleModelMatrices[ slot ] = m;
+        commands[ slot ].count = uint( draws[ i ].command.x );
+        commands[ slot ].instanceCount = 1u;
+        commands[ slot ].firstIndex = uint( draws[ i ].command.y );
+        commands[ slot ].baseVertex = draws[ i ].command.z;
+        commands[ slot ].baseInstance = 0u;
+    }
+    )";
+
+    // Forward+ light culler, port of LightCuller.metal. Tile frustums use GL's bottom-left window origin
+    // and depthNormalsTexture's x is view-space z, which is negative in front of the camera.
+    const char* lightCullSource = R"(
+    #version 430 core
+    #define TILE_RES 16
+    #define NUM_THREADS_PER_TILE (TILE_RES * TILE_RES)
+    #define MAX_NUM_LIGHTS_PER_TILE 544
+    #define LIGHT_INDEX_BUFFER_SENTINEL 0x7fffffff
+    layout (local_size_x = TILE_RES, local_size_y = TILE_RES) in;
+
+    layout (std430, binding = 0) readonly buffer CullerUniforms
+    {
+        mat4 invProjection;
+        mat4 viewMatrix;
+        uint windowWidth;
+        uint windowHeight;
+        uint numLights;
+        int maxNumLightsPerTile;
+    };
+
+    layout (std430, binding = 1) readonly buffer PointLights { vec4 pointLightCenterAndRadius[]; };
+    layout (std430, binding = 2) writeonly buffer PerTileLightIndices { uint perTileLightIndexBuffer[]; };
+    layout (std430, binding = 3) writeonly buffer LightCountPerTile { uint lightCountPerTile[]; };
+
+    layout (binding = 0) uniform sampler2D depthNormalsTexture;
+
+    shared uint ldsLightIdx[ MAX_NUM_LIGHTS_PER_TILE ];
+    shared uint ldsZMax;
+    shared uint ldsZMin;
+    shared uint ldsLightIdxCounter;
+
+    vec3 ConvertProjToView( vec4 p )
+    {
+        p = invProjection * p;
+        return p.xyz / p.w;
+    }
+
+    uint GetNumTilesX()
+    {
+        return (windowWidth + TILE_RES - 1) / TILE_RES;
+    }
+
+    uint GetNumTilesY()
+    {
+        return (windowHeight + TILE_RES - 1) / TILE_RES;
+    }
+
+    void main()
+    {
+        uvec2 globalIdx = gl_GlobalInvocationID.xy;
+        uvec2 groupIdx = gl_WorkGroupID.xy;
+        uint localIdxFlattened = gl_LocalInvocationIndex;
+        uint tileIdxFlattened = groupIdx.x + groupIdx.y * GetNumTilesX();
+
+        if (localIdxFlattened == 0)
+        {
+            ldsZMin = 0x7f7fffff; // FLT_MAX as uint
+            ldsZMax = 0;
+            ldsLightIdxCounter = 0;
+        }
+
+        // Side planes of the tile's frustum. Normals point out of the frustum.
+        vec3 frustumEqn[ 4 ];
+        {
+            float winWidth = float( TILE_RES * GetNumTilesX() );
+            float winHeight = float( TILE_RES * GetNumTilesY() );
+            vec2 tileMin = vec2( TILE_RES * groupIdx ) / vec2( winWidth, winHeight ) * 2.0 - 1.0;
+            vec2 tileMax = vec2( TILE_RES * (groupIdx + 1) ) / vec2( winWidth, winHeight ) * 2.0 - 1.0;
+
+            vec3 frustum[ 4 ];
+            frustum[ 0 ] = ConvertProjToView( vec4( tileMin.x, tileMin.y, 1.0, 1.0 ) );
+            frustum[ 1 ] = ConvertProjToView( vec4( tileMax.x, tileMin.y, 1.0, 1.0 ) );
+            frustum[ 2 ] = ConvertProjToView( vec4( tileMax.x, tileMax.y, 1.0, 1.0 ) );
+            frustum[ 3 ] = ConvertProjToView( vec4( tileMin.x, tileMax.y, 1.0, 1.0 ) );
+
+            vec3 tileCenter = frustum[ 0 ] + frustum[ 1 ] + frustum[ 2 ] + frustum[ 3 ];
+
+            for (int i = 0; i < 4; ++i)
+            {
+                vec3 n = normalize( cross( frustum[ i ], frustum[ (i + 1) & 3 ] ) );
+                frustumEqn[ i ] = dot( n, tileCenter ) > 0.0 ? -n : n;
+            }
+        }
+
+        barrier();
+
+        // Min and max depth of the tile form the front and back of the frustum.
+        // Edge tiles can extend past the texture.
+        bool isInside = all( lessThan( ivec2( globalIdx ), textureSize( depthNormalsTexture, 0 ) ) );
+        float depth = isInside ? -texelFetch( depthNormalsTexture, ivec2( globalIdx ), 0 ).x : 0.0;
+
+        if (depth > 0.0)
+        {
+            atomicMin( ldsZMin, floatBitsToUint( depth ) );
+            atomicMax( ldsZMax, floatBitsToUint( depth ) );
+        }
+
+        barrier();
+
+        float minZ = uintBitsToFloat( ldsZMin );
+        float maxZ = uintBitsToFloat( ldsZMax );
+        uint numPointLights = numLights & 0xFFFFu;
+
+        for (uint i = localIdxFlattened; i < numPointLights; i += NUM_THREADS_PER_TILE)
+        {
+            vec4 centerAndRadius = pointLightCenterAndRadius[ i ];
+            float radius = centerAndRadius.w;
+            vec3 center = (viewMatrix * vec4( centerAndRadius.xyz, 1.0 )).xyz;
+            float lightDepth = -center.z;
+
+            if (minZ - lightDepth < radius && lightDepth - maxZ < radius &&
+                dot( frustumEqn[ 0 ], center ) < radius &&
+                dot( frustumEqn[ 1 ], center ) < radius &&
+                dot( frustumEqn[ 2 ], center ) < radius &&
+                dot( frustumEqn[ 3 ], center ) < radius)
+            {
+                uint dstIdx = atomicAdd( ldsLightIdxCounter, 1u );
+
+                if (dstIdx < MAX_NUM_LIGHTS_PER_TILE)
+                {
+                    ldsLightIdx[ dstIdx ] = i;
+                }
+            }
+        }
+
+        barrier();
+
+        // Leaves room for the sentinel.
+        uint numPointLightsInThisTile = min( ldsLightIdxCounter, uint( maxNumLightsPerTile - 1 ) );
+        uint startOffset = uint( maxNumLightsPerTile ) * tileIdxFlattened;
+
+        for (uint i = localIdxFlattened; i < numPointLightsInThisTile; i += NUM_THREADS_PER_TILE)
+        {
+            perTileLightIndexBuffer[ startOffset + i ] = ldsLightIdx[ i ];
+        }
+
+        if (localIdxFlattened == 0)
+        {
+            perTileLightIndexBuffer[ startOffset + numPointLightsInThisTile ] = LIGHT_INDEX_BUFFER_SENTINEL;
+            lightCountPerTile[ tileIdxFlattened ] = numPointLightsInThisTile;
+        }
+    }
+    )";
+
+    GLint majorVersion = 0;
+    GLint minorVersion = 0;
+    glGetIntegerv( GL_MAJOR_VERSION, &majorVersion );
+    glGetIntegerv( GL_MINOR_VERSION, &minorVersion );
+
+    // Compute shaders need GL 4.3, macOS has 4.1.
+    if (majorVersion * 10 + minorVersion >= 43)
+    {
+        frustumCullShader.Load( frustumCullSource );
+        lightCullShader.Load( lightCullSource );
+    }
 }
@@ -1,5 +1,6 @@
 #include "Shader.hpp"
 #include <GL/glxw.h>
+#include <cstring>
 #include <vector>
 #include "FileSystem.hpp"
 #include "FileWatcher.hpp"
@@ -9,11 +10,20 @@
 #include "Texture2D.hpp"
 #include "TextureCube.hpp"
 #include "RenderTexture.hpp"
+#include "VertexBuffer.hpp"
 
 //#define WARN_ON_MISSING_BINDINGS
 
 extern ae3d::FileWatcher fileWatcher;
 
+ae3d::Shader::UniformBlock ae3d::Shader::perFrameBlock;
+
+namespace ShaderGlobal
+{
+    // Program in use. ComputeShader::Dispatch changes the program, so it also updates this.
+    unsigned boundHandle = 0;
+}
+
 namespace MathUtil
 {
     bool IsFinite( float f );
@@ -152,7 +162,7 @@ void ae3d::Shader::Load( const char* vertexSource, const char* fragmentSource )
 
     GLuint program = GfxDevice::CreateProgramId();
 
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_PROGRAM, program, -1, "shader" );
     }
@@ -177,6 +187,55 @@ void ae3d::Shader::Load( const char* vertexSource, const char* fragmentSource )
 
     handle = program;
     uniformLocations = GetUniformLocations( program );
+    propertyLayout.clear();
+
+    perObjectBlockIndex = -1;
+    perFrameBlockIndex = -1;
+    perObjectBlock = UniformBlock();
+    const GLuint perObjectIndex = glGetUniformBlockIndex( program, "PerObject" );
+    const GLuint perFrameIndex = glGetUniformBlockIndex( program, "PerFrame" );
+
+    if (perObjectIndex != GL_INVALID_INDEX)
+    {
+        GLint size = 0;
+        glGetActiveUniformBlockiv( program, perObjectIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &size );
+        glUniformBlockBinding( program, perObjectIndex, PerObjectBinding );
+        perObjectBlock.data.resize( (std::size_t)size );
+        perObjectBlockIndex = static_cast< int >( perObjectIndex );
+    }
+
+    if (perFrameIndex != GL_INVALID_INDEX)
+    {
+        GLint size = 0;
+        glGetActiveUniformBlockiv( program, perFrameIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &size );
+        glUniformBlockBinding( program, perFrameIndex, PerFrameBinding );
+        perFrameBlockIndex = static_cast< int >( perFrameIndex );
+
+        if (perFrameBlock.data.empty())
+        {
+            perFrameBlock.data.resize( (std::size_t)size );
+        }
+        else if (perFrameBlock.data.size() != (std::size_t)size)
+        {
+            System::Print( "PerFrame uniform block is declared differently than in other shaders, size %d\n", size );
+        }
+    }
+    appliedMaterialStamp = 0;
+    appliedGlobalsVersion = 0;
+    isInstanced = glGetAttribLocation( program, "aInstanceModelMatrix" ) == VertexBuffer::instanceChannel;
+    isDrawIndirect = false;
+
+    // Storage blocks need GL 4.3, which every driver that has gl_DrawID through this extension also has.
+    if (GfxDevice::GetExtensions().ARB_shader_draw_parameters)
+    {
+        const GLuint perDrawIndex = glGetProgramResourceIndex( program, GL_SHADER_STORAGE_BLOCK, "PerDraw" );
+
+        if (perDrawIndex != GL_INVALID_INDEX)
+        {
+            glShaderStorageBlockBinding( program, perDrawIndex, PerDrawBinding );
+            isDrawIndirect = true;
+        }
+    }
 }
 
 void ae3d::Shader::Load( const FileSystem::FileContentsData& vertexGLSL, const FileSystem::FileContentsData& fragmentGLSL,
@@ -211,77 +270,233 @@ void ae3d::Shader::Load( const FileSystem::FileContentsData& vertexGLSL, const F
 
 void ae3d::Shader::Use()
 {
-    static unsigned boundHandle = 0;
-    
-    if (boundHandle != handle)
+    if (ShaderGlobal::boundHandle != handle)
     {
         Statistics::IncShaderBinds();
         glUseProgram( handle );
-        boundHandle = handle;
+        ShaderGlobal::boundHandle = handle;
+    }
+    else
+    {
+        Statistics::IncStateChangesSaved();
+    }
+}
+
+const ae3d::Shader::PropertyLocation& ae3d::Shader::GetPropertyLocation( int propertyId )
+{
+    if (propertyId >= static_cast< int >( propertyLayout.size() ))
+    {
+        propertyLayout.resize( propertyId + 1 );
+    }
+
+    PropertyLocation& property = propertyLayout[ propertyId ];
+
+    if (property.location == -2)
+    {
+        const std::string name = GetPropertyName( propertyId );
+        const auto location = uniformLocations.find( name );
+        property.location = location != std::end( uniformLocations ) ? location->second.i : -1;
+
+        const auto scaleOffsetLocation = uniformLocations.find( name + "_ST" );
+        property.scaleOffsetLocation = scaleOffsetLocation != std::end( uniformLocations ) ? scaleOffsetLocation->second.i : -1;
+
+        if (property.location == -1 && (perObjectBlockIndex != -1 || perFrameBlockIndex != -1))
+        {
+            const GLchar* uniformName = name.c_str();
+            GLuint index = GL_INVALID_INDEX;
+            glGetUniformIndices( handle, 1, &uniformName, &index );
+
+            if (index != GL_INVALID_INDEX)
+            {
+                GLint blockIndex = -1;
+                GLint offset = -1;
+                glGetActiveUniformsiv( handle, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex );
+                glGetActiveUniformsiv( handle, 1, &index, GL_UNIFORM_OFFSET, &offset );
+
+                if (blockIndex != -1 && (blockIndex == perObjectBlockIndex || blockIndex == perFrameBlockIndex))
+                {
+                    property.blockOffset = offset;
+                    property.isPerFrame = blockIndex == perFrameBlockIndex;
+                }
+            }
+        }
+    }
+
+    return property;
+}
+
+bool ae3d::Shader::WriteBlockMember( const PropertyLocation& property, const void* value, unsigned byteCount )
+{
+    if (property.blockOffset == -1)
+    {
+        return false;
+    }
+
+    UniformBlock& block = property.isPerFrame ? perFrameBlock : perObjectBlock;
+
+    if (property.blockOffset + byteCount > block.data.size())
+    {
+        System::Print( "Uniform doesn't fit into its block in shader %s\n", fragmentPath.c_str() );
+        return true;
+    }
+
+    unsigned char* member = block.data.data() + property.blockOffset;
+
+    if (std::memcmp( member, value, byteCount ) != 0)
+    {
+        std::memcpy( member, value, byteCount );
+        block.isDirty = true;
+    }
+
+    return true;
+}
+
+void ae3d::Shader::UploadUniformBlock( UniformBlock& block, unsigned binding )
+{
+    const unsigned size = static_cast< unsigned >( block.data.size() );
+
+    if (block.isDirty || block.ringFrame != GfxDevice::GetUniformRingFrame())
+    {
+        block.ringOffset = GfxDevice::UploadUniforms( block.data.data(), size );
+        block.ringFrame = GfxDevice::GetUniformRingFrame();
+        block.isDirty = false;
+    }
+
+    GfxDevice::BindUniforms( binding, block.ringOffset, size );
+}
+
+void ae3d::Shader::UploadUniformBlocks()
+{
+    if (perObjectBlockIndex != -1)
+    {
+        UploadUniformBlock( perObjectBlock, PerObjectBinding );
+    }
+
+    if (perFrameBlockIndex != -1)
+    {
+        UploadUniformBlock( perFrameBlock, PerFrameBinding );
     }
 }
 
 void ae3d::Shader::SetMatrix( const char* name, const float* matrix4x4 )
 {
+    SetMatrix( GetPropertyId( name ), matrix4x4 );
+}
+
+void ae3d::Shader::SetTexture( const char* name, ae3d::Texture2D* texture, int textureUnit )
+{
+    SetTexture( GetPropertyId( name ), texture, textureUnit );
+}
+
+void ae3d::Shader::SetTexture( const char* name, ae3d::TextureCube* texture, int textureUnit )
+{
+    SetTexture( GetPropertyId( name ), texture, textureUnit );
+}
+
+void ae3d::Shader::SetRenderTexture( const char* name, ae3d::RenderTexture* texture, int textureUnit )
+{
+    SetRenderTexture( GetPropertyId( name ), texture, textureUnit );
+}
+
+void ae3d::Shader::SetInt( const char* name, int value )
+{
+    SetInt( GetPropertyId( name ), value );
+}
+
+void ae3d::Shader::SetFloat( const char* name, float value )
+{
+    SetFloat( GetPropertyId( name ), value );
+}
+
+void ae3d::Shader::SetVector3( const char* name, const float* vec3 )
+{
+    SetVector3( GetPropertyId( name ), vec3 );
+}
+
+void ae3d::Shader::SetVector4( const char* name, const float* vec4 )
+{
+    SetVector4( GetPropertyId( name ), vec4 );
+}
+
+void ae3d::Shader::SetMatrix( int propertyId, const float* matrix4x4 )
+{
+    const PropertyLocation& property = GetPropertyLocation( propertyId );
+
+    if (WriteBlockMember( property, matrix4x4, 16 * sizeof( float ) ))
+    {
+        return;
+    }
+
+    const int location = property.location;
 #ifdef WARN_ON_MISSING_BINDINGS
-    if (uniformLocations[ name ].i == -1) { System::Print( "Missing uniform matrix binding %s in vertex or fragment shader %s\n", name, fragmentPath.c_str() ); }
+    if (location == -1) { System::Print( "Missing uniform matrix binding %s in vertex or fragment shader %s\n", GetPropertyName( propertyId ), fragmentPath.c_str() ); }
 #endif
-    glProgramUniformMatrix4fv( handle, uniformLocations[ name ].i, 1, GL_FALSE, matrix4x4 );
+    glProgramUniformMatrix4fv( handle, location, 1, GL_FALSE, matrix4x4 );
 }
 
-void ae3d::Shader::SetTexture( const char* name, ae3d::Texture2D* texture, int textureUnit )
+void ae3d::Shader::SetTexture( int propertyId, ae3d::Texture2D* texture, int textureUnit )
 {
     glActiveTexture( GL_TEXTURE0 + textureUnit );
     glBindTexture( GL_TEXTURE_2D, texture->GetID() );
     Statistics::IncTextureBinds();
-    SetInt( name, textureUnit );
-
-    const std::string scaleOffsetName = std::string( name ) + std::string( "_ST" );
-    SetVector4( scaleOffsetName.c_str(), &texture->GetScaleOffset().x );
+    SetInt( propertyId, textureUnit );
+    glProgramUniform4fv( handle, GetPropertyLocation( propertyId ).scaleOffsetLocation, 1, &texture->GetScaleOffset().x );
 }
 
-void ae3d::Shader::SetTexture( const char* name, ae3d::TextureCube* texture, int textureUnit )
+void ae3d::Shader::SetTexture( int propertyId, ae3d::TextureCube* texture, int textureUnit )
 {
     glActiveTexture( GL_TEXTURE0 + textureUnit );
     glBindTexture( GL_TEXTURE_CUBE_MAP, texture->GetID() );
     Statistics::IncTextureBinds();
-    SetInt( name, textureUnit );
-    
-    const std::string scaleOffsetName = std::string( name ) + std::string( "_ST" );
-    SetVector4( scaleOffsetName.c_str(), &texture->GetScaleOffset().x );
+    SetInt( propertyId, textureUnit );
+    glProgramUniform4fv( handle, GetPropertyLocation( propertyId ).scaleOffsetLocation, 1, &texture->GetScaleOffset().x );
 }
 
-void ae3d::Shader::SetRenderTexture( const char* name, ae3d::RenderTexture* texture, int textureUnit )
+void ae3d::Shader::SetRenderTexture( int propertyId, ae3d::RenderTexture* texture, int textureUnit )
 {
     glActiveTexture( GL_TEXTURE0 + textureUnit );
     glBindTexture( texture->IsCube() ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, texture->GetID() );
     Statistics::IncTextureBinds();
-    SetInt( name, textureUnit );
-
-    const std::string scaleOffsetName = std::string( name ) + std::string( "_ST" );
-    SetVector4( scaleOffsetName.c_str(), &texture->GetScaleOffset().x );
+    SetInt( propertyId, textureUnit );
+    glProgramUniform4fv( handle, GetPropertyLocation( propertyId ).scaleOffsetLocation, 1, &texture->GetScaleOffset().x );
 }
 
-void ae3d::Shader::SetInt( const char* name, int value )
+void ae3d::Shader::SetInt( int propertyId, int value )
 {
+    const PropertyLocation& property = GetPropertyLocation( propertyId );
+
+    if (WriteBlockMember( property, &value, sizeof( int ) ))
+    {
+        return;
+    }
+
+    const int location = property.location;
 #ifdef WARN_ON_MISSING_BINDINGS
-    if (uniformLocations[ name ].i == -1) { System::Print( "Missing uniform int binding %s in vertex or fragment shader %s\n", name, fragmentPath.c_str() ); }
+    if (location == -1) { System::Print( "Missing uniform int binding %s in vertex or fragment shader %s\n", GetPropertyName( propertyId ), fragmentPath.c_str() ); }
 #endif
-    glProgramUniform1i( handle, uniformLocations[ name ].i, value );
+    glProgramUniform1i( handle, location, value );
 }
 
-void ae3d::Shader::SetFloat( const char* name, float value )
+void ae3d::Shader::SetFloat( int propertyId, float value )
 {
 #if DEBUG
     System::Assert( MathUtil::IsFinite( value ), "Shader::SetFloat got an invalid value" );
 #endif
+    const PropertyLocation& property = GetPropertyLocation( propertyId );
+
+    if (WriteBlockMember( property, &value, sizeof( float ) ))
+    {
+        return;
+    }
+
+    const int location = property.location;
 #ifdef WARN_ON_MISSING_BINDINGS
-    if (uniformLocations[ name ].i == -1) { System::Print( "Missing uniform float binding %s in vertex or fragment shader %s\n", name, fragmentPath.c_str() ); }
+    if (location == -1) { System::Print( "Missing uniform float binding %s in vertex or fragment shader %s\n", GetPropertyName( propertyId ), fragmentPath.c_str() ); }
 #endif
-    glProgramUniform1f( handle, uniformLocations[ name ].i, value );
+    glProgramUniform1f( handle, location, value );
 }
 
-void ae3d::Shader::SetVector3( const char* name, const float* vec3 )
+void ae3d::Shader::SetVector3( int propertyId, const float* vec3 )
 {
 #if DEBUG
     for (int i = 0; i < 3; ++i)
@@ -289,13 +504,21 @@ void ae3d::Shader::SetVector3( const char* name, const float* vec3 )
         System::Assert( MathUtil::IsFinite( vec3[ i ] ), "Shader::SetVector got an invalid value" );
     }
 #endif
+    const PropertyLocation& property = GetPropertyLocation( propertyId );
+
+    if (WriteBlockMember( property, vec3, 3 * sizeof( float ) ))
+    {
+        return;
+    }
+
+    const int location = property.location;
 #ifdef WARN_ON_MISSING_BINDINGS
-    if (uniformLocations[ name ].i == -1) { System::Print( "Missing uniform vec3 binding %s in vertex or fragment shader %s\n", name, fragmentPath.c_str() ); }
+    if (location == -1) { System::Print( "Missing uniform vec3 binding %s in vertex or fragment shader %s\n", GetPropertyName( propertyId ), fragmentPath.c_str() ); }
 #endif
-    glProgramUniform3fv( handle, uniformLocations[ name ].i, 1, vec3 );
+    glProgramUniform3fv( handle, location, 1, vec3 );
 }
 
-void ae3d::Shader::SetVector4( const char* name, const float* vec4 )
+void ae3d::Shader::SetVector4( int propertyId, const float* vec4 )
 {
 #if DEBUG
     for (int i = 0; i < 4; ++i)
@@ -303,8 +526,16 @@ void ae3d::Shader::SetVector4( const char* name, const float* vec4 )
         System::Assert( MathUtil::IsFinite( vec4[ i ] ), "Shader::SetVector got an invalid value" );
     }
 #endif
+    const PropertyLocation& property = GetPropertyLocation( propertyId );
+
+    if (WriteBlockMember( property, vec4, 4 * sizeof( float ) ))
+    {
+        return;
+    }
+
+    const int location = property.location;
 #ifdef WARN_ON_MISSING_BINDINGS
-    if (uniformLocations[ name ].i == -1) { System::Print( "Missing uniform vec4 binding %s in vertex or fragment shader %s\n", name, fragmentPath.c_str() ); }
+    if (location == -1) { System::Print( "Missing uniform vec4 binding %s in vertex or fragment shader %s\n", GetPropertyName( propertyId ), fragmentPath.c_str() ); }
 #endif
-    glProgramUniform4fv( handle, uniformLocations[ name ].i, 1, vec4 );
+    glProgramUniform4fv( handle, location, 1, vec4 );
 }
@@ -14,6 +14,7 @@
 
 extern ae3d::FileWatcher fileWatcher;
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+unsigned char* DecodeSTB( const ae3d::FileSystem::FileView& fileContents, int& outWidth, int& outHeight, int& outComponents ); // Defined in TextureCommon.cpp
 float GetFloatAnisotropy( ae3d::Anisotropy anisotropy );
 void Tokenize( const std::string& str,
               std::vector< std::string >& tokens,
@@ -51,7 +52,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Repeat, ae3d::TextureFilter::Nearest, ae3d::Mipmaps::Generate, ae3d::ColorSpace::RGB, ae3d::Anisotropy::k1 );
@@ -59,7 +60,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Repeat, ae3d::TextureFilter::Nearest, ae3d::Mipmaps::None, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -67,7 +68,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Clamp, ae3d::TextureFilter::Linear, ae3d::Mipmaps::None, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -75,7 +76,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Repeat, ae3d::TextureFilter::Linear, ae3d::Mipmaps::None, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -83,7 +84,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Clamp, ae3d::TextureFilter::Linear, ae3d::Mipmaps::Generate, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -91,7 +92,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Repeat, ae3d::TextureFilter::Linear, ae3d::Mipmaps::Generate, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -99,7 +100,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Repeat, ae3d::TextureFilter::Nearest, ae3d::Mipmaps::Generate, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -107,7 +108,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 
     cacheHash = GetCacheHash( path, ae3d::TextureWrap::Clamp, ae3d::TextureFilter::Nearest, ae3d::Mipmaps::Generate, ae3d::ColorSpace::SRGB, ae3d::Anisotropy::k1 );
@@ -115,7 +116,7 @@ void TexReload( const std::string& path )
     if (Texture2DGlobal::hashToCachedTexture.find( cacheHash ) != std::end( Texture2DGlobal::hashToCachedTexture ) )
     {
         auto& tex = Texture2DGlobal::hashToCachedTexture[ cacheHash ];
-        tex.Load( ae3d::FileSystem::FileContents( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
+        tex.Load( ae3d::FileSystem::FileContentsView( path.c_str() ), tex.GetWrap(), tex.GetFilter(), tex.GetMipmaps(), tex.GetColorSpace(), tex.GetAnisotropy() );
     }
 }
 
@@ -134,7 +135,7 @@ ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
         glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
 
-        if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+        if (GfxDevice::GetExtensions().KHR_debug)
         {
             glObjectLabel( GL_TEXTURE, Texture2DGlobal::defaultTexture.handle, -1, "default texture 2d" );
         }
@@ -148,7 +149,7 @@ ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
     return &Texture2DGlobal::defaultTexture;
 }
 
-void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+void ae3d::Texture2D::Load( const FileSystem::FileView& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     filter = aFilter;
     wrap = aWrap;
@@ -199,12 +200,12 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (wrap == TextureWrap::Repeat) ? GL_REPEAT : GL_CLAMP_TO_EDGE );
     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (wrap == TextureWrap::Repeat) ? GL_REPEAT : GL_CLAMP_TO_EDGE );
 
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_TEXTURE, handle, -1, fileContents.path.c_str() );
     }
 
-    if (GfxDevice::HasExtension( "GL_EXT_texture_filter_anisotropic" ) && anisotropy != Anisotropy::k1)
+    if (GfxDevice::GetExtensions().EXT_texture_filter_anisotropic && anisotropy != Anisotropy::k1)
     {
         glTexParameterf( GL_TEXTURE_2D, 0x84FE/*GL_TEXTURE_MAX_ANISOTROPY_EXT*/, GetFloatAnisotropy( anisotropy ) );
     }
@@ -240,7 +241,7 @@ void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, Te
 void ae3d::Texture2D::LoadDDS( const char* aPath )
 {
     DDSLoader::Output unusedOutput;
-    const DDSLoader::LoadResult loadResult = DDSLoader::Load( FileSystem::FileContents( aPath ), 0, width, height, opaque, unusedOutput );
+    const DDSLoader::LoadResult loadResult = DDSLoader::Load( FileSystem::FileContentsView( aPath ), 0, width, height, opaque, unusedOutput );
 
     if (loadResult != DDSLoader::LoadResult::Success)
     {
@@ -248,10 +249,10 @@ void ae3d::Texture2D::LoadDDS( const char* aPath )
     }
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileView& fileContents )
 {
     int components;
-    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
+    unsigned char* data = DecodeSTB( fileContents, width, height, components );
 
     if (data == nullptr)
     {
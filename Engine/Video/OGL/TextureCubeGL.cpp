@@ -100,7 +100,7 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
     glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
     glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
 
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_TEXTURE, handle, -1, negX.path.c_str() );
     }
@@ -134,7 +134,7 @@ void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const Fi
         else if (isDDS)
         {
             DDSLoader::Output unusedOutput;
-            const DDSLoader::LoadResult result = DDSLoader::Load( FileSystem::FileContents( paths[ face ].c_str() ), face + 1, width, height, opaque, unusedOutput );
+            const DDSLoader::LoadResult result = DDSLoader::Load( FileSystem::FileContentsView( paths[ face ].c_str() ), face + 1, width, height, opaque, unusedOutput );
             
             if (result != DDSLoader::LoadResult::Success)
             {
@@ -3,6 +3,7 @@
 #include <vector>
 #include <GL/glxw.h>
 #include "GfxDevice.hpp"
+#include "MeshArena.hpp"
 #include "Statistics.hpp"
 #include "Vec3.hpp"
 
@@ -11,10 +12,58 @@ namespace Global
     GLuint activeVao = 0;
 }
 
+bool ae3d::VertexBuffer::GenerateInMeshArena( const Face* faces, int faceCount, const void* vertices, int vertexCount )
+{
+    ReleaseMeshArenaRange();
+
+    if (!useMeshArena)
+    {
+        return false;
+    }
+
+    const MeshArena::Range range = MeshArena::Allocate( vertexFormat, vertices, static_cast< unsigned >( vertexCount ), faces, static_cast< unsigned >( faceCount ) );
+    vaoId = MeshArena::GetVao( range.page );
+    arenaPage = range.page;
+    baseVertex = range.firstVertex;
+    firstIndex = range.firstIndex;
+    arenaVertexCount = range.vertexCount;
+    return true;
+}
+
+void ae3d::VertexBuffer::ReleaseMeshArenaRange()
+{
+    if (arenaPage == -1)
+    {
+        return;
+    }
+
+    MeshArena::Range range;
+    range.page = arenaPage;
+    range.firstVertex = baseVertex;
+    range.vertexCount = arenaVertexCount;
+    range.firstIndex = firstIndex;
+    range.indexCount = static_cast< unsigned >( elementCount );
+    MeshArena::Free( range );
+
+    // The VAO belongs to the arena, so a regenerated buffer with its own buffers creates a new one.
+    arenaPage = -1;
+    vaoId = 0;
+    baseVertex = 0;
+    firstIndex = 0;
+}
+
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTC;
+
+    // Releases the previous arena range, so elementCount must still be the previous count.
+    const bool isInMeshArena = GenerateInMeshArena( faces, faceCount, vertices, vertexCount );
     elementCount = faceCount * 3;
+
+    if (isInMeshArena)
+    {
+        return;
+    }
     
     if (vaoId == 0)
     {
@@ -22,6 +71,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     }
     
     glBindVertexArray( vaoId );
+    Global::activeVao = vaoId;
     
     if (vboId == 0)
     {
@@ -54,7 +104,8 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 
 void ae3d::VertexBuffer::SetDebugName( const char* name )
 {
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    // Arena buffers are shared.
+    if (GfxDevice::GetExtensions().KHR_debug && arenaPage == -1)
     {
         glObjectLabel( GL_BUFFER, vboId, -1, name );
     }
@@ -63,7 +114,14 @@ void ae3d::VertexBuffer::SetDebugName( const char* name )
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTN* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTN;
+
+    const bool isInMeshArena = GenerateInMeshArena( faces, faceCount, vertices, vertexCount );
     elementCount = faceCount * 3;
+
+    if (isInMeshArena)
+    {
+        return;
+    }
     
     if (vaoId == 0)
     {
@@ -71,6 +129,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     }
     
     glBindVertexArray( vaoId );
+    Global::activeVao = vaoId;
     
     if (vboId == 0)
     {
@@ -79,12 +138,12 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     
     glBindBuffer( GL_ARRAY_BUFFER, vboId );
 
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_BUFFER, vboId, -1, "vbo" );
     }
 
-    if (GfxDevice::HasExtension( "GL_ARB_buffer_storage" ))
+    if (GfxDevice::GetExtensions().ARB_buffer_storage)
     {
         const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
         glBufferStorage( GL_ARRAY_BUFFER, vertexCount * sizeof( VertexPTN ), vertices, flags );
@@ -101,12 +160,12 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, iboId );
 
-    if (GfxDevice::HasExtension( "GL_KHR_debug" ))
+    if (GfxDevice::GetExtensions().KHR_debug)
     {
         glObjectLabel( GL_BUFFER, iboId, -1, "ibo" );
     }
 
-    if (GfxDevice::HasExtension( "GL_ARB_buffer_storage" ))
+    if (GfxDevice::GetExtensions().ARB_buffer_storage)
     {
         const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
         glBufferStorage( GL_ELEMENT_ARRAY_BUFFER, faceCount * sizeof( Face ), faces, flags );
@@ -132,7 +191,14 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
 {
     vertexFormat = VertexFormat::PTNTC;
+
+    const bool isInMeshArena = GenerateInMeshArena( faces, faceCount, vertices, vertexCount );
     elementCount = faceCount * 3;
+
+    if (isInMeshArena)
+    {
+        return;
+    }
     
     if (vaoId == 0)
     {
@@ -140,6 +206,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     }
     
     glBindVertexArray( vaoId );
+    Global::activeVao = vaoId;
     
     if (vboId == 0)
     {
@@ -148,7 +215,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 
     glBindBuffer( GL_ARRAY_BUFFER, vboId );
     
-    if (GfxDevice::HasExtension( "GL_ARB_buffer_storage" ))
+    if (GfxDevice::GetExtensions().ARB_buffer_storage)
     {
         const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
         glBufferStorage( GL_ARRAY_BUFFER, vertexCount * sizeof( VertexPTNTC ), vertices, flags );
@@ -165,7 +232,7 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
 
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, iboId );
 
-    if (GfxDevice::HasExtension( "GL_ARB_buffer_storage" ))
+    if (GfxDevice::GetExtensions().ARB_buffer_storage)
     {
         const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
         glBufferStorage( GL_ELEMENT_ARRAY_BUFFER, faceCount * sizeof( Face ), faces, flags );
@@ -204,4 +271,8 @@ void ae3d::VertexBuffer::Bind() const
         Global::activeVao = vaoId;
         Statistics::IncVertexBufferBinds();
     }
+    else
+    {
+        Statistics::IncStateChangesSaved();
+    }
 }
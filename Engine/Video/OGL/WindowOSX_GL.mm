@@ -720,6 +720,7 @@ void ae3d::Window::SetTitle( const char* title )
 
 void ae3d::Window::SwapBuffers()
 {
+    GfxDevice::Present();
     [WindowGlobal::glContext flushBuffer];
     UpdateFrameTiming();
 }
@@ -21,6 +21,8 @@ namespace ae3d
         Shader momentsShader;
         Shader depthNormalsShader;
         ComputeShader lightCullShader;
+        /// Culls DrawIndirectCulled's draws against the camera frustum. OpenGL only.
+        ComputeShader frustumCullShader;
     };
 
     /// High-level rendering stuff.
@@ -0,0 +1,74 @@
+#include "Shader.hpp"
+#include <unordered_map>
+#include "System.hpp"
+
+namespace ShaderCommonGlobal
+{
+    std::unordered_map< std::string, int > propertyIds;
+    std::vector< std::string > propertyNames;
+}
+
+int ae3d::Shader::GetPropertyId( const char* name )
+{
+    const auto id = ShaderCommonGlobal::propertyIds.find( name );
+
+    if (id != std::end( ShaderCommonGlobal::propertyIds ))
+    {
+        return id->second;
+    }
+
+    const int newId = static_cast< int >( ShaderCommonGlobal::propertyNames.size() );
+    ShaderCommonGlobal::propertyNames.push_back( name );
+    ShaderCommonGlobal::propertyIds[ name ] = newId;
+    return newId;
+}
+
+const char* ae3d::Shader::GetPropertyName( int propertyId )
+{
+    System::Assert( propertyId >= 0 && propertyId < static_cast< int >( ShaderCommonGlobal::propertyNames.size() ), "invalid property id" );
+    return ShaderCommonGlobal::propertyNames[ propertyId ].c_str();
+}
+
+#if !RENDERER_OPENGL
+// Other renderers look uniforms up by name, so ids are translated back.
+
+void ae3d::Shader::SetMatrix( int propertyId, const float* matrix4x4 )
+{
+    SetMatrix( GetPropertyName( propertyId ), matrix4x4 );
+}
+
+void ae3d::Shader::SetTexture( int propertyId, Texture2D* texture, int textureUnit )
+{
+    SetTexture( GetPropertyName( propertyId ), texture, textureUnit );
+}
+
+void ae3d::Shader::SetTexture( int propertyId, TextureCube* texture, int textureUnit )
+{
+    SetTexture( GetPropertyName( propertyId ), texture, textureUnit );
+}
+
+void ae3d::Shader::SetRenderTexture( int propertyId, RenderTexture* renderTexture, int textureUnit )
+{
+    SetRenderTexture( GetPropertyName( propertyId ), renderTexture, textureUnit );
+}
+
+void ae3d::Shader::SetInt( int propertyId, int value )
+{
+    SetInt( GetPropertyName( propertyId ), value );
+}
+
+void ae3d::Shader::SetFloat( int propertyId, float value )
+{
+    SetFloat( GetPropertyName( propertyId ), value );
+}
+
+void ae3d::Shader::SetVector3( int propertyId, const float* vec3 )
+{
+    SetVector3( GetPropertyName( propertyId ), vec3 );
+}
+
+void ae3d::Shader::SetVector4( int propertyId, const float* vec4 )
+{
+    SetVector4( GetPropertyName( propertyId ), vec4 );
+}
+#endif
@@ -43,9 +43,15 @@ void ae3d::ComputeShader::LoadSPIRV( const ae3d::FileSystem::FileContentsData& /
 	System::Print("LoadSPIRV unimplemented\n");
 }
 
-void ae3d::ComputeShader::SetRenderTexture( class RenderTexture* /*renderTexture*/, unsigned /*slot*/ )
+// Descriptor sets are owned by the caller, eg. LightTiler writes its render texture into its own set.
+void ae3d::ComputeShader::SetRenderTexture( RenderTexture* renderTexture, unsigned slot )
 {
-	System::Print("SetRenderTexture unimplemented\n");
+    if (renderTextures.size() <= slot)
+    {
+        renderTextures.resize( slot + 1, nullptr );
+    }
+
+    renderTextures[ slot ] = renderTexture;
 }
 
 void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY, unsigned groupCountZ )
@@ -1,10 +1,12 @@
 #include "GfxDevice.hpp"
 #include <cstdint>
+#include <cstring>
 #include <map>
 #include <vector> 
 #include <string>
 #include <sstream>
 #include <vulkan/vulkan.h>
+#include "LightTiler.hpp"
 #include "Macros.hpp"
 #include "RenderTexture.hpp"
 #include "System.hpp"
@@ -42,6 +44,12 @@ struct Ubo
     std::uint8_t* uboData = nullptr;
 };
 
+struct InstanceBuffer
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+};
+
 namespace GfxDeviceGlobal
 {
     struct SwapchainBuffer
@@ -110,7 +118,12 @@ namespace GfxDeviceGlobal
     VkSampler sampler0 = VK_NULL_HANDLE;
     std::vector< VkBuffer > pendingFreeVBs;
     std::vector< Ubo > frameUbos;
+    // Instance buffers uploaded this frame. The last one is read by DrawInstanced.
+    std::vector< InstanceBuffer > frameInstanceBuffers;
     VkSampleCountFlagBits msaaSampleBits = VK_SAMPLE_COUNT_1_BIT;
+    ae3d::LightTiler lightTiler;
+    int backBufferWidth = 640;
+    int backBufferHeight = 400;
 }
 
 namespace ae3d
@@ -271,8 +284,39 @@ namespace ae3d
     }
 
     void CreatePSO( VertexBuffer& vertexBuffer, ae3d::Shader& shader, ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc,
-                    ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, unsigned hash )
+                    ae3d::GfxDevice::CullMode cullMode, ae3d::GfxDevice::FillMode fillMode, bool isInstanced, unsigned hash )
     {
+        // Instanced pipelines read model matrices from a second binding that advances per instance.
+        const VkPipelineVertexInputStateCreateInfo& vertexInputState = *vertexBuffer.GetInputState();
+        std::vector< VkVertexInputBindingDescription > bindingDescriptions( vertexInputState.pVertexBindingDescriptions,
+                                                                            vertexInputState.pVertexBindingDescriptions + vertexInputState.vertexBindingDescriptionCount );
+        std::vector< VkVertexInputAttributeDescription > attributeDescriptions( vertexInputState.pVertexAttributeDescriptions,
+                                                                                vertexInputState.pVertexAttributeDescriptions + vertexInputState.vertexAttributeDescriptionCount );
+        if (isInstanced)
+        {
+            VkVertexInputBindingDescription instanceBinding = {};
+            instanceBinding.binding = VertexBuffer::INSTANCE_BUFFER_BIND_ID;
+            instanceBinding.stride = sizeof( float ) * 16;
+            instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+            bindingDescriptions.push_back( instanceBinding );
+
+            for (std::uint32_t column = 0; column < 4; ++column)
+            {
+                VkVertexInputAttributeDescription columnAttribute = {};
+                columnAttribute.binding = VertexBuffer::INSTANCE_BUFFER_BIND_ID;
+                columnAttribute.location = VertexBuffer::instanceChannel + column;
+                columnAttribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+                columnAttribute.offset = sizeof( float ) * 4 * column;
+                attributeDescriptions.push_back( columnAttribute );
+            }
+        }
+
+        VkPipelineVertexInputStateCreateInfo inputState = vertexInputState;
+        inputState.vertexBindingDescriptionCount = static_cast< std::uint32_t >( bindingDescriptions.size() );
+        inputState.pVertexBindingDescriptions = bindingDescriptions.data();
+        inputState.vertexAttributeDescriptionCount = static_cast< std::uint32_t >( attributeDescriptions.size() );
+        inputState.pVertexAttributeDescriptions = attributeDescriptions.data();
+
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
         inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -381,7 +425,7 @@ namespace ae3d
         pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineCreateInfo.layout = GfxDeviceGlobal::pipelineLayout;
         pipelineCreateInfo.renderPass = GfxDeviceGlobal::renderPass;
-        pipelineCreateInfo.pVertexInputState = vertexBuffer.GetInputState();
+        pipelineCreateInfo.pVertexInputState = &inputState;
         pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
         pipelineCreateInfo.pRasterizationState = &rasterizationState;
         pipelineCreateInfo.pColorBlendState = &colorBlendState;
@@ -1245,16 +1289,19 @@ namespace ae3d
 
     void CreateDescriptorPool()
     {
-        VkDescriptorPoolSize typeCounts[ 2 ];
+        VkDescriptorPoolSize typeCounts[ 3 ];
         typeCounts[ 0 ].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         typeCounts[ 0 ].descriptorCount = AE3D_DESCRIPTOR_SETS_COUNT;
         typeCounts[ 1 ].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         typeCounts[ 1 ].descriptorCount = AE3D_DESCRIPTOR_SETS_COUNT;
+        // Per-tile light lists, point lights and culler uniforms.
+        typeCounts[ 2 ].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        typeCounts[ 2 ].descriptorCount = AE3D_DESCRIPTOR_SETS_COUNT * 3;
 
         VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
         descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         descriptorPoolInfo.pNext = nullptr;
-        descriptorPoolInfo.poolSizeCount = 2;
+        descriptorPoolInfo.poolSizeCount = 3;
         descriptorPoolInfo.pPoolSizes = typeCounts;
         descriptorPoolInfo.maxSets = AE3D_DESCRIPTOR_SETS_COUNT;
         descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
@@ -1305,8 +1352,32 @@ namespace ae3d
         samplerSet.pImageInfo = &samplerDesc;
         samplerSet.dstBinding = 1;
 
-        VkWriteDescriptorSet sets[ 2 ] = { uboSet, samplerSet };
-        vkUpdateDescriptorSets( GfxDeviceGlobal::device, 2, sets, 0, nullptr );
+        // Bindings LightTiler::PerTileLightIndicesBinding etc. : Forward+ light lists. Until the first CullLights they are left unwritten,
+        // so shaders that read them must not be drawn before it, like on Metal.
+        const ae3d::LightTiler& lightTiler = GfxDeviceGlobal::lightTiler;
+        const VkDescriptorBufferInfo lightListInfos[ 3 ] =
+        {
+            { lightTiler.GetPerTileLightIndexBuffer(), 0, VK_WHOLE_SIZE },
+            { lightTiler.GetPointLightCenterAndRadiusBuffer(), 0, VK_WHOLE_SIZE },
+            { lightTiler.GetCullerUniforms(), 0, VK_WHOLE_SIZE }
+        };
+        const std::uint32_t lightListBindings[ 3 ] = { ae3d::LightTiler::PerTileLightIndicesBinding, ae3d::LightTiler::PointLightsBinding,
+                                                       ae3d::LightTiler::CullerUniformsBinding };
+
+        VkWriteDescriptorSet sets[ 5 ] = { uboSet, samplerSet };
+
+        for (int i = 0; i < 3; ++i)
+        {
+            VkWriteDescriptorSet& lightListSet = sets[ 2 + i ];
+            lightListSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            lightListSet.dstSet = outDescriptorSet;
+            lightListSet.descriptorCount = 1;
+            lightListSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            lightListSet.pBufferInfo = &lightListInfos[ i ];
+            lightListSet.dstBinding = lightListBindings[ i ];
+        }
+
+        vkUpdateDescriptorSets( GfxDeviceGlobal::device, lightTiler.HasLightLists() ? 5 : 2, sets, 0, nullptr );
 
         return outDescriptorSet;
     }
@@ -1329,12 +1400,23 @@ namespace ae3d
         layoutBindingSampler.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
         layoutBindingSampler.pImmutableSamplers = nullptr;
 
-        const VkDescriptorSetLayoutBinding bindings[2] = { layoutBindingUBO, layoutBindingSampler };
+        // Bindings LightTiler::PerTileLightIndicesBinding etc. : Forward+ light lists (Fragment shader)
+        VkDescriptorSetLayoutBinding bindings[ 5 ] = { layoutBindingUBO, layoutBindingSampler };
+        const std::uint32_t lightListBindings[ 3 ] = { ae3d::LightTiler::PerTileLightIndicesBinding, ae3d::LightTiler::PointLightsBinding,
+                                                       ae3d::LightTiler::CullerUniformsBinding };
+
+        for (int i = 0; i < 3; ++i)
+        {
+            bindings[ 2 + i ].binding = lightListBindings[ i ];
+            bindings[ 2 + i ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[ 2 + i ].descriptorCount = 1;
+            bindings[ 2 + i ].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
 
         VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
         descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         descriptorLayout.pNext = nullptr;
-        descriptorLayout.bindingCount = 2;
+        descriptorLayout.bindingCount = 5;
         descriptorLayout.pBindings = bindings;
 
         VkResult err = vkCreateDescriptorSetLayout( GfxDeviceGlobal::device, &descriptorLayout, nullptr, &GfxDeviceGlobal::descriptorSetLayout );
@@ -1353,6 +1435,8 @@ namespace ae3d
     void CreateRenderer( int samples )
     {
         GfxDeviceGlobal::msaaSampleBits = GetSampleBits( samples );
+        GfxDeviceGlobal::backBufferWidth = WindowGlobal::windowWidth;
+        GfxDeviceGlobal::backBufferHeight = WindowGlobal::windowHeight;
         CreateInstance( &GfxDeviceGlobal::instance );
         
         if (debug::enabled)
@@ -1441,6 +1525,7 @@ namespace ae3d
         AE3D_CHECK_VULKAN( err, "vkCreateSemaphore" );
 
         GfxDevice::SetClearColor( 0, 0, 0 );
+        GfxDeviceGlobal::lightTiler.Init();
     }
 }
 
@@ -1565,45 +1650,107 @@ void ae3d::GfxDevice::DrawLines( int handle )
 
 }
 
+namespace ae3d
+{
+    // Shared by Draw and DrawInstanced.
+    void DrawIndexed( VertexBuffer& vertexBuffer, int startIndex, int endIndex, int firstInstance, int instanceCount, ae3d::Shader& shader,
+                      ae3d::GfxDevice::BlendMode blendMode, ae3d::GfxDevice::DepthFunc depthFunc, ae3d::GfxDevice::CullMode cullMode,
+                      ae3d::GfxDevice::FillMode fillMode, bool isInstanced )
+    {
+        System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
+        System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
+        System::Assert( GfxDeviceGlobal::currentBuffer < GfxDeviceGlobal::drawCmdBuffers.size(), "invalid draw buffer index" );
+        System::Assert( GfxDeviceGlobal::pipelineLayout != VK_NULL_HANDLE, "invalid pipelineLayout" );
+
+        if (GfxDeviceGlobal::view0 == VK_NULL_HANDLE || GfxDeviceGlobal::sampler0 == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        if (shader.GetVertexInfo().module == VK_NULL_HANDLE || shader.GetFragmentInfo().module == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        const unsigned psoHash = GetPSOHash( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, isInstanced );
+
+        if (GfxDeviceGlobal::psoCache.find( psoHash ) == std::end( GfxDeviceGlobal::psoCache ))
+        {
+            CreatePSO( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, isInstanced, psoHash );
+        }
+
+        VkDescriptorSet descriptorSet = AllocateDescriptorSet( GfxDeviceGlobal::frameUbos.back().uboDesc, GfxDeviceGlobal::view0, GfxDeviceGlobal::sampler0 );
+
+        vkCmdBindDescriptorSets( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
+
+        vkCmdBindPipeline( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VK_PIPELINE_BIND_POINT_GRAPHICS, GfxDeviceGlobal::psoCache[ psoHash ] );
+
+        VkDeviceSize offsets[ 1 ] = { 0 };
+        vkCmdBindVertexBuffers( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, vertexBuffer.GetVertexBuffer(), offsets );
+
+        if (isInstanced)
+        {
+            VkDeviceSize instanceOffsets[ 1 ] = { firstInstance * sizeof( float ) * 16 };
+            vkCmdBindVertexBuffers( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VertexBuffer::INSTANCE_BUFFER_BIND_ID, 1,
+                                    &GfxDeviceGlobal::frameInstanceBuffers.back().buffer, instanceOffsets );
+        }
+
+        vkCmdBindIndexBuffer( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], *vertexBuffer.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT16 );
+        vkCmdDrawIndexed( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], (endIndex - startIndex) * 3, instanceCount, startIndex * 3, 0, 0 );
+        Statistics::IncTriangleCount( (endIndex - startIndex) * instanceCount );
+        Statistics::IncDrawCalls();
+    }
+}
+
 void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
                             CullMode cullMode, FillMode fillMode )
 {
-    System::Assert( startIndex > -1 && startIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in startIndex" );
-    System::Assert( endIndex > -1 && endIndex >= startIndex && endIndex <= vertexBuffer.GetFaceCount() / 3, "Invalid vertex buffer draw range in endIndex" );
-    System::Assert( GfxDeviceGlobal::currentBuffer < GfxDeviceGlobal::drawCmdBuffers.size(), "invalid draw buffer index" );
-    System::Assert( GfxDeviceGlobal::pipelineLayout != VK_NULL_HANDLE, "invalid pipelineLayout" );
+    DrawIndexed( vertexBuffer, startIndex, endIndex, 0, 1, shader, blendMode, depthFunc, cullMode, fillMode, false );
+}
 
-    if (GfxDeviceGlobal::view0 == VK_NULL_HANDLE || GfxDeviceGlobal::sampler0 == VK_NULL_HANDLE)
-    {
-        return;
-    }
+void ae3d::GfxDevice::DrawInstanced( VertexBuffer& vertexBuffer, int startIndex, int endIndex, int firstInstance, int instanceCount, Shader& shader,
+                                     BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode )
+{
+    System::Assert( !GfxDeviceGlobal::frameInstanceBuffers.empty(), "UploadInstanceData must be called before DrawInstanced" );
+    DrawIndexed( vertexBuffer, startIndex, endIndex, firstInstance, instanceCount, shader, blendMode, depthFunc, cullMode, fillMode, true );
+}
 
-    if (shader.GetVertexInfo().module == VK_NULL_HANDLE || shader.GetFragmentInfo().module == VK_NULL_HANDLE)
-    {
-        return;
-    }
+void ae3d::GfxDevice::UploadInstanceData( const float* modelMatrices, int instanceCount )
+{
+    const VkDeviceSize bufferSize = instanceCount * sizeof( float ) * 16;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 
-    const unsigned psoHash = GetPSOHash( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode );
+    InstanceBuffer instanceBuffer;
 
-    if (GfxDeviceGlobal::psoCache.find( psoHash ) == std::end( GfxDeviceGlobal::psoCache ))
-    {
-        CreatePSO( vertexBuffer, shader, blendMode, depthFunc, cullMode, fillMode, psoHash );
-    }
+    VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &instanceBuffer.buffer );
+    AE3D_CHECK_VULKAN( err, "vkCreateBuffer instance buffer" );
 
-    VkDescriptorSet descriptorSet = AllocateDescriptorSet( GfxDeviceGlobal::frameUbos.back().uboDesc, GfxDeviceGlobal::view0, GfxDeviceGlobal::sampler0 );
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, instanceBuffer.buffer, &memReqs );
 
-    vkCmdBindDescriptorSets( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                             GfxDeviceGlobal::pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReqs.size;
+    GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &allocInfo.memoryTypeIndex );
+    err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &instanceBuffer.memory );
+    AE3D_CHECK_VULKAN( err, "vkAllocateMemory instance buffer" );
+    Statistics::IncAllocCalls();
 
-    vkCmdBindPipeline( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VK_PIPELINE_BIND_POINT_GRAPHICS, GfxDeviceGlobal::psoCache[ psoHash ] );
+    err = vkBindBufferMemory( GfxDeviceGlobal::device, instanceBuffer.buffer, instanceBuffer.memory, 0 );
+    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory instance buffer" );
 
-    VkDeviceSize offsets[ 1 ] = { 0 };
-    vkCmdBindVertexBuffers( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, vertexBuffer.GetVertexBuffer(), offsets );
+    void* mappedMemory = nullptr;
+    err = vkMapMemory( GfxDeviceGlobal::device, instanceBuffer.memory, 0, bufferSize, 0, &mappedMemory );
+    AE3D_CHECK_VULKAN( err, "vkMapMemory instance buffer" );
+    std::memcpy( mappedMemory, modelMatrices, static_cast< std::size_t >( bufferSize ) );
+    vkUnmapMemory( GfxDeviceGlobal::device, instanceBuffer.memory );
 
-    vkCmdBindIndexBuffer( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], *vertexBuffer.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT16 );
-    vkCmdDrawIndexed( GfxDeviceGlobal::drawCmdBuffers[ GfxDeviceGlobal::currentBuffer ], (endIndex - startIndex) * 3, 1, startIndex * 3, 0, 0 );
-    Statistics::IncTriangleCount( endIndex - startIndex );
-    Statistics::IncDrawCalls();
+    GfxDeviceGlobal::frameInstanceBuffers.push_back( instanceBuffer );
 }
 
 void ae3d::GfxDevice::CreateNewUniformBuffer()
@@ -1710,8 +1857,15 @@ void ae3d::GfxDevice::Present()
         vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::frameUbos[ i ].ubo, nullptr );
     }
 
+    for (std::size_t i = 0; i < GfxDeviceGlobal::frameInstanceBuffers.size(); ++i)
+    {
+        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::frameInstanceBuffers[ i ].memory, nullptr );
+        vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::frameInstanceBuffers[ i ].buffer, nullptr );
+    }
+
     GfxDeviceGlobal::pendingFreeVBs.clear();
     GfxDeviceGlobal::frameUbos.clear();
+    GfxDeviceGlobal::frameInstanceBuffers.clear();
 }
 
 void ae3d::GfxDevice::ReleaseGPUObjects()
@@ -1754,6 +1908,7 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
     TextureCube::DestroyTextures();
     RenderTexture::DestroyTextures();
     VertexBuffer::DestroyBuffers();
+    GfxDeviceGlobal::lightTiler.DestroyBuffers();
 
     for (auto pso : GfxDeviceGlobal::psoCache)
     {
@@ -0,0 +1,350 @@
+#include "LightTiler.hpp"
+#include <cstring>
+#include <vulkan/vulkan.h>
+#include "ComputeShader.hpp"
+#include "Macros.hpp"
+#include "Matrix.hpp"
+#include "RenderTexture.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "Vec3.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern VkDevice device;
+    extern VkCommandBuffer computeCmdBuffer;
+    extern VkQueue graphicsQueue;
+    extern VkPipelineCache pipelineCache;
+}
+
+namespace ae3d
+{
+    void GetMemoryType( std::uint32_t typeBits, VkFlags properties, std::uint32_t* typeIndex );
+}
+
+using namespace ae3d;
+
+// Layout matches CullerUniforms in LightCuller.comp.
+struct CullerUniforms
+{
+    Matrix44 invProjection;
+    Matrix44 viewMatrix;
+    unsigned windowWidth;
+    unsigned windowHeight;
+    unsigned numLights;
+    int maxNumLightsPerTile;
+};
+
+namespace
+{
+    // Bindings in LightCuller.comp.
+    const std::uint32_t UniformBinding = 0;
+    const std::uint32_t PointLightBinding = 1;
+    const std::uint32_t PerTileLightIndexBinding = 2;
+    const std::uint32_t LightCountPerTileBinding = 3;
+    const std::uint32_t DepthNormalsBinding = 4;
+
+    template< class Buffer > void CreateBuffer( VkDeviceSize size, VkMemoryPropertyFlags properties, Buffer& outBuffer )
+    {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &outBuffer.buffer );
+        AE3D_CHECK_VULKAN( err, "vkCreateBuffer light tiler" );
+
+        VkMemoryRequirements memReqs;
+        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, outBuffer.buffer, &memReqs );
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memReqs.size;
+        GetMemoryType( memReqs.memoryTypeBits, properties, &allocInfo.memoryTypeIndex );
+        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &outBuffer.memory );
+        AE3D_CHECK_VULKAN( err, "vkAllocateMemory light tiler" );
+        Statistics::IncAllocCalls();
+
+        err = vkBindBufferMemory( GfxDeviceGlobal::device, outBuffer.buffer, outBuffer.memory, 0 );
+        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory light tiler" );
+
+        if ((properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+        {
+            err = vkMapMemory( GfxDeviceGlobal::device, outBuffer.memory, 0, size, 0, &outBuffer.mappedData );
+            AE3D_CHECK_VULKAN( err, "vkMapMemory light tiler" );
+        }
+    }
+
+    template< class Buffer > void DestroyBuffer( Buffer& buffer )
+    {
+        if (buffer.buffer == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        vkDestroyBuffer( GfxDeviceGlobal::device, buffer.buffer, nullptr );
+        vkFreeMemory( GfxDeviceGlobal::device, buffer.memory, nullptr );
+        buffer = Buffer();
+    }
+
+    VkWriteDescriptorSet MakeBufferWrite( VkDescriptorSet set, std::uint32_t binding, const VkDescriptorBufferInfo* bufferInfo )
+    {
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = binding;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = bufferInfo;
+        return write;
+    }
+}
+
+void ae3d::LightTiler::Init()
+{
+    pointLightCenterAndRadius.resize( MaxLights );
+
+    const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    CreateBuffer( sizeof( CullerUniforms ), hostVisible, uniformBuffer );
+    CreateBuffer( MaxLights * sizeof( Vec4 ), hostVisible, pointLightCenterAndRadiusBuffer );
+
+    VkDescriptorSetLayoutBinding bindings[ 5 ] = {};
+
+    for (std::uint32_t i = 0; i < 5; ++i)
+    {
+        bindings[ i ].binding = i;
+        bindings[ i ].descriptorType = i == DepthNormalsBinding ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[ i ].descriptorCount = 1;
+        bindings[ i ].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 5;
+    layoutInfo.pBindings = bindings;
+
+    VkResult err = vkCreateDescriptorSetLayout( GfxDeviceGlobal::device, &layoutInfo, nullptr, &descriptorSetLayout );
+    AE3D_CHECK_VULKAN( err, "vkCreateDescriptorSetLayout light tiler" );
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+
+    err = vkCreatePipelineLayout( GfxDeviceGlobal::device, &pipelineLayoutInfo, nullptr, &pipelineLayout );
+    AE3D_CHECK_VULKAN( err, "vkCreatePipelineLayout light tiler" );
+
+    const VkDescriptorPoolSize poolSizes[ 2 ] =
+    {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = 1;
+
+    err = vkCreateDescriptorPool( GfxDeviceGlobal::device, &poolInfo, nullptr, &descriptorPool );
+    AE3D_CHECK_VULKAN( err, "vkCreateDescriptorPool light tiler" );
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    err = vkAllocateDescriptorSets( GfxDeviceGlobal::device, &allocInfo, &descriptorSet );
+    AE3D_CHECK_VULKAN( err, "vkAllocateDescriptorSets light tiler" );
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxAnisotropy = 1;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+
+    err = vkCreateSampler( GfxDeviceGlobal::device, &samplerInfo, nullptr, &depthNormalsSampler );
+    AE3D_CHECK_VULKAN( err, "vkCreateSampler light tiler" );
+
+    const VkDescriptorBufferInfo uniformInfo = { uniformBuffer.buffer, 0, VK_WHOLE_SIZE };
+    const VkDescriptorBufferInfo pointLightInfo = { pointLightCenterAndRadiusBuffer.buffer, 0, VK_WHOLE_SIZE };
+    const VkWriteDescriptorSet writes[ 2 ] =
+    {
+        MakeBufferWrite( descriptorSet, UniformBinding, &uniformInfo ),
+        MakeBufferWrite( descriptorSet, PointLightBinding, &pointLightInfo )
+    };
+
+    vkUpdateDescriptorSets( GfxDeviceGlobal::device, 2, writes, 0, nullptr );
+}
+
+bool ae3d::LightTiler::HasLightLists() const
+{
+    return perTileLightIndexBuffer.buffer != VK_NULL_HANDLE;
+}
+
+void ae3d::LightTiler::DestroyBuffers()
+{
+    if (GfxDeviceGlobal::device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    DestroyBuffer( uniformBuffer );
+    DestroyBuffer( pointLightCenterAndRadiusBuffer );
+    DestroyBuffer( perTileLightIndexBuffer );
+    DestroyBuffer( lightCountPerTileBuffer );
+    bufferTileCount = 0;
+
+    vkDestroyPipeline( GfxDeviceGlobal::device, pipeline, nullptr );
+    vkDestroyPipelineLayout( GfxDeviceGlobal::device, pipelineLayout, nullptr );
+    vkDestroyDescriptorPool( GfxDeviceGlobal::device, descriptorPool, nullptr );
+    vkDestroyDescriptorSetLayout( GfxDeviceGlobal::device, descriptorSetLayout, nullptr );
+    vkDestroySampler( GfxDeviceGlobal::device, depthNormalsSampler, nullptr );
+    pipeline = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSetLayout = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+    depthNormalsSampler = VK_NULL_HANDLE;
+}
+
+void ae3d::LightTiler::UpdateLightBuffers()
+{
+    if (pointLightCenterAndRadiusBuffer.mappedData != nullptr)
+    {
+        std::memcpy( pointLightCenterAndRadiusBuffer.mappedData, pointLightCenterAndRadius.data(), activePointLights * sizeof( Vec4 ) );
+    }
+}
+
+void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& view, RenderTexture& depthNormalTarget )
+{
+    // LightCuller.spv was not deployed.
+    if (shader.GetVertexInfo().module == VK_NULL_HANDLE || descriptorSet == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    if (pipeline == VK_NULL_HANDLE)
+    {
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = shader.GetVertexInfo();
+        pipelineInfo.layout = pipelineLayout;
+
+        VkResult err = vkCreateComputePipelines( GfxDeviceGlobal::device, GfxDeviceGlobal::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline );
+        AE3D_CHECK_VULKAN( err, "vkCreateComputePipelines light tiler" );
+    }
+
+    const unsigned numTiles = GetNumTilesX() * GetNumTilesY();
+
+    if (numTiles != bufferTileCount)
+    {
+        // The previous cull has finished because CullLights waits for the queue.
+        DestroyBuffer( perTileLightIndexBuffer );
+        DestroyBuffer( lightCountPerTileBuffer );
+
+        CreateBuffer( GetMaxNumLightsPerTile() * numTiles * sizeof( unsigned ), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, perTileLightIndexBuffer );
+        CreateBuffer( numTiles * sizeof( unsigned ), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lightCountPerTileBuffer );
+        bufferTileCount = numTiles;
+    }
+
+    CullerUniforms uniforms;
+
+    Matrix44::Invert( projection, uniforms.invProjection );
+
+    uniforms.viewMatrix = view;
+    uniforms.windowWidth = depthNormalTarget.GetWidth();
+    uniforms.windowHeight = depthNormalTarget.GetHeight();
+    unsigned activeSpotLights = 0;
+    uniforms.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    uniforms.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+
+    cullerUniformsCreated = true;
+
+    std::memcpy( uniformBuffer.mappedData, &uniforms, sizeof( CullerUniforms ) );
+
+    const VkDescriptorBufferInfo perTileLightIndexInfo = { perTileLightIndexBuffer.buffer, 0, VK_WHOLE_SIZE };
+    const VkDescriptorBufferInfo lightCountPerTileInfo = { lightCountPerTileBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+    VkDescriptorImageInfo depthNormalsInfo = {};
+    depthNormalsInfo.sampler = depthNormalsSampler;
+    depthNormalsInfo.imageView = depthNormalTarget.GetColorView();
+    depthNormalsInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet depthNormalsWrite = {};
+    depthNormalsWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    depthNormalsWrite.dstSet = descriptorSet;
+    depthNormalsWrite.dstBinding = DepthNormalsBinding;
+    depthNormalsWrite.descriptorCount = 1;
+    depthNormalsWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    depthNormalsWrite.pImageInfo = &depthNormalsInfo;
+
+    const VkWriteDescriptorSet writes[ 3 ] =
+    {
+        MakeBufferWrite( descriptorSet, PerTileLightIndexBinding, &perTileLightIndexInfo ),
+        MakeBufferWrite( descriptorSet, LightCountPerTileBinding, &lightCountPerTileInfo ),
+        depthNormalsWrite
+    };
+
+    vkUpdateDescriptorSets( GfxDeviceGlobal::device, 3, writes, 0, nullptr );
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::computeCmdBuffer, &beginInfo );
+    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer light tiler" );
+
+    vkCmdBindPipeline( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline );
+    vkCmdBindDescriptorSets( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr );
+
+    shader.SetRenderTexture( &depthNormalTarget, 0 );
+    shader.Dispatch( GetNumTilesX(), GetNumTilesY(), 1 );
+
+    // Makes the lists visible to forward passes and the counts to GetLightCountPerTile.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier( GfxDeviceGlobal::computeCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+    Statistics::IncBarrierCalls();
+
+    err = vkEndCommandBuffer( GfxDeviceGlobal::computeCmdBuffer );
+    AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer light tiler" );
+
+    // computeCmdBuffer is allocated from the graphics queue family's pool, so it's submitted to the graphics queue.
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &GfxDeviceGlobal::computeCmdBuffer;
+
+    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
+    AE3D_CHECK_VULKAN( err, "vkQueueSubmit light tiler" );
+
+    // Keeps the uniform and light buffers single-buffered.
+    err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
+    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle light tiler" );
+    Statistics::IncFenceCalls();
+}
+
+void ae3d::LightTiler::GetLightCountPerTile( std::vector< unsigned >& outLightCounts )
+{
+    outLightCounts.clear();
+
+    // The back buffer has been resized after the last CullLights.
+    if (lightCountPerTileBuffer.mappedData == nullptr || GetNumTilesX() * GetNumTilesY() != bufferTileCount)
+    {
+        return;
+    }
+
+    // LightCuller.comp's tile 0 is the top-left one.
+    outLightCounts.resize( bufferTileCount );
+    std::memcpy( outLightCounts.data(), lightCountPerTileBuffer.mappedData, bufferTileCount * sizeof( unsigned ) );
+}
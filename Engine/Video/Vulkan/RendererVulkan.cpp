@@ -1,13 +1,21 @@
-#include "Renderer.hpp"
-#include "FileSystem.hpp"
-
-ae3d::Renderer renderer;
-
-void ae3d::BuiltinShaders::Load()
-{
-    spriteRendererShader.LoadSPIRV( FileSystem::FileContents( "sprite_vert.spv" ), FileSystem::FileContents( "sprite_frag.spv" ) );
-    sdfShader.LoadSPIRV( FileSystem::FileContents( "sprite_vert.spv" ), FileSystem::FileContents( "sprite_frag.spv" ) );
-    skyboxShader.LoadSPIRV( FileSystem::FileContents( "skybox_vert.spv" ), FileSystem::FileContents( "skybox_frag.spv" ) );
-    momentsShader.LoadSPIRV( FileSystem::FileContents( "unlit_vert.spv" ), FileSystem::FileContents( "unlit_frag.spv" ) );
-    depthNormalsShader.LoadSPIRV( FileSystem::FileContents( "unlit_vert.spv" ), FileSystem::FileContents( "unlit_frag.spv" ) );
-}
+#include "Renderer.hpp"
+#include "FileSystem.hpp"
+
+ae3d::Renderer renderer;
+
+void ae3d::BuiltinShaders::Load()
+{
+    spriteRendererShader.LoadSPIRV( FileSystem::FileContents( "sprite_vert.spv" ), FileSystem::FileContents( "sprite_frag.spv" ) );
+    sdfShader.LoadSPIRV( FileSystem::FileContents( "sprite_vert.spv" ), FileSystem::FileContents( "sprite_frag.spv" ) );
+    skyboxShader.LoadSPIRV( FileSystem::FileContents( "skybox_vert.spv" ), FileSystem::FileContents( "skybox_frag.spv" ) );
+    momentsShader.LoadSPIRV( FileSystem::FileContents( "unlit_vert.spv" ), FileSystem::FileContents( "unlit_frag.spv" ) );
+    depthNormalsShader.LoadSPIRV( FileSystem::FileContents( "unlit_vert.spv" ), FileSystem::FileContents( "unlit_frag.spv" ) );
+
+    const FileSystem::FileContentsData lightCullerSPIRV = FileSystem::FileContents( "LightCuller.spv" );
+
+    // LightTiler skips culling if the shader isn't deployed.
+    if (lightCullerSPIRV.isLoaded)
+    {
+        lightCullShader.Load( "light_culler", FileSystem::FileContents( "" ), lightCullerSPIRV );
+    }
+}
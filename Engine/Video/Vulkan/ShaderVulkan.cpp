@@ -8,6 +8,7 @@
 #include "TextureCube.hpp"
 #include "RenderTexture.hpp"
 #include "Vec3.hpp"
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
@@ -73,6 +74,11 @@ void ae3d::Shader::LoadSPIRV( const FileSystem::FileContentsData& vertexData, co
         vertexInfo.pSpecializationInfo = nullptr;
 
         System::Assert( vertexInfo.module != VK_NULL_HANDLE, "vertex shader module not created" );
+
+        // Attribute names are in the module's debug names, which glslangValidator keeps unless told to strip them.
+        const char instanceAttributeName[] = "aInstanceModelMatrix";
+        isInstanced = std::search( std::begin( vertexData.data ), std::end( vertexData.data ),
+                                   instanceAttributeName, instanceAttributeName + std::strlen( instanceAttributeName ) ) != std::end( vertexData.data );
     }
 
     // Fragment shader
@@ -14,6 +14,7 @@
 #include "VulkanUtils.hpp"
 
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+unsigned char* DecodeSTB( const ae3d::FileSystem::FileView& fileContents, int& outWidth, int& outHeight, int& outComponents ); // Defined in TextureCommon.cpp
 float GetFloatAnisotropy( ae3d::Anisotropy anisotropy );
 void Tokenize( const std::string& str,
 std::vector< std::string >& tokens,
@@ -73,7 +74,7 @@ void ae3d::Texture2D::DestroyTextures()
     }
 }
 
-void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+void ae3d::Texture2D::Load( const FileSystem::FileView& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     // TODO: Move somewhere else.
     if (Texture2DGlobal::texCmdBuffer == VK_NULL_HANDLE)
@@ -149,7 +150,7 @@ bool isBC3( VkFormat format )
     return format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
 }
 
-void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkFormat format )
+void ae3d::Texture2D::CreateVulkanObjects( const void* data, int bytesPerPixel, VkFormat format )
 {
     if (!MathUtil::IsPowerOfTwo( width ) || !MathUtil::IsPowerOfTwo( height ))
     {
@@ -376,7 +377,7 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
 void ae3d::Texture2D::LoadDDS( const char* aPath )
 {
     DDSLoader::Output ddsOutput;
-    auto fileContents = FileSystem::FileContents( aPath );
+    auto fileContents = FileSystem::FileContentsView( aPath );
     const DDSLoader::LoadResult loadResult = DDSLoader::Load( fileContents, 0, width, height, opaque, ddsOutput );
 
     if (loadResult != DDSLoader::LoadResult::Success)
@@ -417,17 +418,17 @@ void ae3d::Texture2D::LoadDDS( const char* aPath )
     
     ae3d::System::Assert( ddsOutput.dataOffsets.size() > 0, "DDS reader error: dataoffsets is empty" );
 
-    CreateVulkanObjects( &fileContents.data[ ddsOutput.dataOffsets[ 0 ] ], bytesPerPixel, format );
+    CreateVulkanObjects( fileContents.data + ddsOutput.dataOffsets[ 0 ], bytesPerPixel, format );
 }
 
-void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileView& fileContents )
 {
     System::Assert( GfxDeviceGlobal::graphicsQueue != VK_NULL_HANDLE, "queue not initialized" );
     System::Assert( GfxDeviceGlobal::device != VK_NULL_HANDLE, "device not initialized" );
     System::Assert( Texture2DGlobal::texCmdBuffer != VK_NULL_HANDLE, "texCmdBuffer not initialized" );
 
     int components;
-    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast<int>(fileContents.data.size()), &width, &height, &components, 4 );
+    unsigned char* data = DecodeSTB( fileContents, width, height, components );
 
     if (data == nullptr)
     {
@@ -435,6 +435,7 @@ namespace ae3d
     void Window::SwapBuffers()
     {
 #if RENDERER_OPENGL
+        GfxDevice::Present();
         ::SwapBuffers( WindowGlobal::hdc );
         Statistics::EndFrameTimeProfiling();
 #endif
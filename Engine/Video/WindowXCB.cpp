@@ -714,6 +714,7 @@ void ae3d::Window::PumpEvents()
 void ae3d::Window::SwapBuffers()
 {
 #if RENDERER_OPENGL
+    GfxDevice::Present();
     glXSwapBuffers( WindowGlobal::display, WindowGlobal::drawable );
 #endif
 #if RENDERER_VULKAN
@@ -1,84 +1,344 @@
 /**
   Combines files listed in input text file into one.
-  
-  Usage: CombineFiles input.txt output
+
+  Usage: CombineFiles [-compress] input.txt output
 
   Input file contains one path per line.
-  
-  Output file's first 4 bytes is the block count. After it blocks are followed where data is ordered like below:
-  offset      data
-      0       file name
-    128       file length
-    132       file contents
+
+  Output file is a version 3 .pak, see Engine/Include/PakFormat.hpp for the layout.
+  With -compress, entries are compressed with LZ4 on all hardware threads, unless compression
+  saves less than MinSavingsPercent. Each entry's ratio and throughput is printed.
 */
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
-#include <sstream>
-#include <list>
+#include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
-#include <cstring>
+#include "PakFormat.hpp"
+#define LZ4_BLOCK_IMPLEMENTATION
+#include "lz4_block.h"
+
+using namespace ae3d;
+
+// Entries that would shrink less than this are stored uncompressed, because decompressing them costs more than the I/O it saves.
+const std::uint64_t MinSavingsPercent = 5;
 
 struct FileMetaBlock
 {
     std::string path;
-    unsigned dataSize;
+    std::uint64_t dataSize;
+    std::uint64_t pathHash;
+    // Contents as they are written into the pak, filled when the entry's batch is processed.
+    std::vector< unsigned char > stored;
+    PakFormat::Compression compression;
+    double compressSeconds;
+    double decompressSeconds;
 };
 
+static void WriteZeros( std::ofstream& ofs, std::uint64_t count )
+{
+    const char zeros[ PakFormat::EntryAlignment ] = {};
+
+    while (count > 0)
+    {
+        const std::uint64_t writeCount = std::min( count, (std::uint64_t)sizeof( zeros ) );
+        ofs.write( zeros, (std::streamsize)writeCount );
+        count -= writeCount;
+    }
+}
+
+static void WritePadding( std::ofstream& ofs, std::uint64_t offset, std::uint64_t alignment )
+{
+    WriteZeros( ofs, PakFormat::Align( offset, alignment ) - offset );
+}
+
+static double SecondsSince( std::chrono::high_resolution_clock::time_point start )
+{
+    return std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+}
+
+// Compresses data into file.stored as independent chunks. Leaves file.stored empty if compression doesn't pay off.
+// Chunks are decompressed again to verify them and to measure decompression throughput.
+static bool Compress( const std::vector< unsigned char >& data, FileMetaBlock& file )
+{
+    const std::uint64_t chunkCount = (data.size() + PakFormat::DefaultChunkSize - 1) / PakFormat::DefaultChunkSize;
+    std::vector< unsigned char > chunk( (std::size_t)lz4b_compress_bound( (int)PakFormat::DefaultChunkSize ) );
+    std::vector< unsigned char > decompressed( PakFormat::DefaultChunkSize );
+
+    file.stored.assign( (std::size_t)chunkCount * sizeof( std::uint32_t ), 0 );
+
+    for (std::uint64_t i = 0; i < chunkCount; ++i)
+    {
+        const unsigned char* src = data.data() + i * PakFormat::DefaultChunkSize;
+        const int srcSize = (int)std::min( (std::uint64_t)PakFormat::DefaultChunkSize, data.size() - i * PakFormat::DefaultChunkSize );
+
+        auto start = std::chrono::high_resolution_clock::now();
+        const int compressedSize = lz4b_compress( src, srcSize, chunk.data(), (int)chunk.size() );
+        file.compressSeconds += SecondsSince( start );
+
+        std::uint32_t chunkStoredSize = 0;
+
+        if (compressedSize == 0 || compressedSize >= srcSize)
+        {
+            chunkStoredSize = (std::uint32_t)srcSize | PakFormat::ChunkStoredRaw;
+            file.stored.insert( std::end( file.stored ), src, src + srcSize );
+        }
+        else
+        {
+            start = std::chrono::high_resolution_clock::now();
+            const int decompressedSize = lz4b_decompress( chunk.data(), compressedSize, decompressed.data(), srcSize );
+            file.decompressSeconds += SecondsSince( start );
+
+            if (decompressedSize != srcSize || std::memcmp( decompressed.data(), src, (std::size_t)srcSize ) != 0)
+            {
+                std::cout << "Compressing " << file.path << " failed verification" << std::endl;
+                return false;
+            }
+
+            chunkStoredSize = (std::uint32_t)compressedSize;
+            file.stored.insert( std::end( file.stored ), chunk.data(), chunk.data() + compressedSize );
+        }
+
+        std::memcpy( file.stored.data() + i * sizeof( std::uint32_t ), &chunkStoredSize, sizeof( chunkStoredSize ) );
+    }
+
+    if (file.stored.size() * 100 > data.size() * (100 - MinSavingsPercent))
+    {
+        file.stored.clear();
+    }
+
+    return true;
+}
+
+// Reads and optionally compresses files [begin, end) on all hardware threads.
+static bool ProcessBatch( std::vector< FileMetaBlock >& fileList, std::size_t begin, std::size_t end, bool compress )
+{
+    std::atomic< std::size_t > nextIndex( begin );
+    std::atomic< bool > succeeded( true );
+    const unsigned threadCount = std::max( std::thread::hardware_concurrency(), 1u );
+    std::vector< std::thread > threads;
+
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.push_back( std::thread( [&]()
+        {
+            for (std::size_t i = nextIndex++; i < end; i = nextIndex++)
+            {
+                FileMetaBlock& file = fileList[ i ];
+                std::vector< unsigned char > data;
+                std::ifstream ifs( file.path, std::ios::binary );
+                data.assign( std::istreambuf_iterator< char >( ifs ), std::istreambuf_iterator< char >() );
+
+                if (data.size() != file.dataSize)
+                {
+                    std::cout << file.path << " changed while combining" << std::endl;
+                    succeeded = false;
+                    continue;
+                }
+
+                if (compress && !data.empty())
+                {
+                    if (!Compress( data, file ))
+                    {
+                        succeeded = false;
+                        continue;
+                    }
+                }
+
+                if (file.stored.empty())
+                {
+                    file.stored.swap( data );
+                }
+                else
+                {
+                    file.compression = PakFormat::Compression::LZ4;
+                }
+            }
+        } ) );
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    return succeeded;
+}
+
 int main( int argCount, char* args[] )
 {
-    if (argCount != 3)
+    const bool compress = argCount == 4 && std::string( args[ 1 ] ) == "-compress";
+
+    if (argCount != 3 && !compress)
     {
-        std::cout << "Usage: CombineFiles indexFile.txt outputfile" << std::endl;
+        std::cout << "Usage: CombineFiles [-compress] indexFile.txt outputfile" << std::endl;
         return 1;
     }
 
-    std::ifstream fileListFile( args[ 1 ] );
+    const char* listPath = args[ argCount - 2 ];
+    const char* outputPath = args[ argCount - 1 ];
+
+    std::ifstream fileListFile( listPath );
     if (!fileListFile.is_open())
     {
-        std::cout << "Could not open " << args[ 1 ] << std::endl;
+        std::cout << "Could not open " << listPath << std::endl;
         return 1;
     }
 
-    std::list< FileMetaBlock > fileList;
+    std::vector< FileMetaBlock > fileList;
     std::string line;
-    const unsigned MaxPathLength = 128;
 
     while (std::getline( fileListFile, line ))
     {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        if (line.empty())
+        {
+            continue;
+        }
+
         fileList.push_back( FileMetaBlock() );
         fileList.back().path = line;
-        
-        if (line.length() > MaxPathLength)
+        fileList.back().pathHash = PakFormat::HashPath( line.c_str(), (std::uint32_t)line.length() );
+        fileList.back().compression = PakFormat::Compression::None;
+        fileList.back().compressSeconds = 0;
+        fileList.back().decompressSeconds = 0;
+    }
+
+    // 1st pass: Determine file sizes.
+    for (auto& file : fileList)
+    {
+        std::ifstream ifs( file.path, std::ios::binary | std::ios::ate );
+
+        if (!ifs.is_open())
         {
-            std::cout << "Too long path in " << line << ". Max length is " << MaxPathLength << std::endl;
+            std::cout << "Could not open " << file.path << std::endl;
             return 1;
         }
+
+        file.dataSize = static_cast< std::uint64_t >( ifs.tellg() );
     }
 
-    // 1st pass: Determine file sizes.    
-    for (auto& file : fileList)
+    // Sorting by hash makes each bucket's entries contiguous.
+    std::stable_sort( std::begin( fileList ), std::end( fileList ), []( const FileMetaBlock& a, const FileMetaBlock& b ) { return a.pathHash < b.pathHash; } );
+
+    PakFormat::Header header = {};
+    std::memcpy( header.magic, "AEPK", 4 );
+    header.version = PakFormat::Version;
+    header.entryCount = static_cast< std::uint32_t >( fileList.size() );
+    // About one entry per bucket.
+    header.bucketCount = std::max( header.entryCount, 1u );
+
+    std::vector< std::uint32_t > buckets( header.bucketCount + 1, 0 );
+
+    for (const auto& file : fileList)
+    {
+        ++buckets[ PakFormat::GetBucket( file.pathHash, header.bucketCount ) + 1 ];
+    }
+
+    for (std::size_t i = 1; i < buckets.size(); ++i)
+    {
+        buckets[ i ] += buckets[ i - 1 ];
+    }
+
+    header.tocOffset = PakFormat::Align( sizeof( header ) + buckets.size() * sizeof( std::uint32_t ), alignof( PakFormat::TocEntry ) );
+    header.stringsOffset = header.tocOffset + fileList.size() * sizeof( PakFormat::TocEntry );
+
+    std::vector< PakFormat::TocEntry > toc( fileList.size() );
+    std::uint64_t stringsSize = 0;
+
+    for (std::size_t i = 0; i < fileList.size(); ++i)
     {
-        std::ifstream ifs( file.path );
-        ifs.seekg( 0, std::ios::end );
-        file.dataSize = static_cast< unsigned >( ifs.tellg() );
+        toc[ i ].pathHash = fileList[ i ].pathHash;
+        toc[ i ].size = fileList[ i ].dataSize;
+        toc[ i ].pathOffset = static_cast< std::uint32_t >( stringsSize );
+        toc[ i ].pathLength = static_cast< std::uint32_t >( fileList[ i ].path.length() );
+        stringsSize += fileList[ i ].path.length();
     }
-    
-    std::ofstream ofs( args[ 2 ], std::ios::out | std::ios::binary );
-    const unsigned listLength = static_cast< unsigned >( fileList.size() );
-    ofs.write( (char*)&listLength, 4 );
+
+    std::ofstream ofs( outputPath, std::ios::out | std::ios::binary );
+    if (!ofs.is_open())
+    {
+        std::cout << "Could not open " << outputPath << std::endl;
+        return 1;
+    }
+
+    // Header and TOC are written last, when entry offsets and stored sizes are known.
+    std::uint64_t offset = header.stringsOffset + stringsSize;
+    WriteZeros( ofs, offset );
+
+    // Batches bound memory use and keep the entry order independent of thread timing.
+    const std::size_t batchSize = std::max( std::thread::hardware_concurrency(), 1u ) * 4;
+
+    for (std::size_t begin = 0; begin < fileList.size(); begin += batchSize)
+    {
+        const std::size_t end = std::min( begin + batchSize, fileList.size() );
+
+        if (!ProcessBatch( fileList, begin, end, compress ))
+        {
+            return 1;
+        }
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            WritePadding( ofs, offset, PakFormat::EntryAlignment );
+            toc[ i ].offset = PakFormat::Align( offset, PakFormat::EntryAlignment );
+            toc[ i ].storedSize = fileList[ i ].stored.size();
+            toc[ i ].compression = fileList[ i ].compression;
+            toc[ i ].chunkSize = fileList[ i ].compression == PakFormat::Compression::None ? 0 : PakFormat::DefaultChunkSize;
+            ofs.write( (const char*)fileList[ i ].stored.data(), (std::streamsize)fileList[ i ].stored.size() );
+            offset = toc[ i ].offset + toc[ i ].storedSize;
+            std::vector< unsigned char >().swap( fileList[ i ].stored );
+        }
+    }
+
+    ofs.seekp( 0 );
+    ofs.write( (const char*)&header, sizeof( header ) );
+    ofs.write( (const char*)buckets.data(), (std::streamsize)(buckets.size() * sizeof( std::uint32_t )) );
+    WritePadding( ofs, sizeof( header ) + buckets.size() * sizeof( std::uint32_t ), alignof( PakFormat::TocEntry ) );
+    ofs.write( (const char*)toc.data(), (std::streamsize)(toc.size() * sizeof( PakFormat::TocEntry )) );
 
     for (const auto& file : fileList)
     {
-        char path[ MaxPathLength ] = { 0 };
-        std::strcpy( path, file.path.c_str() );
-        ofs.write( (char*)path, MaxPathLength );
-        ofs.write( (char*)&file.dataSize, 4 );
-        std::vector< unsigned char > data;
-        std::ifstream ifs( file.path );
-        data.assign( std::istreambuf_iterator< char >( ifs ), std::istreambuf_iterator< char >() );
-        ofs.write( (char*)data.data(), data.size() );
+        ofs.write( file.path.c_str(), (std::streamsize)file.path.length() );
+    }
+
+    if (compress)
+    {
+        std::uint64_t totalSize = 0;
+        std::uint64_t totalStoredSize = 0;
+
+        for (std::size_t i = 0; i < fileList.size(); ++i)
+        {
+            const FileMetaBlock& file = fileList[ i ];
+            const double megabytes = file.dataSize / (1024.0 * 1024.0);
+            std::printf( "%s: %llu -> %llu bytes (%.1f%%)", file.path.c_str(), (unsigned long long)file.dataSize, (unsigned long long)toc[ i ].storedSize,
+                         file.dataSize == 0 ? 100.0 : 100.0 * toc[ i ].storedSize / file.dataSize );
+
+            if (file.compression == PakFormat::Compression::None)
+            {
+                std::printf( ", stored\n" );
+            }
+            else
+            {
+                std::printf( ", compress %.0f MB/s, decompress %.0f MB/s\n", megabytes / std::max( file.compressSeconds, 1e-9 ), megabytes / std::max( file.decompressSeconds, 1e-9 ) );
+            }
+
+            totalSize += file.dataSize;
+            totalStoredSize += toc[ i ].storedSize;
+        }
+
+        std::printf( "Total: %llu -> %llu bytes (%.1f%%)\n", (unsigned long long)totalSize, (unsigned long long)totalStoredSize,
+                     totalSize == 0 ? 100.0 : 100.0 * totalStoredSize / totalSize );
     }
 
-    return 0;
+    return ofs.good() ? 0 : 1;
 }